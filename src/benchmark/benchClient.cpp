@@ -0,0 +1,51 @@
+#include <stdexcept>
+#include <unistd.h>
+
+#include "benchClient.hpp"
+
+namespace Benchmark
+{
+void readFull(int fd, uint8_t *buffer, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t ret = read(fd, buffer, len);
+        if(ret <= 0)
+            throw std::runtime_error("read failed");
+        buffer += ret;
+        len -= ret;
+    }
+}
+
+Message readFrame(int fd, std::vector<uint8_t> &buffer)
+{
+    buffer.resize(Message::maxMessageLen);
+
+    uint32_t messageLen = 0;
+    readFull(fd, buffer.data(), sizeof(messageLen));
+    Utilities::Endian::Instance().readWithEndianness(messageLen, buffer.data(), Message::messageEndianness);
+    if(messageLen > buffer.size() || messageLen < Message::overheadLen)
+        throw std::runtime_error("invalid frame length");
+    readFull(fd, buffer.data() + sizeof(messageLen), messageLen - sizeof(messageLen));
+    return Message(buffer.data(), messageLen);
+}
+
+void sendCommand(int fd, uint32_t sourceId, ServerProtocol::Command command, const PayloadWriter &body)
+{
+    PayloadWriter payload;
+    payload.write(static_cast<uint8_t>(command));
+    payload.writeBytes(body.getPointer(), body.getLen());
+
+    Message request(sourceId, 0, payload.getPointer(), payload.getLen());
+    const uint8_t *data = request.getMessagePointer();
+    size_t         len  = request.getMessageLen();
+    while(len > 0)
+    {
+        ssize_t ret = write(fd, data, len);
+        if(ret <= 0)
+            throw std::runtime_error("write failed");
+        data += ret;
+        len -= ret;
+    }
+}
+} // namespace Benchmark
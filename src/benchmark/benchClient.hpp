@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "message/message.hpp"
+#include "message/payload.hpp"
+#include "server/serverProtocol.hpp"
+
+// Client side of simulated node connections, shared by the benchmarks that talk to the server over sockets
+namespace Benchmark
+{
+// Reads exactly len bytes, throws if the connection is closed before
+void readFull(int fd, uint8_t *buffer, size_t len);
+
+// Reads one complete message frame, a frame can take more than one read on a stream socket
+Message readFrame(int fd, std::vector<uint8_t> &buffer);
+
+// Sends a server command as node sourceId
+void sendCommand(int fd, uint32_t sourceId, ServerProtocol::Command command, const PayloadWriter &body);
+} // namespace Benchmark
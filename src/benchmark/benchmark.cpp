@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "benchmark.hpp"
+
+namespace Benchmark
+{
+namespace
+{
+struct Result
+{
+    std::string benchmark;
+    std::string metric;
+    std::string unit;
+    double      value;
+    Statistics  statistics; // samplesNum is 0 for a single value
+};
+
+struct Session
+{
+    size_t                                                repetitions = 10;
+    std::vector<Result>                                   results;
+    std::map<std::pair<std::string, std::string>, double> baseline; // By benchmark and metric
+    double                                                thresholdPercent = 0;
+    size_t                                                regressionsNum   = 0;
+};
+
+Session &getSession()
+{
+    static Session session;
+    return session;
+}
+
+std::string escape(const std::string &text)
+{
+    std::string escaped;
+    for(char c : text)
+    {
+        if(c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Reads the string value of "key": "..." from a result line of writeJson
+bool readString(const std::string &line, const std::string &key, std::string &value)
+{
+    size_t pos = line.find("\"" + key + "\": \"");
+    if(pos == std::string::npos)
+        return false;
+
+    value.clear();
+    for(pos += key.size() + 5; pos < line.size() && line[pos] != '"'; pos++)
+    {
+        if(line[pos] == '\\' && pos + 1 < line.size())
+            pos++;
+        value += line[pos];
+    }
+    return pos < line.size();
+}
+
+bool readNumber(const std::string &line, const std::string &key, double &value)
+{
+    size_t pos = line.find("\"" + key + "\": ");
+    if(pos == std::string::npos)
+        return false;
+    return std::sscanf(line.c_str() + pos + key.size() + 4, "%lf", &value) == 1;
+}
+
+// 1 if a higher value is better, -1 if a lower one is, 0 if the unit does not tell
+int getDirection(const std::string &unit)
+{
+    if(unit == "ns" || unit == "ns/op" || unit == "us" || unit == "ms" || unit == "s")
+        return -1;
+    if(unit.size() > 2 && unit.compare(unit.size() - 2, 2, "/s") == 0)
+        return 1;
+    return 0;
+}
+
+// Change against the baseline, e.g. " [+3.1% vs baseline]", empty without a baseline value
+std::string compareWithBaseline(const Result &result)
+{
+    Session &session  = getSession();
+    auto     baseline = session.baseline.find({result.benchmark, result.metric});
+    if(baseline == session.baseline.end() || baseline->second == 0)
+        return "";
+
+    double change    = (result.value - baseline->second) * 100 / baseline->second;
+    int    direction = getDirection(result.unit);
+    bool   regressed = direction != 0 && change * direction < -session.thresholdPercent;
+    if(regressed)
+        session.regressionsNum++;
+
+    char text[64];
+    std::snprintf(text, sizeof(text), " [%+.1f%% vs baseline%s]", change, regressed ? ", REGRESSION" : "");
+    return text;
+}
+} // namespace
+
+Statistics Statistics::calculate(std::vector<double> samples)
+{
+    Statistics statistics;
+    if(samples.empty())
+        return statistics;
+
+    std::sort(samples.begin(), samples.end());
+    size_t middle         = samples.size() / 2;
+    statistics.samplesNum = samples.size();
+    statistics.min        = samples.front();
+    statistics.max        = samples.back();
+    statistics.median     = samples.size() % 2 == 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+
+    for(double sample : samples)
+        statistics.mean += sample;
+    statistics.mean /= samples.size();
+    for(double sample : samples)
+        statistics.stddev += (sample - statistics.mean) * (sample - statistics.mean);
+    statistics.stddev = samples.size() > 1 ? std::sqrt(statistics.stddev / (samples.size() - 1)) : 0;
+    return statistics;
+}
+
+void report(const std::string &benchmark, const std::string &metric, double value, const std::string &unit)
+{
+    Result result{benchmark, metric, unit, value, Statistics()};
+    std::printf("%s: %s = %.3f %s%s\n",
+                benchmark.c_str(),
+                metric.c_str(),
+                value,
+                unit.c_str(),
+                compareWithBaseline(result).c_str());
+    std::fflush(stdout);
+    getSession().results.push_back(result);
+}
+
+void report(const std::string &benchmark,
+            const std::string &metric,
+            const Statistics  &statistics,
+            const std::string &unit)
+{
+    // The spread as relative standard deviation tells whether a change against the baseline is noise
+    Result result{benchmark, metric, unit, statistics.median, statistics};
+    std::printf("%s: %s = %.3f %s (min %.3f, max %.3f, stddev %.1f%%, n=%zu)%s\n",
+                benchmark.c_str(),
+                metric.c_str(),
+                statistics.median,
+                unit.c_str(),
+                statistics.min,
+                statistics.max,
+                statistics.mean != 0 ? statistics.stddev * 100 / statistics.mean : 0,
+                statistics.samplesNum,
+                compareWithBaseline(result).c_str());
+    std::fflush(stdout);
+    getSession().results.push_back(result);
+}
+
+size_t getArgument(const Arguments &arguments, size_t index, size_t defaultValue)
+{
+    if(index >= arguments.size())
+        return defaultValue;
+    return std::stoull(arguments[index]);
+}
+
+void setRepetitions(size_t repetitions)
+{
+    getSession().repetitions = std::max<size_t>(repetitions, 1);
+}
+
+size_t getRepetitions()
+{
+    return getSession().repetitions;
+}
+
+void loadBaseline(const std::string &path, double thresholdPercent)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        throw std::runtime_error("Unable to open baseline " + path);
+    }
+
+    Session &session         = getSession();
+    session.thresholdPercent = thresholdPercent;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::string benchmark;
+        std::string metric;
+        double      value = 0;
+        if(readString(line, "benchmark", benchmark) && readString(line, "metric", metric) &&
+           readNumber(line, "value", value))
+        {
+            session.baseline[{benchmark, metric}] = value;
+        }
+    }
+}
+
+size_t getRegressionsNum()
+{
+    return getSession().regressionsNum;
+}
+
+void writeJson(const std::string &path, const std::string &label)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if(file == nullptr)
+    {
+        throw std::runtime_error("Unable to write " + path);
+    }
+
+    const Session &session = getSession();
+    std::fprintf(file,
+                 "{\"label\": \"%s\", \"timestamp\": %lld, \"repetitions\": %zu, \"results\": [\n",
+                 escape(label).c_str(),
+                 static_cast<long long>(std::time(nullptr)),
+                 session.repetitions);
+    for(size_t i = 0; i < session.results.size(); i++)
+    {
+        const Result &result = session.results[i];
+        std::fprintf(file,
+                     "{\"benchmark\": \"%s\", \"metric\": \"%s\", \"unit\": \"%s\", \"value\": %.6g",
+                     escape(result.benchmark).c_str(),
+                     escape(result.metric).c_str(),
+                     escape(result.unit).c_str(),
+                     result.value);
+        if(result.statistics.samplesNum > 0)
+        {
+            std::fprintf(file,
+                         ", \"min\": %.6g, \"max\": %.6g, \"mean\": %.6g, \"stddev\": %.6g, \"samples\": %zu",
+                         result.statistics.min,
+                         result.statistics.max,
+                         result.statistics.mean,
+                         result.statistics.stddev,
+                         result.statistics.samplesNum);
+        }
+        std::fprintf(file, "}%s\n", i + 1 < session.results.size() ? "," : "");
+    }
+    std::fprintf(file, "]}\n");
+    std::fclose(file);
+}
+} // namespace Benchmark
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Benchmark
+{
+using Arguments         = std::vector<std::string>;
+using BenchmarkFunction = std::function<void(const Arguments &arguments)>;
+
+class Registry
+{
+public:
+    struct Entry
+    {
+        std::string       description;
+        BenchmarkFunction function;
+    };
+
+    static void add(const std::string &name, const std::string &description, BenchmarkFunction function)
+    {
+        getEntries()[name] = Entry{description, function};
+    }
+
+    static std::map<std::string, Entry> &getEntries()
+    {
+        static std::map<std::string, Entry> entries;
+        return entries;
+    }
+};
+
+// Registers a benchmark from a static object in the benchmark source file
+struct Registrar
+{
+    Registrar(const std::string &name, const std::string &description, BenchmarkFunction function)
+    {
+        Registry::add(name, description, function);
+    }
+};
+
+class Stopwatch
+{
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void   restart() { start = std::chrono::steady_clock::now(); }
+    double elapsedSeconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Spread of the repetitions of a measured case
+struct Statistics
+{
+    size_t samplesNum = 0;
+    double min        = 0;
+    double median     = 0;
+    double mean       = 0;
+    double stddev     = 0;
+    double max        = 0;
+
+    static Statistics calculate(std::vector<double> samples);
+};
+
+// Prints a single result line: "<benchmark>: <metric> = <value> <unit>", results are kept for the JSON output and
+// compared with the baseline if one is loaded
+void report(const std::string &benchmark, const std::string &metric, double value, const std::string &unit);
+
+// As above with the median as value, followed by the spread
+void report(const std::string &benchmark,
+            const std::string &metric,
+            const Statistics  &statistics,
+            const std::string &unit);
+
+// Returns the argument at index converted to a number or defaultValue if not given
+size_t getArgument(const Arguments &arguments, size_t index, size_t defaultValue);
+
+// Timed repetitions of a measured case, the warm-up run is not counted
+void   setRepetitions(size_t repetitions);
+size_t getRepetitions();
+
+/* Results of an earlier run written by writeJson. A result that is worse by more than thresholdPercent counts as a
+ * regression: times ("ns", "ns/op", "us", "ms", "s") are worse when higher, rates ("<unit>/s") when lower, other
+ * units are only printed with their change.
+ */
+void   loadBaseline(const std::string &path, double thresholdPercent);
+size_t getRegressionsNum();
+
+/* Writes every result reported so far, one result per line:
+ * {"label": "...", "timestamp": <unix seconds>, "repetitions": n, "results": [
+ * {"benchmark": "...", "metric": "...", "unit": "...", "value": v[, "min": ..., "max": ..., "mean": ..., "stddev": ...,
+ * "samples": n]},
+ * ...]}
+ */
+void writeJson(const std::string &path, const std::string &label);
+
+// Keeps the compiler from removing a computation whose result is not used
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/* Runs operation(i) operationsNum times per repetition, once for warm-up and then getRepetitions() times, and reports
+ * the median time of an operation with the spread of the repetitions.
+ */
+template <typename Operation>
+Statistics measure(const std::string &benchmark, const std::string &metric, size_t operationsNum, Operation operation)
+{
+    std::vector<double> samples;
+    for(size_t repetition = 0; repetition <= getRepetitions(); repetition++)
+    {
+        Stopwatch stopwatch;
+        for(size_t i = 0; i < operationsNum; i++)
+            operation(i);
+        if(repetition > 0)
+            samples.push_back(stopwatch.elapsedSeconds() * 1e9 / operationsNum);
+    }
+
+    Statistics statistics = Statistics::calculate(std::move(samples));
+    report(benchmark, metric, statistics, "ns/op");
+    return statistics;
+}
+} // namespace Benchmark
@@ -0,0 +1,258 @@
+#include <filesystem>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "benchClient.hpp"
+#include "benchmark.hpp"
+#include "database/blobStore.hpp"
+#include "node/nodeList.hpp"
+#include "server/serverNode.hpp"
+#include "utilities/sha256.hpp"
+
+/* Camera clip ingest: every camera streams one clip as ClipData messages of maximum payload size over its own
+ * socketpair while all cameras upload at the same time. The server side dispatches the messages of all connections
+ * from one thread like the event handler does, chunks are hashed and stored by the blob store worker. The rate
+ * includes syncing the clips at ClipEnd. Afterwards one clip is uploaded again to show deduplication and served
+ * back with sendfile and verified chunk by chunk.
+ * Arguments: [cameras] [megabytes per clip]
+ */
+namespace
+{
+using Command = ServerProtocol::Command;
+
+constexpr const char *benchmarkName = "blob";
+constexpr uint32_t    firstCameraId = 1000;
+constexpr uint32_t    uploadId      = 1;
+
+struct Camera
+{
+    int   clientFd = -1;
+    int   serverFd = -1;
+    Node *node     = nullptr;
+};
+
+// Incompressible content that differs between cameras, like real video
+std::vector<uint8_t> makeClip(size_t len, uint64_t seed)
+{
+    std::vector<uint8_t> clip(len);
+    uint64_t             state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    for(size_t i = 0; i < len; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        clip[i] = static_cast<uint8_t>(state);
+    }
+    return clip;
+}
+
+// Uploads a clip and returns the clip ID from ClipStored
+uint64_t uploadClip(int fd, uint32_t cameraId, const std::vector<uint8_t> &clip)
+{
+    constexpr size_t dataLen = Message::maxPayloadLen - 1 - sizeof(uint32_t);
+
+    PayloadWriter begin;
+    begin.write(uploadId);
+    begin.write(uint64_t(cameraId));
+    begin.writeString<uint8_t>("motion detected");
+    Benchmark::sendCommand(fd, cameraId, Command::ClipBegin, begin);
+
+    for(size_t offset = 0; offset < clip.size(); offset += dataLen)
+    {
+        PayloadWriter data;
+        data.write(uploadId);
+        data.writeBytes(clip.data() + offset, std::min(dataLen, clip.size() - offset));
+        Benchmark::sendCommand(fd, cameraId, Command::ClipData, data);
+    }
+
+    PayloadWriter end;
+    end.write(uploadId);
+    Benchmark::sendCommand(fd, cameraId, Command::ClipEnd, end);
+
+    std::vector<uint8_t> buffer;
+    Message              stored = Benchmark::readFrame(fd, buffer);
+    PayloadReader        reader(stored.getPayloadPointer(), stored.getPayloadLen());
+    if(static_cast<Command>(reader.read<uint8_t>()) != Command::ClipStored || reader.read<uint32_t>() != uploadId)
+        throw std::runtime_error("ClipStored expected");
+    return reader.read<uint64_t>();
+}
+
+// Dispatches messages of all cameras until every client closed its connection
+void serve(ServerNode &serverNode, std::vector<Camera> &cameras)
+{
+    std::vector<pollfd> fds;
+    for(const Camera &camera : cameras)
+    {
+        fds.push_back(pollfd{camera.serverFd, POLLIN, 0});
+    }
+
+    std::vector<uint8_t> buffer;
+    size_t               openConnections = cameras.size();
+    while(openConnections > 0)
+    {
+        if(poll(fds.data(), fds.size(), -1) < 0)
+            throw std::runtime_error("poll failed");
+
+        for(size_t i = 0; i < fds.size(); i++)
+        {
+            if(fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+
+            try
+            {
+                serverNode.handleMessage(cameras[i].node, Benchmark::readFrame(fds[i].fd, buffer));
+            }
+            catch(const std::exception &)
+            {
+                // Client closed the connection
+                fds[i].fd = -1;
+                openConnections--;
+            }
+        }
+    }
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t camerasNum = Benchmark::getArgument(arguments, 0, 50);
+    size_t megabytes  = Benchmark::getArgument(arguments, 1, 16);
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "iot-bench-blobs";
+    std::filesystem::remove_all(directory);
+
+    Database::BlobStore::Config config;
+    config.directory     = directory.string();
+    config.packSize      = 256 * 1024 * 1024;
+    config.database.path = (directory / "blobs.db").string();
+
+    // The cameras send faster than the worker stores, all clips may wait for it. The ingest time ends with the last
+    // ClipStored, so it still covers storing every clip.
+    config.maxPendingBytes = camerasNum * megabytes * 1024 * 1024;
+    std::filesystem::create_directories(directory);
+
+    Database::BlobStore blobStore(config);
+    NodeList            nodeList;
+    ServerNode          serverNode("", &nodeList, nullptr, nullptr, nullptr, &blobStore, nullptr, nullptr);
+
+    std::vector<Camera> cameras(camerasNum);
+    for(size_t i = 0; i < camerasNum; i++)
+    {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+            throw std::runtime_error("socketpair failed");
+
+        cameras[i].clientFd = fds[0];
+        cameras[i].serverFd = fds[1];
+        cameras[i].node     = new Node(fds[1], "127.0.0.1", [](const Node *, const Message &) {}, [](const Node *) {});
+        nodeList.addNode(cameras[i].node);
+        cameras[i].node->setRegistration(firstCameraId + i, "camera", "camera", "motion triggered clips");
+    }
+
+    std::vector<std::vector<uint8_t>> clips;
+    for(size_t i = 0; i < camerasNum; i++)
+    {
+        clips.push_back(makeClip(megabytes * 1024 * 1024, i + 1));
+    }
+
+    // All cameras upload at the same time
+    std::vector<uint64_t>    clipIds(camerasNum);
+    std::vector<std::thread> uploaders;
+    Benchmark::Stopwatch     stopwatch;
+    for(size_t i = 0; i < camerasNum; i++)
+    {
+        uploaders.emplace_back([&, i]() {
+            clipIds[i] = uploadClip(cameras[i].clientFd, firstCameraId + i, clips[i]);
+            shutdown(cameras[i].clientFd, SHUT_WR);
+        });
+    }
+    serve(serverNode, cameras);
+    for(auto &uploader : uploaders)
+    {
+        uploader.join();
+    }
+    double ingestSeconds = stopwatch.elapsedSeconds();
+
+    double totalMegabytes = double(camerasNum * megabytes);
+    Benchmark::report(benchmarkName, "cameras", camerasNum, "streams");
+    Benchmark::report(benchmarkName, "ingest", totalMegabytes / ingestSeconds, "MB/s");
+    Benchmark::report(benchmarkName, "per camera", totalMegabytes * 8 / ingestSeconds / camerasNum, "Mbit/s");
+    for(uint64_t clipId : clipIds)
+    {
+        if(clipId == 0)
+            throw std::runtime_error("Clip upload failed");
+    }
+
+    // Second connection of the first camera: the same clip again is only hashed, then it is served back
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        throw std::runtime_error("socketpair failed");
+    Node *node = new Node(fds[1], "127.0.0.1", [](const Node *, const Message &) {}, [](const Node *) {});
+    nodeList.addNode(node);
+    node->setRegistration(firstCameraId, "camera", "camera", "motion triggered clips");
+
+    uint64_t    dedupedBefore = blobStore.getDedupedChunks();
+    std::thread duplicate([&]() { uploadClip(fds[0], firstCameraId, clips[0]); });
+    std::vector<uint8_t> buffer;
+    while(true)
+    {
+        Message message = Benchmark::readFrame(fds[1], buffer);
+        serverNode.handleMessage(node, message);
+        if(message.getPayloadPointer()[0] == static_cast<uint8_t>(Command::ClipEnd))
+            break;
+    }
+    duplicate.join();
+    Benchmark::report(benchmarkName, "deduplicated chunks", blobStore.getDedupedChunks() - dedupedBefore, "chunks");
+
+    PayloadWriter request;
+    request.write(clipIds[0]);
+    Benchmark::sendCommand(fds[0], firstCameraId, Command::ClipRequest, request);
+
+    stopwatch.restart();
+    std::thread server([&]() { serverNode.handleMessage(node, Benchmark::readFrame(fds[1], buffer)); });
+
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> chunk;
+    std::vector<uint8_t> headerBuffer;
+    uint32_t             chunksNum = 1;
+    for(uint32_t i = 0; i < chunksNum; i++)
+    {
+        Message       header = Benchmark::readFrame(fds[0], headerBuffer);
+        PayloadReader reader(header.getPayloadPointer(), header.getPayloadLen());
+        if(static_cast<Command>(reader.read<uint8_t>()) != Command::ClipChunk || reader.read<uint64_t>() != clipIds[0])
+            throw std::runtime_error("ClipChunk expected");
+        reader.read<uint32_t>();
+        chunksNum = reader.read<uint32_t>();
+
+        Database::BlobStore::Hash hash;
+        memcpy(hash.data(), reader.readBytes(hash.size()), hash.size());
+        chunk.resize(reader.read<uint32_t>());
+        Benchmark::readFull(fds[0], chunk.data(), chunk.size());
+        if(Utilities::Sha256::calculate(chunk.data(), chunk.size()) != hash)
+            throw std::runtime_error("Chunk hash mismatch");
+        received.insert(received.end(), chunk.begin(), chunk.end());
+    }
+    server.join();
+    double serveSeconds = stopwatch.elapsedSeconds();
+    Benchmark::report(benchmarkName, "serve with verification", megabytes / serveSeconds, "MB/s");
+
+    if(received != clips[0])
+        throw std::runtime_error("Served clip differs from the uploaded one");
+
+    nodeList.removeNode(node);
+    close(fds[0]);
+    for(Camera &camera : cameras)
+    {
+        serverNode.nodeRemoved(camera.node);
+        nodeList.removeNode(camera.node);
+        close(camera.clientFd);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "concurrent camera clip ingest, deduplication and sendfile serving", run);
+} // namespace
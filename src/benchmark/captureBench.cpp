@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "message/message.hpp"
+#include "utilities/trafficCapture.hpp"
+
+/* Traffic capture cost on the node data threads: frames are recorded from several threads at once, each thread with
+ * connections of its own like node data threads. The capture is written to a temporary file, its size per frame and
+ * how fast iot-traffic-replay reads it back are reported as well.
+ * Arguments: [frames per thread] [threads] [payload len]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "capture";
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t framesNum  = std::max<size_t>(Benchmark::getArgument(arguments, 0, 1000000), 1);
+    size_t threadsNum = std::max<size_t>(Benchmark::getArgument(arguments, 1, 4), 1);
+    size_t payloadLen = std::min(Benchmark::getArgument(arguments, 2, 64), Message::maxPayloadLen);
+    std::string path  = (std::filesystem::temp_directory_path() / "iot-bench-capture.bin").string();
+
+    Message message(1, 2, std::vector<uint8_t>(payloadLen, 0x5A).data(), payloadLen);
+    for(size_t threads : {size_t(1), threadsNum})
+    {
+        uint64_t droppedNum = 0;
+        double   seconds    = 0;
+        {
+            Utilities::TrafficCapture capture(path);
+            std::vector<std::thread>  workers;
+            Benchmark::Stopwatch      stopwatch;
+            for(size_t t = 0; t < threads; t++)
+            {
+                workers.emplace_back([&, t] {
+                    for(size_t i = 0; i < framesNum; i++)
+                        capture.record(t * 100 + i % 100, message.getMessagePointer(), message.getMessageLen());
+                });
+            }
+            for(auto &worker : workers)
+                worker.join();
+            seconds    = stopwatch.elapsedSeconds();
+            droppedNum = capture.getDroppedNum();
+        }
+
+        // Frames dropped on a full buffer are cheaper than recorded ones, the drop rate tells if the time holds
+        std::string suffix = " " + std::to_string(threads) + " threads";
+        Benchmark::report(benchmarkName, "record" + suffix, seconds * 1e9 / (framesNum * threads), "ns/op");
+        Benchmark::report(benchmarkName, "dropped" + suffix, droppedNum * 100.0 / (framesNum * threads), "%");
+    }
+
+    std::ifstream        file(path, std::ios::binary);
+    std::vector<uint8_t> content{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    size_t               recordsNum = 0;
+    Benchmark::Stopwatch stopwatch;
+    Utilities::TrafficCapture::readCapture(
+        content.data(), content.size(), [&](const Utilities::TrafficCapture::Record &) { recordsNum++; });
+    double seconds = stopwatch.elapsedSeconds();
+    std::filesystem::remove(path);
+
+    Benchmark::report(benchmarkName,
+                      "file bytes per frame",
+                      recordsNum > 0 ? double(content.size()) / recordsNum : 0,
+                      "B");
+    Benchmark::report(benchmarkName, "read", seconds > 0 ? content.size() / seconds / 1e6 : 0, "MB/s");
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Traffic capture recording cost from node threads, file size", run);
+} // namespace
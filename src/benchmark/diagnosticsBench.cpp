@@ -0,0 +1,117 @@
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "utilities/diagnostics.hpp"
+#include "utilities/logger.hpp"
+#include "utilities/quarantineRing.hpp"
+
+/* A flood of malformed frames from several nodes at once: every frame logged with a hex dump as the node data thread
+ * did before, against sampled and rate limited logging with the complete frames kept in a quarantine ring. The
+ * console output goes to /dev/null.
+ * Arguments: [frames per node] [nodes] [frame len]
+ */
+namespace
+{
+using Logger   = Utilities::Logger;
+using LogLevel = Logger::LogLevel;
+
+constexpr const char *benchmarkName = "diagnostics";
+
+constexpr Logger::Module logModule = Logger::Module::Node;
+
+void logHexDump(const uint8_t *data, size_t len)
+{
+    LOG_MESSAGE(LogLevel::Warning, "Unable to create message from incoming data: Invalid frame");
+
+    std::stringstream ss;
+    ss << "Number of bytes=" << len << ", raw data: ";
+    ss << std::hex << std::uppercase << std::setfill('0');
+    for(size_t i = 0; i < len; i++)
+    {
+        ss << std::setw(2) << (int)data[i] << " ";
+    }
+    LOG_MESSAGE(LogLevel::Debug, ss.str());
+}
+
+template <typename Flood>
+void runCase(const std::string &name, size_t framesNum, size_t nodesNum, Flood flood)
+{
+    std::fflush(stdout);
+    int nullFd   = open("/dev/null", O_WRONLY);
+    int stdoutFd = dup(STDOUT_FILENO);
+    int stderrFd = dup(STDERR_FILENO);
+    dup2(nullFd, STDOUT_FILENO);
+    dup2(nullFd, STDERR_FILENO);
+    Logger::setGlobalLogLevel(LogLevel::Debug);
+
+    Benchmark::Stopwatch     stopwatch;
+    std::vector<std::thread> threads;
+    for(size_t node = 0; node < nodesNum; node++)
+        threads.emplace_back(flood, node);
+    for(auto &thread : threads)
+        thread.join();
+    double handledSeconds = stopwatch.elapsedSeconds();
+    Logger::flush();
+    double writtenSeconds = stopwatch.elapsedSeconds();
+
+    Logger::setGlobalLogLevel(LogLevel::None);
+    dup2(stdoutFd, STDOUT_FILENO);
+    dup2(stderrFd, STDERR_FILENO);
+    close(stdoutFd);
+    close(stderrFd);
+    close(nullFd);
+
+    size_t totalFrames = framesNum * nodesNum;
+    Benchmark::report(benchmarkName, name + " handled", totalFrames / handledSeconds, "frames/s");
+    Benchmark::report(benchmarkName, name + " written", totalFrames / writtenSeconds, "frames/s");
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t framesNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 20000), 1);
+    size_t nodesNum  = std::max<size_t>(Benchmark::getArgument(arguments, 1, 4), 1);
+    size_t frameLen  = std::max<size_t>(Benchmark::getArgument(arguments, 2, 1024), 1);
+
+    std::vector<uint8_t> frame(frameLen);
+    for(size_t i = 0; i < frameLen; i++)
+        frame[i] = uint8_t(i * 31 + 7);
+
+    Logger::setOverflowPolicy(Logger::OverflowPolicy::Block);
+    runCase("hex dump", framesNum, nodesNum, [&](size_t) {
+        for(size_t i = 0; i < framesNum; i++)
+            logHexDump(frame.data(), frame.size());
+    });
+
+    Utilities::Diagnostic     malformedFrames(logModule, "Malformed frames");
+    Utilities::QuarantineRing quarantineRing(4 * 1024 * 1024);
+    runCase("sampled", framesNum, nodesNum, [&](size_t node) {
+        Utilities::Diagnostic::Source source(malformedFrames);
+        for(size_t i = 0; i < framesNum; i++)
+        {
+            quarantineRing.store(node, frame.data(), frame.size());
+            if(malformedFrames.sample(source))
+            {
+                LOG_FORMAT(LogLevel::Warning,
+                           "Unable to create message from incoming data of {}: {}, {} bytes: {}",
+                           node,
+                           "Invalid frame",
+                           frame.size(),
+                           Utilities::Diagnostic::toHex(frame.data(), frame.size()));
+            }
+        }
+        malformedFrames.endSource(source, "node " + std::to_string(node));
+    });
+    Logger::setOverflowPolicy(Logger::OverflowPolicy::Drop);
+
+    Benchmark::report(benchmarkName, "sampled logged", malformedFrames.getEvents() - malformedFrames.getSuppressed(),
+                      "frames");
+    Benchmark::report(benchmarkName, "quarantined", quarantineRing.getRecordsNum(), "frames");
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Malformed frame flood, hex dump logging vs sampled diagnostics", run);
+} // namespace
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "message/message.hpp"
+#include "node/node.hpp"
+#include "server/fanOut.hpp"
+
+/* Fan-out of one publisher to 1, 100 and 10k subscribers: frames published from the benchmark thread as the event
+ * handler does until the writers delivered all of them. Subscribers are nodes without data threads on memory
+ * transports, which only count the bytes, and on Unix sockets drained by a reader thread; socket subscribers are
+ * limited by the open files limit. Last, one socket subscriber that never reads among 100: the others still get every
+ * frame and its frames beyond the outbox limit are dropped.
+ * Arguments: [deliveries per case] [payload len]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "fanout";
+constexpr uint32_t    publisherId   = 1;
+constexpr auto        stallTimeout  = std::chrono::milliseconds(500);
+
+struct Subscribers
+{
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<int>                   clientFds; // Socket subscribers, read by the drain
+};
+
+// Reads all client ends until stopped, the bytes of the client ends from slowNum on are counted
+class Drain
+{
+public:
+    Drain(const std::vector<int> &fds, size_t slowNum) : epollFd(epoll_create1(EPOLL_CLOEXEC))
+    {
+        if(epollFd < 0)
+            throw std::runtime_error("epoll_create1 failed in fanout benchmark");
+        for(size_t i = slowNum; i < fds.size(); i++)
+        {
+            epoll_event event;
+            event.events  = EPOLLIN;
+            event.data.fd = fds[i];
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[i], &event);
+        }
+        thread = std::thread([this] { process(); });
+    }
+
+    ~Drain()
+    {
+        stopped = true;
+        thread.join();
+        close(epollFd);
+    }
+
+    std::atomic<size_t> bytes = 0;
+
+private:
+    int               epollFd;
+    std::thread       thread;
+    std::atomic<bool> stopped = false;
+
+    void process()
+    {
+        epoll_event          events[64];
+        std::vector<uint8_t> buffer(256 * 1024);
+        while(!stopped)
+        {
+            int eventsReady = epoll_wait(epollFd, events, 64, 10);
+            for(int i = 0; i < eventsReady; i++)
+            {
+                ssize_t len = read(events[i].data.fd, buffer.data(), buffer.size());
+                if(len > 0)
+                    bytes.fetch_add(len, std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+Subscribers createSubscribers(size_t subscribersNum, bool sockets, std::atomic<size_t> &memoryBytes)
+{
+    Subscribers subscribers;
+    for(size_t i = 0; i < subscribersNum; i++)
+    {
+        auto callback     = [](const Node *, const Message &) {};
+        auto disconnected = [](const Node *) {};
+        if(!sockets)
+        {
+            auto sink = [&memoryBytes](const uint8_t *, size_t len) {
+                memoryBytes.fetch_add(len, std::memory_order_relaxed);
+            };
+            subscribers.nodes.push_back(std::make_unique<Node>(
+                std::make_unique<MemoryTransport>(i, sink), "fanout", callback, disconnected));
+            continue;
+        }
+
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+            throw std::runtime_error("socketpair failed in fanout benchmark");
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        subscribers.nodes.push_back(std::make_unique<Node>(fds[0], "fanout", callback, disconnected));
+        subscribers.clientFds.push_back(fds[1]);
+    }
+    return subscribers;
+}
+
+void closeSubscribers(Subscribers &subscribers)
+{
+    subscribers.nodes.clear();
+    for(int fd : subscribers.clientFds)
+        close(fd);
+}
+
+// Publishes until deliveriesNum frames were queued, waits until received reaches them or stops growing
+void publish(FanOut &fanOut, const Message &message, size_t subscribersNum, size_t deliveriesNum,
+             const std::atomic<size_t> &received, size_t expectedPerFrame, const std::string &name)
+{
+    size_t framesNum  = std::max<size_t>(deliveriesNum / subscribersNum, 1);
+    size_t queuedNum  = 0;
+    size_t initialLen = received.load();
+
+    Benchmark::Stopwatch stopwatch;
+    for(size_t i = 0; i < framesNum; i++)
+        queuedNum += fanOut.publish(publisherId, message.getMessagePointer(), message.getMessageLen());
+    double publishSeconds = stopwatch.elapsedSeconds();
+
+    size_t expectedLen = initialLen + framesNum * expectedPerFrame * message.getMessageLen();
+    size_t lastLen     = received.load();
+    auto   lastChange  = std::chrono::steady_clock::now();
+    while(lastLen < expectedLen && std::chrono::steady_clock::now() - lastChange < stallTimeout)
+    {
+        std::this_thread::yield();
+        size_t len = received.load();
+        if(len != lastLen)
+        {
+            lastLen    = len;
+            lastChange = std::chrono::steady_clock::now();
+        }
+    }
+    double seconds   = stopwatch.elapsedSeconds();
+    size_t delivered = (lastLen - initialLen) / message.getMessageLen();
+
+    Benchmark::report(benchmarkName, "publish " + name, publishSeconds * 1e9 / framesNum, "ns/frame");
+    Benchmark::report(benchmarkName, "deliveries " + name, delivered / seconds, "msg/s");
+    if(delivered < framesNum * expectedPerFrame)
+        Benchmark::report(benchmarkName, "missing " + name, double(framesNum * expectedPerFrame - delivered), "msg");
+    if(queuedNum < framesNum * subscribersNum)
+        Benchmark::report(benchmarkName, "dropped " + name, double(framesNum * subscribersNum - queuedNum), "msg");
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t deliveriesNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 2000000), 1);
+    size_t payloadLen    = std::min(Benchmark::getArgument(arguments, 1, 64), Message::maxPayloadLen);
+
+    Message message(publisherId, 2, std::vector<uint8_t>(payloadLen, 0x5A).data(), payloadLen);
+
+    // Two descriptors per socket subscriber, some left for the rest
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    size_t socketSubscribersMax = limit.rlim_cur > 256 ? (limit.rlim_cur - 256) / 2 : 0;
+
+    for(bool sockets : {false, true})
+    {
+        for(size_t subscribersNum : {1, 100, 10000})
+        {
+            std::string name = std::to_string(subscribersNum) + (sockets ? " socket" : " memory");
+            if(sockets && subscribersNum > socketSubscribersMax)
+            {
+                subscribersNum = socketSubscribersMax;
+                name           = std::to_string(subscribersNum) + " socket (open files limit)";
+            }
+
+            std::atomic<size_t> memoryBytes = 0;
+            FanOut              fanOut;
+            Subscribers         subscribers = createSubscribers(subscribersNum, sockets, memoryBytes);
+            for(auto &node : subscribers.nodes)
+                fanOut.subscribe(publisherId, node.get());
+
+            std::unique_ptr<Drain> drain;
+            if(sockets)
+                drain = std::make_unique<Drain>(subscribers.clientFds, 0);
+            publish(fanOut, message, subscribersNum, deliveriesNum, sockets ? drain->bytes : memoryBytes,
+                    subscribersNum, name);
+
+            drain.reset();
+            closeSubscribers(subscribers);
+        }
+    }
+
+    // The slow subscriber fills its socket buffer and its outbox, then only its frames are dropped
+    std::atomic<size_t> unused = 0;
+    FanOut              fanOut;
+    Subscribers         subscribers = createSubscribers(100, true, unused);
+    for(auto &node : subscribers.nodes)
+        fanOut.subscribe(publisherId, node.get());
+    {
+        Drain drain(subscribers.clientFds, 1);
+        publish(fanOut, message, 100, deliveriesNum * 5, drain.bytes, 99, "100 socket, 1 never reading");
+    }
+    closeSubscribers(subscribers);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Fan-out of published frames to subscribers", run);
+} // namespace
@@ -0,0 +1,87 @@
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "database/historyStore.hpp"
+
+/* Sustained ingest into the history store: producer threads append records of a fixed payload size for a fleet of
+ * nodes, the rate includes the final flush so it is what the disk took, not only what was queued.
+ * Arguments: [records] [payload len] [producer threads] [nodes]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "history";
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t recordsNum   = Benchmark::getArgument(arguments, 0, 10000000);
+    size_t payloadLen   = Benchmark::getArgument(arguments, 1, 64);
+    size_t producersNum = Benchmark::getArgument(arguments, 2, 1);
+    size_t nodesNum     = Benchmark::getArgument(arguments, 3, 1000);
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "iot-bench-history";
+    std::filesystem::remove_all(directory);
+
+    Database::HistoryStore::Config config;
+    config.directory = directory.string();
+
+    double appendSeconds    = 0;
+    double sustainedSeconds = 0;
+    {
+        Database::HistoryStore store(config);
+        std::vector<uint8_t>   payload(payloadLen, 0xA5);
+
+        Benchmark::Stopwatch     stopwatch;
+        std::vector<std::thread> producers;
+        for(size_t p = 0; p < producersNum; p++)
+        {
+            producers.emplace_back([&, p]() {
+                for(size_t i = p; i < recordsNum; i += producersNum)
+                {
+                    store.append(i % nodesNum + 1, Database::HistoryStore::getTimestamp(), payload.data(), payloadLen);
+                }
+            });
+        }
+        for(auto &producer : producers)
+        {
+            producer.join();
+        }
+        appendSeconds = stopwatch.elapsedSeconds();
+        store.flush();
+        sustainedSeconds = stopwatch.elapsedSeconds();
+    }
+
+    // Reopen the store to read everything back from the segments
+    Benchmark::Stopwatch   stopwatch;
+    Database::HistoryStore store(config);
+    double                 openSeconds = stopwatch.elapsedSeconds();
+
+    stopwatch.restart();
+    size_t readRecords = 0;
+    for(size_t node = 1; node <= nodesNum; node++)
+    {
+        store.query(node, 0, UINT64_MAX, [&](const Database::HistoryStore::Record &) {
+            readRecords++;
+            return true;
+        });
+    }
+    double querySeconds = stopwatch.elapsedSeconds();
+
+    double megabytes = recordsNum * (payloadLen + 24) / (1024.0 * 1024.0);
+    Benchmark::report(benchmarkName, "append rate", recordsNum / appendSeconds, "records/s");
+    Benchmark::report(benchmarkName, "sustained rate (incl. flush)", recordsNum / sustainedSeconds, "records/s");
+    Benchmark::report(benchmarkName, "sustained throughput", megabytes / sustainedSeconds, "MB/s");
+    Benchmark::report(benchmarkName, "reopen", openSeconds * 1000, "ms");
+    Benchmark::report(benchmarkName, "full history query per node", querySeconds * 1000 / nodesNum, "ms");
+    if(readRecords != recordsNum)
+    {
+        throw std::runtime_error("Read back " + std::to_string(readRecords) + " of " + std::to_string(recordsNum) +
+                                 " records");
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "sustained append rate of the mmap segment history store", run);
+} // namespace
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "message/message.hpp"
+#include "node/node.hpp"
+#include "node/sharedMemoryTransport.hpp"
+
+/* Local clients on the shared memory transport and on the packet socket of the local listener against the same client
+ * on a Unix stream socket. The server end is a node with its data thread like on the server, the client end runs on
+ * the benchmark thread: frames to the node, frames from the node while the benchmark receives them, and round trips
+ * with the node echoing every frame.
+ * Arguments: [messages] [payload len]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "local";
+
+enum class Kind
+{
+    SharedMemory,
+    Packet,
+    Stream,
+};
+constexpr const char *kindSuffixes[] = {" shm", " packet", " stream"};
+
+struct Client
+{
+    std::function<void(const Message &)>       send;
+    std::function<void(std::vector<uint8_t> &)> receive; // Frame of the known length
+};
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t messagesNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 1000000), 1);
+    size_t payloadLen  = std::min(Benchmark::getArgument(arguments, 1, 64), Message::maxPayloadLen);
+
+    Message message(1, 2, std::vector<uint8_t>(payloadLen, 0x5A).data(), payloadLen);
+    for(Kind kind : {Kind::SharedMemory, Kind::Packet, Kind::Stream})
+    {
+        int fds[2];
+        int type = kind == Kind::Packet ? SOCK_SEQPACKET : SOCK_STREAM;
+        if(socketpair(AF_UNIX, type | SOCK_CLOEXEC, 0, fds) != 0)
+            throw std::runtime_error("socketpair failed in local benchmark");
+
+        std::atomic<size_t> receivedNum = 0;
+        std::atomic<bool>   echo        = false;
+        auto                callback    = [&](const Node *node, const Message &received) {
+            if(echo.load(std::memory_order_relaxed))
+                node->sendMessage(received);
+            receivedNum.fetch_add(1, std::memory_order_release);
+        };
+
+        // The server channel passes the segment before the client can receive it, the socket buffer holds it
+        std::unique_ptr<SharedMemoryClient> sharedMemoryClient;
+        std::unique_ptr<Node>               node;
+        Client                              client;
+        if(kind == Kind::SharedMemory)
+        {
+            auto channel = std::make_unique<SharedMemoryChannel>(fds[0], SharedMemoryChannel::defaultCapacity);
+            node         = std::make_unique<Node>(
+                std::make_unique<SharedMemoryTransport>(std::move(channel)), "local", callback, [](const Node *) {});
+            sharedMemoryClient = std::make_unique<SharedMemoryClient>(fds[1]);
+            client.send        = [&](const Message &frame) { sharedMemoryClient->send(frame); };
+            client.receive     = [&](std::vector<uint8_t> &frame) {
+                if(!sharedMemoryClient->receive(frame, 1000))
+                    throw std::runtime_error("Receive timed out in local benchmark");
+            };
+        }
+        else if(kind == Kind::Packet)
+        {
+            auto transport = std::make_unique<SocketTransport>(fds[0], SocketTransport::Kind::Packet);
+            node           = std::make_unique<Node>(std::move(transport), "local", callback, [](const Node *) {});
+            client.receive = [&](std::vector<uint8_t> &frame) {
+                // One read is one packet is one frame
+                frame.resize(Message::maxMessageLen);
+                ssize_t len = read(fds[1], frame.data(), frame.size());
+                if(len <= 0)
+                    throw std::runtime_error("read failed in local benchmark");
+                frame.resize(len);
+            };
+        }
+        else
+        {
+            node           = std::make_unique<Node>(fds[0], "local", callback, [](const Node *) {});
+            client.receive = [&](std::vector<uint8_t> &frame) {
+                frame.resize(message.getMessageLen());
+                for(size_t offset = 0; offset < frame.size();)
+                {
+                    ssize_t len = read(fds[1], frame.data() + offset, frame.size() - offset);
+                    if(len <= 0)
+                        throw std::runtime_error("read failed in local benchmark");
+                    offset += len;
+                }
+            };
+        }
+        if(kind != Kind::SharedMemory)
+        {
+            client.send = [&](const Message &frame) {
+                if(write(fds[1], frame.getMessagePointer(), frame.getMessageLen()) != ssize_t(frame.getMessageLen()))
+                    throw std::runtime_error("write failed in local benchmark");
+            };
+        }
+        node->start();
+
+        std::string          suffix = kindSuffixes[static_cast<size_t>(kind)];
+        std::vector<uint8_t> frame;
+
+        // Frames to the node until its data thread has handled all of them
+        Benchmark::Stopwatch stopwatch;
+        for(size_t i = 0; i < messagesNum; i++)
+            client.send(message);
+        while(receivedNum.load(std::memory_order_acquire) < messagesNum)
+            std::this_thread::yield();
+        Benchmark::report(benchmarkName, "to node" + suffix, messagesNum / stopwatch.elapsedSeconds(), "msg/s");
+
+        // Frames from the node, written by another thread like the event handler does
+        stopwatch.restart();
+        std::thread sender([&] {
+            for(size_t i = 0; i < messagesNum; i++)
+                node->sendMessage(message);
+        });
+        for(size_t i = 0; i < messagesNum; i++)
+            client.receive(frame);
+        sender.join();
+        Benchmark::report(benchmarkName, "from node" + suffix, messagesNum / stopwatch.elapsedSeconds(), "msg/s");
+
+        echo = true;
+        Benchmark::measure(benchmarkName, "round trip" + suffix, std::min<size_t>(messagesNum, 100000), [&](size_t) {
+            client.send(message);
+            client.receive(frame);
+        });
+
+        node.reset();
+        sharedMemoryClient.reset();
+        if(kind != Kind::SharedMemory)
+            close(fds[1]);
+    }
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Shared memory and packet socket transports of local clients", run);
+} // namespace
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "utilities/logger.hpp"
+
+/* Log call throughput and caller-side latency of the synchronous logger, of the background writer with both
+ * overflow policies and of deferred formatting with LOG_FORMAT to text and to a binary file. The console output goes
+ * to /dev/null, the file cases write rotating log files. Every thread logs a typical node message as fast as it can.
+ * Also the cost of a call whose level is filtered at runtime or at compile time.
+ * Arguments: [messages per thread] [threads]
+ */
+namespace
+{
+using Logger = Utilities::Logger;
+
+constexpr const char *benchmarkName = "logger";
+constexpr const char *binaryLogPath = "bench-log.bin";
+constexpr const char *logDirectory  = "bench-log";
+
+void logText(size_t i)
+{
+    Logger::logMessage("Node:: Message received from node " + std::to_string(i) + " len=64", Logger::LogLevel::Debug);
+}
+
+void logLazy(size_t i)
+{
+    LOG_MESSAGE(Logger::LogLevel::Debug, "Node:: Message received from node " + std::to_string(i) + " len=64");
+}
+
+void logDeferred(size_t i)
+{
+    LOG_FORMAT(Logger::LogLevel::Debug, "Node:: Message received from node {} len={}", i, 64);
+}
+
+// As built with IOT_LOG_LEVEL=Info, the call is removed at compile time
+#pragma push_macro("IOT_LOG_MAX_LEVEL")
+#undef IOT_LOG_MAX_LEVEL
+#define IOT_LOG_MAX_LEVEL 3
+void logCompiledOut(size_t i)
+{
+    LOG_FORMAT(Logger::LogLevel::Debug, "Node:: Message received from node {} len={}", i, 64);
+}
+#pragma pop_macro("IOT_LOG_MAX_LEVEL")
+
+void runCase(const std::string &name, size_t messagesNum, size_t threadsNum, void (*logCall)(size_t))
+{
+    std::vector<std::vector<uint32_t>> latencies(threadsNum);
+    uint64_t                           droppedBefore = Logger::getDroppedMessages();
+
+    // Log output replaces stdout and stderr until the writer is flushed
+    std::fflush(stdout);
+    int nullFd   = open("/dev/null", O_WRONLY);
+    int stdoutFd = dup(STDOUT_FILENO);
+    int stderrFd = dup(STDERR_FILENO);
+    dup2(nullFd, STDOUT_FILENO);
+    dup2(nullFd, STDERR_FILENO);
+    Logger::setGlobalLogLevel(Logger::LogLevel::Debug);
+
+    Benchmark::Stopwatch     stopwatch;
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < threadsNum; t++)
+    {
+        threads.emplace_back([&, t] {
+            std::vector<uint32_t> &threadLatencies = latencies[t];
+            threadLatencies.reserve(messagesNum);
+            for(size_t i = 0; i < messagesNum; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                logCall(i);
+                auto end = std::chrono::steady_clock::now();
+                threadLatencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            }
+        });
+    }
+    for(auto &thread : threads)
+        thread.join();
+    double callsSeconds = stopwatch.elapsedSeconds();
+    Logger::flush();
+    double writtenSeconds = stopwatch.elapsedSeconds();
+
+    Logger::setGlobalLogLevel(Logger::LogLevel::None);
+    dup2(stdoutFd, STDOUT_FILENO);
+    dup2(stderrFd, STDERR_FILENO);
+    close(stdoutFd);
+    close(stderrFd);
+    close(nullFd);
+
+    std::vector<uint32_t> all;
+    for(const auto &threadLatencies : latencies)
+        all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+    std::sort(all.begin(), all.end());
+
+    size_t callsNum = all.size();
+    Benchmark::report(benchmarkName, name + " calls", callsNum / callsSeconds, "calls/s");
+    Benchmark::report(benchmarkName, name + " written", callsNum / writtenSeconds, "messages/s");
+    Benchmark::report(benchmarkName, name + " p50 latency", all[callsNum / 2] / 1e3, "us");
+    Benchmark::report(benchmarkName, name + " p99 latency", all[callsNum * 99 / 100] / 1e3, "us");
+    Benchmark::report(benchmarkName, name + " p99.9 latency", all[callsNum * 999 / 1000] / 1e3, "us");
+    Benchmark::report(benchmarkName, name + " max latency", all.back() / 1e3, "us");
+    Benchmark::report(benchmarkName, name + " dropped", Logger::getDroppedMessages() - droppedBefore, "messages");
+}
+
+// Cost of a call whose level is disabled, logMessage still builds its message
+void runFiltered(const std::string &name, size_t messagesNum, void (*logCall)(size_t))
+{
+    Logger::setGlobalLogLevel(Logger::LogLevel::Info);
+    Benchmark::Stopwatch stopwatch;
+    for(size_t i = 0; i < messagesNum; i++)
+        logCall(i);
+    double seconds = stopwatch.elapsedSeconds();
+    Logger::setGlobalLogLevel(Logger::LogLevel::None);
+
+    Benchmark::report(benchmarkName, name + " filtered call", seconds * 1e9 / messagesNum, "ns");
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t messagesNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 200000), 1);
+    size_t threadsNum  = std::max<size_t>(Benchmark::getArgument(arguments, 1, 4), 1);
+
+    Logger::setSynchronous(true);
+    runCase("sync", messagesNum, threadsNum, logText);
+    Logger::setSynchronous(false);
+
+    Logger::setOverflowPolicy(Logger::OverflowPolicy::Block);
+    runCase("async block", messagesNum, threadsNum, logText);
+    runCase("deferred text", messagesNum, threadsNum, logDeferred);
+
+    std::remove(binaryLogPath);
+    Logger::setBinaryOutput(binaryLogPath);
+    runCase("deferred binary", messagesNum, threadsNum, logDeferred);
+    Logger::setBinaryOutput("");
+
+    struct stat binaryLog;
+    if(stat(binaryLogPath, &binaryLog) == 0)
+    {
+        Benchmark::report(benchmarkName,
+                          "deferred binary size",
+                          double(binaryLog.st_size) / (messagesNum * threadsNum),
+                          "bytes/message");
+    }
+    std::remove(binaryLogPath);
+
+    // Rotating files, a few files per run to include the rotation
+    Utilities::LogFile::Config fileConfig;
+    fileConfig.directory = logDirectory;
+    fileConfig.fileSize  = 16 * 1024 * 1024;
+    std::filesystem::remove_all(logDirectory);
+    Logger::setFileOutput(fileConfig);
+    runCase("file text", messagesNum, threadsNum, logText);
+    fileConfig.binary = true;
+    Logger::setFileOutput(fileConfig);
+    runCase("file binary", messagesNum, threadsNum, logDeferred);
+    Logger::setConsoleOutput();
+    std::filesystem::remove_all(logDirectory);
+
+    Logger::setOverflowPolicy(Logger::OverflowPolicy::Drop);
+    runCase("async drop", messagesNum, threadsNum, logText);
+
+    runFiltered("logMessage", messagesNum, logText);
+    runFiltered("LOG_MESSAGE", messagesNum, logLazy);
+    runFiltered("LOG_FORMAT", messagesNum, logDeferred);
+    runFiltered("compiled out", messagesNum, logCompiledOut);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Log calls per second and caller latency, sync and async", run);
+} // namespace
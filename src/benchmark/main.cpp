@@ -0,0 +1,134 @@
+#include <cstdlib>
+#include <iostream>
+#include <sched.h>
+#include <string>
+
+#include "benchmark.hpp"
+#include "utilities/logger.hpp"
+
+static void printUsage(const char *executable)
+{
+    std::cout << "Usage: " << executable << " [options] <benchmark|all> [arguments...]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --repetitions <n>   Timed repetitions of measured cases, default 10" << std::endl;
+    std::cout << "  --cpu <n>           Pin the benchmark to a CPU for steadier results" << std::endl;
+    std::cout << "  --json <file>       Write the results as JSON, e.g. to keep as a baseline" << std::endl;
+    std::cout << "  --label <text>      Label of the JSON results, e.g. the commit" << std::endl;
+    std::cout << "  --baseline <file>   Compare with the JSON results of an earlier run" << std::endl;
+    std::cout << "  --threshold <pct>   Change against the baseline that is a regression, default 10" << std::endl;
+    std::cout << "Benchmarks:" << std::endl;
+    for(const auto &[name, entry] : Benchmark::Registry::getEntries())
+    {
+        std::cout << "  " << name << ": " << entry.description << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string jsonPath;
+    std::string label;
+    std::string baselinePath;
+    double      thresholdPercent = 10;
+    int         i                = 1;
+    for(; i + 1 < argc && std::string(argv[i]).compare(0, 2, "--") == 0; i += 2)
+    {
+        std::string option = argv[i];
+        if(option == "--repetitions")
+        {
+            Benchmark::setRepetitions(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+        else if(option == "--cpu")
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(std::atoi(argv[i + 1]), &cpus);
+            if(sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+            {
+                std::cerr << "Unable to pin to CPU " << argv[i + 1] << std::endl;
+                return 1;
+            }
+        }
+        else if(option == "--json")
+        {
+            jsonPath = argv[i + 1];
+        }
+        else if(option == "--label")
+        {
+            label = argv[i + 1];
+        }
+        else if(option == "--baseline")
+        {
+            baselinePath = argv[i + 1];
+        }
+        else if(option == "--threshold")
+        {
+            thresholdPercent = std::atof(argv[i + 1]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(i >= argc)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Benchmarks measure the code paths, not the console
+    Utilities::Logger::setGlobalLogLevel(Utilities::Logger::LogLevel::None);
+
+    std::string          requested = argv[i];
+    Benchmark::Arguments arguments(argv + i + 1, argv + argc);
+    bool                 found = false;
+    try
+    {
+        if(!baselinePath.empty())
+        {
+            Benchmark::loadBaseline(baselinePath, thresholdPercent);
+        }
+
+        for(const auto &[name, entry] : Benchmark::Registry::getEntries())
+        {
+            if(requested == "all" || requested == name)
+            {
+                found = true;
+                try
+                {
+                    entry.function(arguments);
+                }
+                catch(const std::exception &e)
+                {
+                    std::cerr << name << " failed: " << e.what() << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        if(found && !jsonPath.empty())
+        {
+            Benchmark::writeJson(jsonPath, label);
+        }
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if(!found)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // A regression fails the run so a script can stop a deployment
+    if(Benchmark::getRegressionsNum() > 0)
+    {
+        std::cerr << Benchmark::getRegressionsNum() << " regressions against " << baselinePath << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "message/crc.hpp"
+#include "message/endian.hpp"
+#include "message/message.hpp"
+
+/* Framing cost of every message a node sends or receives: Message encode and decode at payload sizes from empty to
+ * the maximum, CRC32 over the same sizes and the Endian reads and writes of the header fields in both byte orders.
+ * Arguments: [operations per repetition]
+ */
+namespace
+{
+using Endian = Utilities::Endian;
+
+constexpr const char *benchmarkName = "message";
+
+// Operations of the largest payload, smaller payloads run more so every case takes a similar time
+size_t getOperationsNum(size_t operationsNum, size_t payloadLen)
+{
+    return std::max<size_t>(operationsNum * 64 / std::max<size_t>(payloadLen, 64), 1);
+}
+
+template <typename T>
+void runEndianCases(size_t operationsNum, const char *typeName)
+{
+    constexpr size_t     slotsNum = 1024;
+    std::vector<uint8_t> buffer(slotsNum * sizeof(T));
+    for(Utilities::Endianness endianness : {Utilities::LittleEndian, Utilities::BigEndian})
+    {
+        std::string suffix = std::string(" ") + typeName + (endianness == Utilities::LittleEndian ? " LE" : " BE");
+        Benchmark::measure(benchmarkName, "endian write" + suffix, operationsNum, [&](size_t i) {
+            Endian::Instance().writeWithEndianness(static_cast<T>(i), &buffer[(i % slotsNum) * sizeof(T)], endianness);
+        });
+        Benchmark::doNotOptimize(buffer[0]);
+
+        T sum = 0;
+        Benchmark::measure(benchmarkName, "endian read" + suffix, operationsNum, [&](size_t i) {
+            T value;
+            Endian::Instance().readWithEndianness(value, &buffer[(i % slotsNum) * sizeof(T)], endianness);
+            sum += value;
+        });
+        Benchmark::doNotOptimize(sum);
+    }
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t operationsNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 200000), 1);
+
+    std::vector<uint8_t> payload(Message::maxPayloadLen);
+    for(size_t i = 0; i < payload.size(); i++)
+        payload[i] = static_cast<uint8_t>(i * 31);
+
+    for(size_t payloadLen : {size_t(0), size_t(16), size_t(256), size_t(4096), Message::maxPayloadLen})
+    {
+        std::string suffix = " " + std::to_string(payloadLen) + " B";
+        size_t      num    = getOperationsNum(operationsNum, payloadLen);
+
+        Benchmark::measure(benchmarkName, "encode" + suffix, num, [&](size_t i) {
+            Message message(static_cast<uint32_t>(i), 1, payload.data(), payloadLen);
+            Benchmark::doNotOptimize(message);
+        });
+
+        Message                    encoded(7, 1, payload.data(), payloadLen);
+        const std::vector<uint8_t> frame(encoded.getMessagePointer(),
+                                         encoded.getMessagePointer() + encoded.getMessageLen());
+        Benchmark::measure(benchmarkName, "decode" + suffix, num, [&](size_t) {
+            Message message(frame.data(), frame.size());
+            Benchmark::doNotOptimize(message);
+        });
+
+        uint32_t crc = 0;
+        Benchmark::measure(benchmarkName, "crc32" + suffix, num, [&](size_t) {
+            crc ^= Utilities::crc32_instance.calculate(payload.data(), static_cast<uint32_t>(payloadLen));
+        });
+        Benchmark::doNotOptimize(crc);
+    }
+
+    runEndianCases<uint16_t>(operationsNum * 50, "u16");
+    runEndianCases<uint32_t>(operationsNum * 50, "u32");
+    runEndianCases<uint64_t>(operationsNum * 50, "u64");
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Message encode and decode, CRC32 and Endian by payload size", run);
+} // namespace
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "metrics/exporter.hpp"
+#include "metrics/registry.hpp"
+#include "metrics/tracer.hpp"
+
+/* Cost of recording a counter, gauge, node counter and histogram value from several threads at once, against a
+ * single atomic shared by all threads. Also the time of a registry snapshot and of rendering it for export with a
+ * large number of per node series, and what taking the latest publication costs a routing thread. Message tracing is
+ * timed through all of its stages with tracing off, sampled and on for every message.
+ * Arguments: [operations per thread] [threads] [nodes]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "metrics";
+
+template <typename Operation>
+void runCase(const std::string &name, size_t operationsNum, size_t threadsNum, Operation operation)
+{
+    std::vector<std::thread> threads;
+    Benchmark::Stopwatch     stopwatch;
+    for(size_t t = 0; t < threadsNum; t++)
+    {
+        threads.emplace_back([&] {
+            for(size_t i = 0; i < operationsNum; i++)
+                operation(i);
+        });
+    }
+    for(auto &thread : threads)
+        thread.join();
+    double seconds = stopwatch.elapsedSeconds();
+
+    // Wall time per operation of all threads, equal to the cost of one operation as long as threads do not contend
+    Benchmark::report(benchmarkName, name, seconds * 1e9 / (operationsNum * threadsNum), "ns/op");
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t operationsNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 10000000), 1);
+    size_t threadsNum    = std::max<size_t>(Benchmark::getArgument(arguments, 1, 4), 1);
+    size_t nodesNum      = Benchmark::getArgument(arguments, 2, 100000);
+
+    std::atomic<uint64_t> shared = 0;
+    Metrics::Counter &    counter = Metrics::Registry::getCounter("bench_counter_total", "Benchmark counter");
+    Metrics::Gauge &      gauge   = Metrics::Registry::getGauge("bench_gauge", "Benchmark gauge");
+    Metrics::NodeCounters &nodeCounters = Metrics::Registry::getNodeCounters(1);
+    Metrics::Histogram &   histogram =
+        Metrics::Registry::getHistogram("bench_latency_nanoseconds", "Benchmark histogram");
+
+    for(size_t threads : {size_t(1), threadsNum})
+    {
+        std::string suffix = " " + std::to_string(threads) + " threads";
+        runCase("shared atomic" + suffix, operationsNum, threads, [&](size_t) {
+            shared.fetch_add(1, std::memory_order_relaxed);
+        });
+        runCase("counter" + suffix, operationsNum, threads, [&](size_t) { counter.add(); });
+        runCase("gauge" + suffix, operationsNum, threads, [&](size_t) { gauge.add(); });
+        runCase("node counters" + suffix, operationsNum, threads, [&](size_t i) { nodeCounters.addIn(i & 0xFF); });
+        runCase("histogram" + suffix, operationsNum, threads, [&](size_t i) { histogram.record(i & 0xFFFFF); });
+    }
+
+    Metrics::Histogram::Snapshot histogramSnapshot = histogram.getSnapshot();
+    Benchmark::report(benchmarkName, "histogram p50", histogramSnapshot.getQuantile(0.5), "ns");
+    Benchmark::report(benchmarkName, "histogram p99", histogramSnapshot.getQuantile(0.99), "ns");
+    Benchmark::report(benchmarkName, "histogram max", histogramSnapshot.getMax(), "ns");
+
+    // Every stage a routed message passes, the off case is the price every message pays
+    for(uint32_t interval : {0u, 1000u, 1u})
+    {
+        Metrics::Tracer::setSampleInterval(interval);
+        runCase("trace 1/" + std::to_string(interval), operationsNum, threadsNum, [&](size_t) {
+            uint64_t       readTime = Metrics::Tracer::sample() ? Metrics::Tracer::getNow() : 0;
+            Metrics::Trace trace    = Metrics::Tracer::begin(readTime, 1);
+            for(uint8_t stage = Metrics::Trace::Enqueue; stage < Metrics::Trace::StagesNum; stage++)
+                trace.mark(static_cast<Metrics::Trace::Stage>(stage));
+            Metrics::Tracer::finish(trace);
+        });
+    }
+    Metrics::Tracer::setSampleInterval(0);
+    Benchmark::report(benchmarkName, "chrome trace size", Metrics::Tracer::renderChromeTrace().size() / 1024.0, "KB");
+
+    for(uint32_t nodeId = 1; nodeId <= nodesNum; nodeId++)
+        Metrics::Registry::getNodeCounters(nodeId).addIn(nodeId);
+    std::string nodes = " " + std::to_string(nodesNum) + " nodes";
+
+    // Export runs on the exporter thread, every step is timed on its own
+    size_t                      exportsNum = 10;
+    Metrics::Registry::Snapshot snapshot;
+    std::string                 text;
+    std::vector<uint8_t>        binary;
+    Benchmark::Stopwatch        stopwatch;
+    for(size_t i = 0; i < exportsNum; i++)
+        snapshot = Metrics::Registry::getSnapshot();
+    Benchmark::report(benchmarkName, "snapshot" + nodes, stopwatch.elapsedSeconds() * 1e3 / exportsNum, "ms");
+    stopwatch.restart();
+    for(size_t i = 0; i < exportsNum; i++)
+        text = Metrics::Exporter::renderText(snapshot);
+    Benchmark::report(benchmarkName, "text" + nodes, stopwatch.elapsedSeconds() * 1e3 / exportsNum, "ms");
+    stopwatch.restart();
+    for(size_t i = 0; i < exportsNum; i++)
+        binary = Metrics::Exporter::renderBinary(snapshot);
+    Benchmark::report(benchmarkName, "binary" + nodes, stopwatch.elapsedSeconds() * 1e3 / exportsNum, "ms");
+    Benchmark::report(benchmarkName, "text size" + nodes, text.size() / 1024.0, "KB");
+    Benchmark::report(benchmarkName, "binary size" + nodes, binary.size() / 1024.0, "KB");
+
+    Metrics::Exporter::Config config;
+    config.socketPath = "";
+    Metrics::Exporter exporter(config);
+    size_t            readsNum = 1000000;
+    stopwatch.restart();
+    for(size_t i = 0; i < readsNum; i++)
+        exporter.getPublication();
+    Benchmark::report(benchmarkName, "get publication", stopwatch.elapsedSeconds() * 1e9 / readsNum, "ns");
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Recording cost of counters, gauges and histograms, snapshot time", run);
+} // namespace
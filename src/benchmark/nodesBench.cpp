@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "benchmark.hpp"
+#include "node/nodeDirectory.hpp"
+
+/* Syncing the connected nodes list of an app: the changes since the version the app has, after a number of nodes
+ * reconnected, disconnected or connected for the first time, against the full list. The full list is serialized once
+ * per version, the first request of a version pays for it.
+ * Arguments: [nodes]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "nodes";
+
+void run(const Benchmark::Arguments &arguments)
+{
+    uint32_t nodesNum = std::clamp<uint32_t>(Benchmark::getArgument(arguments, 0, 10000), 1, 1000000);
+
+    NodeDirectory directory;
+    for(uint32_t nodeId = 1; nodeId <= nodesNum; nodeId++)
+        directory.set(nodeId, "node " + std::to_string(nodeId), "thermostat");
+
+    Benchmark::measure(benchmarkName, "full list", 100, [&](size_t) {
+        directory.set(1, "node 1", "thermostat"); // A new version, the cached list is not used
+        Benchmark::doNotOptimize(directory.getChanges(0));
+    });
+    Benchmark::report(benchmarkName, "full list len", double(directory.getChanges(0)->size()), "B");
+
+    // A third of the changes each: reconnects, disconnects and new nodes
+    uint32_t nodeId     = 1;
+    uint32_t nextNodeId = nodesNum + 1;
+    for(size_t changesNum : {10, 100, 1000})
+    {
+        uint64_t since = directory.getVersion();
+        for(size_t i = 0; i < changesNum; i++)
+        {
+            nodeId = nodeId % nodesNum + 1;
+            if(i % 3 == 0)
+            {
+                directory.remove(nodeId);
+                directory.set(nodeId, "node " + std::to_string(nodeId), "thermostat");
+            }
+            else if(i % 3 == 1)
+            {
+                directory.remove(nodeId);
+            }
+            else
+            {
+                directory.set(nextNodeId++, "new node", "thermostat");
+            }
+        }
+
+        std::string suffix = " " + std::to_string(changesNum) + " changes";
+        Benchmark::measure(benchmarkName, "delta" + suffix, 100, [&](size_t) {
+            Benchmark::doNotOptimize(directory.getChanges(since));
+        });
+        Benchmark::report(benchmarkName, "delta len" + suffix, double(directory.getChanges(since)->size()), "B");
+    }
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Changes of the connected nodes list against the full list", run);
+} // namespace
@@ -0,0 +1,161 @@
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "message/message.hpp"
+#include "message/payload.hpp"
+#include "node/nodeList.hpp"
+#include "server/serverNode.hpp"
+#include "server/serverProtocol.hpp"
+
+/* Reconnect storm: every node connects, registers and disconnects once, then the whole fleet reconnects either
+ * with a full registration or by resuming its session with the token received at registration.
+ * Connections are socketpairs driven from one thread, so the numbers show the server side registration cost
+ * plus one round-trip through the kernel per node.
+ */
+namespace
+{
+using Command = ServerProtocol::Command;
+
+constexpr const char *benchmarkName = "registration";
+
+struct Connection
+{
+    int   clientFd = -1;
+    int   serverFd = -1;
+    Node *node     = nullptr;
+};
+
+Connection connect(NodeList &nodeList)
+{
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        throw std::runtime_error("socketpair failed");
+
+    Connection connection;
+    connection.clientFd = fds[0];
+    connection.serverFd = fds[1];
+    connection.node     = new Node(fds[1], "127.0.0.1", [](const Node *, const Message &) {}, [](const Node *) {});
+    nodeList.addNode(connection.node);
+    return connection;
+}
+
+void disconnect(NodeList &nodeList, Connection &connection)
+{
+    nodeList.removeNode(connection.node);
+    close(connection.clientFd);
+}
+
+Message readMessage(int fd)
+{
+    std::vector<uint8_t> buffer(Message::maxMessageLen);
+    ssize_t              len = read(fd, buffer.data(), buffer.size());
+    if(len <= 0)
+        throw std::runtime_error("read failed");
+    return Message(buffer.data(), len);
+}
+
+void sendRequest(int fd, Command command, const PayloadWriter &body)
+{
+    PayloadWriter payload;
+    payload.write(static_cast<uint8_t>(command));
+    payload.writeBytes(body.getPointer(), body.getLen());
+
+    Message request(0, 0, payload.getPointer(), payload.getLen());
+    if(write(fd, request.getMessagePointer(), request.getMessageLen()) != static_cast<ssize_t>(request.getMessageLen()))
+        throw std::runtime_error("write failed");
+}
+
+// Server side of one request: read the frame from the node socket and dispatch it like the event handler does
+void serveRequest(ServerNode &serverNode, Connection &connection)
+{
+    Message request = readMessage(connection.serverFd);
+    serverNode.handleMessage(connection.node, request);
+}
+
+ServerProtocol::SessionToken registerNode(ServerNode &serverNode, Connection &connection, const std::string &interface)
+{
+    PayloadWriter body;
+    body.writeString<uint8_t>("door sensor");
+    body.writeString<uint8_t>("sensor");
+    body.writeString<uint16_t>("simulated node registering in the reconnect storm");
+    body.write<uint32_t>(0);
+    body.write<uint32_t>(interface.size());
+    body.writeBytes(reinterpret_cast<const uint8_t *>(interface.data()), interface.size());
+    sendRequest(connection.clientFd, Command::Register, body);
+    serveRequest(serverNode, connection);
+
+    Message       ack = readMessage(connection.clientFd);
+    PayloadReader reader(ack.getPayloadPointer(), ack.getPayloadLen());
+    if(static_cast<Command>(reader.read<uint8_t>()) != Command::RegisterAck)
+        throw std::runtime_error("RegisterAck expected");
+    reader.read<uint32_t>();
+    return ServerProtocol::SessionToken::read(reader);
+}
+
+void resumeNode(ServerNode &serverNode, Connection &connection, const ServerProtocol::SessionToken &token)
+{
+    PayloadWriter body;
+    token.write(body);
+    sendRequest(connection.clientFd, Command::Resume, body);
+    serveRequest(serverNode, connection);
+
+    Message       ack = readMessage(connection.clientFd);
+    PayloadReader reader(ack.getPayloadPointer(), ack.getPayloadLen());
+    if(static_cast<Command>(reader.read<uint8_t>()) != Command::ResumeAck)
+        throw std::runtime_error("ResumeAck expected");
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t nodesNum = Benchmark::getArgument(arguments, 0, 20000);
+
+    // Interface description of a typical node, sent with every full registration
+    std::string interface = "{\"interfaceVersion\":1.0,\"interfaces\":[";
+    for(int i = 0; i < 24; i++)
+    {
+        interface += "{\"index\":" + std::to_string(i) +
+                     ",\"name\":\"field\",\"type\":\"data\",\"arguments\":[{\"dataType\":\"integer\"}]},";
+    }
+    interface += "]}";
+
+    NodeList   nodeList;
+    ServerNode serverNode("", &nodeList, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    std::vector<ServerProtocol::SessionToken> tokens(nodesNum);
+    for(size_t i = 0; i < nodesNum; i++)
+    {
+        Connection connection = connect(nodeList);
+        tokens[i]             = registerNode(serverNode, connection, interface);
+        disconnect(nodeList, connection);
+    }
+
+    Benchmark::Stopwatch stopwatch;
+    for(size_t i = 0; i < nodesNum; i++)
+    {
+        Connection connection = connect(nodeList);
+        registerNode(serverNode, connection, interface);
+        disconnect(nodeList, connection);
+    }
+    double fullSeconds = stopwatch.elapsedSeconds();
+
+    stopwatch.restart();
+    for(size_t i = 0; i < nodesNum; i++)
+    {
+        Connection connection = connect(nodeList);
+        resumeNode(serverNode, connection, tokens[i]);
+        disconnect(nodeList, connection);
+    }
+    double resumeSeconds = stopwatch.elapsedSeconds();
+
+    Benchmark::report(benchmarkName, "reconnecting nodes", nodesNum, "nodes");
+    Benchmark::report(benchmarkName, "full registration storm", nodesNum / fullSeconds, "nodes/s");
+    Benchmark::report(benchmarkName, "resumption storm", nodesNum / resumeSeconds, "nodes/s");
+    Benchmark::report(benchmarkName, "speedup", fullSeconds / resumeSeconds, "x");
+}
+
+Benchmark::Registrar registrar(benchmarkName, "reconnect storm with full registration vs session resumption", run);
+} // namespace
@@ -0,0 +1,166 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "benchClient.hpp"
+#include "benchmark.hpp"
+#include "database/historyStore.hpp"
+#include "message/message.hpp"
+#include "message/payload.hpp"
+#include "node/nodeList.hpp"
+#include "server/serverNode.hpp"
+#include "server/serverProtocol.hpp"
+
+/* History replay: one node's history is streamed to an app node through a history query cursor.
+ * The app side reads the pages over a socketpair, verifies them and requests the next pages, the server side
+ * dispatches the requests like the event handler does. Anonymous memory is sampled during the replay, frames are
+ * written from the segment mappings so it should stay flat while the mapped file pages show up as file memory.
+ * Arguments: [megabytes] [payload len] [pages per request]
+ */
+namespace
+{
+using Command = ServerProtocol::Command;
+
+constexpr const char *benchmarkName = "replay";
+constexpr uint32_t    sourceNodeId  = 7;
+constexpr uint32_t    appNodeId     = 100;
+constexpr uint32_t    queryId       = 1;
+
+// Value of a "<key>: <value> kB" line of /proc/self/status in kB
+size_t readStatus(const std::string &key)
+{
+    std::ifstream file("/proc/self/status");
+    std::string   line;
+    while(std::getline(file, line))
+    {
+        if(line.rfind(key + ":", 0) == 0)
+            return std::stoul(line.substr(key.size() + 1));
+    }
+    return 0;
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t   megabytes  = Benchmark::getArgument(arguments, 0, 1024);
+    size_t   payloadLen = Benchmark::getArgument(arguments, 1, 256);
+    uint16_t pages      = Benchmark::getArgument(arguments, 2, 16);
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "iot-bench-replay";
+    std::filesystem::remove_all(directory);
+
+    Database::HistoryStore::Config config;
+    config.directory = directory.string();
+    Database::HistoryStore historyStore(config);
+
+    // Stored frames are what the source node sent, a megabyte of replay is a megabyte of frames
+    std::vector<uint8_t> payload(payloadLen, 0x5A);
+    Message              frame(sourceNodeId, 0, payload.data(), payload.size());
+    size_t               recordsNum = megabytes * 1024 * 1024 / frame.getMessageLen();
+    for(size_t i = 0; i < recordsNum; i++)
+    {
+        historyStore.append(sourceNodeId, i + 1, frame.getMessagePointer(), frame.getMessageLen());
+    }
+    historyStore.flush();
+
+    NodeList   nodeList;
+    ServerNode serverNode("", &nodeList, nullptr, &historyStore, nullptr, nullptr, nullptr, nullptr);
+
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        throw std::runtime_error("socketpair failed");
+    Node *node = new Node(fds[1], "127.0.0.1", [](const Node *, const Message &) {}, [](const Node *) {});
+    nodeList.addNode(node);
+    node->setRegistration(appNodeId, "dashboard", "app", "replays the history of a node");
+
+    size_t              anonymousBefore = readStatus("RssAnon");
+    std::atomic<size_t> anonymousPeak   = anonymousBefore;
+    size_t              receivedRecords = 0;
+    size_t              receivedBytes   = 0;
+
+    Benchmark::Stopwatch stopwatch;
+    std::thread          app([&]() {
+        std::vector<uint8_t> buffer;
+
+        ServerProtocol::HistoryQuery query;
+        query.queryId = queryId;
+        query.nodeId  = sourceNodeId;
+        query.to      = UINT64_MAX;
+        query.pages   = pages;
+
+        PayloadWriter body;
+        query.write(body);
+        Benchmark::sendCommand(fds[0], appNodeId, Command::HistoryQuery, body);
+
+        for(size_t page = 1;; page++)
+        {
+            Message       message = Benchmark::readFrame(fds[0], buffer);
+            PayloadReader reader(message.getPayloadPointer(), message.getPayloadLen());
+            Command command = static_cast<Command>(reader.read<uint8_t>());
+            if(command != Command::HistoryPage || reader.read<uint32_t>() != queryId)
+                throw std::runtime_error("HistoryPage expected");
+
+            uint8_t  flags      = reader.read<uint8_t>();
+            uint16_t recordsNum = reader.read<uint16_t>();
+            for(uint16_t i = 0; i < recordsNum; i++)
+            {
+                reader.read<uint64_t>();
+                uint32_t frameLen = reader.read<uint32_t>();
+                reader.readBytes(frameLen);
+                receivedBytes += frameLen;
+            }
+            receivedRecords += recordsNum;
+
+            if(page % 64 == 0)
+                anonymousPeak = std::max<size_t>(anonymousPeak, readStatus("RssAnon"));
+            if(flags & ServerProtocol::LastPage)
+                break;
+
+            if(page % pages == 0)
+            {
+                PayloadWriter next;
+                next.write(queryId);
+                next.write(pages);
+                Benchmark::sendCommand(fds[0], appNodeId, Command::HistoryNext, next);
+            }
+        }
+        shutdown(fds[0], SHUT_WR);
+    });
+
+    // Server side: requests are dispatched until the app node is done
+    std::vector<uint8_t> buffer(Message::maxMessageLen);
+    while(true)
+    {
+        ssize_t len = read(fds[1], buffer.data(), buffer.size());
+        if(len <= 0)
+            break;
+        serverNode.handleMessage(node, Message(buffer.data(), len));
+    }
+    app.join();
+    double seconds = stopwatch.elapsedSeconds();
+
+    Benchmark::report(benchmarkName, "replayed", receivedBytes / (1024.0 * 1024.0), "MB");
+    Benchmark::report(benchmarkName, "throughput", receivedBytes / (1024.0 * 1024.0) / seconds, "MB/s");
+    Benchmark::report(benchmarkName, "records", receivedRecords / seconds, "records/s");
+    Benchmark::report(benchmarkName, "anonymous memory growth", (anonymousPeak - anonymousBefore) / 1024.0, "MB");
+    Benchmark::report(benchmarkName, "file memory after replay", readStatus("RssFile") / 1024.0, "MB");
+
+    serverNode.nodeRemoved(node);
+    nodeList.removeNode(node);
+    close(fds[0]);
+    std::filesystem::remove_all(directory);
+
+    if(receivedRecords != recordsNum)
+    {
+        throw std::runtime_error("Replayed " + std::to_string(receivedRecords) + " of " + std::to_string(recordsNum) +
+                                 " records");
+    }
+}
+
+Benchmark::Registrar registrar(benchmarkName, "history replay MB/s and server memory through a query cursor", run);
+} // namespace
@@ -0,0 +1,68 @@
+#include <filesystem>
+
+#include "benchmark.hpp"
+#include "database/historyStore.hpp"
+#include "database/rollupStore.hpp"
+
+/* Rollup updates and range queries.
+ * Update rate is measured for samples spread over many series within one minute, the query reads one year of
+ * hourly buckets of a series that got a sample every 10 minutes for that year.
+ * Arguments: [updates] [series]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "rollup";
+
+void removeDatabase(const std::filesystem::path &path)
+{
+    for(const char *suffix : {"", "-wal", "-shm"})
+    {
+        std::filesystem::remove(path.string() + suffix);
+    }
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t updatesNum = Benchmark::getArgument(arguments, 0, 10000000);
+    size_t seriesNum  = Benchmark::getArgument(arguments, 1, 1000);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "iot-bench-rollups.db";
+    removeDatabase(path);
+
+    Database::RollupStore::Config config;
+    config.database.path = path.string();
+    {
+        Database::RollupStore rollupStore(config);
+
+        constexpr uint64_t sampleIntervalNs = 10ULL * 60 * 1000 * 1000 * 1000;
+        constexpr uint64_t yearNs           = 365ULL * 24 * 60 * 60 * 1000 * 1000 * 1000;
+
+        uint64_t now   = Database::HistoryStore::getTimestamp();
+        uint64_t start = now - yearNs;
+
+        Benchmark::Stopwatch populate;
+        size_t               samplesNum = 0;
+        for(uint64_t timestamp = start; timestamp < now; timestamp += sampleIntervalNs, samplesNum++)
+        {
+            rollupStore.update(1, 0, 0, timestamp, double(samplesNum % 100));
+        }
+        rollupStore.flush();
+        Benchmark::report(benchmarkName, "populate year", populate.elapsedSeconds() * 1e3, "ms");
+
+        Benchmark::Stopwatch updates;
+        for(size_t i = 0; i < updatesNum; i++)
+        {
+            rollupStore.update(uint32_t(i % seriesNum) + 2, 0, 1, now + i, double(i & 0xFF));
+        }
+        Benchmark::report(benchmarkName, "updates", updatesNum / updates.elapsedSeconds(), "updates/s");
+
+        Benchmark::Stopwatch query;
+        auto buckets = rollupStore.query(1, 0, 0, Database::RollupStore::Resolution::Hour, start, now);
+        Benchmark::report(benchmarkName, "hourly year query", query.elapsedSeconds() * 1e3, "ms");
+        Benchmark::report(benchmarkName, "hourly buckets", buckets.size(), "buckets");
+    }
+    removeDatabase(path);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "O(1) rollup updates and a year of hourly buckets query", run);
+} // namespace
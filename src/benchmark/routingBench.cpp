@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <semaphore>
+#include <stdexcept>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "message/message.hpp"
+#include "metrics/tracer.hpp"
+#include "node/nodeList.hpp"
+
+/* Per message work of the event handler besides sending: pushing the event to the queue and popping it, alone and
+ * with the lock and the semaphore that wake the handler, and looking up the destination in the NodeList by id, found
+ * and not found, with a number of registered nodes. Nodes are not connected, lookups only read the list.
+ * Arguments: [operations per repetition] [nodes]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "routing";
+
+// Same fields as the event of the server, which keeps its own private
+struct Event
+{
+    int                                   type    = 0;
+    Node *                                node    = nullptr;
+    Message *                             message = nullptr;
+    std::chrono::steady_clock::time_point receivedTime;
+    Metrics::Trace                        trace;
+};
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t   operationsNum = std::max<size_t>(Benchmark::getArgument(arguments, 0, 1000000), 1);
+    uint32_t nodesNum      = std::max<uint32_t>(Benchmark::getArgument(arguments, 1, 10000), 1);
+
+    std::queue<Event> eventQueue;
+    Event             event;
+    Benchmark::measure(benchmarkName, "event push and pop", operationsNum, [&](size_t) {
+        eventQueue.push(event);
+        Benchmark::doNotOptimize(eventQueue.front());
+        eventQueue.pop();
+    });
+
+    // As the server does it: pushed under the lock, the handler woken and the queue taken as a whole
+    std::mutex                 eventMutex;
+    std::counting_semaphore<1> eventSemaphore(0);
+    Benchmark::measure(benchmarkName, "event push and pop with lock and semaphore", operationsNum, [&](size_t) {
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            eventQueue.push(event);
+        }
+        eventSemaphore.release();
+        eventSemaphore.acquire();
+        std::queue<Event> events;
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            events.swap(eventQueue);
+        }
+        Benchmark::doNotOptimize(events.front());
+        events.pop();
+    });
+
+    NodeList nodeList;
+    for(uint32_t id = 1; id <= nodesNum; id++)
+    {
+        Node *node = new Node(-1, "127.0.0.1", nullptr, nullptr);
+        node->setRegistration(id, "node" + std::to_string(id), "bench", "");
+        nodeList.addNode(node);
+        nodeList.nodeRegistered(node);
+    }
+
+    // Random ids so the lookups do not walk the map in order
+    std::vector<uint32_t> ids(4096);
+    std::mt19937          generator(1);
+    for(uint32_t &id : ids)
+        id = std::uniform_int_distribution<uint32_t>(1, nodesNum)(generator);
+
+    std::string nodes = " " + std::to_string(nodesNum) + " nodes";
+    Benchmark::measure(benchmarkName, "lookup found" + nodes, operationsNum, [&](size_t i) {
+        Benchmark::doNotOptimize(nodeList.getNodeById(ids[i % ids.size()]));
+    });
+
+    // An undeliverable message, the lookup throws
+    size_t missesNum = std::max<size_t>(operationsNum / 10, 1);
+    Benchmark::measure(benchmarkName, "lookup not found" + nodes, missesNum, [&](size_t i) {
+        try
+        {
+            nodeList.getNodeById(nodesNum + 1 + static_cast<uint32_t>(i % ids.size()));
+        }
+        catch(const std::runtime_error &e)
+        {
+            Benchmark::doNotOptimize(e);
+        }
+    });
+
+    for(uint32_t id = 1; id <= nodesNum; id++)
+        nodeList.removeNode(nodeList.getNodeById(id));
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Event queue push and pop, NodeList lookups by node id", run);
+} // namespace
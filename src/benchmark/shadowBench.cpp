@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "benchmark.hpp"
+#include "server/deviceShadow.hpp"
+
+/* Device shadow of a fleet: updates of the last values as ingest does them, the fleet snapshot after a part of the
+ * nodes changed, which copies only those, and its serialization. Nodes share a few interface layouts, every node
+ * reports all fields of its interface once before the measurements.
+ * Arguments: [nodes] [fields per node]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "shadow";
+constexpr uint32_t    interfacesNum = 4; // Distinct interface layouts
+
+void run(const Benchmark::Arguments &arguments)
+{
+    uint32_t nodesNum  = std::clamp<uint32_t>(Benchmark::getArgument(arguments, 0, 10000), 1, 1000000);
+    uint32_t fieldsNum = std::clamp<uint32_t>(Benchmark::getArgument(arguments, 1, 16), 1, 256);
+
+    DeviceShadow shadow;
+    uint64_t     timestamp = 1;
+    for(uint32_t nodeId = 1; nodeId <= nodesNum; nodeId++)
+    {
+        shadow.addNode(nodeId, nodeId % interfacesNum);
+        for(uint32_t field = 0; field < fieldsNum; field++)
+            shadow.update(nodeId, 0, uint8_t(field), timestamp++, field);
+    }
+
+    size_t   operationsNum = std::max<size_t>(nodesNum, 100000);
+    uint32_t sampleIndex   = 0;
+    Benchmark::measure(benchmarkName, "update", operationsNum, [&](size_t) {
+        uint32_t nodeId = sampleIndex / fieldsNum % nodesNum + 1;
+        shadow.update(nodeId, 0, uint8_t(sampleIndex % fieldsNum), timestamp++, sampleIndex);
+        sampleIndex++;
+    });
+
+    Benchmark::measure(benchmarkName, "fleet snapshot unchanged", 1000, [&](size_t) {
+        Benchmark::doNotOptimize(shadow.getSnapshot());
+    });
+
+    // One sample of the given share of the nodes between snapshots
+    for(uint32_t percent : {1, 10, 100})
+    {
+        uint32_t changedNum = std::max<uint32_t>(nodesNum * percent / 100, 1);
+        Benchmark::measure(benchmarkName, "fleet snapshot " + std::to_string(percent) + "% changed", 20, [&](size_t) {
+            for(uint32_t i = 0; i < changedNum; i++)
+                shadow.update((sampleIndex++ % nodesNum) + 1, 0, 0, timestamp++, i);
+            Benchmark::doNotOptimize(shadow.getSnapshot());
+        });
+    }
+
+    auto   snapshot = shadow.getSnapshot();
+    size_t len      = DeviceShadow::serialize(*snapshot).size();
+    Benchmark::measure(benchmarkName, "serialize fleet", 20, [&](size_t) {
+        Benchmark::doNotOptimize(DeviceShadow::serialize(*snapshot));
+    });
+    Benchmark::report(benchmarkName, "serialized fleet len", double(len), "B");
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Last value cache of the fleet and its snapshots", run);
+} // namespace
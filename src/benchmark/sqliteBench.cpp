@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "database/nodeDatabase.hpp"
+
+/* Audit event inserts through the group committing SQLite writer with different batch sizes.
+ * Rows/s include the final flush, enqueue latency is the time a caller spends in NodeDatabase::recordEvent.
+ * Arguments: [rows per batch size]
+ */
+namespace
+{
+constexpr const char *benchmarkName = "sqlite";
+
+void removeDatabase(const std::filesystem::path &path)
+{
+    for(const char *suffix : {"", "-wal", "-shm"})
+    {
+        std::filesystem::remove(path.string() + suffix);
+    }
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t rowsNum = Benchmark::getArgument(arguments, 0, 20000);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "iot-bench.db";
+    for(size_t batchRows : {1, 8, 64, 256, 1024})
+    {
+        removeDatabase(path);
+
+        Database::SqliteWriter::Config config;
+        config.path      = path.string();
+        config.batchRows = batchRows;
+
+        std::vector<double> latencies(rowsNum);
+        double              seconds = 0;
+        {
+            Database::NodeDatabase nodeDatabase(config);
+
+            Benchmark::Stopwatch stopwatch;
+            for(size_t i = 0; i < rowsNum; i++)
+            {
+                Benchmark::Stopwatch enqueue;
+                nodeDatabase.recordEvent(i % 1000 + 1, "connected", "fd=42, ip=192.168.1.20, registered=false");
+                latencies[i] = enqueue.elapsedSeconds();
+            }
+            nodeDatabase.flush();
+            seconds = stopwatch.elapsedSeconds();
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        std::string prefix = "batch " + std::to_string(batchRows) + " ";
+        Benchmark::report(benchmarkName, prefix + "rows", rowsNum / seconds, "rows/s");
+        Benchmark::report(benchmarkName, prefix + "p99 enqueue", latencies[rowsNum * 99 / 100] * 1e6, "us");
+    }
+    removeDatabase(path);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "group commit rows/s and enqueue latency per batch size", run);
+} // namespace
@@ -0,0 +1,124 @@
+#include <filesystem>
+#include <stdexcept>
+
+#include "benchmark.hpp"
+#include "database/registryStore.hpp"
+#include "node/nodeList.hpp"
+
+/* Node registry restore time by registry size.
+ * For every size the registry is stored as a snapshot only, as a snapshot of 90% of the records plus a log with the
+ * rest, and as a log only, then a fresh NodeList is restored from it. Files are in the page cache, so the numbers
+ * show parsing and building the records, not disk reads.
+ * Arguments: [max records] [device types]
+ */
+namespace
+{
+using Records = Database::RegistryStore::Records;
+
+constexpr const char *benchmarkName = "startup";
+
+constexpr size_t interfaceLen = 2048;
+
+Records makeRecords(size_t recordsNum, size_t typesNum)
+{
+    std::vector<std::shared_ptr<const std::string>> interfaces;
+    for(size_t i = 0; i < typesNum; i++)
+    {
+        std::string interface = "{\"type\":\"device-" + std::to_string(i) + "\",\"fields\":[";
+        interface.resize(interfaceLen, 'x');
+        interfaces.push_back(std::make_shared<const std::string>(interface));
+    }
+
+    Records records;
+    for(uint32_t id = 1; id <= recordsNum; id++)
+    {
+        NodeRecord record;
+        record.id            = id;
+        record.name          = "node-" + std::to_string(id);
+        record.type          = "device-" + std::to_string(id % typesNum);
+        record.description   = "Sensor node " + std::to_string(id) + " in building " + std::to_string(id % 97);
+        record.options       = id & 0x3;
+        record.interfaceHash = uint32_t(id % typesNum);
+        record.interface     = interfaces[id % typesNum];
+        record.secret        = uint64_t(id) * 0x9E3779B97F4A7C15ULL;
+        records.emplace(id, std::make_shared<const NodeRecord>(std::move(record)));
+    }
+    return records;
+}
+
+// Writes the first snapshotNum records as a checkpoint and the rest to the log after it
+void storeRegistry(const Database::RegistryStore::Config &config, const Records &records, size_t snapshotNum)
+{
+    std::filesystem::remove_all(config.directory);
+
+    Database::RegistryStore registryStore(config);
+    Records                 loaded;
+    uint32_t                nextNodeId = 1;
+    registryStore.load(loaded, nextNodeId);
+
+    Records snapshot;
+    for(uint32_t id = 1; id <= snapshotNum; id++)
+        snapshot.emplace(id, records.at(id));
+
+    // The stall is the time the caller's thread spends in checkpoint, the snapshot is serialized and written after
+    Benchmark::Stopwatch checkpoint;
+    registryStore.checkpoint(snapshot, uint32_t(snapshotNum + 1));
+    double stallMs = checkpoint.elapsedSeconds() * 1e3;
+    registryStore.flush();
+    double checkpointMs = checkpoint.elapsedSeconds() * 1e3;
+    if(snapshotNum == records.size())
+    {
+        Benchmark::report(benchmarkName, "checkpoint stall " + std::to_string(records.size()), stallMs, "ms");
+        Benchmark::report(benchmarkName, "checkpoint written " + std::to_string(records.size()), checkpointMs, "ms");
+    }
+
+    for(uint32_t id = uint32_t(snapshotNum + 1); id <= records.size(); id++)
+        registryStore.append(*records.at(id));
+    registryStore.flush();
+}
+
+void measureRestore(const Database::RegistryStore::Config &config, const Records &records, const std::string &layout)
+{
+    Benchmark::Stopwatch    restore;
+    Database::RegistryStore registryStore(config);
+    NodeList                nodeList(&registryStore);
+    Benchmark::report(benchmarkName,
+                      "restore " + layout + " " + std::to_string(records.size()),
+                      restore.elapsedSeconds() * 1e3,
+                      "ms");
+
+    for(const auto &[id, record] : records)
+    {
+        const NodeRecord *restored = nodeList.findRecord(id, record->options, record->interfaceHash, record->secret);
+        if(restored == nullptr || restored->name != record->name || *restored->interface != *record->interface)
+            throw std::runtime_error("Record " + std::to_string(id) + " not restored");
+    }
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t maxRecordsNum = Benchmark::getArgument(arguments, 0, 100000);
+    size_t typesNum      = std::max<size_t>(Benchmark::getArgument(arguments, 1, 16), 1);
+
+    Database::RegistryStore::Config config;
+    config.directory         = (std::filesystem::temp_directory_path() / "iot-bench-registry").string();
+    config.checkpointLogSize = SIZE_MAX;
+
+    for(size_t recordsNum = 1000; recordsNum <= maxRecordsNum; recordsNum *= 10)
+    {
+        Records records = makeRecords(recordsNum, typesNum);
+
+        storeRegistry(config, records, recordsNum);
+        measureRestore(config, records, "snapshot");
+
+        storeRegistry(config, records, recordsNum * 9 / 10);
+        measureRestore(config, records, "snapshot+log");
+
+        storeRegistry(config, records, 0);
+        measureRestore(config, records, "log");
+    }
+    std::filesystem::remove_all(config.directory);
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Node registry restore from snapshot and change log", run);
+} // namespace
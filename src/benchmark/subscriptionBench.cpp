@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "node/node.hpp"
+#include "server/subscriptionIndex.hpp"
+
+/* Matching of telemetry samples against content subscriptions: the index against evaluating every predicate, with
+ * the predicates spread over the fields of several node types and with all of them on one field. Predicates are a mix
+ * of lower bounds, upper bounds and ranges over values in [0, 100), samples are uniform over the same fields and
+ * values. The first match after the predicates were added builds the trees of the fields.
+ * Arguments: [samples per repetition] [predicates]
+ */
+namespace
+{
+constexpr const char *benchmarkName  = "subscription";
+constexpr size_t      subscribersNum = 1000;
+constexpr size_t      typesNum       = 8;
+constexpr size_t      interfacesNum  = 4;
+constexpr size_t      fieldsNum      = 8;
+
+struct Sample
+{
+    const std::string *type;
+    uint8_t            interfaceIndex;
+    uint8_t            fieldIndex;
+    double             value;
+};
+
+bool fulfills(const SubscriptionIndex::Predicate &predicate, const Sample &sample)
+{
+    return predicate.nodeType == *sample.type && predicate.interfaceIndex == sample.interfaceIndex &&
+           predicate.fieldIndex == sample.fieldIndex &&
+           (predicate.low < sample.value || (predicate.lowInclusive && predicate.low == sample.value)) &&
+           (predicate.high > sample.value || (predicate.highInclusive && predicate.high == sample.value));
+}
+
+void run(const Benchmark::Arguments &arguments)
+{
+    size_t samplesNum    = std::max<size_t>(Benchmark::getArgument(arguments, 0, 100000), 1);
+    size_t predicatesNum = std::max<size_t>(Benchmark::getArgument(arguments, 1, 100000), 1);
+
+    std::vector<std::unique_ptr<Node>> subscribers;
+    for(size_t i = 0; i < subscribersNum; i++)
+    {
+        auto transport = std::make_unique<MemoryTransport>(i, [](const uint8_t *, size_t) {});
+        subscribers.push_back(
+            std::make_unique<Node>(std::move(transport), "subscription", [](const Node *, const Message &) {},
+                                   [](const Node *) {}));
+    }
+
+    std::vector<std::string> types;
+    for(size_t i = 0; i < typesNum; i++)
+        types.push_back("type" + std::to_string(i));
+
+    for(bool oneField : {false, true})
+    {
+        std::string                            suffix = oneField ? " one field" : " spread";
+        std::mt19937                           generator(1);
+        std::uniform_real_distribution<double> valueDistribution(0, 100);
+        auto                                   random = [&](size_t bound) {
+            return std::uniform_int_distribution<size_t>(0, bound - 1)(generator);
+        };
+
+        SubscriptionIndex                         index;
+        std::vector<SubscriptionIndex::Predicate> predicates(predicatesNum);
+        for(size_t i = 0; i < predicatesNum; i++)
+        {
+            SubscriptionIndex::Predicate &predicate = predicates[i];
+            predicate.nodeType                      = oneField ? types[0] : types[random(typesNum)];
+            predicate.interfaceIndex                = oneField ? 0 : random(interfacesNum);
+            predicate.fieldIndex                    = oneField ? 0 : random(fieldsNum);
+
+            // Thresholds like "> 30" mostly, some "< 10" and narrow ranges
+            double   bound = valueDistribution(generator);
+            uint32_t kind  = random(4);
+            if(kind <= 1)
+                predicate.low = bound;
+            else if(kind == 2)
+                predicate.high = bound;
+            else
+            {
+                predicate.low  = bound;
+                predicate.high = bound + 5;
+            }
+            predicate.lowInclusive = kind != 0;
+            index.add(subscribers[i % subscribersNum].get(), uint32_t(i), predicate);
+        }
+
+        std::vector<Sample> samples(4096);
+        for(Sample &sample : samples)
+        {
+            sample.type           = oneField ? &types[0] : &types[random(typesNum)];
+            sample.interfaceIndex = oneField ? 0 : random(interfacesNum);
+            sample.fieldIndex     = oneField ? 0 : random(fieldsNum);
+            sample.value          = valueDistribution(generator);
+        }
+
+        std::vector<SubscriptionIndex::Match> matches;
+        Benchmark::Stopwatch                  stopwatch;
+        index.match(*samples[0].type, samples[0].interfaceIndex, samples[0].fieldIndex, samples[0].value, matches);
+        Benchmark::report(benchmarkName, "first match with build" + suffix, stopwatch.elapsedSeconds() * 1e3, "ms");
+
+        Benchmark::measure(benchmarkName, "index match" + suffix, samplesNum, [&](size_t i) {
+            const Sample &sample = samples[i % samples.size()];
+            matches.clear();
+            index.match(*sample.type, sample.interfaceIndex, sample.fieldIndex, sample.value, matches);
+        });
+        stopwatch.restart();
+        for(size_t i = 0; i < samplesNum; i++)
+        {
+            const Sample &sample = samples[i % samples.size()];
+            matches.clear();
+            index.match(*sample.type, sample.interfaceIndex, sample.fieldIndex, sample.value, matches);
+        }
+        Benchmark::report(benchmarkName, "samples matched" + suffix, samplesNum / stopwatch.elapsedSeconds(), "msg/s");
+
+        // Evaluating every predicate, fewer samples, it is slower by the number of predicates
+        size_t scannedNum = std::max<size_t>(samplesNum / 100, 1);
+        Benchmark::measure(benchmarkName, "linear match" + suffix, scannedNum, [&](size_t i) {
+            const Sample &sample = samples[i % samples.size()];
+            size_t        found  = 0;
+            for(const SubscriptionIndex::Predicate &predicate : predicates)
+                found += fulfills(predicate, sample);
+            Benchmark::doNotOptimize(found);
+        });
+
+        // The index has to find what the scan finds
+        size_t matchesNum = 0;
+        size_t expected   = 0;
+        for(size_t i = 0; i < samples.size(); i++)
+        {
+            const Sample &sample = samples[i];
+            matches.clear();
+            index.match(*sample.type, sample.interfaceIndex, sample.fieldIndex, sample.value, matches);
+            matchesNum += matches.size();
+            for(const SubscriptionIndex::Predicate &predicate : predicates)
+                expected += fulfills(predicate, sample);
+        }
+        if(matchesNum != expected)
+            throw std::runtime_error("Index and scan disagree in subscription benchmark");
+        Benchmark::report(benchmarkName, "matches per sample" + suffix, double(matchesNum) / samples.size(), "matches");
+    }
+}
+
+Benchmark::Registrar registrar(benchmarkName, "Content subscription index against evaluating every predicate", run);
+} // namespace
@@ -0,0 +1,476 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "blobStore.hpp"
+#include "historyStore.hpp"
+
+namespace Database
+{
+static const std::string schema =
+    "CREATE TABLE IF NOT EXISTS chunks (hash BLOB PRIMARY KEY, pack INTEGER, offset INTEGER, len INTEGER) "
+    "WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS clips ("
+    "id INTEGER PRIMARY KEY, "
+    "node_id INTEGER, "
+    "event_timestamp INTEGER, "
+    "event TEXT, "
+    "size INTEGER, "
+    "created INTEGER);"
+    "CREATE INDEX IF NOT EXISTS clips_node ON clips (node_id, event_timestamp);"
+    "CREATE TABLE IF NOT EXISTS clip_chunks (clip_id INTEGER, chunk_index INTEGER, hash BLOB, "
+    "PRIMARY KEY (clip_id, chunk_index)) WITHOUT ROWID;";
+
+// Order matches BlobStore::Statement
+static const std::vector<std::string> statements = {
+    "INSERT OR IGNORE INTO chunks (hash, pack, offset, len) VALUES (?, ?, ?, ?);",
+    "INSERT INTO clips (id, node_id, event_timestamp, event, size, created) VALUES (?, ?, ?, ?, ?, ?);",
+    "INSERT INTO clip_chunks (clip_id, chunk_index, hash) VALUES (?, ?, ?);",
+};
+
+BlobStore::Pack::~Pack()
+{
+    if(fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+BlobStore::BlobStore(const Config &config) : config(config), writer(config.database, schema, statements)
+{
+    if(config.chunkSize == 0 || config.chunkSize > config.packSize || config.chunkSize > UINT32_MAX)
+    {
+        throw std::runtime_error("Invalid BlobStore configuration");
+    }
+
+    int ret = sqlite3_open_v2(config.database.path.c_str(), &readDb, SQLITE_OPEN_READONLY, nullptr);
+    if(ret != SQLITE_OK)
+    {
+        std::string error = readDb != nullptr ? sqlite3_errmsg(readDb) : std::to_string(ret);
+        sqlite3_close(readDb);
+        throw std::runtime_error("Unable to open blob database for reading: " + error);
+    }
+
+    try
+    {
+        selectClipStatement   = prepareRead("SELECT node_id, event_timestamp, event, size FROM clips WHERE id = ?;");
+        selectChunksStatement = prepareRead("SELECT hash FROM clip_chunks WHERE clip_id = ? ORDER BY chunk_index;");
+
+        std::filesystem::create_directories(config.directory);
+        std::map<uint32_t, size_t> packEnds;
+        loadIndex(packEnds);
+        openPacks(packEnds);
+    }
+    catch(const std::exception &e)
+    {
+        sqlite3_finalize(selectClipStatement);
+        sqlite3_finalize(selectChunksStatement);
+        sqlite3_close(readDb);
+        throw;
+    }
+
+    workerThread = std::thread(BlobStore::workerThreadProcess, this);
+}
+
+BlobStore::~BlobStore()
+{
+    LOG_MESSAGE(LogLevel::Debug, "Destructing blob store");
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        inDestruction = true;
+    }
+    taskCondition.notify_one();
+
+    if(workerThread.joinable())
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Joining worker thread");
+        workerThread.join();
+    }
+
+    sqlite3_finalize(selectClipStatement);
+    sqlite3_finalize(selectChunksStatement);
+    sqlite3_close(readDb);
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
+}
+
+std::shared_ptr<BlobStore::Upload>
+    BlobStore::beginClip(uint32_t nodeId, uint64_t eventTimestamp, const std::string &event)
+{
+    return std::shared_ptr<Upload>(new Upload(this, nodeId, eventTimestamp, event));
+}
+
+bool BlobStore::findClip(uint64_t clipId, Clip &clip)
+{
+    std::vector<Hash> hashes;
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        sqlite3_bind_int64(selectClipStatement, 1, int64_t(clipId));
+        bool found = sqlite3_step(selectClipStatement) == SQLITE_ROW;
+        if(found)
+        {
+            const unsigned char *event = sqlite3_column_text(selectClipStatement, 2);
+
+            clip.id             = clipId;
+            clip.nodeId         = sqlite3_column_int64(selectClipStatement, 0);
+            clip.eventTimestamp = sqlite3_column_int64(selectClipStatement, 1);
+            clip.event          = event != nullptr ? reinterpret_cast<const char *>(event) : "";
+            clip.size           = sqlite3_column_int64(selectClipStatement, 3);
+        }
+        sqlite3_reset(selectClipStatement);
+        if(!found)
+            return false;
+
+        sqlite3_bind_int64(selectChunksStatement, 1, int64_t(clipId));
+        while(sqlite3_step(selectChunksStatement) == SQLITE_ROW)
+        {
+            Hash hash = {};
+            if(sqlite3_column_bytes(selectChunksStatement, 0) == static_cast<int>(hash.size()))
+                memcpy(hash.data(), sqlite3_column_blob(selectChunksStatement, 0), hash.size());
+            hashes.push_back(hash);
+        }
+        sqlite3_reset(selectChunksStatement);
+    }
+
+    std::lock_guard<std::mutex> lock(packMutex);
+    clip.chunks.clear();
+    for(const Hash &hash : hashes)
+    {
+        auto it = chunkIndex.find(hash);
+        if(it == chunkIndex.end())
+        {
+            throw std::runtime_error("Chunk missing for clip " + std::to_string(clipId));
+        }
+        clip.chunks.push_back(it->second);
+    }
+    return true;
+}
+
+int BlobStore::getPackFd(uint32_t pack) const
+{
+    std::lock_guard<std::mutex> lock(packMutex);
+    auto                        it = packs.find(pack);
+    if(it == packs.end())
+    {
+        throw std::runtime_error("Unknown pack in BlobStore::getPackFd: " + std::to_string(pack));
+    }
+    return it->second->fd;
+}
+
+BlobStore::Chunk BlobStore::storeChunk(const Hash &hash, const uint8_t *data, uint32_t len)
+{
+    std::lock_guard<std::mutex> lock(packMutex);
+
+    // The data is written before the chunk is indexed, a deduplicated chunk is always complete in the page cache
+    auto it = chunkIndex.find(hash);
+    if(it != chunkIndex.end())
+    {
+        dedupedChunks++;
+        return it->second;
+    }
+
+    Pack *pack = packs.rbegin()->second.get();
+    if(pack->writeOffset + len > pack->capacity)
+    {
+        uint32_t sequence = pack->sequence + 1;
+        packs[sequence]   = openPack(sequence, true);
+        pack              = packs[sequence].get();
+    }
+
+    Chunk chunk;
+    chunk.hash   = hash;
+    chunk.pack   = pack->sequence;
+    chunk.offset = pack->writeOffset;
+    chunk.len    = len;
+
+    size_t written = 0;
+    while(written < len)
+    {
+        ssize_t ret = pwrite(pack->fd, data + written, len - written, chunk.offset + written);
+        if(ret <= 0)
+        {
+            throw std::runtime_error("pwrite failed for " + pack->path);
+        }
+        written += ret;
+    }
+
+    pack->writeOffset = alignOffset(chunk.offset + len);
+    chunkIndex.emplace(hash, chunk);
+    storedChunks++;
+    return chunk;
+}
+
+uint64_t BlobStore::recordClip(const Upload &upload)
+{
+    // Rows may only refer to durable pack data, deduplicated chunks of other uploads included
+    std::set<uint32_t> usedPacks;
+    for(const Chunk &chunk : upload.chunks)
+    {
+        usedPacks.insert(chunk.pack);
+    }
+    for(uint32_t pack : usedPacks)
+    {
+        if(fdatasync(getPackFd(pack)) != 0)
+        {
+            throw std::runtime_error("fdatasync failed for pack " + std::to_string(pack));
+        }
+    }
+
+    uint64_t                       clipId = nextClipId++;
+    std::vector<std::future<void>> rows;
+    for(const Chunk &chunk : upload.chunks)
+    {
+        rows.push_back(writer.execute(Statement::InsertChunk,
+                                      {std::vector<uint8_t>(chunk.hash.begin(), chunk.hash.end()),
+                                       int64_t(chunk.pack),
+                                       int64_t(chunk.offset),
+                                       int64_t(chunk.len)}));
+    }
+
+    rows.push_back(writer.execute(Statement::InsertClip,
+                                  {int64_t(clipId),
+                                   int64_t(upload.nodeId),
+                                   int64_t(upload.eventTimestamp),
+                                   upload.event,
+                                   int64_t(upload.size),
+                                   int64_t(HistoryStore::getTimestamp())}));
+
+    for(size_t i = 0; i < upload.chunks.size(); i++)
+    {
+        const Hash &hash = upload.chunks[i].hash;
+        rows.push_back(writer.execute(Statement::InsertClipChunk,
+                                      {int64_t(clipId), int64_t(i), std::vector<uint8_t>(hash.begin(), hash.end())}));
+    }
+
+    for(auto &row : rows)
+    {
+        row.get();
+    }
+    return clipId;
+}
+
+bool BlobStore::post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        if(inDestruction || (task.len > 0 && pendingBytes + task.len > config.maxPendingBytes))
+            return false;
+
+        pendingBytes += task.len;
+        tasks.push_back(std::move(task));
+    }
+    taskCondition.notify_one();
+    return true;
+}
+
+void BlobStore::workerThreadProcess(BlobStore *self)
+{
+    std::unique_lock<std::mutex> lock(self->taskMutex);
+    while(true)
+    {
+        self->taskCondition.wait(lock, [&] { return self->inDestruction || !self->tasks.empty(); });
+
+        // Queued tasks still run in destruction, uploads that finished before get their clips recorded
+        if(self->tasks.empty())
+            break;
+
+        Task task = std::move(self->tasks.front());
+        self->tasks.pop_front();
+        lock.unlock();
+        task.run();
+        lock.lock();
+        self->pendingBytes -= task.len;
+    }
+}
+
+void BlobStore::loadIndex(std::map<uint32_t, size_t> &packEnds)
+{
+    sqlite3_stmt *statement = prepareRead("SELECT hash, pack, offset, len FROM chunks;");
+    while(sqlite3_step(statement) == SQLITE_ROW)
+    {
+        Chunk chunk;
+        if(sqlite3_column_bytes(statement, 0) != static_cast<int>(chunk.hash.size()))
+            continue;
+
+        memcpy(chunk.hash.data(), sqlite3_column_blob(statement, 0), chunk.hash.size());
+        chunk.pack   = sqlite3_column_int64(statement, 1);
+        chunk.offset = sqlite3_column_int64(statement, 2);
+        chunk.len    = sqlite3_column_int64(statement, 3);
+        chunkIndex.emplace(chunk.hash, chunk);
+
+        size_t &end = packEnds[chunk.pack];
+        end         = std::max<size_t>(end, chunk.offset + chunk.len);
+    }
+    sqlite3_finalize(statement);
+
+    statement = prepareRead("SELECT MAX(id) FROM clips;");
+    if(sqlite3_step(statement) == SQLITE_ROW)
+    {
+        nextClipId = sqlite3_column_int64(statement, 0) + 1;
+    }
+    sqlite3_finalize(statement);
+    LOG_MESSAGE(LogLevel::Debug, "Loaded " + std::to_string(chunkIndex.size()) + " chunks");
+}
+
+void BlobStore::openPacks(const std::map<uint32_t, size_t> &packEnds)
+{
+    for(const auto &entry : std::filesystem::directory_iterator(config.directory))
+    {
+        unsigned int sequence = 0;
+        if(sscanf(entry.path().filename().string().c_str(), "pack-%u.pack", &sequence) == 1)
+        {
+            packs[sequence] = openPack(sequence, false);
+        }
+    }
+
+    // Data after the last recorded chunk belongs to uploads that never finished and is overwritten
+    for(auto &[sequence, pack] : packs)
+    {
+        auto end          = packEnds.find(sequence);
+        pack->writeOffset = end != packEnds.end() ? alignOffset(end->second) : 0;
+    }
+
+    if(packs.empty())
+    {
+        packs[0] = openPack(0, true);
+    }
+}
+
+std::unique_ptr<BlobStore::Pack> BlobStore::openPack(uint32_t sequence, bool create)
+{
+    auto pack      = std::make_unique<Pack>();
+    pack->sequence = sequence;
+    pack->path     = getPackPath(sequence);
+    pack->capacity = config.packSize;
+
+    pack->fd = open(pack->path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+    if(pack->fd < 0)
+    {
+        throw std::runtime_error("Unable to open blob pack " + pack->path);
+    }
+
+    if(create)
+    {
+        // Preallocated space keeps the chunks of a pack contiguous on disk
+        int ret = posix_fallocate(pack->fd, 0, config.packSize);
+        if(ret != 0)
+        {
+            throw std::runtime_error("Unable to preallocate blob pack " + pack->path + ": " + strerror(ret));
+        }
+    }
+    else
+    {
+        pack->capacity = std::max<size_t>(std::filesystem::file_size(pack->path), config.packSize);
+    }
+    return pack;
+}
+
+sqlite3_stmt *BlobStore::prepareRead(const std::string &sql)
+{
+    sqlite3_stmt *statement = nullptr;
+    if(sqlite3_prepare_v2(readDb, sql.c_str(), -1, &statement, nullptr) != SQLITE_OK)
+    {
+        throw std::runtime_error("Preparing \"" + sql + "\" failed: " + sqlite3_errmsg(readDb));
+    }
+    return statement;
+}
+
+std::string BlobStore::getPackPath(uint32_t sequence) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "pack-%08u.pack", sequence);
+    return config.directory + "/" + name;
+}
+
+BlobStore::Upload::Upload(BlobStore *store, uint32_t nodeId, uint64_t eventTimestamp, const std::string &event) :
+    store(store), nodeId(nodeId), eventTimestamp(eventTimestamp), event(event)
+{
+    buffer.reserve(store->config.chunkSize);
+}
+
+void BlobStore::Upload::write(const uint8_t *data, size_t len)
+{
+    if(finished)
+    {
+        throw std::runtime_error("BlobStore::Upload::write called after finish");
+    }
+
+    size += len;
+    while(len > 0 && !failed)
+    {
+        size_t copyLen = std::min(len, store->config.chunkSize - buffer.size());
+        buffer.insert(buffer.end(), data, data + copyLen);
+        data += copyLen;
+        len -= copyLen;
+
+        if(buffer.size() == store->config.chunkSize)
+            storeBuffer();
+    }
+}
+
+void BlobStore::Upload::finish(std::function<void(uint64_t clipId)> done)
+{
+    if(finished)
+    {
+        throw std::runtime_error("BlobStore::Upload::finish called twice");
+    }
+    finished = true;
+
+    if(!buffer.empty() && !failed)
+        storeBuffer();
+
+    // Queued behind the chunks of the upload, so the clip is recorded once all of them are stored
+    auto self = shared_from_this();
+    auto run  = [self, done] {
+        uint64_t clipId = 0;
+        try
+        {
+            if(!self->failed)
+                clipId = self->store->recordClip(*self);
+        }
+        catch(const std::exception &e)
+        {
+            LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in BlobStore::Upload::finish");
+        }
+        done(clipId);
+    };
+    if(!store->post({run}))
+        done(0);
+}
+
+void BlobStore::Upload::storeBuffer()
+{
+    // The chunk moves to the worker, std::function needs a copyable capture
+    auto data = std::make_shared<std::vector<uint8_t>>(std::move(buffer));
+    auto self = shared_from_this();
+    buffer    = std::vector<uint8_t>();
+    buffer.reserve(store->config.chunkSize);
+
+    if(!store->post({[self, data] { self->storeChunk(*data); }, data->size()}))
+    {
+        LOG_MESSAGE(LogLevel::Warning, "Clip upload of node " + std::to_string(nodeId) + " failed, storage is behind");
+        failed = true;
+    }
+}
+
+void BlobStore::Upload::storeChunk(const std::vector<uint8_t> &data)
+{
+    if(failed)
+        return;
+
+    try
+    {
+        Hash hash = Utilities::Sha256::calculate(data.data(), data.size());
+        chunks.push_back(store->storeChunk(hash, data.data(), data.size()));
+    }
+    catch(const std::exception &e)
+    {
+        LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in BlobStore::Upload::storeChunk");
+        failed = true;
+    }
+}
+} // namespace Database
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sqlite3.h>
+
+#include "sqliteWriter.hpp"
+#include "utilities/logger.hpp"
+#include "utilities/sha256.hpp"
+
+namespace Database
+{
+/* Content-addressed store for large binary objects such as camera clips, kept apart from the history store.
+ *
+ * Uploads are cut into chunks of chunkSize bytes while they arrive. Every chunk is addressed by its SHA-256 and
+ * stored once, no matter how many clips contain it. Chunks are appended page aligned to preallocated pack files:
+ *
+ * pack-<sequence>.pack: | Chunk | padding | Chunk | padding | ... | preallocated space |
+ *
+ * Chunk locations, clips and the chunk lists of clips are kept in an SQLite database. A clip is only recorded after
+ * the pack data of all its chunks is synced, chunks of unfinished uploads are kept for deduplication only.
+ *
+ * Hashing, pack writes and recording clips run on a worker thread, the uploading thread only copies data. An upload
+ * fails once more than maxPendingBytes of chunks wait for the worker.
+ */
+class BlobStore
+{
+public:
+    using Hash = Utilities::Sha256::Digest;
+
+    class Upload;
+
+    struct Config
+    {
+        std::string          directory       = "blobs";
+        size_t               packSize        = 1024 * 1024 * 1024;
+        size_t               chunkSize       = 256 * 1024;
+        size_t               maxPendingBytes = 64 * 1024 * 1024;
+        SqliteWriter::Config database        = {.path = "blobs.db"};
+    };
+
+    struct Chunk
+    {
+        Hash     hash   = {};
+        uint32_t pack   = 0;
+        uint64_t offset = 0;
+        uint32_t len    = 0;
+    };
+
+    struct Clip
+    {
+        uint64_t           id             = 0;
+        uint32_t           nodeId         = 0;
+        uint64_t           eventTimestamp = 0; // Timestamp of the triggering record in the node's history
+        std::string        event;
+        uint64_t           size = 0;
+        std::vector<Chunk> chunks;
+    };
+
+    BlobStore() = delete;
+    BlobStore(const Config &config);
+    ~BlobStore();
+
+    // Starts a clip upload, the upload must not outlive the store
+    std::shared_ptr<Upload> beginClip(uint32_t nodeId, uint64_t eventTimestamp, const std::string &event);
+
+    // Reads a stored clip with the locations of its chunks, returns false if the clip is unknown
+    bool findClip(uint64_t clipId, Clip &clip);
+
+    // Descriptor of a pack file for sending chunks with sendfile, valid as long as the store exists
+    int getPackFd(uint32_t pack) const;
+
+    uint64_t getStoredChunks() const { return storedChunks; }
+    uint64_t getDedupedChunks() const { return dedupedChunks; }
+
+private:
+    using LogLevel = Utilities::Logger::LogLevel;
+
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::BlobStore;
+
+    static constexpr size_t packAlignment = 4096;
+
+    enum Statement : uint32_t
+    {
+        InsertChunk = 0,
+        InsertClip,
+        InsertClipChunk,
+    };
+
+    struct Task
+    {
+        std::function<void()> run;
+        size_t                len = 0; // Bytes of chunk data the task holds
+    };
+
+    struct Pack
+    {
+        uint32_t    sequence = 0;
+        std::string path;
+        int         fd          = -1;
+        size_t      capacity    = 0;
+        size_t      writeOffset = 0;
+
+        ~Pack();
+    };
+
+    Config       config;
+    SqliteWriter writer;
+
+    mutable std::mutex                                       packMutex; // Guards packs and chunkIndex
+    std::map<uint32_t, std::unique_ptr<Pack>>                packs;
+    std::unordered_map<Hash, Chunk, Utilities::DigestHasher> chunkIndex;
+
+    std::atomic<uint64_t> nextClipId{1};
+    std::atomic<uint64_t> storedChunks{0};
+    std::atomic<uint64_t> dedupedChunks{0};
+
+    std::mutex    readMutex;
+    sqlite3 *     readDb                = nullptr;
+    sqlite3_stmt *selectClipStatement   = nullptr;
+    sqlite3_stmt *selectChunksStatement = nullptr;
+
+    // Worker, guarded by taskMutex
+    std::mutex              taskMutex;
+    std::condition_variable taskCondition;
+    std::deque<Task>        tasks;
+    size_t                  pendingBytes  = 0;
+    bool                    inDestruction = false;
+    std::thread             workerThread;
+
+    bool                  post(Task task);
+    Chunk                 storeChunk(const Hash &hash, const uint8_t *data, uint32_t len);
+    uint64_t              recordClip(const Upload &upload);
+    void                  loadIndex(std::map<uint32_t, size_t> &packEnds);
+    void                  openPacks(const std::map<uint32_t, size_t> &packEnds);
+    std::unique_ptr<Pack> openPack(uint32_t sequence, bool create);
+    sqlite3_stmt *        prepareRead(const std::string &sql);
+    std::string           getPackPath(uint32_t sequence) const;
+
+    static size_t alignOffset(size_t offset) { return (offset + packAlignment - 1) & ~(packAlignment - 1); }
+    static void   workerThreadProcess(BlobStore *self);
+};
+
+// Streaming clip upload, data is chunked while it arrives and its chunks are hashed and stored by the worker
+class BlobStore::Upload : public std::enable_shared_from_this<Upload>
+{
+public:
+    Upload() = delete;
+
+    // Data of a failed upload is dropped
+    void write(const uint8_t *data, size_t len);
+
+    // Stores the remaining data and records the clip on the worker, which calls done with the clip ID once the clip
+    // is durable, or with 0 if the upload failed
+    void finish(std::function<void(uint64_t clipId)> done);
+
+    uint64_t getSize() const { return size; }
+
+private:
+    friend class BlobStore;
+
+    Upload(BlobStore *store, uint32_t nodeId, uint64_t eventTimestamp, const std::string &event);
+
+    BlobStore *          store;
+    uint32_t             nodeId;
+    uint64_t             eventTimestamp;
+    std::string          event;
+    uint64_t             size     = 0;
+    bool                 finished = false;
+    std::atomic<bool>    failed{false};
+    std::vector<uint8_t> buffer;
+    std::vector<Chunk>   chunks; // Only touched by the worker
+
+    void storeBuffer();
+    void storeChunk(const std::vector<uint8_t> &data);
+};
+} // namespace Database
@@ -0,0 +1,565 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "historyStore.hpp"
+#include "message/crc.hpp"
+
+namespace Database
+{
+HistoryStore::Segment::~Segment()
+{
+    if(map != nullptr)
+    {
+        munmap(map, capacity);
+        map = nullptr;
+    }
+
+    if(fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+HistoryStore::HistoryStore(const Config &config) : config(config)
+{
+    if(config.shardsNum == 0 || config.segmentSize <= segmentHeaderLen + recordHeaderLen)
+    {
+        throw std::runtime_error("Invalid HistoryStore configuration");
+    }
+
+    std::filesystem::create_directories(config.directory);
+    for(uint32_t i = 0; i < config.shardsNum; i++)
+    {
+        shards.push_back(std::make_unique<Shard>());
+    }
+    openShards();
+
+    writerThread = std::thread(HistoryStore::writerThreadProcess, this);
+}
+
+HistoryStore::~HistoryStore()
+{
+    LOG_MESSAGE(LogLevel::Debug, "Destructing history store");
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        inDestruction = true;
+    }
+    writerCondition.notify_one();
+
+    if(writerThread.joinable())
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Joining writer thread");
+        writerThread.join();
+    }
+
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
+}
+
+uint64_t HistoryStore::getTimestamp()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+bool HistoryStore::append(uint32_t nodeId, uint64_t timestamp, const uint8_t *payload, uint32_t payloadLen)
+{
+    if(getRecordLen(payloadLen) > config.segmentSize - segmentHeaderLen)
+    {
+        throw std::runtime_error("Record too large in HistoryStore::append, payloadLen=" + std::to_string(payloadLen));
+    }
+
+    RecordHeader header = {};
+    header.payloadLen   = payloadLen;
+    header.nodeId       = nodeId;
+
+    // Payload CRC is calculated outside the lock, the header fields are added once the timestamp is final
+    uint32_t crc = Utilities::crc32_instance.init();
+    Utilities::crc32_instance.update(crc, payload, payloadLen);
+
+    size_t recordLen = getRecordLen(payloadLen);
+    Shard &shard     = *shards[nodeId % shards.size()];
+
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if(config.dropWhenBehind && pendingBytes >= config.maxPendingBytes)
+    {
+        droppedRecords++;
+        return false;
+    }
+    producerCondition.wait(lock, [&] { return pendingBytes < config.maxPendingBytes || inDestruction; });
+
+    // A zero timestamp marks the end of the records in a segment
+    header.timestamp    = std::max({timestamp, shard.lastTimestamp, uint64_t(1)});
+    shard.lastTimestamp = header.timestamp;
+    Utilities::crc32_instance.update(crc, reinterpret_cast<const uint8_t *>(&header), crcHeaderFieldLen);
+    Utilities::crc32_instance.finish(crc);
+    header.crc = crc;
+
+    size_t index = shard.pending.size();
+    shard.pending.resize(index + recordLen);
+    memcpy(shard.pending.data() + index, &header, recordHeaderLen);
+    memcpy(shard.pending.data() + index + recordHeaderLen, payload, payloadLen);
+
+    pendingBytes += recordLen;
+    bool wakeWriter = pendingBytes >= config.batchSize && pendingBytes - recordLen < config.batchSize;
+    lock.unlock();
+
+    if(wakeWriter)
+    {
+        writerCondition.notify_one();
+    }
+    return true;
+}
+
+void HistoryStore::flush()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    uint64_t                     ticket = ++requestedFlush;
+    writerCondition.notify_one();
+    producerCondition.wait(lock, [&] { return completedFlush >= ticket; });
+}
+
+void HistoryStore::query(uint32_t nodeId, uint64_t from, uint64_t to, const RecordCallback &callback) const
+{
+    Cursor cursor = openCursor(nodeId, from, to);
+    cursor.next(callback);
+}
+
+HistoryStore::Cursor HistoryStore::openCursor(uint32_t nodeId, uint64_t from, uint64_t to) const
+{
+    const Shard &shard = *shards[nodeId % shards.size()];
+
+    Cursor cursor;
+    cursor.nodeId = nodeId;
+    cursor.from   = from;
+    cursor.to     = to;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for(const auto &segment : shard.segments)
+    {
+        size_t end = segment->committedLen.load(std::memory_order_acquire);
+        if(end <= segmentHeaderLen || segment->lastTimestamp < from || segment->firstTimestamp > to)
+            continue;
+
+        // Last index entry at or before from, records between entries are in timestamp order
+        auto it = std::upper_bound(
+            segment->index.begin(), segment->index.end(), from, [](uint64_t value, const IndexEntry &entry) {
+                return value < entry.timestamp;
+            });
+        size_t start = it == segment->index.begin() ? segmentHeaderLen : std::prev(it)->offset;
+        cursor.ranges.push_back(Cursor::Range{segment, start, end});
+    }
+
+    if(!cursor.ranges.empty())
+        cursor.offset = cursor.ranges.front().start;
+    return cursor;
+}
+
+bool HistoryStore::Cursor::next(const RecordCallback &callback)
+{
+    // Segments are read through their mappings without holding any lock
+    while(rangeIndex < ranges.size())
+    {
+        const Range &range = ranges[rangeIndex];
+        while(offset + recordHeaderLen <= range.end)
+        {
+            const RecordHeader *header = reinterpret_cast<const RecordHeader *>(range.segment->map + offset);
+            if(header->timestamp > to)
+            {
+                rangeIndex = ranges.size();
+                return false;
+            }
+
+            if(header->nodeId == nodeId && header->timestamp >= from)
+            {
+                Record record;
+                record.nodeId     = header->nodeId;
+                record.timestamp  = header->timestamp;
+                record.payload    = range.segment->map + offset + recordHeaderLen;
+                record.payloadLen = header->payloadLen;
+                if(!callback(record))
+                    return true;
+            }
+            offset += getRecordLen(header->payloadLen);
+        }
+
+        rangeIndex++;
+        if(rangeIndex < ranges.size())
+            offset = ranges[rangeIndex].start;
+    }
+    return false;
+}
+
+void HistoryStore::writerThreadProcess(HistoryStore *self)
+{
+    std::vector<std::vector<uint8_t>> batches(self->shards.size());
+    auto                              lastSync           = std::chrono::steady_clock::now();
+    auto                              lastRetentionCheck = std::chrono::steady_clock::now();
+
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(self->queueMutex);
+        self->writerCondition.wait_for(lock, self->config.flushInterval, [&] {
+            return self->inDestruction || self->pendingBytes >= self->config.batchSize ||
+                   self->requestedFlush > self->completedFlush;
+        });
+
+        // Take over the pending batches, producers continue with the emptied buffers of the last round
+        for(size_t i = 0; i < self->shards.size(); i++)
+        {
+            batches[i].clear();
+            std::swap(batches[i], self->shards[i]->pending);
+        }
+        self->pendingBytes = 0;
+
+        uint64_t flushTicket = self->requestedFlush;
+        bool     stopping    = self->inDestruction;
+        lock.unlock();
+        self->producerCondition.notify_all();
+
+        for(size_t i = 0; i < batches.size(); i++)
+        {
+            try
+            {
+                self->writeBatch(i, batches[i]);
+                self->notifyObserver(batches[i]);
+            }
+            catch(const std::exception &e)
+            {
+                LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in HistoryStore::writerThreadProcess");
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if(flushTicket > self->completedFlush || stopping || now - lastSync >= self->config.syncInterval)
+        {
+            self->syncShards();
+            lastSync = now;
+        }
+
+        if(self->config.retention.count() > 0 && now - lastRetentionCheck >= retentionCheckInterval)
+        {
+            self->removeExpiredSegments();
+            lastRetentionCheck = now;
+        }
+
+        lock.lock();
+        self->completedFlush = flushTicket;
+        lock.unlock();
+        self->producerCondition.notify_all();
+
+        if(stopping)
+            return;
+    }
+}
+
+void HistoryStore::writeBatch(uint32_t shardIndex, std::vector<uint8_t> &batch)
+{
+    Shard &shard = *shards[shardIndex];
+    if(batch.empty())
+        return;
+
+    std::shared_ptr<Segment> segment;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        segment = shard.segments.back();
+    }
+
+    size_t                  writeOffset = segment->committedLen.load(std::memory_order_relaxed);
+    size_t                  runStart    = 0;
+    size_t                  position    = 0;
+    std::vector<IndexEntry> newEntries;
+    uint64_t                firstTimestamp = 0;
+    uint64_t                lastTimestamp  = 0;
+
+    // Writes the records in [runStart, position) to the active segment and publishes them
+    auto commitRun = [&]() {
+        size_t len = position - runStart;
+        if(len > 0)
+        {
+            ssize_t written = pwrite(segment->fd, batch.data() + runStart, len, writeOffset);
+            if(written != static_cast<ssize_t>(len))
+            {
+                throw std::runtime_error("pwrite failed for " + segment->path);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        segment->index.insert(segment->index.end(), newEntries.begin(), newEntries.end());
+        if(segment->firstTimestamp == 0)
+            segment->firstTimestamp = firstTimestamp;
+        if(lastTimestamp != 0)
+            segment->lastTimestamp = lastTimestamp;
+        writeOffset += len;
+        segment->committedLen.store(writeOffset, std::memory_order_release);
+
+        newEntries.clear();
+        firstTimestamp = 0;
+        runStart       = position;
+    };
+
+    while(position < batch.size())
+    {
+        const RecordHeader *header    = reinterpret_cast<const RecordHeader *>(batch.data() + position);
+        size_t              recordLen = getRecordLen(header->payloadLen);
+        size_t              offset    = writeOffset + (position - runStart);
+
+        if(offset + recordLen > segment->capacity)
+        {
+            // Segment is full, continue in a new one
+            commitRun();
+            fdatasync(segment->fd);
+            std::shared_ptr<Segment> next = openSegment(shardIndex, segment->sequence + 1, true);
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.segments.push_back(next);
+            }
+            segment     = next;
+            writeOffset = segment->committedLen.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        if(segment->index.empty() && newEntries.empty())
+        {
+            newEntries.push_back(IndexEntry{header->timestamp, offset});
+            segment->lastIndexedOffset = offset;
+        }
+        else if(offset - segment->lastIndexedOffset >= config.indexInterval)
+        {
+            newEntries.push_back(IndexEntry{header->timestamp, offset});
+            segment->lastIndexedOffset = offset;
+        }
+
+        if(firstTimestamp == 0)
+            firstTimestamp = header->timestamp;
+        lastTimestamp = header->timestamp;
+        position += recordLen;
+    }
+    commitRun();
+}
+
+void HistoryStore::syncShards()
+{
+    for(auto &shard : shards)
+    {
+        std::shared_ptr<Segment> segment;
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            segment = shard->segments.back();
+        }
+
+        // Records below the synced length are durable, reopening only has to verify the ones after it
+        uint64_t syncedLen = segment->committedLen.load(std::memory_order_relaxed);
+        fdatasync(segment->fd);
+        pwrite(segment->fd, &syncedLen, sizeof(syncedLen), segmentSyncedLenIndex);
+    }
+}
+
+void HistoryStore::notifyObserver(const std::vector<uint8_t> &batch) const
+{
+    if(!config.observer)
+        return;
+
+    size_t position = 0;
+    while(position < batch.size())
+    {
+        const RecordHeader *header = reinterpret_cast<const RecordHeader *>(batch.data() + position);
+
+        Record record;
+        record.nodeId     = header->nodeId;
+        record.timestamp  = header->timestamp;
+        record.payload    = batch.data() + position + recordHeaderLen;
+        record.payloadLen = header->payloadLen;
+        try
+        {
+            config.observer(record);
+        }
+        catch(const std::exception &e)
+        {
+            // A malformed record must not hide the rest of the batch from the observer
+            LOG_MESSAGE(LogLevel::Warning, std::string(e.what()) + " in HistoryStore::notifyObserver");
+        }
+
+        position += getRecordLen(header->payloadLen);
+    }
+}
+
+void HistoryStore::removeExpiredSegments()
+{
+    uint64_t retentionNs = std::chrono::duration_cast<std::chrono::nanoseconds>(config.retention).count();
+    uint64_t now         = getTimestamp();
+    if(now <= retentionNs)
+        return;
+
+    for(auto &shard : shards)
+    {
+        std::vector<std::shared_ptr<Segment>> expired;
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+
+            // The active segment is never removed, queries still reading a removed segment keep its mapping
+            auto end = std::prev(shard->segments.end());
+            auto it  = shard->segments.begin();
+            while(it != end && (*it)->lastTimestamp < now - retentionNs)
+            {
+                expired.push_back(*it);
+                it++;
+            }
+            shard->segments.erase(shard->segments.begin(), it);
+        }
+
+        for(const auto &segment : expired)
+        {
+            LOG_MESSAGE(LogLevel::Debug, "Removing expired segment " + segment->path);
+            unlink(segment->path.c_str());
+        }
+    }
+}
+
+std::string HistoryStore::getSegmentPath(uint32_t shardIndex, uint32_t sequence) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "shard-%03u-%08u.seg", shardIndex, sequence);
+    return config.directory + "/" + name;
+}
+
+void HistoryStore::openShards()
+{
+    for(uint32_t shardIndex = 0; shardIndex < shards.size(); shardIndex++)
+    {
+        Shard &shard = *shards[shardIndex];
+
+        std::vector<uint32_t> sequences;
+        for(const auto &entry : std::filesystem::directory_iterator(config.directory))
+        {
+            unsigned int fileShard    = 0;
+            unsigned int fileSequence = 0;
+            std::string  fileName     = entry.path().filename().string();
+            if(sscanf(fileName.c_str(), "shard-%u-%u.seg", &fileShard, &fileSequence) == 2 && fileShard == shardIndex)
+            {
+                sequences.push_back(fileSequence);
+            }
+        }
+        std::sort(sequences.begin(), sequences.end());
+
+        for(size_t i = 0; i < sequences.size(); i++)
+        {
+            std::shared_ptr<Segment> segment = openSegment(shardIndex, sequences[i], false);
+
+            // Only the last segment of a shard can have a torn record at its end
+            scanSegment(*segment, i + 1 == sequences.size());
+            shard.segments.push_back(segment);
+        }
+
+        if(shard.segments.empty())
+        {
+            shard.segments.push_back(openSegment(shardIndex, 0, true));
+        }
+        shard.lastTimestamp = shard.segments.back()->lastTimestamp;
+    }
+}
+
+std::shared_ptr<HistoryStore::Segment> HistoryStore::openSegment(uint32_t shardIndex, uint32_t sequence, bool create)
+{
+    auto segment      = std::make_shared<Segment>();
+    segment->sequence = sequence;
+    segment->path     = getSegmentPath(shardIndex, sequence);
+    segment->capacity = config.segmentSize;
+
+    segment->fd = open(segment->path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+    if(segment->fd < 0)
+    {
+        throw std::runtime_error("Unable to open history segment " + segment->path);
+    }
+
+    if(create)
+    {
+        // Preallocate the whole segment, unwritten space reads as zeroes which marks the end of the records
+        int ret = posix_fallocate(segment->fd, 0, segment->capacity);
+        if(ret != 0)
+        {
+            throw std::runtime_error("posix_fallocate failed for " + segment->path + " with error " +
+                                     std::to_string(ret));
+        }
+
+        uint8_t header[segmentHeaderLen] = {0};
+        memcpy(header + segmentMagicIndex, &segmentMagic, sizeof(segmentMagic));
+        memcpy(header + segmentShardIndex, &shardIndex, sizeof(shardIndex));
+        memcpy(header + segmentSequenceIndex, &sequence, sizeof(sequence));
+        if(pwrite(segment->fd, header, sizeof(header), 0) != sizeof(header))
+        {
+            throw std::runtime_error("Unable to write header of " + segment->path);
+        }
+    }
+    else
+    {
+        segment->capacity = std::filesystem::file_size(segment->path);
+    }
+
+    void *map = mmap(nullptr, segment->capacity, PROT_READ, MAP_SHARED, segment->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        throw std::runtime_error("mmap failed for " + segment->path);
+    }
+    segment->map = static_cast<uint8_t *>(map);
+
+    uint64_t magic = 0;
+    memcpy(&magic, segment->map + segmentMagicIndex, sizeof(magic));
+    if(magic != segmentMagic)
+    {
+        throw std::runtime_error("Invalid segment header in " + segment->path);
+    }
+
+    segment->committedLen.store(segmentHeaderLen, std::memory_order_release);
+    return segment;
+}
+
+void HistoryStore::scanSegment(Segment &segment, bool verify)
+{
+    uint64_t syncedLen = 0;
+    memcpy(&syncedLen, segment.map + segmentSyncedLenIndex, sizeof(syncedLen));
+
+    size_t offset = segmentHeaderLen;
+    while(offset + recordHeaderLen <= segment.capacity)
+    {
+        const RecordHeader *header    = reinterpret_cast<const RecordHeader *>(segment.map + offset);
+        size_t              recordLen = getRecordLen(header->payloadLen);
+        if(header->timestamp == 0 || offset + recordLen > segment.capacity)
+            break;
+
+        if(verify && offset >= syncedLen)
+        {
+            uint32_t crc = Utilities::crc32_instance.init();
+            Utilities::crc32_instance.update(crc, segment.map + offset + recordHeaderLen, header->payloadLen);
+            Utilities::crc32_instance.update(crc, reinterpret_cast<const uint8_t *>(header), crcHeaderFieldLen);
+            Utilities::crc32_instance.finish(crc);
+            if(crc != header->crc)
+            {
+                LOG_MESSAGE(LogLevel::Warning,
+                            "Torn record at offset " + std::to_string(offset) + " of " + segment.path + ", truncating");
+
+                // Zero the torn tail and reserve the space again, the next appends continue from here
+                fallocate(segment.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, segment.capacity - offset);
+                posix_fallocate(segment.fd, offset, segment.capacity - offset);
+                break;
+            }
+        }
+
+        if(segment.index.empty() || offset - segment.lastIndexedOffset >= config.indexInterval)
+        {
+            segment.index.push_back(IndexEntry{header->timestamp, offset});
+            segment.lastIndexedOffset = offset;
+        }
+        if(segment.firstTimestamp == 0)
+            segment.firstTimestamp = header->timestamp;
+        segment.lastTimestamp = header->timestamp;
+        offset += recordLen;
+    }
+    segment.committedLen.store(offset, std::memory_order_release);
+}
+} // namespace Database
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utilities/logger.hpp"
+
+namespace Database
+{
+/* Append-only per-node history, records are spread over shards by node id and every shard is a sequence of
+ * preallocated segment files:
+ *
+ * shard-<shard>-<sequence>.seg: | Segment header (64 bytes) | Record | Record | ... | zeroes |
+ *
+ * Segment header: | Magic (8) | Shard (4) | Sequence (4) | Synced len (8) | Reserved |
+ *
+ * Record format (host byte order, records are 8 byte aligned):
+ *
+ * | Field       | Size    | Type     |
+ * |-------------|---------|----------|
+ * | Payload len | 4 bytes | uint32_t |
+ * | Node ID     | 4 bytes | uint32_t |
+ * | Timestamp   | 8 bytes | uint64_t | nanoseconds since epoch
+ * | CRC         | 4 bytes | uint32_t | CRC32 of payload followed by the 16 header bytes above
+ * | Reserved    | 4 bytes | uint32_t |
+ * | Payload     | n bytes | raw data |
+ *
+ * Callers only copy records into a per-shard batch, a dedicated writer thread appends the batches to the segments
+ * with one pwrite per shard. Once maxPendingBytes are queued, callers wait for the writer or, with dropWhenBehind,
+ * their records are dropped and counted. Segments are mmap'd read-only for queries, a sparse time index per segment
+ * points the query to the first block that can contain the requested time range. With a retention configured,
+ * sealed segments whose newest record is older than the retention are removed.
+ */
+class HistoryStore
+{
+public:
+    class Cursor;
+
+    struct Record
+    {
+        uint32_t       nodeId;
+        uint64_t       timestamp;
+        const uint8_t *payload;
+        uint32_t       payloadLen;
+    };
+
+    // Return false to stop the iteration
+    using RecordCallback = std::function<bool(const Record &record)>;
+
+    // Called from the writer thread for every record after it is written
+    using RecordObserver = std::function<void(const Record &record)>;
+
+    struct Config
+    {
+        std::string               directory       = "history";
+        uint32_t                  shardsNum       = 16;
+        size_t                    segmentSize     = 64 * 1024 * 1024;
+        size_t                    indexInterval   = 64 * 1024; // Bytes between sparse index entries
+        size_t                    batchSize       = 1024 * 1024;
+        size_t                    maxPendingBytes = 64 * 1024 * 1024;
+        std::chrono::milliseconds flushInterval   = std::chrono::milliseconds(10);
+        std::chrono::milliseconds syncInterval    = std::chrono::milliseconds(1000);
+        std::chrono::seconds      retention       = std::chrono::seconds(0); // Age of removed segments, 0 keeps all
+        bool                      dropWhenBehind  = false; // Drop records instead of waiting at maxPendingBytes
+        RecordObserver            observer;
+    };
+
+    HistoryStore() = delete;
+    HistoryStore(const Config &config);
+    ~HistoryStore();
+
+    // Queues a record, timestamps older than the last record of the shard are stored as that timestamp. Returns false
+    // if the record was dropped since the writer is behind and dropWhenBehind is set.
+    bool append(uint32_t nodeId, uint64_t timestamp, const uint8_t *payload, uint32_t payloadLen);
+
+    // Blocks until every record appended before the call is written and synced to disk
+    void flush();
+
+    // Calls callback for the records of nodeId with from <= timestamp <= to in timestamp order
+    void query(uint32_t nodeId, uint64_t from, uint64_t to, const RecordCallback &callback) const;
+
+    // Cursor over the same records as query, records appended after opening it are not included
+    Cursor openCursor(uint32_t nodeId, uint64_t from, uint64_t to) const;
+
+    uint64_t getDroppedRecords() const { return droppedRecords; }
+
+    // Current time as used for record timestamps
+    static uint64_t getTimestamp();
+
+private:
+    using LogLevel = Utilities::Logger::LogLevel;
+
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::HistoryStore;
+
+    static constexpr uint64_t segmentMagic          = 0x3147455354534948; // "HISTSEG1"
+    static constexpr size_t   segmentMagicIndex     = 0;
+    static constexpr size_t   segmentShardIndex     = 8;
+    static constexpr size_t   segmentSequenceIndex  = 12;
+    static constexpr size_t   segmentSyncedLenIndex = 16;
+    static constexpr size_t   segmentHeaderLen      = 64;
+    static constexpr size_t   recordHeaderLen       = 24;
+    static constexpr size_t   recordAlignment       = 8;
+    static constexpr size_t   crcHeaderFieldLen     = 16;
+
+    static constexpr std::chrono::seconds retentionCheckInterval = std::chrono::seconds(60);
+
+    struct RecordHeader
+    {
+        uint32_t payloadLen;
+        uint32_t nodeId;
+        uint64_t timestamp;
+        uint32_t crc;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(RecordHeader) == recordHeaderLen);
+
+    struct IndexEntry
+    {
+        uint64_t timestamp;
+        size_t   offset;
+    };
+
+    struct Segment
+    {
+        uint32_t                sequence = 0;
+        std::string             path;
+        int                     fd       = -1;
+        uint8_t *               map      = nullptr;
+        size_t                  capacity = 0;
+        std::atomic<size_t>     committedLen{0};
+        std::vector<IndexEntry> index;         // Guarded by Shard::mutex
+        size_t                  lastIndexedOffset = 0;
+        uint64_t                firstTimestamp    = 0;
+        uint64_t                lastTimestamp     = 0;
+
+        ~Segment();
+    };
+
+    struct Shard
+    {
+        mutable std::mutex                    mutex; // Guards segments and their index
+        std::vector<std::shared_ptr<Segment>> segments;
+
+        // Producer side, guarded by HistoryStore::queueMutex
+        std::vector<uint8_t> pending;
+        uint64_t             lastTimestamp = 0;
+    };
+
+    Config                              config;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::mutex              queueMutex;
+    std::condition_variable writerCondition;
+    std::condition_variable producerCondition;
+    size_t                  pendingBytes   = 0;
+    uint64_t                requestedFlush = 0;
+    uint64_t                completedFlush = 0;
+    bool                    inDestruction  = false;
+    std::thread             writerThread;
+
+    std::atomic<uint64_t> droppedRecords{0};
+
+    static void writerThreadProcess(HistoryStore *self);
+
+    void                     openShards();
+    std::shared_ptr<Segment> openSegment(uint32_t shardIndex, uint32_t sequence, bool create);
+    void                     scanSegment(Segment &segment, bool verify);
+    void                     writeBatch(uint32_t shardIndex, std::vector<uint8_t> &batch);
+    void                     syncShards();
+    void                     notifyObserver(const std::vector<uint8_t> &batch) const;
+    void                     removeExpiredSegments();
+    std::string              getSegmentPath(uint32_t shardIndex, uint32_t sequence) const;
+
+    static size_t getRecordLen(uint32_t payloadLen)
+    {
+        return (recordHeaderLen + payloadLen + recordAlignment - 1) & ~(recordAlignment - 1);
+    }
+};
+
+/* Position in the result of a history query. Records handed out by a cursor point into the segment mappings, the
+ * cursor keeps the segments it reads mapped until it is destroyed, even if retention removed them in the meantime.
+ */
+class HistoryStore::Cursor
+{
+public:
+    Cursor() = default;
+
+    // Calls callback for the next records until it returns false, that record is passed again by the next call.
+    // Returns false once every record was consumed.
+    bool next(const RecordCallback &callback);
+
+    bool isFinished() const { return rangeIndex >= ranges.size(); }
+
+private:
+    friend class HistoryStore;
+
+    struct Range
+    {
+        std::shared_ptr<Segment> segment;
+        size_t                   start;
+        size_t                   end;
+    };
+
+    uint32_t           nodeId = 0;
+    uint64_t           from   = 0;
+    uint64_t           to     = 0;
+    std::vector<Range> ranges;
+    size_t             rangeIndex = 0;
+    size_t             offset     = 0;
+};
+} // namespace Database
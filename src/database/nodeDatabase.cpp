@@ -0,0 +1,56 @@
+#include "nodeDatabase.hpp"
+#include "historyStore.hpp"
+
+namespace Database
+{
+static const std::string schema = "CREATE TABLE IF NOT EXISTS nodes ("
+                                  "id INTEGER PRIMARY KEY, "
+                                  "name TEXT, "
+                                  "type TEXT, "
+                                  "description TEXT, "
+                                  "options INTEGER, "
+                                  "interface_hash INTEGER, "
+                                  "interface TEXT, "
+                                  "registered_at INTEGER);"
+                                  "CREATE TABLE IF NOT EXISTS events ("
+                                  "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                  "timestamp INTEGER, "
+                                  "node_id INTEGER, "
+                                  "type TEXT, "
+                                  "details TEXT);";
+
+// Order matches NodeDatabase::Statement
+static const std::vector<std::string> statements = {
+    "INSERT OR REPLACE INTO nodes "
+    "(id, name, type, description, options, interface_hash, interface, registered_at) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?);",
+    "INSERT INTO events (timestamp, node_id, type, details) VALUES (?, ?, ?, ?);",
+};
+
+NodeDatabase::NodeDatabase(const SqliteWriter::Config &config) : writer(config, schema, statements) {}
+
+std::future<void> NodeDatabase::recordRegistration(uint32_t           nodeId,
+                                                   const std::string &name,
+                                                   const std::string &type,
+                                                   const std::string &description,
+                                                   uint32_t           options,
+                                                   uint32_t           interfaceHash,
+                                                   const std::string &interface)
+{
+    return writer.execute(Statement::InsertNode,
+                          {int64_t(nodeId),
+                           name,
+                           type,
+                           description,
+                           int64_t(options),
+                           int64_t(interfaceHash),
+                           interface,
+                           int64_t(HistoryStore::getTimestamp())});
+}
+
+std::future<void> NodeDatabase::recordEvent(uint32_t nodeId, const std::string &type, const std::string &details)
+{
+    return writer.execute(Statement::InsertEvent,
+                          {int64_t(HistoryStore::getTimestamp()), int64_t(nodeId), type, details});
+}
+} // namespace Database
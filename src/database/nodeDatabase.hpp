@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <string>
+
+#include "sqliteWriter.hpp"
+
+namespace Database
+{
+// Node registrations and audit events, written through the group committing SqliteWriter
+class NodeDatabase
+{
+public:
+    NodeDatabase() = delete;
+    NodeDatabase(const SqliteWriter::Config &config);
+    ~NodeDatabase() = default;
+
+    std::future<void> recordRegistration(uint32_t           nodeId,
+                                         const std::string &name,
+                                         const std::string &type,
+                                         const std::string &description,
+                                         uint32_t           options,
+                                         uint32_t           interfaceHash,
+                                         const std::string &interface);
+
+    std::future<void> recordEvent(uint32_t nodeId, const std::string &type, const std::string &details = "");
+
+    // Blocks until every record queued before the call is durable
+    void flush() { writer.flush(); }
+
+private:
+    enum Statement : uint32_t
+    {
+        InsertNode = 0,
+        InsertEvent,
+    };
+
+    SqliteWriter writer;
+};
+} // namespace Database
@@ -0,0 +1,654 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "registryStore.hpp"
+#include "message/crc.hpp"
+#include "message/payload.hpp"
+
+namespace Database
+{
+namespace
+{
+// Read-only mapping of a whole file
+struct FileMapping
+{
+    const uint8_t *data = nullptr;
+    size_t         len  = 0;
+
+    FileMapping(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+        {
+            throw std::runtime_error("Unable to open " + path);
+        }
+
+        struct stat fileStat;
+        if(fstat(fd, &fileStat) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("fstat failed for " + path);
+        }
+
+        len = fileStat.st_size;
+        if(len > 0)
+        {
+            void *map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if(map == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error("mmap failed for " + path);
+            }
+            data = static_cast<const uint8_t *>(map);
+        }
+        close(fd);
+    }
+
+    ~FileMapping()
+    {
+        if(data != nullptr)
+            munmap(const_cast<uint8_t *>(data), len);
+    }
+};
+
+// Generation of a file named by format, which has to end with %n so that names with a suffix are not accepted
+bool parseGeneration(const std::string &fileName, const char *format, uint32_t &generation)
+{
+    unsigned int value = 0;
+    int          len   = 0;
+    if(sscanf(fileName.c_str(), format, &value, &len) != 1 || static_cast<size_t>(len) != fileName.size())
+        return false;
+
+    generation = value;
+    return true;
+}
+
+void writeAll(int fd, const uint8_t *data, size_t len, const std::string &path)
+{
+    while(len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+        {
+            throw std::runtime_error("write failed for " + path);
+        }
+        data += written;
+        len -= written;
+    }
+}
+} // namespace
+
+RegistryStore::RegistryStore(const Config &config) : config(config), lastCheckpoint(std::chrono::steady_clock::now())
+{
+    std::filesystem::create_directories(config.directory);
+    checkpointThread = std::thread(RegistryStore::checkpointThreadProcess, this);
+}
+
+RegistryStore::~RegistryStore()
+{
+    LOG_MESSAGE(LogLevel::Debug, "Destructing registry store");
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        inDestruction = true;
+    }
+    checkpointCondition.notify_one();
+
+    if(checkpointThread.joinable())
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Joining checkpoint thread");
+        checkpointThread.join();
+    }
+
+    if(logFd >= 0)
+    {
+        close(logFd);
+        logFd = -1;
+    }
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
+}
+
+void RegistryStore::load(Records &records, uint32_t &nextNodeId)
+{
+    if(logFd >= 0)
+    {
+        throw std::runtime_error("RegistryStore::load called twice");
+    }
+
+    std::vector<uint32_t> snapshots;
+    std::vector<uint32_t> logs;
+    for(const auto &entry : std::filesystem::directory_iterator(config.directory))
+    {
+        uint32_t    fileGeneration = 0;
+        std::string fileName       = entry.path().filename().string();
+        if(parseGeneration(fileName, "snapshot-%u.snap%n", fileGeneration))
+            snapshots.push_back(fileGeneration);
+        else if(parseGeneration(fileName, "log-%u.wal%n", fileGeneration))
+            logs.push_back(fileGeneration);
+        else if(entry.path().extension() == ".tmp")
+            std::filesystem::remove(entry.path()); // Snapshot of an interrupted checkpoint
+    }
+    std::sort(snapshots.rbegin(), snapshots.rend());
+    std::sort(logs.begin(), logs.end());
+
+    // Newest snapshot that is intact, the logs of older snapshots are only removed after a newer one is synced
+    uint32_t baseGeneration = 0;
+    uint32_t initialNextId  = nextNodeId;
+    for(uint32_t snapshotGeneration : snapshots)
+    {
+        if(readSnapshot(snapshotGeneration, records, nextNodeId))
+        {
+            baseGeneration = snapshotGeneration;
+            break;
+        }
+        records.clear();
+        nextNodeId = initialNextId;
+    }
+    size_t snapshotRecords = records.size();
+
+    for(uint32_t logGeneration : logs)
+    {
+        if(logGeneration < baseGeneration)
+            continue;
+
+        size_t logLen = std::filesystem::file_size(getLogPath(logGeneration));
+        logEntries += replayLog(logGeneration, records, nextNodeId);
+        logBytes += logLen > logHeaderLen ? logLen - logHeaderLen : 0;
+    }
+
+    // Replayed logs count towards the next checkpoint, they are compacted together with the new one
+    generation = baseGeneration;
+    if(!snapshots.empty())
+        generation = std::max(generation, snapshots.front());
+    if(!logs.empty())
+        generation = std::max(generation, logs.back());
+    generation++;
+
+    int fd = openLog(generation);
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        logFd = fd;
+    }
+    lastCheckpoint = std::chrono::steady_clock::now();
+
+    LOG_FORMAT(LogLevel::Debug,
+               "Loaded {} records from snapshot {} and {} log entries",
+               snapshotRecords,
+               baseGeneration,
+               logEntries);
+}
+
+void RegistryStore::append(const NodeRecord &record)
+{
+    if(logFd < 0)
+    {
+        throw std::runtime_error("RegistryStore::append called before load");
+    }
+
+    uint32_t interfaceIndex = record.interface != nullptr ? getInterfaceIndex(record.interface) : noInterface;
+
+    PayloadWriter body;
+    body.write(static_cast<uint8_t>(EntryType::Record));
+    writeRecord(body, record, interfaceIndex);
+    writeEntry(body);
+}
+
+bool RegistryStore::isCheckpointDue() const
+{
+    if(logBytes >= config.checkpointLogSize)
+        return true;
+
+    return logEntries > 0 && std::chrono::steady_clock::now() - lastCheckpoint >= config.checkpointInterval;
+}
+
+void RegistryStore::checkpoint(const Records &records, uint32_t nextNodeId)
+{
+    if(logFd < 0)
+    {
+        throw std::runtime_error("RegistryStore::checkpoint called before load");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        if(checkpointRunning)
+            return;
+    }
+
+    // Only the references are taken here, the background thread serializes them
+    auto checkpoint        = std::make_unique<Checkpoint>();
+    checkpoint->generation = generation + 1;
+    checkpoint->nextNodeId = nextNodeId;
+    checkpoint->records.reserve(records.size());
+    for(const auto &[id, record] : records)
+    {
+        checkpoint->records.push_back(record);
+    }
+
+    // Changes after this point go to the next log, which the snapshot is the base of
+    int fd = openLog(checkpoint->generation);
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        checkpoint->previousLogFd = logFd;
+        logFd                     = fd;
+        logDirty                  = false;
+        pending                   = std::move(checkpoint);
+        checkpointRunning         = true;
+    }
+    checkpointCondition.notify_one();
+
+    generation++;
+    logBytes       = 0;
+    logEntries     = 0;
+    lastCheckpoint = std::chrono::steady_clock::now();
+    logInterfaces.clear();
+    logInterfaceRefs.clear();
+}
+
+void RegistryStore::flush()
+{
+    std::unique_lock<std::mutex> lock(checkpointMutex);
+    uint64_t                     ticket = ++requestedFlush;
+    checkpointCondition.notify_one();
+    flushCondition.wait(lock, [&] { return completedFlush >= ticket; });
+}
+
+void RegistryStore::checkpointThreadProcess(RegistryStore *self)
+{
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(self->checkpointMutex);
+        self->checkpointCondition.wait_for(lock, self->config.syncInterval, [&] {
+            return self->inDestruction || self->pending != nullptr || self->requestedFlush > self->completedFlush;
+        });
+
+        std::unique_ptr<Checkpoint> checkpoint  = std::move(self->pending);
+        uint64_t                    flushTicket = self->requestedFlush;
+        bool                        stopping    = self->inDestruction;
+        lock.unlock();
+
+        if(checkpoint != nullptr)
+        {
+            try
+            {
+                self->writeCheckpoint(*checkpoint);
+            }
+            catch(const std::exception &e)
+            {
+                // The logs of the failed checkpoint are kept, loading replays them on top of the previous snapshot
+                LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in RegistryStore::checkpointThreadProcess");
+            }
+
+            lock.lock();
+            self->checkpointRunning = false;
+            lock.unlock();
+        }
+
+        self->syncLog();
+
+        lock.lock();
+        self->completedFlush = flushTicket;
+        lock.unlock();
+        self->flushCondition.notify_all();
+
+        if(stopping)
+            return;
+    }
+}
+
+void RegistryStore::writeCheckpoint(Checkpoint &checkpoint)
+{
+    serializeSnapshot(checkpoint);
+
+    // The previous log has to stay durable until the snapshot replacing it is
+    if(checkpoint.previousLogFd >= 0)
+    {
+        fdatasync(checkpoint.previousLogFd);
+        close(checkpoint.previousLogFd);
+        checkpoint.previousLogFd = -1;
+    }
+
+    std::string path    = getSnapshotPath(checkpoint.generation);
+    std::string tmpPath = path + ".tmp";
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Unable to create " + tmpPath);
+    }
+    try
+    {
+        writeAll(fd, checkpoint.snapshot.data(), checkpoint.snapshot.size(), tmpPath);
+        if(fdatasync(fd) != 0)
+        {
+            throw std::runtime_error("fdatasync failed for " + tmpPath);
+        }
+    }
+    catch(const std::exception &e)
+    {
+        close(fd);
+        unlink(tmpPath.c_str());
+        throw;
+    }
+    close(fd);
+
+    if(rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        throw std::runtime_error("Unable to rename " + tmpPath);
+    }
+
+    int directoryFd = open(config.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(directoryFd >= 0)
+    {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+
+    removeFilesBefore(checkpoint.generation);
+    LOG_FORMAT(LogLevel::Debug, "Checkpoint {} written, {} bytes", checkpoint.generation, checkpoint.snapshot.size());
+}
+
+void RegistryStore::serializeSnapshot(Checkpoint &checkpoint)
+{
+    std::unordered_map<const std::string *, uint32_t> interfaceIndices;
+    std::vector<const std::string *>                  interfaces;
+    for(const auto &record : checkpoint.records)
+    {
+        if(record->interface == nullptr)
+            continue;
+        if(interfaceIndices.try_emplace(record->interface.get(), interfaces.size()).second)
+            interfaces.push_back(record->interface.get());
+    }
+
+    PayloadWriter data;
+    for(const std::string *interface : interfaces)
+    {
+        data.write(static_cast<uint32_t>(interface->size()));
+        data.writeBytes(reinterpret_cast<const uint8_t *>(interface->data()), interface->size());
+    }
+    for(const auto &record : checkpoint.records)
+    {
+        const std::string *interface      = record->interface.get();
+        uint32_t           interfaceIndex = interface != nullptr ? interfaceIndices[interface] : noInterface;
+        writeRecord(data, *record, interfaceIndex);
+    }
+
+    PayloadWriter header;
+    header.write(snapshotMagic);
+    header.write(checkpoint.generation);
+    header.write(checkpoint.nextNodeId);
+    header.write(static_cast<uint32_t>(checkpoint.records.size()));
+    header.write(static_cast<uint32_t>(interfaces.size()));
+    header.write(static_cast<uint64_t>(data.getLen()));
+    header.write(Utilities::crc32_instance.calculate(data.getPointer(), data.getLen()));
+    header.write(uint32_t(0));
+
+    checkpoint.snapshot.reserve(header.getLen() + data.getLen());
+    checkpoint.snapshot.insert(checkpoint.snapshot.end(), header.getPointer(), header.getPointer() + header.getLen());
+    checkpoint.snapshot.insert(checkpoint.snapshot.end(), data.getPointer(), data.getPointer() + data.getLen());
+
+    // Replaced records are only kept alive by the checkpoint
+    checkpoint.records.clear();
+    checkpoint.records.shrink_to_fit();
+}
+
+void RegistryStore::syncLog()
+{
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        if(!logDirty)
+            return;
+        fd       = logFd;
+        logDirty = false;
+    }
+
+    // Only this thread closes replaced logs, so fd stays valid even if a checkpoint replaced it meanwhile
+    fdatasync(fd);
+}
+
+void RegistryStore::writeEntry(const PayloadWriter &body)
+{
+    PayloadWriter entry;
+    entry.write(static_cast<uint32_t>(body.getLen()));
+    entry.write(Utilities::crc32_instance.calculate(body.getPointer(), body.getLen()));
+    entry.writeBytes(body.getPointer(), body.getLen());
+
+    writeAll(logFd, entry.getPointer(), entry.getLen(), getLogPath(generation));
+    logBytes += entry.getLen();
+    logEntries++;
+
+    std::lock_guard<std::mutex> lock(checkpointMutex);
+    logDirty = true;
+}
+
+int RegistryStore::openLog(uint32_t logGeneration)
+{
+    std::string path = getLogPath(logGeneration);
+    int         fd   = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Unable to create " + path);
+    }
+
+    PayloadWriter header;
+    header.write(logMagic);
+    header.write(logGeneration);
+    header.write(uint32_t(0));
+    try
+    {
+        writeAll(fd, header.getPointer(), header.getLen(), path);
+    }
+    catch(const std::exception &e)
+    {
+        close(fd);
+        throw;
+    }
+    return fd;
+}
+
+bool RegistryStore::readSnapshot(uint32_t snapshotGeneration, Records &records, uint32_t &nextNodeId)
+{
+    std::string path = getSnapshotPath(snapshotGeneration);
+    try
+    {
+        FileMapping   snapshot(path);
+        PayloadReader reader(snapshot.data, snapshot.len);
+
+        uint64_t magic          = reader.read<uint64_t>();
+        uint32_t fileGeneration = reader.read<uint32_t>();
+        uint32_t nextId         = reader.read<uint32_t>();
+        uint32_t recordsNum     = reader.read<uint32_t>();
+        uint32_t interfacesNum  = reader.read<uint32_t>();
+        uint64_t dataLen        = reader.read<uint64_t>();
+        uint32_t dataCrc        = reader.read<uint32_t>();
+        reader.read<uint32_t>();
+
+        if(magic != snapshotMagic || fileGeneration != snapshotGeneration || dataLen != reader.getRemainingLen())
+        {
+            throw std::runtime_error("invalid header");
+        }
+
+        const uint8_t *data = reader.readBytes(dataLen);
+        if(Utilities::crc32_instance.calculate(data, dataLen) != dataCrc)
+        {
+            throw std::runtime_error("CRC mismatch");
+        }
+
+        PayloadReader                                   dataReader(data, dataLen);
+        std::vector<std::shared_ptr<const std::string>> interfaces;
+        interfaces.reserve(interfacesNum);
+        for(uint32_t i = 0; i < interfacesNum; i++)
+        {
+            uint32_t len = dataReader.read<uint32_t>();
+            interfaces.push_back(
+                std::make_shared<const std::string>(reinterpret_cast<const char *>(dataReader.readBytes(len)), len));
+        }
+
+        records.reserve(recordsNum);
+        for(uint32_t i = 0; i < recordsNum; i++)
+        {
+            auto record         = std::make_shared<const NodeRecord>(readRecord(dataReader, interfaces));
+            records[record->id] = std::move(record);
+        }
+        nextNodeId = nextId;
+    }
+    catch(const std::exception &e)
+    {
+        LOG_MESSAGE(LogLevel::Warning, "Ignoring snapshot " + path + ": " + e.what());
+        return false;
+    }
+    return true;
+}
+
+size_t RegistryStore::replayLog(uint32_t logGeneration, Records &records, uint32_t &nextNodeId)
+{
+    std::string path = getLogPath(logGeneration);
+    FileMapping logFile(path);
+
+    PayloadReader reader(logFile.data, logFile.len);
+    if(logFile.len < logHeaderLen || reader.read<uint64_t>() != logMagic || reader.read<uint32_t>() != logGeneration)
+    {
+        LOG_MESSAGE(LogLevel::Warning, "Ignoring log with invalid header " + path);
+        return 0;
+    }
+    reader.read<uint32_t>();
+
+    // Interface indices of records refer to the interfaces defined earlier in the same log
+    std::vector<std::shared_ptr<const std::string>> interfaces;
+    size_t                                          entriesNum = 0;
+    while(reader.getRemainingLen() >= entryHeaderLen)
+    {
+        uint32_t len = reader.read<uint32_t>();
+        uint32_t crc = reader.read<uint32_t>();
+        if(len == 0 || len > reader.getRemainingLen())
+        {
+            LOG_MESSAGE(LogLevel::Warning, "Torn entry at the end of " + path);
+            break;
+        }
+
+        const uint8_t *body = reader.readBytes(len);
+        if(Utilities::crc32_instance.calculate(body, len) != crc)
+        {
+            LOG_MESSAGE(LogLevel::Warning, "Torn entry at the end of " + path);
+            break;
+        }
+
+        try
+        {
+            PayloadReader bodyReader(body, len);
+            EntryType     type = static_cast<EntryType>(bodyReader.read<uint8_t>());
+            if(type == EntryType::Interface)
+            {
+                size_t interfaceLen = bodyReader.getRemainingLen();
+                interfaces.push_back(std::make_shared<const std::string>(
+                    reinterpret_cast<const char *>(bodyReader.readBytes(interfaceLen)), interfaceLen));
+            }
+            else if(type == EntryType::Record)
+            {
+                auto record         = std::make_shared<const NodeRecord>(readRecord(bodyReader, interfaces));
+                nextNodeId          = record->id + 1;
+                records[record->id] = std::move(record);
+            }
+            else
+            {
+                throw std::runtime_error("unknown entry type " + std::to_string(static_cast<int>(type)));
+            }
+        }
+        catch(const std::exception &e)
+        {
+            LOG_MESSAGE(LogLevel::Warning, "Invalid entry in " + path + ": " + e.what());
+            break;
+        }
+        entriesNum++;
+    }
+    return entriesNum;
+}
+
+void RegistryStore::removeFilesBefore(uint32_t oldestGeneration)
+{
+    for(const auto &entry : std::filesystem::directory_iterator(config.directory))
+    {
+        uint32_t    fileGeneration = 0;
+        std::string fileName       = entry.path().filename().string();
+        if((parseGeneration(fileName, "snapshot-%u.snap%n", fileGeneration) ||
+            parseGeneration(fileName, "log-%u.wal%n", fileGeneration)) &&
+           fileGeneration < oldestGeneration)
+        {
+            std::filesystem::remove(entry.path());
+        }
+    }
+}
+
+uint32_t RegistryStore::getInterfaceIndex(const std::shared_ptr<const std::string> &interface)
+{
+    auto [it, inserted] = logInterfaces.try_emplace(interface.get(), logInterfaceRefs.size());
+    if(inserted)
+    {
+        PayloadWriter body;
+        body.write(static_cast<uint8_t>(EntryType::Interface));
+        body.writeBytes(reinterpret_cast<const uint8_t *>(interface->data()), interface->size());
+        writeEntry(body);
+        logInterfaceRefs.push_back(interface);
+    }
+    return it->second;
+}
+
+std::string RegistryStore::getSnapshotPath(uint32_t fileGeneration) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "snapshot-%08u.snap", fileGeneration);
+    return config.directory + "/" + name;
+}
+
+std::string RegistryStore::getLogPath(uint32_t fileGeneration) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "log-%08u.wal", fileGeneration);
+    return config.directory + "/" + name;
+}
+
+void RegistryStore::writeRecord(PayloadWriter &writer, const NodeRecord &record, uint32_t interfaceIndex)
+{
+    writer.write(record.id);
+    writer.write(record.options);
+    writer.write(record.interfaceHash);
+    writer.write(interfaceIndex);
+    writer.write(record.secret);
+    writer.writeString<uint8_t>(record.name);
+    writer.writeString<uint8_t>(record.type);
+    writer.writeString<uint16_t>(record.description);
+}
+
+NodeRecord RegistryStore::readRecord(PayloadReader                                         &reader,
+                                     const std::vector<std::shared_ptr<const std::string>> &interfaces)
+{
+    NodeRecord record;
+    record.id               = reader.read<uint32_t>();
+    record.options          = reader.read<uint32_t>();
+    record.interfaceHash    = reader.read<uint32_t>();
+    uint32_t interfaceIndex = reader.read<uint32_t>();
+    record.secret           = reader.read<uint64_t>();
+    record.name             = reader.readString<uint8_t>();
+    record.type             = reader.readString<uint8_t>();
+    record.description      = reader.readString<uint16_t>();
+
+    if(interfaceIndex != noInterface)
+    {
+        if(interfaceIndex >= interfaces.size())
+        {
+            throw std::runtime_error("invalid interface index " + std::to_string(interfaceIndex));
+        }
+        record.interface = interfaces[interfaceIndex];
+    }
+    return record;
+}
+} // namespace Database
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "node/nodeRecord.hpp"
+#include "utilities/logger.hpp"
+
+class PayloadReader;
+class PayloadWriter;
+
+namespace Database
+{
+/* Persistent node registry: a binary snapshot of all node records plus a change log of the records added after it.
+ *
+ * snapshot-<generation>.snap: | Header (40 bytes) | Interface | ... | Record | ... |
+ * log-<generation>.wal:       | Header (16 bytes) | Entry | Entry | ... |
+ *
+ * Snapshot header: | Magic (8) | Generation (4) | Next node ID (4) | Records num (4) | Interfaces num (4) |
+ *                  | Data len (8) | Data CRC (4) | Reserved (4) |
+ * Log header:      | Magic (8) | Generation (4) | Reserved (4) |
+ * Log entry:       | Len (4) | CRC (4) | Entry type (1) | Entry body |, CRC32 of type and body
+ *
+ * Interface:  | Len (4) | Interface bytes |
+ * Record:     | ID (4) | Options (4) | Interface hash (4) | Interface index (4) | Secret (8) |
+ *             | Name len (1) | Name | Type len (1) | Type | Description len (2) | Description |
+ *
+ * Interfaces are shared by every record of a device type, so they are stored once per file and records refer to
+ * them by their index within that file. Snapshot <n> holds the registry as it was when log <n> was started, loading
+ * maps the newest valid snapshot and replays the logs from its generation on. A checkpoint starts the next log and
+ * hands references to the records to a background thread, which serializes and writes the snapshot and removes the
+ * older files once it is synced. Records are immutable and replaced on change, so the caller keeps changing the
+ * registry meanwhile. Log entries are written before the caller acknowledges a change and synced every syncInterval.
+ */
+class RegistryStore
+{
+public:
+    using Records = std::unordered_map<uint32_t, std::shared_ptr<const NodeRecord>>;
+
+    struct Config
+    {
+        std::string               directory          = "registry";
+        size_t                    checkpointLogSize  = 8 * 1024 * 1024; // Log bytes that trigger a checkpoint
+        std::chrono::seconds      checkpointInterval = std::chrono::seconds(600);
+        std::chrono::milliseconds syncInterval       = std::chrono::milliseconds(1000);
+    };
+
+    RegistryStore() = delete;
+    RegistryStore(const Config &config);
+    ~RegistryStore();
+
+    // Restores the registry and starts a new log, has to be called once before any other call
+    void load(Records &records, uint32_t &nextNodeId);
+
+    // Appends an added or changed record to the log
+    void append(const NodeRecord &record);
+
+    // True if the log grew past checkpointLogSize or was not checkpointed for checkpointInterval
+    bool isCheckpointDue() const;
+
+    // Starts the next log and serializes and writes a snapshot of records in the background
+    void checkpoint(const Records &records, uint32_t nextNodeId);
+
+    // Blocks until a running checkpoint finished and the log is synced
+    void flush();
+
+private:
+    using LogLevel = Utilities::Logger::LogLevel;
+
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::RegistryStore;
+
+    static constexpr uint64_t snapshotMagic     = 0x3150414E53474552; // "REGSNAP1"
+    static constexpr uint64_t logMagic          = 0x3130474F4C474552; // "REGLOG01"
+    static constexpr size_t   snapshotHeaderLen = 40;
+    static constexpr size_t   logHeaderLen      = 16;
+    static constexpr size_t   entryHeaderLen    = 8;
+    static constexpr uint32_t noInterface       = UINT32_MAX; // Interface index of records without interface
+
+    enum class EntryType : uint8_t
+    {
+        Interface = 0,
+        Record,
+    };
+
+    struct Checkpoint
+    {
+        uint32_t                                       generation = 0;
+        uint32_t                                       nextNodeId = 0;
+        std::vector<std::shared_ptr<const NodeRecord>> records; // Serialized into snapshot by the checkpoint thread
+        std::vector<uint8_t>                           snapshot;
+        int                                            previousLogFd = -1;
+    };
+
+    Config config;
+
+    // Log state, only used from the caller's thread
+    uint32_t                                          generation = 0;
+    size_t                                            logBytes   = 0;
+    size_t                                            logEntries = 0;
+    std::chrono::steady_clock::time_point             lastCheckpoint;
+    std::unordered_map<const std::string *, uint32_t> logInterfaces;
+    std::vector<std::shared_ptr<const std::string>>   logInterfaceRefs; // Keeps the keys of logInterfaces alive
+
+    std::mutex                  checkpointMutex; // Guards the members below and the log fd
+    std::condition_variable     checkpointCondition;
+    std::condition_variable     flushCondition;
+    int                         logFd    = -1;
+    bool                        logDirty = false;
+    std::unique_ptr<Checkpoint> pending;
+    bool                        checkpointRunning = false;
+    uint64_t                    requestedFlush    = 0;
+    uint64_t                    completedFlush    = 0;
+    bool                        inDestruction     = false;
+    std::thread                 checkpointThread;
+
+    static void checkpointThreadProcess(RegistryStore *self);
+
+    void     writeCheckpoint(Checkpoint &checkpoint);
+    void     writeEntry(const PayloadWriter &body);
+    void     syncLog();
+    int      openLog(uint32_t logGeneration);
+    bool     readSnapshot(uint32_t snapshotGeneration, Records &records, uint32_t &nextNodeId);
+    size_t   replayLog(uint32_t logGeneration, Records &records, uint32_t &nextNodeId);
+    void     removeFilesBefore(uint32_t oldestGeneration);
+    uint32_t getInterfaceIndex(const std::shared_ptr<const std::string> &interface);
+
+    std::string getSnapshotPath(uint32_t fileGeneration) const;
+    std::string getLogPath(uint32_t fileGeneration) const;
+
+    static void       serializeSnapshot(Checkpoint &checkpoint);
+    static void       writeRecord(PayloadWriter &writer, const NodeRecord &record, uint32_t interfaceIndex);
+    static NodeRecord readRecord(PayloadReader                                         &reader,
+                                 const std::vector<std::shared_ptr<const std::string>> &interfaces);
+};
+} // namespace Database
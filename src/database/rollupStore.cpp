@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "rollupStore.hpp"
+#include "historyStore.hpp"
+
+namespace Database
+{
+static const std::string schema = "CREATE TABLE IF NOT EXISTS rollups ("
+                                  "node_id INTEGER, "
+                                  "interface_index INTEGER, "
+                                  "field_index INTEGER, "
+                                  "resolution INTEGER, "
+                                  "start INTEGER, "
+                                  "count INTEGER, "
+                                  "min REAL, "
+                                  "max REAL, "
+                                  "sum REAL, "
+                                  "last REAL, "
+                                  "PRIMARY KEY (node_id, interface_index, field_index, resolution, start)) "
+                                  "WITHOUT ROWID;";
+
+// Order matches RollupStore::Statement
+static const std::vector<std::string> statements = {
+    "INSERT OR REPLACE INTO rollups "
+    "(node_id, interface_index, field_index, resolution, start, count, min, max, sum, last) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);",
+    "DELETE FROM rollups WHERE resolution = ? AND start < ?;",
+};
+
+static const std::string selectSql = "SELECT start, count, min, max, sum, last FROM rollups "
+                                     "WHERE node_id = ? AND interface_index = ? AND field_index = ? "
+                                     "AND resolution = ? AND start >= ? AND start <= ? ORDER BY start;";
+
+RollupStore::RollupStore(const Config &config) :
+    config(config), writer(config.database, schema, statements), lastFlush(std::chrono::steady_clock::now())
+{
+    // Queries use their own connection, WAL mode lets them read while the writer commits
+    int ret = sqlite3_open_v2(config.database.path.c_str(), &readDb, SQLITE_OPEN_READONLY, nullptr);
+    if(ret != SQLITE_OK || sqlite3_prepare_v2(readDb, selectSql.c_str(), -1, &selectStatement, nullptr) != SQLITE_OK)
+    {
+        std::string error = readDb != nullptr ? sqlite3_errmsg(readDb) : std::to_string(ret);
+        sqlite3_close(readDb);
+        throw std::runtime_error("Unable to open rollups for reading: " + error);
+    }
+}
+
+RollupStore::~RollupStore()
+{
+    LOG_MESSAGE(LogLevel::Debug, "Destructing rollup store");
+    {
+        std::lock_guard<std::mutex> lock(seriesMutex);
+        writeOpenBuckets();
+    }
+
+    sqlite3_finalize(selectStatement);
+    sqlite3_close(readDb);
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
+}
+
+uint64_t RollupStore::getResolutionNs(Resolution resolution)
+{
+    constexpr uint64_t minuteNs = 60ULL * 1000 * 1000 * 1000;
+    switch(resolution)
+    {
+    case Resolution::Minute:
+        return minuteNs;
+    case Resolution::Hour:
+        return minuteNs * 60;
+    case Resolution::Day:
+        return minuteNs * 60 * 24;
+    }
+    throw std::runtime_error("Invalid resolution in RollupStore::getResolutionNs");
+}
+
+void RollupStore::update(uint32_t nodeId, uint8_t interfaceIndex, uint8_t fieldIndex, uint64_t timestamp, double value)
+{
+    uint64_t seriesKey = getSeriesKey(nodeId, interfaceIndex, fieldIndex);
+
+    std::lock_guard<std::mutex> lock(seriesMutex);
+    auto [it, inserted] = series.try_emplace(seriesKey);
+    Series &current     = it->second;
+
+    for(size_t r = 0; r < resolutionsNum; r++)
+    {
+        uint64_t resolutionNs = getResolutionNs(static_cast<Resolution>(r));
+        uint64_t start        = timestamp - timestamp % resolutionNs;
+        Bucket & bucket       = current.open[r];
+
+        if(bucket.start != start)
+        {
+            if(bucket.count > 0)
+            {
+                // The bucket is complete, it stays in memory until the next one closes
+                writeBucket(seriesKey, r, bucket);
+                current.closed[r] = bucket;
+                bucket            = Bucket();
+            }
+            else if(inserted)
+            {
+                // First sample of the series since startup, continue a bucket stored before the restart
+                std::vector<Bucket> stored;
+                readBuckets(seriesKey, r, start, start, stored);
+                if(!stored.empty())
+                    bucket = stored.front();
+            }
+            bucket.start = start;
+        }
+
+        if(bucket.count == 0 || value < bucket.min)
+            bucket.min = value;
+        if(bucket.count == 0 || value > bucket.max)
+            bucket.max = value;
+        bucket.sum += value;
+        bucket.last = value;
+        bucket.count++;
+    }
+    current.dirty = true;
+
+    auto now = std::chrono::steady_clock::now();
+    if(now - lastFlush >= config.flushInterval)
+    {
+        lastFlush = now;
+        writeOpenBuckets();
+        removeExpiredBuckets();
+    }
+}
+
+std::vector<RollupStore::Bucket> RollupStore::query(uint32_t   nodeId,
+                                                    uint8_t    interfaceIndex,
+                                                    uint8_t    fieldIndex,
+                                                    Resolution resolution,
+                                                    uint64_t   from,
+                                                    uint64_t   to)
+{
+    uint64_t seriesKey = getSeriesKey(nodeId, interfaceIndex, fieldIndex);
+    size_t   r         = static_cast<size_t>(resolution);
+
+    std::vector<Bucket> buckets;
+    readBuckets(seriesKey, r, from, to, buckets);
+
+    // Buckets in memory are newer than or replace the stored ones
+    std::lock_guard<std::mutex> lock(seriesMutex);
+    auto                        it = series.find(seriesKey);
+    if(it == series.end())
+        return buckets;
+
+    for(const Bucket &bucket : {it->second.closed[r], it->second.open[r]})
+    {
+        if(bucket.count == 0 || bucket.start < from || bucket.start > to)
+            continue;
+
+        auto position = std::lower_bound(
+            buckets.begin(), buckets.end(), bucket.start, [](const Bucket &b, uint64_t s) { return b.start < s; });
+        if(position != buckets.end() && position->start == bucket.start)
+            *position = bucket;
+        else
+            buckets.insert(position, bucket);
+    }
+    return buckets;
+}
+
+void RollupStore::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(seriesMutex);
+        writeOpenBuckets();
+    }
+    writer.flush();
+}
+
+void RollupStore::writeBucket(uint64_t seriesKey, size_t resolution, const Bucket &bucket)
+{
+    writer.execute(Statement::UpsertBucket,
+                   {int64_t(seriesKey >> 16),
+                    int64_t((seriesKey >> 8) & 0xFF),
+                    int64_t(seriesKey & 0xFF),
+                    int64_t(resolution),
+                    int64_t(bucket.start),
+                    int64_t(bucket.count),
+                    bucket.min,
+                    bucket.max,
+                    bucket.sum,
+                    bucket.last});
+}
+
+void RollupStore::writeOpenBuckets()
+{
+    for(auto &[seriesKey, current] : series)
+    {
+        if(!current.dirty)
+            continue;
+
+        for(size_t r = 0; r < resolutionsNum; r++)
+        {
+            if(current.open[r].count > 0)
+                writeBucket(seriesKey, r, current.open[r]);
+        }
+        current.dirty = false;
+    }
+}
+
+void RollupStore::removeExpiredBuckets()
+{
+    uint64_t retentionNs = std::chrono::duration_cast<std::chrono::nanoseconds>(config.minuteRetention).count();
+    uint64_t now         = HistoryStore::getTimestamp();
+    if(now > retentionNs)
+    {
+        writer.execute(Statement::DeleteBuckets, {int64_t(Resolution::Minute), int64_t(now - retentionNs)});
+    }
+}
+
+void RollupStore::readBuckets(uint64_t             seriesKey,
+                              size_t               resolution,
+                              uint64_t             from,
+                              uint64_t             to,
+                              std::vector<Bucket> &buckets)
+{
+    std::lock_guard<std::mutex> lock(readMutex);
+    sqlite3_bind_int64(selectStatement, 1, int64_t(seriesKey >> 16));
+    sqlite3_bind_int64(selectStatement, 2, int64_t((seriesKey >> 8) & 0xFF));
+    sqlite3_bind_int64(selectStatement, 3, int64_t(seriesKey & 0xFF));
+    sqlite3_bind_int64(selectStatement, 4, int64_t(resolution));
+    sqlite3_bind_int64(selectStatement, 5, int64_t(std::min<uint64_t>(from, INT64_MAX)));
+    sqlite3_bind_int64(selectStatement, 6, int64_t(std::min<uint64_t>(to, INT64_MAX)));
+
+    while(sqlite3_step(selectStatement) == SQLITE_ROW)
+    {
+        Bucket bucket;
+        bucket.start = sqlite3_column_int64(selectStatement, 0);
+        bucket.count = sqlite3_column_int64(selectStatement, 1);
+        bucket.min   = sqlite3_column_double(selectStatement, 2);
+        bucket.max   = sqlite3_column_double(selectStatement, 3);
+        bucket.sum   = sqlite3_column_double(selectStatement, 4);
+        bucket.last  = sqlite3_column_double(selectStatement, 5);
+        buckets.push_back(bucket);
+    }
+    sqlite3_reset(selectStatement);
+}
+} // namespace Database
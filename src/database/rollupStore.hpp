@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <sqlite3.h>
+
+#include "sqliteWriter.hpp"
+#include "utilities/logger.hpp"
+
+namespace Database
+{
+/* Incremental rollups of telemetry values per node, interface and field.
+ *
+ * Every sample updates the open 1 minute, 1 hour and 1 day bucket of its series in O(1). A bucket is written to the
+ * rollups table through SqliteWriter when the next bucket of its series opens, open buckets are written every
+ * flushInterval so a crash loses at most that much. Queries, e.g. a RollupQuery of a node (see
+ * server/serverProtocol.hpp), read the stored buckets with an index range scan and merge the buckets still in memory.
+ * Minute buckets are deleted after minuteRetention, hour and day buckets are kept after the raw history aged out.
+ */
+class RollupStore
+{
+public:
+    enum class Resolution : uint8_t
+    {
+        Minute = 0,
+        Hour,
+        Day,
+    };
+    static constexpr size_t resolutionsNum = 3;
+
+    struct Bucket
+    {
+        uint64_t start = 0; // Nanoseconds since epoch
+        uint64_t count = 0;
+        double   min   = 0;
+        double   max   = 0;
+        double   sum   = 0;
+        double   last  = 0;
+    };
+
+    struct Config
+    {
+        SqliteWriter::Config database        = {.path = "rollups.db"};
+        std::chrono::seconds flushInterval   = std::chrono::seconds(60);
+        std::chrono::hours   minuteRetention = std::chrono::hours(24 * 7);
+    };
+
+    RollupStore() = delete;
+    RollupStore(const Config &config);
+    ~RollupStore();
+
+    // Adds a sample to the buckets of its series, timestamps of a series are expected to be non-decreasing
+    void update(uint32_t nodeId, uint8_t interfaceIndex, uint8_t fieldIndex, uint64_t timestamp, double value);
+
+    // Buckets of a series with from <= start <= to in start order
+    std::vector<Bucket> query(uint32_t   nodeId,
+                              uint8_t    interfaceIndex,
+                              uint8_t    fieldIndex,
+                              Resolution resolution,
+                              uint64_t   from,
+                              uint64_t   to);
+
+    // Writes the open buckets and blocks until they are durable
+    void flush();
+
+    static uint64_t getResolutionNs(Resolution resolution);
+
+private:
+    using LogLevel = Utilities::Logger::LogLevel;
+
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::RollupStore;
+
+    enum Statement : uint32_t
+    {
+        UpsertBucket = 0,
+        DeleteBuckets,
+    };
+
+    struct Series
+    {
+        std::array<Bucket, resolutionsNum> open;
+        std::array<Bucket, resolutionsNum> closed; // Kept until the writer committed it
+        bool                               dirty = false;
+    };
+
+    Config       config;
+    SqliteWriter writer;
+
+    std::mutex                            seriesMutex;
+    std::unordered_map<uint64_t, Series>  series;
+    std::chrono::steady_clock::time_point lastFlush;
+
+    std::mutex    readMutex;
+    sqlite3 *     readDb          = nullptr;
+    sqlite3_stmt *selectStatement = nullptr;
+
+    void writeBucket(uint64_t seriesKey, size_t resolution, const Bucket &bucket);
+    void writeOpenBuckets();
+    void removeExpiredBuckets();
+    void readBuckets(uint64_t             seriesKey,
+                     size_t               resolution,
+                     uint64_t             from,
+                     uint64_t             to,
+                     std::vector<Bucket> &buckets);
+
+    static uint64_t getSeriesKey(uint32_t nodeId, uint8_t interfaceIndex, uint8_t fieldIndex)
+    {
+        return (uint64_t(nodeId) << 16) | (uint64_t(interfaceIndex) << 8) | fieldIndex;
+    }
+};
+} // namespace Database
@@ -0,0 +1,289 @@
+#include <stdexcept>
+
+#include "sqliteWriter.hpp"
+
+namespace Database
+{
+SqliteWriter::SqliteWriter(const Config &                  config,
+                           const std::string &             schema,
+                           const std::vector<std::string> &statements) :
+    config(config)
+{
+    if(config.batchRows == 0 || config.maxQueuedRows == 0)
+    {
+        throw std::runtime_error("Invalid SqliteWriter configuration");
+    }
+
+    int ret = sqlite3_open_v2(config.path.c_str(),
+                              &db,
+                              SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+                              nullptr);
+    if(ret != SQLITE_OK)
+    {
+        std::string error = db != nullptr ? getError() : std::to_string(ret);
+        closeDatabase();
+        throw std::runtime_error("Unable to open database " + config.path + ": " + error);
+    }
+
+    try
+    {
+        // WAL lets readers continue during commits, synchronous=FULL makes every commit durable
+        executeSql("PRAGMA journal_mode=WAL;");
+        executeSql("PRAGMA synchronous=FULL;");
+        executeSql(schema);
+
+        beginStatement  = prepareStatement("BEGIN;");
+        commitStatement = prepareStatement("COMMIT;");
+        for(const auto &sql : statements)
+        {
+            preparedStatements.push_back(prepareStatement(sql));
+        }
+    }
+    catch(const std::exception &e)
+    {
+        closeDatabase();
+        throw;
+    }
+
+    writerThread = std::thread(SqliteWriter::writerThreadProcess, this);
+}
+
+SqliteWriter::~SqliteWriter()
+{
+    LOG_MESSAGE(LogLevel::Debug, "Destructing SQLite writer");
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        inDestruction = true;
+    }
+    writerCondition.notify_one();
+    producerCondition.notify_all();
+
+    if(writerThread.joinable())
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Joining writer thread");
+        writerThread.join();
+    }
+
+    closeDatabase();
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
+}
+
+std::future<void> SqliteWriter::execute(uint32_t statement, Values values)
+{
+    if(statement >= preparedStatements.size())
+    {
+        throw std::runtime_error("Invalid statement in SqliteWriter::execute: " + std::to_string(statement));
+    }
+
+    std::unique_lock<std::mutex> lock(queueMutex);
+    producerCondition.wait(lock, [&] { return queue.size() < config.maxQueuedRows || inDestruction; });
+    if(inDestruction)
+    {
+        throw std::runtime_error("SqliteWriter::execute called during destruction");
+    }
+
+    queue.push_back(Row{statement, std::move(values), std::promise<void>()});
+    queuedRows++;
+    std::future<void> future = queue.back().done.get_future();
+
+    // The writer waits for the first row and then for a full batch
+    bool wakeWriter = queue.size() == 1 || queue.size() == config.batchRows;
+    lock.unlock();
+
+    if(wakeWriter)
+    {
+        writerCondition.notify_one();
+    }
+    return future;
+}
+
+void SqliteWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    uint64_t                     target = queuedRows;
+    producerCondition.wait(lock, [&] { return completedRows >= target; });
+}
+
+void SqliteWriter::writerThreadProcess(SqliteWriter *self)
+{
+    std::vector<Row> batch;
+    batch.reserve(self->config.batchRows);
+
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(self->queueMutex);
+        self->writerCondition.wait(lock, [&] { return self->inDestruction || !self->queue.empty(); });
+
+        // Group commit: give the batch until batchInterval after its first row to fill up
+        auto deadline = std::chrono::steady_clock::now() + self->config.batchInterval;
+        self->writerCondition.wait_until(lock, deadline, [&] {
+            return self->inDestruction || self->queue.size() >= self->config.batchRows;
+        });
+
+        if(self->queue.empty() && self->inDestruction)
+        {
+            return;
+        }
+
+        size_t rowsNum = std::min(self->queue.size(), self->config.batchRows);
+        for(size_t i = 0; i < rowsNum; i++)
+        {
+            batch.push_back(std::move(self->queue.front()));
+            self->queue.pop_front();
+        }
+        lock.unlock();
+        self->producerCondition.notify_all();
+
+        self->commitBatch(batch);
+
+        lock.lock();
+        self->completedRows += batch.size();
+        lock.unlock();
+        self->producerCondition.notify_all();
+        batch.clear();
+    }
+}
+
+void SqliteWriter::commitBatch(std::vector<Row> &batch)
+{
+    std::vector<bool> failed(batch.size(), false);
+
+    try
+    {
+        if(sqlite3_step(beginStatement) != SQLITE_DONE)
+        {
+            throw std::runtime_error("BEGIN failed: " + getError());
+        }
+        sqlite3_reset(beginStatement);
+
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            sqlite3_stmt *statement = preparedStatements[batch[i].statement];
+            try
+            {
+                bindValues(statement, batch[i].values);
+                if(sqlite3_step(statement) != SQLITE_DONE)
+                {
+                    throw std::runtime_error("Statement " + std::to_string(batch[i].statement) +
+                                             " failed: " + getError());
+                }
+            }
+            catch(const std::exception &e)
+            {
+                // A failing row does not abort the rest of the batch
+                failed[i] = true;
+                batch[i].done.set_exception(std::current_exception());
+            }
+            sqlite3_reset(statement);
+            sqlite3_clear_bindings(statement);
+        }
+
+        int ret = sqlite3_step(commitStatement);
+        sqlite3_reset(commitStatement);
+        if(ret != SQLITE_DONE)
+        {
+            throw std::runtime_error("COMMIT failed: " + getError());
+        }
+    }
+    catch(const std::exception &e)
+    {
+        LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in SqliteWriter::commitBatch");
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            if(!failed[i])
+            {
+                batch[i].done.set_exception(std::current_exception());
+            }
+        }
+        return;
+    }
+
+    for(size_t i = 0; i < batch.size(); i++)
+    {
+        if(!failed[i])
+        {
+            batch[i].done.set_value();
+        }
+    }
+}
+
+void SqliteWriter::bindValues(sqlite3_stmt *statement, const Values &values)
+{
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        int index = static_cast<int>(i) + 1;
+        int ret   = SQLITE_OK;
+
+        const Value &value = values[i];
+        if(std::holds_alternative<std::nullptr_t>(value))
+        {
+            ret = sqlite3_bind_null(statement, index);
+        }
+        else if(std::holds_alternative<int64_t>(value))
+        {
+            ret = sqlite3_bind_int64(statement, index, std::get<int64_t>(value));
+        }
+        else if(std::holds_alternative<double>(value))
+        {
+            ret = sqlite3_bind_double(statement, index, std::get<double>(value));
+        }
+        else if(std::holds_alternative<std::string>(value))
+        {
+            const std::string &str = std::get<std::string>(value);
+            ret = sqlite3_bind_text(statement, index, str.data(), str.size(), SQLITE_STATIC);
+        }
+        else
+        {
+            const std::vector<uint8_t> &blob = std::get<std::vector<uint8_t>>(value);
+            ret = sqlite3_bind_blob(statement, index, blob.data(), blob.size(), SQLITE_STATIC);
+        }
+
+        if(ret != SQLITE_OK)
+        {
+            throw std::runtime_error("Binding value " + std::to_string(index) + " failed: " + getError());
+        }
+    }
+}
+
+sqlite3_stmt *SqliteWriter::prepareStatement(const std::string &sql)
+{
+    sqlite3_stmt *statement = nullptr;
+    if(sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, nullptr) != SQLITE_OK)
+    {
+        throw std::runtime_error("Preparing \"" + sql + "\" failed: " + getError());
+    }
+    return statement;
+}
+
+void SqliteWriter::executeSql(const std::string &sql)
+{
+    char *error = nullptr;
+    if(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK)
+    {
+        std::string errorString = error != nullptr ? error : "unknown error";
+        sqlite3_free(error);
+        throw std::runtime_error("Executing \"" + sql + "\" failed: " + errorString);
+    }
+}
+
+void SqliteWriter::closeDatabase()
+{
+    for(auto statement : preparedStatements)
+    {
+        sqlite3_finalize(statement);
+    }
+    preparedStatements.clear();
+
+    sqlite3_finalize(beginStatement);
+    sqlite3_finalize(commitStatement);
+    beginStatement  = nullptr;
+    commitStatement = nullptr;
+
+    if(db != nullptr)
+    {
+        sqlite3_close(db);
+        db = nullptr;
+    }
+}
+} // namespace Database
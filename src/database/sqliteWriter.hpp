@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+#include <sqlite3.h>
+
+#include "utilities/logger.hpp"
+
+namespace Database
+{
+/* Writes rows to an SQLite database from a dedicated writer thread.
+ *
+ * Callers queue a prepared statement id with its values and get a future that completes once the row is committed.
+ * The writer runs the queued rows in one transaction (group commit) whenever batchRows rows are queued or the
+ * oldest queued row waited for batchInterval. The database runs in WAL mode with synchronous=FULL, so a completed
+ * future means the row is durable.
+ */
+class SqliteWriter
+{
+public:
+    using Value  = std::variant<std::nullptr_t, int64_t, double, std::string, std::vector<uint8_t>>;
+    using Values = std::vector<Value>;
+
+    struct Config
+    {
+        std::string               path          = "iot-server.db";
+        size_t                    batchRows     = 256;
+        std::chrono::milliseconds batchInterval = std::chrono::milliseconds(5);
+        size_t                    maxQueuedRows = 64 * 1024;
+    };
+
+    SqliteWriter() = delete;
+
+    // schema is executed once at startup, statements are prepared and addressed by their index afterwards
+    SqliteWriter(const Config &config, const std::string &schema, const std::vector<std::string> &statements);
+    ~SqliteWriter();
+
+    // Queues a row, the future completes after the row is committed or holds the exception if it failed
+    std::future<void> execute(uint32_t statement, Values values);
+
+    // Blocks until every row queued before the call is committed
+    void flush();
+
+private:
+    using LogLevel = Utilities::Logger::LogLevel;
+
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::SqliteWriter;
+
+    struct Row
+    {
+        uint32_t           statement;
+        Values             values;
+        std::promise<void> done;
+    };
+
+    Config                      config;
+    sqlite3 *                   db = nullptr;
+    std::vector<sqlite3_stmt *> preparedStatements;
+    sqlite3_stmt *              beginStatement  = nullptr;
+    sqlite3_stmt *              commitStatement = nullptr;
+
+    std::mutex              queueMutex;
+    std::condition_variable writerCondition;
+    std::condition_variable producerCondition;
+    std::deque<Row>         queue;
+    uint64_t                queuedRows    = 0;
+    uint64_t                completedRows = 0;
+    bool                    inDestruction = false;
+    std::thread             writerThread;
+
+    static void writerThreadProcess(SqliteWriter *self);
+
+    void          commitBatch(std::vector<Row> &batch);
+    void          bindValues(sqlite3_stmt *statement, const Values &values);
+    sqlite3_stmt *prepareStatement(const std::string &sql);
+    void          executeSql(const std::string &sql);
+    void          closeDatabase();
+    std::string   getError() const { return sqlite3_errmsg(db); }
+};
+} // namespace Database
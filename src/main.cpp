@@ -1,20 +1,84 @@
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#include "node/node.hpp"
 #include "server/server.hpp"
 #include "utilities/logger.hpp"
 #include "utilities/dnsUpdater.hpp"
 #include "simulator/testAppNode.hpp"
 
+static constexpr size_t quarantineRingLen = 4 * 1024 * 1024;
+
 int main(int argc, char *argv[])
 {
-    (void)argc;
-    (void)argv;
+    // --binary-log <file> writes the log in binary form, iot-log-decoder turns it into text
+    // --log-dir <directory> writes the log to rotating, compressed files instead of the console
+    // --quarantine <file> keeps the latest malformed frames of nodes in a ring file, iot-log-decoder prints it
+    // --trace <n> traces 1 in n messages through the server, GET /trace on the metrics socket returns the latest ones
+    // --capture <file> records what nodes send for iot-traffic-replay, the last 100 ms are lost on a kill
+    // --takeover <socket> restarts without dropping connections, taking them over from the server on that local socket
+    std::unique_ptr<Utilities::QuarantineRing> quarantineRing;
+    std::unique_ptr<Utilities::TrafficCapture> trafficCapture;
+    std::string                                takeoverSocketPath;
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if(option == "--binary-log")
+        {
+            Utilities::Logger::setBinaryOutput(argv[i + 1]);
+        }
+        else if(option == "--log-dir")
+        {
+            Utilities::LogFile::Config logFileConfig;
+            logFileConfig.directory = argv[i + 1];
+            logFileConfig.compress  = true;
+            Utilities::Logger::setFileOutput(logFileConfig);
+        }
+        else if(option == "--quarantine")
+        {
+            quarantineRing = std::make_unique<Utilities::QuarantineRing>(quarantineRingLen, argv[i + 1]);
+            Node::setQuarantineRing(quarantineRing.get());
+        }
+        else if(option == "--trace")
+        {
+            Metrics::Tracer::setSampleInterval(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+        else if(option == "--capture")
+        {
+            trafficCapture = std::make_unique<Utilities::TrafficCapture>(argv[i + 1]);
+            Node::setTrafficCapture(trafficCapture.get());
+        }
+        else if(option == "--takeover")
+        {
+            takeoverSocketPath = argv[i + 1];
+        }
+    }
+
+    // Module log levels override the global level, e.g. IOT_LOG_LEVELS=Node=Debug,Server=Warning
+    const char *logLevelOverrides = std::getenv("IOT_LOG_LEVELS");
+
     while(true)
     {
         // Main application loop
         try
         {
             Utilities::Logger::setGlobalLogLevel(Utilities::Logger::LogLevel::Debug);
+            if(logLevelOverrides != nullptr)
+            {
+                Utilities::Logger::setModuleLogLevels(logLevelOverrides);
+            }
             Utilities::Logger::logMessage("=== Starting IoT server app ===", Utilities::Logger::LogLevel::Info);
-            Server server;
+
+            // Only the first start takes over, a restart after an exception begins with new connections
+            Server::Config serverConfig;
+            if(!takeoverSocketPath.empty())
+            {
+                std::string path = std::move(takeoverSocketPath);
+                takeoverSocketPath.clear();
+                serverConfig.handoff = Server::takeOver(path);
+            }
+            Server server(serverConfig);
 
             AppNode testAppNode("Test App Node");
 
@@ -22,15 +86,18 @@ int main(int argc, char *argv[])
             //   Utilities::Logger::LogLevel::Info);
             // Utilities::DnsUpdater dnsUpdater(3600); // Update DNS every 1 hour
 
-            while(true)
+            while(!server.isHandedOff())
             {
-                sleep(1000); // stay in main
+                std::this_thread::sleep_for(std::chrono::milliseconds(100)); // stay in main
             }
+            Utilities::Logger::logMessage("Connections handed off, exiting", Utilities::Logger::LogLevel::Info);
+            break;
         }
         catch(const std::exception &e)
         {
             Utilities::Logger::logMessage("Exception! Error: " + std::string(e.what()),
                                           Utilities::Logger::LogLevel::Error);
+            Utilities::Logger::flush();
             sleep(1);
         }
     }
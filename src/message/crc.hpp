@@ -11,6 +11,8 @@ private:
     static constexpr uint32_t lookup_table_elements_count = 256;
     static constexpr uint32_t WIDTH                       = sizeof(T) * 8;
     static constexpr uint32_t MSB_BIT_INDEX               = WIDTH - 8;
+    static constexpr uint32_t SLICES_COUNT                = 8;
+    static constexpr bool     SLICING                     = sizeof(T) == 4;
 
     T    _polynomial;
     T    _initial_value;
@@ -18,8 +20,15 @@ private:
     bool _reflect_input;
     bool _reflect_output;
 
+    // Reflecting both input and output equals running the whole calculation reflected, which avoids reflecting
+    // every input byte
+    bool _reflected_table;
+
     T _table[lookup_table_elements_count];
 
+    // Slicing-by-8 tables for 32 bit reflected CRCs, _slice_table[k][i] is the CRC of byte i followed by k zero bytes
+    T _slice_table[SLICES_COUNT][lookup_table_elements_count];
+
     uint8_t reflect_byte(const uint8_t byte) const
     {
         uint8_t reflected = 0;
@@ -39,14 +48,49 @@ private:
         T reflected = 0;
         for(uint32_t i = 0; i < WIDTH; i++)
         {
-            if((crc & (1 << i)) != 0)
+            if((crc & ((T)1 << i)) != 0)
             {
-                reflected |= 1 << (WIDTH - 1 - i);
+                reflected |= (T)1 << (WIDTH - 1 - i);
             }
         }
         crc = reflected;
     }
 
+    void calculate_reflected_table()
+    {
+        T reflected_polynomial = _polynomial;
+        reflect(reflected_polynomial);
+        for(uint32_t divident = 0; divident < lookup_table_elements_count; divident++)
+        {
+            T curByte = (T)divident; /* divident byte in LSB of T CRC */
+            for(uint8_t bit = 0; bit < 8; bit++)
+            {
+                if((curByte & 1) != 0)
+                {
+                    curByte = (T)((curByte >> 1) ^ reflected_polynomial);
+                }
+                else
+                {
+                    curByte >>= 1;
+                }
+            }
+            _table[divident] = curByte;
+        }
+
+        if constexpr(SLICING)
+        {
+            for(uint32_t i = 0; i < lookup_table_elements_count; i++)
+            {
+                _slice_table[0][i] = _table[i];
+                for(uint32_t k = 1; k < SLICES_COUNT; k++)
+                {
+                    T previous         = _slice_table[k - 1][i];
+                    _slice_table[k][i] = (T)((previous >> 8) ^ _table[(uint8_t)previous]);
+                }
+            }
+        }
+    }
+
     void calculate_table()
     {
         for(uint32_t divident = 0; divident < lookup_table_elements_count; divident++)
@@ -81,16 +125,54 @@ public:
         _final_xor_value = final_xor_value;
         _reflect_input   = reflect_input;
         _reflect_output  = reflect_output;
+        _reflected_table = reflect_input && reflect_output;
 
-        calculate_table();
+        if(_reflected_table)
+            calculate_reflected_table();
+        else
+            calculate_table();
     }
 
     // Initiates a CRC calculation chain
-    T init() const { return _initial_value; }
+    T init() const
+    {
+        T crc = _initial_value;
+        if(_reflected_table)
+        {
+            reflect(crc);
+        }
+        return crc;
+    }
 
     // Updates given CRC calculation chain
     void update(T &crc, const uint8_t *data, const uint32_t data_len) const
     {
+        if(_reflected_table)
+        {
+            uint32_t i = 0;
+            if constexpr(SLICING)
+            {
+                // 8 bytes per step, the two words are assembled little endian regardless of the host
+                for(; i + SLICES_COUNT <= data_len; i += SLICES_COUNT)
+                {
+                    const uint8_t *p  = data + i;
+                    uint32_t       lo = p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+                    uint32_t       hi = p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+                    lo ^= crc;
+                    crc = _slice_table[7][lo & 0xFF] ^ _slice_table[6][(lo >> 8) & 0xFF] ^
+                          _slice_table[5][(lo >> 16) & 0xFF] ^ _slice_table[4][lo >> 24] ^
+                          _slice_table[3][hi & 0xFF] ^ _slice_table[2][(hi >> 8) & 0xFF] ^
+                          _slice_table[1][(hi >> 16) & 0xFF] ^ _slice_table[0][hi >> 24];
+                }
+            }
+
+            for(; i < data_len; i++)
+            {
+                crc = (T)((crc >> 8) ^ _table[(uint8_t)(crc ^ data[i])]);
+            }
+            return;
+        }
+
         for(uint32_t i = 0; i < data_len; i++)
         {
             uint8_t byte = data[i];
@@ -108,7 +190,7 @@ public:
     // Finished CRC calculation chain
     void finish(T &crc) const
     {
-        if(_reflect_output)
+        if(_reflect_output && !_reflected_table)
         {
             reflect(crc);
         }
@@ -0,0 +1,66 @@
+#include <stdexcept>
+#include <string>
+
+#include "gatherMessage.hpp"
+#include "crc.hpp"
+
+GatherMessage::GatherMessage(const uint32_t sourceId, const uint32_t destinationId) :
+    sourceId(sourceId), destinationId(destinationId)
+{
+}
+
+void GatherMessage::writeBytes(const uint8_t *bytes, const size_t len)
+{
+    if(len == 0)
+        return;
+
+    // Consecutive copies share one piece
+    if(pieces.empty() || pieces.back().reference != nullptr)
+    {
+        pieces.push_back(Piece{nullptr, copied.size(), 0});
+    }
+    copied.insert(copied.end(), bytes, bytes + len);
+    pieces.back().len += len;
+    payloadLen += len;
+}
+
+void GatherMessage::addReference(const uint8_t *bytes, const size_t len)
+{
+    if(len == 0)
+        return;
+
+    pieces.push_back(Piece{bytes, 0, len});
+    payloadLen += len;
+}
+
+const std::vector<iovec> &GatherMessage::encode()
+{
+    if(payloadLen > Message::maxPayloadLen)
+    {
+        throw std::runtime_error("Payload too large in GatherMessage::encode, payloadLen=" +
+                                 std::to_string(payloadLen));
+    }
+
+    auto &endian = Utilities::Endian::Instance();
+    endian.writeWithEndianness(
+        static_cast<uint32_t>(getMessageLen()), header + Message::messageLenIndex, Message::messageEndianness);
+    endian.writeWithEndianness(sourceId, header + Message::messageSourceIdIndex, Message::messageEndianness);
+    endian.writeWithEndianness(destinationId, header + Message::messageDestinationIdIndex, Message::messageEndianness);
+
+    uint32_t crc32 = Utilities::crc32_instance.init();
+    Utilities::crc32_instance.update(crc32, header, sizeof(header));
+
+    vector.clear();
+    vector.push_back(iovec{header, sizeof(header)});
+    for(const Piece &piece : pieces)
+    {
+        const uint8_t *bytes = piece.reference != nullptr ? piece.reference : copied.data() + piece.offset;
+        Utilities::crc32_instance.update(crc32, bytes, piece.len);
+        vector.push_back(iovec{const_cast<uint8_t *>(bytes), piece.len});
+    }
+
+    Utilities::crc32_instance.finish(crc32);
+    endian.writeWithEndianness(crc32, crc, Message::messageEndianness);
+    vector.push_back(iovec{crc, sizeof(crc)});
+    return vector;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <sys/uio.h>
+#include <vector>
+
+#include "message.hpp"
+
+/* Message frame assembled from pieces for a single writev, in the same wire format as Message.
+ *
+ * Small fields are copied into the message, large payload parts can be referenced where they already are (e.g. in
+ * a mapped file) and are only read for the CRC. Referenced bytes have to stay valid until the message is sent.
+ */
+class GatherMessage
+{
+public:
+    GatherMessage() = delete;
+    GatherMessage(const uint32_t sourceId, const uint32_t destinationId);
+
+    // Copies a value into the payload with Message::messageEndianness
+    template <typename T>
+    void write(const T value)
+    {
+        uint8_t bytes[sizeof(T)];
+        Utilities::Endian::Instance().writeWithEndianness(value, bytes, Message::messageEndianness);
+        writeBytes(bytes, sizeof(T));
+    }
+
+    // Copies bytes into the payload
+    void writeBytes(const uint8_t *bytes, const size_t len);
+
+    // Appends bytes to the payload without copying them
+    void addReference(const uint8_t *bytes, const size_t len);
+
+    size_t getPayloadLen() const { return payloadLen; }
+    size_t getMessageLen() const { return payloadLen + Message::overheadLen; }
+
+    // Fills in header and CRC and returns the pieces of the frame in order
+    const std::vector<iovec> &encode();
+
+private:
+    struct Piece
+    {
+        const uint8_t *reference; // nullptr for copied bytes
+        size_t         offset;    // Index in copied for copied bytes
+        size_t         len;
+    };
+
+    uint32_t             sourceId;
+    uint32_t             destinationId;
+    size_t               payloadLen = 0;
+    std::vector<Piece>   pieces;
+    std::vector<uint8_t> copied;
+    std::vector<iovec>   vector;
+    uint8_t              header[Message::messagePayloadIndex];
+    uint8_t              crc[Message::messageCrcBytesNum];
+};
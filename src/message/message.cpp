@@ -160,4 +160,21 @@ const uint8_t *Message::getMessagePointer() const
         return nullptr;
     else
         return data.data();
-}
\ No newline at end of file
+}
+
+void Message::viewFrame(const uint8_t * bytes,
+                        const size_t    bytesLen,
+                        uint32_t &      destinationId,
+                        const uint8_t *&payload,
+                        size_t &        payloadLen)
+{
+    if(bytesLen < overheadLen)
+    {
+        throw std::runtime_error("Invalid bytesLen in Message::viewFrame");
+    }
+
+    Utilities::Endian::Instance().readWithEndianness(
+        destinationId, bytes + messageDestinationIdIndex, messageEndianness);
+    payload    = bytes + messagePayloadIndex;
+    payloadLen = bytesLen - overheadLen;
+}
@@ -21,6 +21,9 @@ class Message
      */
 
 private:
+    // Frames assembled by GatherMessage use the same layout
+    friend class GatherMessage;
+
     static constexpr uint32_t messageLenIndex    = 0;
     static constexpr size_t   messageLenBytesNum = 4;
 
@@ -85,4 +88,11 @@ public:
 
     // Get pointer to raw message frame
     const uint8_t *getMessagePointer() const;
+
+    // Read destination ID and payload location of an already validated raw frame without copying or checking it
+    static void viewFrame(const uint8_t * bytes,
+                          const size_t    bytesLen,
+                          uint32_t &      destinationId,
+                          const uint8_t *&payload,
+                          size_t &        payloadLen);
 };
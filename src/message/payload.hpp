@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "endian.hpp"
+#include "message.hpp"
+
+// Sequential writer for building message payloads, values are written with Message::messageEndianness
+class PayloadWriter
+{
+public:
+    PayloadWriter() = default;
+
+    template <typename T>
+    void write(const T value)
+    {
+        size_t index = data.size();
+        data.resize(index + sizeof(T));
+        Utilities::Endian::Instance().writeWithEndianness(value, data.data() + index, Message::messageEndianness);
+    }
+
+    void writeBytes(const uint8_t *bytes, const size_t len) { data.insert(data.end(), bytes, bytes + len); }
+
+    // Writes a string prefixed by its length as LenType
+    template <typename LenType>
+    void writeString(const std::string &str)
+    {
+        if(str.size() > static_cast<size_t>(static_cast<LenType>(~LenType(0))))
+        {
+            throw std::runtime_error("String too long in PayloadWriter::writeString, len=" +
+                                     std::to_string(str.size()));
+        }
+        write(static_cast<LenType>(str.size()));
+        writeBytes(reinterpret_cast<const uint8_t *>(str.data()), str.size());
+    }
+
+    const uint8_t *getPointer() const { return data.data(); }
+    size_t         getLen() const { return data.size(); }
+
+private:
+    std::vector<uint8_t> data;
+};
+
+// Sequential reader for parsing message payloads, throws if reading past the end of the payload
+class PayloadReader
+{
+public:
+    PayloadReader() = delete;
+    PayloadReader(const uint8_t *data, const size_t len) : data(data), len(len) {}
+
+    template <typename T>
+    T read()
+    {
+        T value = 0;
+        checkAvailable(sizeof(T));
+        Utilities::Endian::Instance().readWithEndianness(value, data + index, Message::messageEndianness);
+        index += sizeof(T);
+        return value;
+    }
+
+    const uint8_t *readBytes(const size_t bytesLen)
+    {
+        checkAvailable(bytesLen);
+        const uint8_t *ptr = data + index;
+        index += bytesLen;
+        return ptr;
+    }
+
+    // Reads a string prefixed by its length as LenType
+    template <typename LenType>
+    std::string readString()
+    {
+        size_t strLen = read<LenType>();
+        return std::string(reinterpret_cast<const char *>(readBytes(strLen)), strLen);
+    }
+
+    size_t getRemainingLen() const { return len - index; }
+
+private:
+    const uint8_t *data;
+    size_t         len;
+    size_t         index = 0;
+
+    void checkAvailable(const size_t bytesLen) const
+    {
+        if(index + bytesLen > len)
+        {
+            throw std::runtime_error("Payload too short in PayloadReader -> index=" + std::to_string(index) +
+                                     ", requested=" + std::to_string(bytesLen) + ", len=" + std::to_string(len));
+        }
+    }
+};
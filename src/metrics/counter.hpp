@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Metrics
+{
+static constexpr size_t shardsNum     = 16;
+static constexpr size_t cacheLineSize = 64;
+
+// Shard of the calling thread, threads are spread over the shards in the order they first record something
+inline size_t getShardIndex()
+{
+    static std::atomic<size_t> nextShard = 0;
+    thread_local size_t        shard     = nextShard.fetch_add(1, std::memory_order_relaxed) % shardsNum;
+    return shard;
+}
+
+/* Monotonic counter split into cache line sized shards. Threads add to the shard of their own, recording is a single
+ * uncontended atomic add, reading sums the shards.
+ */
+class Counter
+{
+public:
+    void add(uint64_t value = 1) { shards[getShardIndex()].value.fetch_add(value, std::memory_order_relaxed); }
+
+    uint64_t getValue() const
+    {
+        uint64_t value = 0;
+        for(const Shard &shard : shards)
+            value += shard.value.load(std::memory_order_relaxed);
+        return value;
+    }
+
+private:
+    struct alignas(cacheLineSize) Shard
+    {
+        std::atomic<uint64_t> value = 0;
+    };
+
+    Shard shards[shardsNum];
+};
+
+// Value that goes up and down, like a queue depth, sharded like Counter. The shards of a gauge can be negative on
+// their own, only their sum is meaningful.
+class Gauge
+{
+public:
+    void add(int64_t value = 1) { shards[getShardIndex()].value.fetch_add(value, std::memory_order_relaxed); }
+    void sub(int64_t value = 1) { add(-value); }
+
+    int64_t getValue() const
+    {
+        int64_t value = 0;
+        for(const Shard &shard : shards)
+            value += shard.value.load(std::memory_order_relaxed);
+        return value;
+    }
+
+private:
+    struct alignas(cacheLineSize) Shard
+    {
+        std::atomic<int64_t> value = 0;
+    };
+
+    Shard shards[shardsNum];
+};
+
+// Traffic of a single node, written by its data thread and by the threads sending to it, so it is not sharded
+struct alignas(cacheLineSize) NodeCounters
+{
+    uint32_t              nodeId      = 0;
+    std::atomic<uint64_t> messagesIn  = 0;
+    std::atomic<uint64_t> bytesIn     = 0;
+    std::atomic<uint64_t> messagesOut = 0;
+    std::atomic<uint64_t> bytesOut    = 0;
+
+    void addIn(size_t len)
+    {
+        messagesIn.fetch_add(1, std::memory_order_relaxed);
+        bytesIn.fetch_add(len, std::memory_order_relaxed);
+    }
+
+    void addOut(size_t len)
+    {
+        messagesOut.fetch_add(1, std::memory_order_relaxed);
+        bytesOut.fetch_add(len, std::memory_order_relaxed);
+    }
+};
+} // namespace Metrics
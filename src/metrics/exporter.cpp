@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <charconv>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "exporter.hpp"
+#include "tracer.hpp"
+#include "message/payload.hpp"
+
+namespace Metrics
+{
+static constexpr int pollTimeoutMs   = 100; // Upper bound of the wait for the destructor
+static constexpr int clientTimeoutMs = 200; // Whole exchange with a client, publishing waits meanwhile
+
+Exporter::Exporter(const Config &config) : config(config)
+{
+    publish();
+
+    if(!config.socketPath.empty())
+    {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(config.socketPath.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error("Socket path too long in Metrics::Exporter: " + config.socketPath);
+        }
+        memcpy(address.sun_path, config.socketPath.c_str(), config.socketPath.size());
+
+        // A socket file left by an earlier run is replaced, like the server's sockets only its user may connect
+        unlink(config.socketPath.c_str());
+        socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(socketFd < 0 || bind(socketFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+           chmod(config.socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(socketFd, 8) != 0)
+        {
+            if(socketFd >= 0)
+                close(socketFd);
+            throw std::runtime_error("Unable to listen on " + config.socketPath + " in Metrics::Exporter");
+        }
+    }
+
+    exporterThread = std::thread(exporterThreadProcess, this);
+}
+
+Exporter::~Exporter()
+{
+    inDestruction = true;
+    if(exporterThread.joinable())
+    {
+        exporterThread.join();
+    }
+
+    if(socketFd >= 0)
+    {
+        close(socketFd);
+        unlink(config.socketPath.c_str());
+    }
+}
+
+std::shared_ptr<const Exporter::Publication> Exporter::getPublication() const
+{
+    std::lock_guard<std::mutex> lock(publicationMutex);
+    return publication;
+}
+
+void Exporter::publish()
+{
+    auto newPublication      = std::make_shared<Publication>();
+    newPublication->snapshot = Registry::getSnapshot();
+    newPublication->text     = renderText(newPublication->snapshot);
+    newPublication->binary   = renderBinary(newPublication->snapshot);
+
+    // Readers keep the publication they got, the old one is freed by its last reader
+    std::lock_guard<std::mutex> lock(publicationMutex);
+    publication = std::move(newPublication);
+}
+
+void Exporter::exporterThreadProcess(Exporter *self)
+{
+    auto nextPublish = std::chrono::steady_clock::now() + self->config.interval;
+    while(!self->inDestruction)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if(now >= nextPublish)
+        {
+            self->publish();
+            nextPublish = now + self->config.interval;
+            continue;
+        }
+
+        int timeout = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(nextPublish - now).count() + 1);
+        pollfd listener = {self->socketFd, POLLIN, 0};
+        if(poll(&listener, self->socketFd >= 0 ? 1 : 0, std::min(timeout, pollTimeoutMs)) <= 0)
+            continue;
+
+        int clientFd = accept4(self->socketFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(clientFd >= 0)
+        {
+            self->serveClient(clientFd);
+            close(clientFd);
+        }
+    }
+}
+
+void Exporter::serveClient(int clientFd) const
+{
+    // One deadline for the whole exchange, a slow client can not hold up publishing longer than that
+    using namespace std::chrono;
+    auto deadline       = steady_clock::now() + milliseconds(clientTimeoutMs);
+    auto getRemainingMs = [&deadline]() {
+        auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        return static_cast<int>(std::max<int64_t>(remaining, 0));
+    };
+
+    // The request is read so the client sees a complete exchange, every path but /trace gets the metrics
+    std::string request;
+    char        buffer[1024];
+    while(request.size() < maxRequestLen && request.find("\r\n\r\n") == std::string::npos)
+    {
+        pollfd client = {clientFd, POLLIN, 0};
+        if(poll(&client, 1, getRemainingMs()) <= 0)
+            break;
+
+        ssize_t len = read(clientFd, buffer, sizeof(buffer));
+        if(len <= 0)
+            break;
+        request.append(buffer, len);
+    }
+
+    std::string response;
+    if(request.compare(0, 11, "GET /trace ") == 0)
+    {
+        std::string trace = Tracer::renderChromeTrace();
+        response          = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                   std::to_string(trace.size()) + "\r\nConnection: close\r\n\r\n";
+        response += trace;
+    }
+    else
+    {
+        std::shared_ptr<const Publication> current = getPublication();
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(current->text.size()) + "\r\nConnection: close\r\n\r\n";
+        response += current->text;
+    }
+
+    size_t written = 0;
+    while(written < response.size())
+    {
+        pollfd  client = {clientFd, POLLOUT, 0};
+        ssize_t len    = 0;
+        if(poll(&client, 1, getRemainingMs()) <= 0 ||
+           (len = send(clientFd, response.data() + written, response.size() - written, MSG_NOSIGNAL)) <= 0)
+        {
+            LOG_MESSAGE(LogLevel::Debug, "Metrics client stopped reading");
+            return;
+        }
+        written += len;
+    }
+}
+
+template <typename T>
+static void appendNumber(std::string &output, T value)
+{
+    char text[24];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    output.append(text, result.ptr - text);
+}
+
+static void appendHeader(std::string &output, const std::string &name, const std::string &help, const char *type)
+{
+    output += "# HELP ";
+    output += name;
+    output += ' ';
+    output += help;
+    output += "\n# TYPE ";
+    output += name;
+    output += ' ';
+    output += type;
+    output += '\n';
+}
+
+std::string Exporter::renderText(const Registry::Snapshot &snapshot)
+{
+    std::string text;
+    text.reserve(4096 + snapshot.nodes.size() * 4 * 48);
+
+    for(const auto &counter : snapshot.counters)
+    {
+        appendHeader(text, counter.name, counter.help, "counter");
+        text += counter.name;
+        text += ' ';
+        appendNumber(text, counter.value);
+        text += '\n';
+    }
+
+    for(const auto &gauge : snapshot.gauges)
+    {
+        appendHeader(text, gauge.name, gauge.help, "gauge");
+        text += gauge.name;
+        text += ' ';
+        appendNumber(text, gauge.value);
+        text += '\n';
+    }
+
+    for(const auto &histogram : snapshot.histograms)
+    {
+        appendHeader(text, histogram.name, histogram.help, "histogram");
+        uint64_t cumulative = 0;
+        for(const Histogram::Bucket &bucket : histogram.snapshot.buckets)
+        {
+            cumulative += bucket.count;
+            text += histogram.name;
+            text += "_bucket{le=\"";
+            appendNumber(text, bucket.upperBound);
+            text += "\"} ";
+            appendNumber(text, cumulative);
+            text += '\n';
+        }
+        text += histogram.name;
+        text += "_bucket{le=\"+Inf\"} ";
+        appendNumber(text, histogram.snapshot.count);
+        text += '\n';
+        text += histogram.name;
+        text += "_sum ";
+        appendNumber(text, histogram.snapshot.sum);
+        text += '\n';
+        text += histogram.name;
+        text += "_count ";
+        appendNumber(text, histogram.snapshot.count);
+        text += '\n';
+    }
+
+    // One family per node counter, a series per node
+    static const std::pair<const char *, uint64_t Registry::NodeValue::*> nodeFamilies[] = {
+        {"iot_node_messages_in_total", &Registry::NodeValue::messagesIn},
+        {"iot_node_bytes_in_total", &Registry::NodeValue::bytesIn},
+        {"iot_node_messages_out_total", &Registry::NodeValue::messagesOut},
+        {"iot_node_bytes_out_total", &Registry::NodeValue::bytesOut},
+    };
+    for(const auto &[name, member] : nodeFamilies)
+    {
+        if(snapshot.nodes.empty())
+            break;
+
+        appendHeader(text, name, "Traffic of a single node, node 0 is every node before it registered", "counter");
+        for(const Registry::NodeValue &node : snapshot.nodes)
+        {
+            text += name;
+            text += "{node=\"";
+            appendNumber(text, node.nodeId);
+            text += "\"} ";
+            appendNumber(text, node.*member);
+            text += '\n';
+        }
+    }
+    return text;
+}
+
+std::vector<uint8_t> Exporter::renderBinary(const Registry::Snapshot &snapshot)
+{
+    PayloadWriter writer;
+    writer.write(snapshot.timestamp);
+    writer.write(static_cast<uint32_t>(snapshot.counters.size()));
+    writer.write(static_cast<uint32_t>(snapshot.gauges.size()));
+    writer.write(static_cast<uint32_t>(snapshot.histograms.size()));
+    writer.write(static_cast<uint32_t>(snapshot.nodes.size()));
+
+    for(const auto &counter : snapshot.counters)
+    {
+        writer.writeString<uint8_t>(counter.name);
+        writer.write(counter.value);
+    }
+    for(const auto &gauge : snapshot.gauges)
+    {
+        writer.writeString<uint8_t>(gauge.name);
+        writer.write(gauge.value);
+    }
+    for(const auto &histogram : snapshot.histograms)
+    {
+        writer.writeString<uint8_t>(histogram.name);
+        writer.write(histogram.snapshot.count);
+        writer.write(histogram.snapshot.sum);
+        writer.write(static_cast<uint16_t>(histogram.snapshot.buckets.size()));
+        for(const Histogram::Bucket &bucket : histogram.snapshot.buckets)
+        {
+            writer.write(bucket.upperBound);
+            writer.write(bucket.count);
+        }
+    }
+    for(const Registry::NodeValue &node : snapshot.nodes)
+    {
+        writer.write(node.nodeId);
+        writer.write(node.messagesIn);
+        writer.write(node.bytesIn);
+        writer.write(node.messagesOut);
+        writer.write(node.bytesOut);
+    }
+    return std::vector<uint8_t>(writer.getPointer(), writer.getPointer() + writer.getLen());
+}
+} // namespace Metrics
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "registry.hpp"
+#include "utilities/logger.hpp"
+
+namespace Metrics
+{
+/* Takes a registry snapshot every interval on a thread of its own and publishes it rendered as Prometheus text and in
+ * binary form. Readers only copy a shared pointer to the latest publication, rendering never blocks them.
+ *
+ * With a socket path the text is served over HTTP on a Unix domain socket, one response per connection:
+ *     curl --unix-socket iot-metrics.sock http://localhost/metrics
+ * and the kept message traces of the Tracer as Chrome trace event JSON:
+ *     curl --unix-socket iot-metrics.sock http://localhost/trace > trace.json
+ *
+ * Binary form, little endian, the server node sends it in MetricsPage messages:
+ *
+ * | Timestamp (8) | Counters num (4) | Gauges num (4) | Histograms num (4) | Nodes num (4) |
+ * | Counters | Gauges | Histograms | Nodes |
+ *
+ * Counter:   | Name len (1) | Name | Value (8) |
+ * Gauge:     | Name len (1) | Name | Value (8, signed) |
+ * Histogram: | Name len (1) | Name | Count (8) | Sum (8) | Buckets num (2) | Upper bound (8) | Count (8) | ... |
+ * Node:      | Node ID (4) | Messages in (8) | Bytes in (8) | Messages out (8) | Bytes out (8) |
+ *
+ * Histogram buckets are the non-empty ones in ascending order with their own counts, not cumulative.
+ */
+class Exporter
+{
+public:
+    struct Config
+    {
+        std::string               socketPath = "iot-metrics.sock"; // Empty for no socket
+        std::chrono::milliseconds interval   = std::chrono::seconds(1);
+    };
+
+    struct Publication
+    {
+        Registry::Snapshot   snapshot;
+        std::string          text;
+        std::vector<uint8_t> binary;
+    };
+
+    Exporter() = delete;
+    Exporter(const Config &config);
+    ~Exporter();
+
+    // Latest publication, a snapshot is taken by the constructor so there always is one
+    std::shared_ptr<const Publication> getPublication() const;
+
+    static std::string          renderText(const Registry::Snapshot &snapshot);
+    static std::vector<uint8_t> renderBinary(const Registry::Snapshot &snapshot);
+
+private:
+    using LogLevel = Utilities::Logger::LogLevel;
+
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::Metrics;
+
+    static constexpr size_t maxRequestLen = 8 * 1024;
+
+    Config                             config;
+    int                                socketFd      = -1;
+    std::atomic<bool>                  inDestruction = false;
+    std::thread                        exporterThread;
+    mutable std::mutex                 publicationMutex; // Only held to copy the pointer
+    std::shared_ptr<const Publication> publication;
+
+    static void exporterThreadProcess(Exporter *self);
+
+    void publish();
+    void serveClient(int clientFd) const;
+};
+} // namespace Metrics
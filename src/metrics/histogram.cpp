@@ -0,0 +1,50 @@
+#include "histogram.hpp"
+
+namespace Metrics
+{
+Histogram::Histogram() : shards(new Shard[shardsNum])
+{
+}
+
+Histogram::~Histogram()
+{
+    delete[] shards;
+}
+
+Histogram::Snapshot Histogram::getSnapshot() const
+{
+    Snapshot snapshot;
+    for(size_t index = 0; index < bucketsNum; index++)
+    {
+        uint64_t count = 0;
+        for(size_t shard = 0; shard < shardsNum; shard++)
+            count += shards[shard].buckets[index].load(std::memory_order_relaxed);
+
+        if(count > 0)
+        {
+            snapshot.buckets.push_back(Bucket{getUpperBound(index), count});
+            snapshot.count += count;
+        }
+    }
+    for(size_t shard = 0; shard < shardsNum; shard++)
+        snapshot.sum += shards[shard].sum.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t Histogram::Snapshot::getQuantile(double quantile) const
+{
+    if(count == 0)
+        return 0;
+
+    // Rank of the value, 1 based, the smallest value for quantile 0
+    uint64_t rank = std::clamp<uint64_t>(uint64_t(quantile * count + 0.5), 1, count);
+    uint64_t seen = 0;
+    for(const Bucket &bucket : buckets)
+    {
+        seen += bucket.count;
+        if(seen >= rank)
+            return bucket.upperBound;
+    }
+    return getMax();
+}
+} // namespace Metrics
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "counter.hpp"
+
+namespace Metrics
+{
+/* High dynamic range histogram of nanosecond values in log-linear buckets: values below 64 have a bucket each, every
+ * power of two above is split into 64 buckets, so a bucket is at most 1/64 (1.6 %) of its values wide. Values up to
+ * 2^40 ns (18 minutes) are tracked, larger ones count as the largest. Recording increments one bucket and the sum of
+ * the calling thread's shard, both wait-free.
+ */
+class Histogram
+{
+public:
+    static constexpr unsigned subBucketBits = 6;
+    static constexpr uint64_t subBucketsNum = uint64_t(1) << subBucketBits;
+    static constexpr unsigned maxValueBits  = 40;
+    static constexpr uint64_t maxValue      = (uint64_t(1) << maxValueBits) - 1;
+    static constexpr size_t   bucketsNum    = (maxValueBits - subBucketBits + 1) * subBucketsNum;
+
+    struct Bucket
+    {
+        uint64_t upperBound; // Highest value of the bucket
+        uint64_t count;
+    };
+
+    // Merged shards, only non-empty buckets in ascending order
+    struct Snapshot
+    {
+        uint64_t            count = 0;
+        uint64_t            sum   = 0;
+        std::vector<Bucket> buckets;
+
+        // Upper bound of the bucket holding the value at quantile (0..1), 0 without values
+        uint64_t getQuantile(double quantile) const;
+        uint64_t getMax() const { return buckets.empty() ? 0 : buckets.back().upperBound; }
+        double   getMean() const { return count > 0 ? double(sum) / count : 0; }
+    };
+
+    Histogram();
+    ~Histogram();
+
+    Histogram(const Histogram &)            = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    void record(uint64_t value)
+    {
+        Shard &shard = shards[getShardIndex()];
+        shard.buckets[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void record(std::chrono::nanoseconds duration) { record(uint64_t(std::max<int64_t>(duration.count(), 0))); }
+
+    Snapshot getSnapshot() const;
+
+    static size_t getBucketIndex(uint64_t value)
+    {
+        if(value < subBucketsNum)
+            return value;
+        if(value > maxValue)
+            value = maxValue;
+
+        unsigned shift = 63 - __builtin_clzll(value) - subBucketBits;
+        return (shift + 1) * subBucketsNum + (value >> shift) - subBucketsNum;
+    }
+
+    static uint64_t getUpperBound(size_t index)
+    {
+        if(index < subBucketsNum)
+            return index;
+
+        unsigned shift = index / subBucketsNum - 1;
+        return (((index % subBucketsNum + subBucketsNum) + 1) << shift) - 1;
+    }
+
+private:
+    struct alignas(cacheLineSize) Shard
+    {
+        std::atomic<uint64_t> sum = 0;
+        std::atomic<uint64_t> buckets[bucketsNum];
+    };
+
+    Shard *shards; // shardsNum of them, too large for the stack of a thread that creates a histogram
+};
+} // namespace Metrics
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "registry.hpp"
+
+namespace Metrics
+{
+Registry::Metrics &Registry::getMetrics()
+{
+    // Never destroyed, threads may still record while static objects are destructed at exit
+    static Metrics *metrics = new Metrics();
+    return *metrics;
+}
+
+template <typename Metric>
+Metric &
+    Registry::getMetric(std::map<std::string, Entry<Metric>> &entries, const std::string &name, const std::string &help)
+{
+    auto entry = entries.find(name);
+    if(entry == entries.end())
+    {
+        entry = entries.emplace(name, Entry<Metric>{help, std::make_unique<Metric>()}).first;
+    }
+    return *entry->second.metric;
+}
+
+Counter &Registry::getCounter(const std::string &name, const std::string &help)
+{
+    Metrics                    &metrics = getMetrics();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    return getMetric(metrics.counters, name, help);
+}
+
+Gauge &Registry::getGauge(const std::string &name, const std::string &help)
+{
+    Metrics                    &metrics = getMetrics();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    return getMetric(metrics.gauges, name, help);
+}
+
+Histogram &Registry::getHistogram(const std::string &name, const std::string &help)
+{
+    Metrics                    &metrics = getMetrics();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    return getMetric(metrics.histograms, name, help);
+}
+
+NodeCounters &Registry::getNodeCounters(uint32_t nodeId)
+{
+    Metrics                    &metrics = getMetrics();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+
+    NodeCounters *&counters = metrics.nodeIndex[nodeId];
+    if(counters == nullptr)
+    {
+        size_t index = metrics.nodesNum.load(std::memory_order_relaxed);
+        size_t chunk = index / nodeChunkLen;
+        if(chunk >= maxNodeChunks)
+        {
+            metrics.nodeIndex.erase(nodeId);
+            throw std::runtime_error("Too many nodes in Metrics::Registry::getNodeCounters");
+        }
+        if(metrics.nodeChunks[chunk].load(std::memory_order_relaxed) == nullptr)
+        {
+            metrics.nodeChunks[chunk].store(new NodeCounters[nodeChunkLen], std::memory_order_relaxed);
+        }
+
+        counters         = &metrics.nodeChunks[chunk].load(std::memory_order_relaxed)[index % nodeChunkLen];
+        counters->nodeId = nodeId;
+        metrics.nodesNum.store(index + 1, std::memory_order_release);
+    }
+    return *counters;
+}
+
+Registry::Snapshot Registry::getSnapshot()
+{
+    Snapshot snapshot;
+    snapshot.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+    // The lock only keeps new metrics out, recording goes on while the values are read
+    Metrics &metrics = getMetrics();
+    {
+        std::lock_guard<std::mutex> lock(metrics.mutex);
+        for(const auto &[name, entry] : metrics.counters)
+            snapshot.counters.push_back(CounterValue{name, entry.help, entry.metric->getValue()});
+        for(const auto &[name, entry] : metrics.gauges)
+            snapshot.gauges.push_back(GaugeValue{name, entry.help, entry.metric->getValue()});
+        for(const auto &[name, entry] : metrics.histograms)
+            snapshot.histograms.push_back(HistogramValue{name, entry.help, entry.metric->getSnapshot()});
+    }
+
+    size_t nodesNum = metrics.nodesNum.load(std::memory_order_acquire);
+    snapshot.nodes.reserve(nodesNum);
+    for(size_t index = 0; index < nodesNum; index++)
+    {
+        const NodeCounters &counters =
+            metrics.nodeChunks[index / nodeChunkLen].load(std::memory_order_relaxed)[index % nodeChunkLen];
+        snapshot.nodes.push_back(NodeValue{counters.nodeId,
+                                           counters.messagesIn.load(std::memory_order_relaxed),
+                                           counters.bytesIn.load(std::memory_order_relaxed),
+                                           counters.messagesOut.load(std::memory_order_relaxed),
+                                           counters.bytesOut.load(std::memory_order_relaxed)});
+    }
+    return snapshot;
+}
+} // namespace Metrics
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "counter.hpp"
+#include "histogram.hpp"
+
+namespace Metrics
+{
+/* Named metrics of the process. Metrics are created on first use and live until exit, hot paths look them up once
+ * and keep the reference, recording never touches the registry. Names follow the Prometheus conventions, e.g.
+ * "iot_messages_routed_total" for a counter and a unit suffix like "_nanoseconds" for a histogram.
+ *
+ * Node counters are kept in chunks that are only appended to, snapshots read them without the lock, so a snapshot of
+ * many nodes does not hold up the registration of a node.
+ */
+class Registry
+{
+public:
+    struct CounterValue
+    {
+        std::string name;
+        std::string help;
+        uint64_t    value;
+    };
+
+    struct GaugeValue
+    {
+        std::string name;
+        std::string help;
+        int64_t     value;
+    };
+
+    struct HistogramValue
+    {
+        std::string         name;
+        std::string         help;
+        Histogram::Snapshot snapshot;
+    };
+
+    struct NodeValue
+    {
+        uint32_t nodeId;
+        uint64_t messagesIn;
+        uint64_t bytesIn;
+        uint64_t messagesOut;
+        uint64_t bytesOut;
+    };
+
+    // Values of every metric, sorted by name, nodes in the order of their first use
+    struct Snapshot
+    {
+        uint64_t                    timestamp; // Nanoseconds since epoch
+        std::vector<CounterValue>   counters;
+        std::vector<GaugeValue>     gauges;
+        std::vector<HistogramValue> histograms;
+        std::vector<NodeValue>      nodes;
+    };
+
+    // help is kept from the first call for a name
+    static Counter &  getCounter(const std::string &name, const std::string &help);
+    static Gauge &    getGauge(const std::string &name, const std::string &help);
+    static Histogram &getHistogram(const std::string &name, const std::string &help);
+
+    // Counters of a node id, node id 0 collects the nodes that are not registered yet
+    static NodeCounters &getNodeCounters(uint32_t nodeId);
+
+    static Snapshot getSnapshot();
+
+private:
+    template <typename Metric>
+    struct Entry
+    {
+        std::string             help;
+        std::unique_ptr<Metric> metric;
+    };
+
+    static constexpr size_t nodeChunkLen  = 1024;
+    static constexpr size_t maxNodeChunks = 4096;
+
+    struct Metrics
+    {
+        std::mutex                                   mutex; // Guards everything but the node chunks
+        std::map<std::string, Entry<Counter>>        counters;
+        std::map<std::string, Entry<Gauge>>          gauges;
+        std::map<std::string, Entry<Histogram>>      histograms;
+        std::unordered_map<uint32_t, NodeCounters *> nodeIndex;
+        std::atomic<NodeCounters *>                  nodeChunks[maxNodeChunks] = {};
+        std::atomic<size_t>                          nodesNum                  = 0; // Published once a node is set up
+    };
+
+    static Metrics &getMetrics();
+
+    template <typename Metric>
+    static Metric &getMetric(std::map<std::string, Entry<Metric>> &entries,
+                             const std::string                    &name,
+                             const std::string                    &help);
+};
+} // namespace Metrics
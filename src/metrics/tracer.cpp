@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "registry.hpp"
+#include "tracer.hpp"
+
+namespace Metrics
+{
+namespace
+{
+// Span from a stage to the next one
+struct Span
+{
+    const char *name;
+    Histogram  &histogram;
+};
+
+Span *getSpans()
+{
+    static Span spans[Trace::StagesNum - 1] = {
+        {"parse", Registry::getHistogram("iot_trace_parse_nanoseconds", "Traced messages, read to queued")},
+        {"queue", Registry::getHistogram("iot_trace_queue_nanoseconds", "Traced messages, waiting in the event queue")},
+        {"handle",
+         Registry::getHistogram("iot_trace_handle_nanoseconds", "Traced messages, dequeued to destination looked up")},
+        {"send", Registry::getHistogram("iot_trace_send_nanoseconds", "Traced messages, written or handled")},
+    };
+    return spans;
+}
+
+Histogram &getTotalHistogram()
+{
+    static Histogram &total = Registry::getHistogram("iot_trace_total_nanoseconds", "Traced messages, read to sent");
+    return total;
+}
+
+std::mutex         tracesMutex; // Guards the members below
+std::vector<Trace> traces;      // Ring of the latest finished traces
+size_t             nextTrace = 0;
+} // namespace
+
+Trace Tracer::begin(uint64_t readTime, uint32_t sourceId)
+{
+    Trace trace;
+    if(readTime != 0)
+    {
+        trace.id                      = nextTraceId.fetch_add(1, std::memory_order_relaxed);
+        trace.sourceId                = sourceId;
+        trace.timestamps[Trace::Read] = readTime;
+    }
+    return trace;
+}
+
+void Tracer::finish(const Trace &trace)
+{
+    if(!trace.isActive())
+        return;
+
+    // Stages that were not reached, e.g. the send of an undeliverable message, leave their spans out
+    Span *spans = getSpans();
+    for(size_t stage = 0; stage + 1 < Trace::StagesNum; stage++)
+    {
+        if(trace.timestamps[stage] != 0 && trace.timestamps[stage + 1] != 0)
+            spans[stage].histogram.record(trace.timestamps[stage + 1] - trace.timestamps[stage]);
+    }
+    if(trace.timestamps[Trace::Send] != 0)
+    {
+        getTotalHistogram().record(trace.timestamps[Trace::Send] - trace.timestamps[Trace::Read]);
+    }
+
+    std::lock_guard<std::mutex> lock(tracesMutex);
+    if(traces.size() < keptTracesNum)
+    {
+        traces.push_back(trace);
+    }
+    else
+    {
+        traces[nextTrace] = trace;
+    }
+    nextTrace = (nextTrace + 1) % keptTracesNum;
+}
+
+std::string Tracer::renderChromeTrace()
+{
+    std::vector<Trace> kept;
+    {
+        std::lock_guard<std::mutex> lock(tracesMutex);
+        kept.reserve(traces.size());
+        size_t first = traces.size() < keptTracesNum ? 0 : nextTrace;
+        for(size_t i = 0; i < traces.size(); i++)
+            kept.push_back(traces[(first + i) % traces.size()]);
+    }
+
+    // Complete events ("X") per span in microseconds, one thread per source node
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char        event[256];
+    bool        first = true;
+    Span       *spans = getSpans();
+    for(const Trace &trace : kept)
+    {
+        for(size_t stage = 0; stage + 1 < Trace::StagesNum; stage++)
+        {
+            if(trace.timestamps[stage] == 0 || trace.timestamps[stage + 1] == 0)
+                continue;
+
+            int len = snprintf(event,
+                               sizeof(event),
+                               "%s{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,"
+                               "\"tid\":%u,\"args\":{\"trace\":%llu,\"destination\":%u}}",
+                               first ? "" : ",",
+                               spans[stage].name,
+                               trace.timestamps[stage] / 1e3,
+                               (trace.timestamps[stage + 1] - trace.timestamps[stage]) / 1e3,
+                               trace.sourceId,
+                               static_cast<unsigned long long>(trace.id),
+                               trace.destinationId);
+            json.append(event, len);
+            first = false;
+        }
+    }
+    json += "]}\n";
+    return json;
+}
+} // namespace Metrics
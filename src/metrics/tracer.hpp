@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Metrics
+{
+// Timestamps of one sampled message on its way through the server, steady clock nanoseconds
+struct Trace
+{
+    enum Stage : uint8_t
+    {
+        Read = 0, // read() of the node data thread returned
+        Enqueue,  // Queued for the event handler
+        Dequeue,  // Taken by the event handler
+        Route,    // Destination looked up, right before it is sent or handled by the server node
+        Send,     // Written to the destination or handled by the server node
+        StagesNum
+    };
+
+    uint64_t id                    = 0; // 0 if the message is not traced
+    uint32_t sourceId              = 0;
+    uint32_t destinationId         = 0;
+    uint64_t timestamps[StagesNum] = {};
+
+    bool isActive() const { return id != 0; }
+    void mark(Stage stage);
+};
+
+/* Per message tracing of 1 in sampleInterval messages. When it is off a node data thread pays one relaxed load per
+ * message. Finished traces are recorded in a histogram per stage ("iot_trace_<span>_nanoseconds", from a stage to the
+ * next one) and the latest ones are kept for export as Chrome trace event JSON, e.g. for chrome://tracing or
+ * ui.perfetto.dev, every source node is a thread there.
+ */
+class Tracer
+{
+public:
+    // 0 turns tracing off
+    static void     setSampleInterval(uint32_t interval) { sampleInterval = interval; }
+    static uint32_t getSampleInterval() { return sampleInterval; }
+
+    // True for every sampleInterval-th call of a thread
+    static bool sample()
+    {
+        uint32_t interval = sampleInterval.load(std::memory_order_relaxed);
+        if(interval == 0)
+            return false;
+
+        thread_local uint32_t calls = 0;
+        return ++calls % interval == 0;
+    }
+
+    static uint64_t getNow()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Starts a trace at readTime, an inactive one if readTime is 0
+    static Trace begin(uint64_t readTime, uint32_t sourceId);
+
+    // Records the spans between the marked stages and keeps the trace for export
+    static void finish(const Trace &trace);
+
+    // The kept traces, oldest first
+    static std::string renderChromeTrace();
+
+private:
+    static constexpr size_t keptTracesNum = 4096;
+
+    inline static std::atomic<uint32_t> sampleInterval = 0;
+    inline static std::atomic<uint64_t> nextTraceId    = 1;
+};
+
+inline void Trace::mark(Stage stage)
+{
+    if(id != 0)
+        timestamps[stage] = Tracer::getNow();
+}
+} // namespace Metrics
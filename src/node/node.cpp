@@ -1,41 +1,62 @@
-#include <iomanip>
-#include <sys/socket.h>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sstream>
 
 #include "node.hpp"
 #include "message/message.hpp"
 
 Node::Node(const int &fd, const char ip[], MessageCallback messageCallback, DisconnectedCallback disconnectedCallback) :
-    fd(fd), ip(ip), messageCallback(messageCallback), disconnectedCallback(disconnectedCallback)
+    Node(std::make_unique<SocketTransport>(fd), ip, messageCallback, disconnectedCallback)
 {
-    log("Node created: " + toString(), LogLevel::Debug);
+}
+
+Node::Node(std::unique_ptr<Transport> transport,
+           const std::string         &ip,
+           MessageCallback            messageCallback,
+           DisconnectedCallback       disconnectedCallback) :
+    transport(std::move(transport)),
+    outbox(std::make_shared<Outbox>(this->transport.get())),
+    ip(ip),
+    messageCallback(messageCallback),
+    disconnectedCallback(disconnectedCallback)
+{
+    LOG_FORMAT(LogLevel::Debug, "Node created: {}", toString());
 }
 
 Node::~Node()
 {
-    log("Destructing node: " + toString(), LogLevel::Debug);
+    LOG_FORMAT(LogLevel::Debug, "Destructing node: {}", toString());
     inDestruction = true;
 
-    shutdown(fd, SHUT_RD);
+    transport->shutdownRead();
 
     if(dataThread.joinable())
     {
-        log("Joining data thread", LogLevel::Debug);
+        LOG_MESSAGE(LogLevel::Debug, "Joining data thread");
         dataThread.join();
     }
+    malformedFrames.endSource(malformedFrameSource, "node " + ip);
+    outbox->close();
+    transport.reset();
 
-    log("Destructor finished", LogLevel::Debug);
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
 }
 
 void Node::start()
 {
-    log("Node started: " + toString(), LogLevel::Debug);
-    dataThread = std::thread(dataThreadProcessor, this);
+    LOG_FORMAT(LogLevel::Debug, "Node started: {}", toString());
+    if(transport->hasReader())
+    {
+        reading    = true;
+        dataThread = std::thread(dataThreadProcessor, this);
+    }
 }
 
 std::string Node::toString() const
 {
     std::stringstream ss;
-    ss << "fd=" << fd << ", ip=" << ip << ", registered=";
+    ss << transport->toString() << ", ip=" << ip << ", registered=";
 
     if(registered)
         ss << "true, id=" << id << ", name=" << name << ", type=" << type << ", description=" << description;
@@ -45,61 +66,221 @@ std::string Node::toString() const
     return ss.str();
 }
 
+void Node::setRegistration(uint32_t           id,
+                           const std::string &name,
+                           const std::string &type,
+                           const std::string &description)
+{
+    this->id          = id;
+    this->name        = name;
+    this->type        = type;
+    this->description = description;
+    registered        = true;
+    nodeCounters      = &Metrics::Registry::getNodeCounters(id);
+}
+
 void Node::dataThreadProcessor(Node *self)
 {
-    uint8_t data[Message::maxMessageLen] = {0};
+    // Room for two frames keeps a partial one from blocking the next read
+    self->input.resize(2 * Message::maxMessageLen);
     while(!self->inDestruction)
     {
-        int len = read(self->fd, data, Message::maxMessageLen);
+        ssize_t len = self->transport->read(self->input.data() + self->inputLen, self->input.size() - self->inputLen);
         if(len > 0)
         {
-            try
-            {
-                Message msg(data, len);
-                self->messageCallback(self, msg);
-            }
-            catch(const std::exception &e)
-            {
-                self->log("Unable to create message from incoming data: " + std::string(e.what()), LogLevel::Warning);
-
-                std::stringstream ss;
-                ss << "Number of bytes=" << len;
-                if(len <= static_cast<int>(Message::maxMessageLen))
-                {
-                    ss << ", raw data: ";
-                    ss << std::hex << std::uppercase << std::setfill('0');
-                    for(int i = 0; i < len; i++)
-                    {
-                        ss << std::setw(2) << (int)data[i] << " ";
-                    }
-                }
-
-                self->log(ss.str(), LogLevel::Debug);
-            }
+            self->inputLen += len;
+            self->received(len);
         }
         else if(len == 0)
         {
-            self->disconnectedCallback(self);
-            return;
+            self->closed();
+            break;
         }
         else
         {
-            // Reading incoming data timed out, do nothing
+            // Reading incoming data timed out or was interrupted by stopReading, do nothing
         }
     }
+    self->reading = false;
 }
 
+bool Node::stopReading()
+{
+    if(!transport->isMovable())
+        return false;
 
-void Node::sendMessage(const Message &message) const
+    // The blocking read is interrupted by a signal without handler action, the thread then sees inDestruction. The
+    // signal may arrive before the thread is in the read, so it is repeated until the thread is done.
+    static std::once_flag handlerInstalled;
+    std::call_once(handlerInstalled, [] {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = [](int) {};
+        sigemptyset(&action.sa_mask);
+        sigaction(readInterruptSignal, &action, nullptr); // Without SA_RESTART
+    });
+
+    inDestruction = true;
+    if(dataThread.joinable())
+    {
+        while(reading)
+        {
+            pthread_kill(dataThread.native_handle(), readInterruptSignal);
+            std::this_thread::yield();
+        }
+        dataThread.join();
+    }
+    return true;
+}
+
+int Node::releaseSocket(std::vector<uint8_t> &pending)
+{
+    if(!transport->isMovable() || dataThread.joinable())
+        return -1;
+
+    // Frames still queued for the node are dropped, the new process does not know them
+    pending.assign(input.data(), input.data() + inputLen);
+    inputLen = 0;
+    outbox->close();
+    return transport->releaseFd();
+}
+
+void Node::writeWithFds(const uint8_t *data, size_t len, const std::vector<int> &fds) const
+{
+    transport->writeWithFds(data, len, fds);
+}
+
+void Node::receive(const uint8_t *data, size_t len)
+{
+    if(input.size() < inputLen + len)
+    {
+        input.resize(inputLen + len);
+    }
+    memcpy(input.data() + inputLen, data, len);
+    inputLen += len;
+    received(len);
+}
+
+void Node::receiveClose()
+{
+    closed();
+}
+
+void Node::received(size_t len)
+{
+    traceReadTime = Metrics::Tracer::sample() ? Metrics::Tracer::getNow() : 0;
+    bytesReceived.add(len);
+    if(trafficCapture != nullptr)
+    {
+        trafficCapture->record(connectionId, input.data() + inputLen - len, len);
+    }
+
+    // A packet is a frame, nothing to split
+    if(transport->keepsFrames())
+    {
+        handleFrame(input.data() + inputLen - len, len);
+        inputLen -= len;
+        return;
+    }
+
+    // A read may end inside a frame or hold several, frames are split by their length field
+    size_t offset = 0;
+    while(inputLen - offset >= sizeof(uint32_t))
+    {
+        uint32_t frameLen = 0;
+        Utilities::Endian::Instance().readWithEndianness(frameLen, input.data() + offset, Message::messageEndianness);
+        if(frameLen < Message::overheadLen || frameLen > Message::maxMessageLen)
+        {
+            // Without a valid length there is no telling where the next frame starts, the data is dropped
+            rejectFrame(input.data() + offset, inputLen - offset, "Invalid frame length");
+            offset = inputLen;
+            break;
+        }
+        if(inputLen - offset < frameLen)
+            break;
+
+        handleFrame(input.data() + offset, frameLen);
+        offset += frameLen;
+    }
+    memmove(input.data(), input.data() + offset, inputLen - offset);
+    inputLen -= offset;
+}
+
+void Node::closed()
 {
-    if(fd < 0)
+    if(trafficCapture != nullptr)
     {
-        throw std::runtime_error("Invalid fd in Node::sendMessage");
+        trafficCapture->recordClose(connectionId);
     }
 
-    size_t len = write(fd, message.getMessagePointer(), message.getMessageLen());
-    if(len != message.getMessageLen())
+    // Reading is shut down by the destructor as well, the node is already being removed then
+    if(!inDestruction)
     {
-        throw std::runtime_error("len != message.getMessageLen() in Node::sendMessage");
+        disconnectedCallback(this);
     }
-}
\ No newline at end of file
+}
+
+void Node::handleFrame(const uint8_t *data, size_t len)
+{
+    try
+    {
+        Message msg(data, len);
+        messagesReceived.add();
+        nodeCounters.load(std::memory_order_relaxed)->addIn(len);
+        messageCallback(this, msg);
+    }
+    catch(const std::exception &e)
+    {
+        rejectFrame(data, len, e.what());
+    }
+}
+
+void Node::rejectFrame(const uint8_t *data, size_t len, const char *reason)
+{
+    malformedFramesReceived.add();
+
+    // The complete frame goes to the quarantine ring, the log only gets a sample with an excerpt
+    if(quarantineRing != nullptr)
+    {
+        quarantineRing->store(id, data, len);
+    }
+    if(malformedFrames.sample(malformedFrameSource))
+    {
+        LOG_FORMAT(LogLevel::Warning,
+                   "Unable to create message from incoming data of {}: {}, {} bytes: {}",
+                   ip,
+                   reason,
+                   len,
+                   Utilities::Diagnostic::toHex(data, len));
+    }
+}
+
+void Node::sendMessage(const Message &message) const
+{
+    outbox->write(message.getMessagePointer(), message.getMessageLen());
+    countSent(message.getMessageLen());
+}
+
+void Node::sendMessage(GatherMessage &message) const
+{
+    std::vector<iovec> vector = message.encode();
+    size_t             len    = 0;
+    for(const iovec &piece : vector)
+        len += piece.iov_len;
+    outbox->writev(vector);
+    countSent(len);
+}
+
+void Node::sendFile(int fileFd, off_t offset, size_t len) const
+{
+    bytesSent.add(len);
+    nodeCounters.load(std::memory_order_relaxed)->bytesOut.fetch_add(len, std::memory_order_relaxed);
+    outbox->sendFile(fileFd, offset, len);
+}
+
+void Node::countSent(size_t len) const
+{
+    messagesSent.add();
+    bytesSent.add(len);
+    nodeCounters.load(std::memory_order_relaxed)->addOut(len);
+}
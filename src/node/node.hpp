@@ -1,13 +1,24 @@
 #pragma once
 
+#include <atomic>
+#include <csignal>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <thread>
 #include <functional>
 
 #include "nodeInterface.hpp"
+#include "outbox.hpp"
+#include "transport.hpp"
 #include "message/message.hpp"
+#include "message/gatherMessage.hpp"
+#include "metrics/registry.hpp"
+#include "metrics/tracer.hpp"
+#include "utilities/diagnostics.hpp"
 #include "utilities/logger.hpp"
+#include "utilities/quarantineRing.hpp"
+#include "utilities/trafficCapture.hpp"
 
 class Node;
 typedef std::function<void(const Node *, const Message &)> MessageCallback;
@@ -17,29 +28,69 @@ class Node
 {
 public:
     Node(const int &fd, const char ip[], MessageCallback messageCallback, DisconnectedCallback disconnectedCallback);
+    Node(std::unique_ptr<Transport> transport,
+         const std::string         &ip,
+         MessageCallback            messageCallback,
+         DisconnectedCallback       disconnectedCallback);
     ~Node();
 
     bool isRegistered() const { return registered; }
-    void setRegistered(bool registered) { registered = registered; }
+    void setRegistered(bool newRegistered) { registered = newRegistered; }
+    void setRegistration(uint32_t id, const std::string &name, const std::string &type, const std::string &description);
     // void setInterface(const DeviceInterface::DeviceInterface &nodeInterface) { interface = nodeInterface; }
 
-    void        start();
-    uint32_t    getId() const { return id; }
-    std::string getName() const { return name; }
-    std::string getType() const { return type; }
+    void               start();
+    uint32_t           getId() const { return id; }
+    std::string        getName() const { return name; }
+    const std::string &getType() const { return type; }
     std::string getDescription() const { return description; }
     // DeviceInterface::DeviceInterface getInterface() const { return interface; }
 
+    std::string getIp() const { return ip; }
     std::string toString() const;
+    uint64_t    getTraceReadTime() const { return traceReadTime; } // Of the message passed to messageCallback
     void        sendMessage(const Message &message) const;
+    void        sendMessage(GatherMessage &message) const;
+    void        sendFile(int fileFd, off_t offset, size_t len) const; // Raw bytes of a file, not framed
+
+    // Every write goes through the outbox, fan-out frames are queued to it, see server/fanOut.hpp
+    const std::shared_ptr<Outbox> &getOutbox() const { return outbox; }
+
+    // Data of a transport without a reader, e.g. of a simulated node, is passed in by the owner of its other end
+    void receive(const uint8_t *data, size_t len);
+    void receiveClose();
+
+    /* Handoff of the connection to another server process, see Server::takeOver. stopReading ends the data thread
+     * without closing the socket, false if the transport can not be passed on. releaseSocket gives up the socket
+     * afterwards, pending gets the bytes of a partial frame read already. The node stays without transport.
+     */
+    bool stopReading();
+    int  releaseSocket(std::vector<uint8_t> &pending);
+
+    // Local connections, e.g. of a new server process, can get fds passed with SCM_RIGHTS
+    bool canPassFds() const { return transport->canPassFds(); }
+    bool getPeerUid(uid_t &uid) const { return transport->getPeerUid(uid); }
+    void writeWithFds(const uint8_t *data, size_t len, const std::vector<int> &fds) const;
+
+    // Malformed frames of all nodes are kept in ring, set before nodes are created
+    static void setQuarantineRing(Utilities::QuarantineRing *ring) { quarantineRing = ring; }
+
+    // Everything nodes send is recorded to capture, set before nodes are created
+    static void setTrafficCapture(Utilities::TrafficCapture *capture) { trafficCapture = capture; }
 
 private:
     Node()         = delete;
     using LogLevel = Utilities::Logger::LogLevel;
 
-    int         fd         = -1;
-    std::string ip         = "";
-    bool        registered = false;
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::Node;
+
+    static constexpr int readInterruptSignal = SIGUSR2; // Ends a blocking read for stopReading
+
+    std::unique_ptr<Transport> transport;
+    std::shared_ptr<Outbox>    outbox; // Shared with the fan-out writer that flushes it
+    std::string                ip           = "";
+    bool                       registered   = false;
+    uint32_t                   connectionId = nextConnectionId.fetch_add(1, std::memory_order_relaxed); // For capture
 
     // These fields are available after registering
     uint32_t    id            = 0;
@@ -49,14 +100,44 @@ private:
     std::string description   = "";
     // DeviceInterface::DeviceInterface interface;
 
-    bool                 inDestruction = false;
+    std::atomic<bool>    inDestruction = false; // Set by the event thread, read by the data thread
     std::thread          dataThread;
+    std::atomic<bool>    reading = false; // While the data thread runs
     MessageCallback      messageCallback;
     DisconnectedCallback disconnectedCallback;
 
+    // Received data up to the end of the last complete frame is handled, a partial frame stays until the rest arrives
+    std::vector<uint8_t> input;
+    size_t               inputLen = 0;
+
+    // A misbehaving node can send garbage as fast as it can, its malformed frames are logged sampled and rate limited
+    inline static Utilities::Diagnostic      malformedFrames{logModule, "Malformed frames"};
+    inline static Utilities::QuarantineRing *quarantineRing = nullptr;
+    Utilities::Diagnostic::Source             malformedFrameSource{malformedFrames};
+
+    inline static Utilities::TrafficCapture *trafficCapture   = nullptr;
+    inline static std::atomic<uint32_t>      nextConnectionId = 1;
+
+    // Traffic of all nodes and of this node, its counters move from node id 0 to its own id when it registers
+    inline static Metrics::Counter &messagesReceived =
+        Metrics::Registry::getCounter("iot_node_received_messages_total", "Messages received from nodes");
+    inline static Metrics::Counter &bytesReceived =
+        Metrics::Registry::getCounter("iot_node_received_bytes_total", "Bytes received from nodes");
+    inline static Metrics::Counter &malformedFramesReceived =
+        Metrics::Registry::getCounter("iot_node_malformed_frames_total", "Frames that were no valid message");
+    inline static Metrics::Counter &messagesSent =
+        Metrics::Registry::getCounter("iot_node_sent_messages_total", "Messages sent to nodes");
+    inline static Metrics::Counter &bytesSent =
+        Metrics::Registry::getCounter("iot_node_sent_bytes_total", "Bytes sent to nodes, including files");
+    std::atomic<Metrics::NodeCounters *> nodeCounters  = &Metrics::Registry::getNodeCounters(0);
+    uint64_t                             traceReadTime = 0; // 0 if the message is not sampled for tracing
+
     static void dataThreadProcessor(Node *self);
-    void        log(const std::string &message, LogLevel logLevel = LogLevel::Info) const
-    {
-        Utilities::Logger::logMessage("Node:: " + message, logLevel);
-    }
+
+    void received(size_t len); // The last len bytes of input
+    void closed();
+    void handleFrame(const uint8_t *data, size_t len);
+    void rejectFrame(const uint8_t *data, size_t len, const char *reason);
+
+    void countSent(size_t len) const;
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+#include "nodeDirectory.hpp"
+#include "message/payload.hpp"
+
+namespace
+{
+void writeNode(PayloadWriter &writer, uint32_t nodeId, const std::string &name, const std::string &type)
+{
+    writer.write(nodeId);
+    writer.writeString<uint8_t>(name);
+    writer.writeString<uint8_t>(type);
+}
+} // namespace
+
+NodeDirectory::NodeDirectory() :
+    version(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count())
+{
+}
+
+void NodeDirectory::set(uint32_t nodeId, const std::string &name, const std::string &type)
+{
+    auto [it, inserted] = entries.insert_or_assign(nodeId, Entry{name, type});
+    (void)it;
+    log(nodeId, inserted ? ChangeKind::Added : ChangeKind::Updated);
+}
+
+void NodeDirectory::remove(uint32_t nodeId)
+{
+    if(entries.erase(nodeId) > 0)
+        log(nodeId, ChangeKind::Removed);
+}
+
+void NodeDirectory::log(uint32_t nodeId, ChangeKind kind)
+{
+    version++;
+    changeLog.push_back({nodeId, kind});
+    if(changeLog.size() > logCapacity)
+        changeLog.pop_front();
+    full.reset();
+}
+
+std::shared_ptr<const std::vector<uint8_t>> NodeDirectory::getChanges(uint64_t sinceVersion)
+{
+    // The log holds the changes to versions oldest to version, it has to reach back to the one after sinceVersion
+    uint64_t oldest = version - changeLog.size() + 1;
+    if(sinceVersion > version || sinceVersion + 1 < oldest)
+    {
+        if(!full)
+            full = std::make_shared<const std::vector<uint8_t>>(serializeFull());
+        return full;
+    }
+
+    // The first change of a node since then tells whether the node was in the list at sinceVersion
+    size_t                             first = sinceVersion + 1 - oldest;
+    std::unordered_map<uint32_t, bool> wasListed(changeLog.size() - first);
+    for(size_t i = first; i < changeLog.size(); i++)
+        wasListed.try_emplace(changeLog[i].nodeId, changeLog[i].kind != ChangeKind::Added);
+
+    std::vector<uint32_t> added;
+    std::vector<uint32_t> updated;
+    std::vector<uint32_t> removed;
+    for(const auto &[nodeId, listed] : wasListed)
+    {
+        bool isListed = entries.contains(nodeId);
+        if(isListed)
+            (listed ? updated : added).push_back(nodeId);
+        else if(listed)
+            removed.push_back(nodeId);
+    }
+
+    PayloadWriter writer;
+    writer.write(version);
+    writer.write(uint8_t(0));
+    for(std::vector<uint32_t> *nodeIds : {&added, &updated})
+    {
+        std::sort(nodeIds->begin(), nodeIds->end());
+        writer.write(static_cast<uint32_t>(nodeIds->size()));
+        for(uint32_t nodeId : *nodeIds)
+        {
+            const Entry &entry = entries.at(nodeId);
+            writeNode(writer, nodeId, entry.name, entry.type);
+        }
+    }
+    std::sort(removed.begin(), removed.end());
+    writer.write(static_cast<uint32_t>(removed.size()));
+    for(uint32_t nodeId : removed)
+        writer.write(nodeId);
+    return std::make_shared<const std::vector<uint8_t>>(writer.getPointer(), writer.getPointer() + writer.getLen());
+}
+
+std::vector<uint8_t> NodeDirectory::serializeFull() const
+{
+    PayloadWriter writer;
+    writer.write(version);
+    writer.write(static_cast<uint8_t>(Full));
+    writer.write(static_cast<uint32_t>(entries.size()));
+    for(const auto &[nodeId, entry] : entries)
+        writeNode(writer, nodeId, entry.name, entry.type);
+    writer.write(uint32_t(0));
+    writer.write(uint32_t(0));
+    return std::vector<uint8_t>(writer.getPointer(), writer.getPointer() + writer.getLen());
+}
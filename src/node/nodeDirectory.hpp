@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Versioned list of the connected registered nodes for apps that keep a copy of it. Every change gets the next
+ * version and goes into a change log of the last logCapacity changes. An app that synced at version V asks for the
+ * changes since V and gets a delta: nodes added, nodes updated (e.g. resumed on a new connection or removed and back)
+ * and nodes removed since V, each node once with its current data. Changes that cancel out (connected and gone
+ * again) are left out. A full list is only sent when V is older than the log or not a version of this process.
+ *
+ * Versions start at the microseconds since epoch at construction, versions of a previous process are lower and get
+ * a full list. The full list of the current version is serialized once for every app asking.
+ *
+ * Serialized changes, little endian:
+ *
+ * | Version (8) | Flags (1) | Added num (4) | Nodes | Updated num (4) | Nodes | Removed num (4) | Node IDs (4 each) |
+ *
+ * Node: | Node ID (4) | Name len (1) | Name | Type len (1) | Type |
+ *
+ * With the Full flag the added nodes are all nodes and the app replaces its list.
+ */
+class NodeDirectory
+{
+public:
+    enum Flags : uint8_t
+    {
+        Full = 1 << 0,
+    };
+
+    static constexpr size_t logCapacity = 8192;
+
+    NodeDirectory();
+
+    // Added or updated, the node is connected and registered
+    void set(uint32_t nodeId, const std::string &name, const std::string &type);
+    void remove(uint32_t nodeId);
+
+    uint64_t getVersion() const { return version; }
+    size_t   getNodesNum() const { return entries.size(); }
+
+    std::shared_ptr<const std::vector<uint8_t>> getChanges(uint64_t sinceVersion);
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string type;
+    };
+
+    enum class ChangeKind : uint8_t
+    {
+        Added,
+        Updated,
+        Removed,
+    };
+
+    struct Change
+    {
+        uint32_t   nodeId;
+        ChangeKind kind;
+    };
+
+    std::map<uint32_t, Entry>                   entries; // By node ID
+    uint64_t                                    version;
+    std::deque<Change>                          changeLog; // Of versions version - size + 1 to version
+    std::shared_ptr<const std::vector<uint8_t>> full;      // Of the current version
+
+    void log(uint32_t nodeId, ChangeKind kind);
+
+    std::vector<uint8_t> serializeFull() const;
+};
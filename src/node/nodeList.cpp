@@ -1,10 +1,44 @@
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/random.h>
 
 #include "nodeList.hpp"
 #include "node.hpp"
 
 
+NodeList::NodeList(Database::RegistryStore *registryStore) : registryStore(registryStore)
+{
+    if(registryStore == nullptr)
+        return;
+
+    registryStore->load(records, nextNodeId);
+
+    // Records of the snapshot and of every log come with their own interface copies, share one per interface
+    std::unordered_map<const std::string *, std::shared_ptr<const std::string>> loaded;
+    for(auto &[id, record] : records)
+    {
+        if(record->interface == nullptr)
+            continue;
+
+        auto [it, inserted] = loaded.try_emplace(record->interface.get());
+        if(inserted)
+            it->second = internInterface(record->interface);
+        if(it->second != record->interface)
+        {
+            auto interned       = std::make_shared<NodeRecord>(*record);
+            interned->interface = it->second;
+            record              = std::move(interned);
+        }
+    }
+    for(const auto &[id, record] : records)
+        recordIds.try_emplace(getRecordKey(*record), id);
+    LOG_MESSAGE(LogLevel::Info, "Restored " + std::to_string(records.size()) + " node records");
+}
+
 void NodeList::addNode(const Node *node)
 {
     nodes.push_back(node);
@@ -15,15 +49,28 @@ void NodeList::removeNode(const Node *node)
 {
     if(node != nullptr)
     {
-        std::remove(nodes.begin(), nodes.end(), node);
+        nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+
+        // A resumed session may already have replaced this node in the registered nodes
+        auto it = registeredNodes.find(node->getId());
+        if(it != registeredNodes.end() && it->second == node)
+        {
+            registeredNodes.erase(it);
+            directory.remove(node->getId());
+        }
         delete node;
     }
 }
 
 uint32_t NodeList::getAvailableId() const
 {
-    // First unoccupied id from database
-    return minNodeId;
+    // First unoccupied id starting from the last assigned one
+    uint32_t id = nextNodeId;
+    while(records.contains(id) || id < minNodeId)
+    {
+        id++;
+    }
+    return id;
 }
 
 Node *NodeList::getNodeById(uint32_t nodeId)
@@ -40,5 +87,97 @@ Node *NodeList::getNodeById(uint32_t nodeId)
 
 void NodeList::nodeRegistered(Node *node)
 {
-    (void)node;
-}
\ No newline at end of file
+    if(node == nullptr || !node->isRegistered())
+    {
+        throw std::runtime_error("NodeList::nodeRegistered called for an unregistered node");
+    }
+    registeredNodes[node->getId()] = node;
+    directory.set(node->getId(), node->getName(), node->getType());
+}
+
+const NodeRecord &NodeList::addRecord(NodeRecord record)
+{
+    // A device that registers again, e.g. after it lost its token, gets its ID back instead of another record
+    auto [reused, isNew] = recordIds.try_emplace(getRecordKey(record), 0);
+    if(!isNew && !registeredNodes.contains(reused->second))
+    {
+        record.id = reused->second;
+    }
+    else
+    {
+        record.id  = getAvailableId();
+        nextNodeId = record.id + 1;
+        if(isNew)
+            reused->second = record.id;
+    }
+    record.secret = generateSecret();
+    if(record.interface != nullptr)
+        record.interface = internInterface(record.interface);
+
+    // The record is in the log before the caller acknowledges the registration
+    if(registryStore != nullptr)
+        registryStore->append(record);
+
+    auto [it, inserted] = records.insert_or_assign(record.id, std::make_shared<const NodeRecord>(std::move(record)));
+    (void)inserted;
+
+    if(registryStore != nullptr && registryStore->isCheckpointDue())
+        registryStore->checkpoint(records, nextNodeId);
+    return *it->second;
+}
+
+const NodeRecord *
+    NodeList::findRecord(uint32_t nodeId, uint32_t options, uint32_t interfaceHash, uint64_t secret) const
+{
+    auto it = records.find(nodeId);
+    if(it == records.end())
+        return nullptr;
+
+    const NodeRecord &record = *it->second;
+    if(record.secret != secret || record.options != options || record.interfaceHash != interfaceHash)
+        return nullptr;
+
+    return &record;
+}
+
+const NodeRecord *NodeList::getRecord(uint32_t nodeId) const
+{
+    auto it = records.find(nodeId);
+    return it != records.end() ? it->second.get() : nullptr;
+}
+
+std::shared_ptr<const std::string> NodeList::internInterface(const std::shared_ptr<const std::string> &interface)
+{
+    auto it = interfaces.find(*interface);
+    if(it != interfaces.end())
+        return it->second;
+
+    interfaces.emplace(*interface, interface);
+    return interface;
+}
+
+std::string NodeList::getRecordKey(const NodeRecord &record)
+{
+    std::string key = record.name + '\0' + record.type + '\0';
+    key.append(reinterpret_cast<const char *>(&record.interfaceHash), sizeof(record.interfaceHash));
+    return key;
+}
+
+uint64_t NodeList::generateSecret()
+{
+    uint64_t secret = 0;
+    uint8_t *out    = reinterpret_cast<uint8_t *>(&secret);
+    size_t   got    = 0;
+    while(got < sizeof(secret))
+    {
+        ssize_t len = getrandom(out + got, sizeof(secret) - got, 0);
+        if(len < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("Failed to generate session secret: ") + strerror(errno));
+        }
+        got += len;
+    }
+    return secret;
+}
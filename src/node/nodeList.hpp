@@ -2,31 +2,64 @@
 
 #include <vector>
 #include <map>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 
 #include "node.hpp"
+#include "nodeDirectory.hpp"
+#include "nodeRecord.hpp"
+#include "database/registryStore.hpp"
 
 class NodeList
 {
 public:
     NodeList() {}
+
+    // Restores the records from registryStore and persists every new record to it
+    NodeList(Database::RegistryStore *registryStore);
     ~NodeList() {}
     void addNode(const Node *node);
     void removeNode(const Node *node);
 
-    uint32_t getAvailableId() const;
-    Node *   getNodeById(uint32_t nodeId);
-    void     nodeRegistered(Node *node);
+    uint32_t                         getAvailableId() const;
+    Node *                           getNodeById(uint32_t nodeId);
+    void                             nodeRegistered(Node *node);
+    const std::vector<const Node *> &getNodes() const { return nodes; } // Connected, registered or not
+    NodeDirectory                   &getDirectory() { return directory; } // Connected and registered, versioned
+
+    // Stores a registration record with a fresh session secret. The ID is the one of the record with the same name,
+    // type and interface if there is one and its node is not connected, a new one otherwise.
+    const NodeRecord &addRecord(NodeRecord record);
+
+    // Returns the record matching the session token fields or nullptr if the token is not valid
+    const NodeRecord *findRecord(uint32_t nodeId, uint32_t options, uint32_t interfaceHash, uint64_t secret) const;
+
+    // Returns the record of a node the server vouches for, e.g. one taken over from another process, or nullptr
+    const NodeRecord *getRecord(uint32_t nodeId) const;
 
 private:
     using LogLevel = Utilities::Logger::LogLevel;
 
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::NodeList;
+
     static constexpr uint32_t minNodeId = 1;
 
-    std::vector<const Node *>  nodes;
-    std::map<uint32_t, Node *> registeredNodes;
+    std::vector<const Node *>                 nodes;
+    std::map<uint32_t, Node *>                registeredNodes;
+    NodeDirectory                             directory;
+    Database::RegistryStore::Records          records; // Replaced on change, a checkpoint may still read the old ones
+    std::unordered_map<std::string, uint32_t> recordIds; // By name, type and interface hash, see getRecordKey
+    uint32_t                                  nextNodeId = minNodeId;
+    Database::RegistryStore *                 registryStore = nullptr;
+
+    // One copy of every distinct interface, keys point into the values
+    std::unordered_map<std::string_view, std::shared_ptr<const std::string>> interfaces;
+
+    std::shared_ptr<const std::string> internInterface(const std::shared_ptr<const std::string> &interface);
+
+    static std::string getRecordKey(const NodeRecord &record);
 
-    void log(const std::string &message, LogLevel logLevel = LogLevel::Info) const
-    {
-        Utilities::Logger::logMessage("NodeList:: " + message, logLevel);
-    }
-};
\ No newline at end of file
+    // From the kernel CSPRNG, tokens must not tell anything about the secrets of other nodes
+    static uint64_t generateSecret();
+};
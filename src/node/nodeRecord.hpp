@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Registration data of a node, kept after the node disconnects so that it can resume its session
+struct NodeRecord
+{
+    uint32_t                           id            = 0;
+    std::string                        name          = "";
+    std::string                        type          = "";
+    std::string                        description   = "";
+    uint32_t                           options       = 0;
+    uint32_t                           interfaceHash = 0;
+    std::shared_ptr<const std::string> interface;
+    uint64_t                           secret = 0;
+};
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "outbox.hpp"
+#include "message/message.hpp"
+
+void Outbox::write(const uint8_t *data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed)
+    {
+        throw std::runtime_error("Outbox closed in Outbox::write");
+    }
+    if(frames.empty())
+    {
+        transport->write(data, len);
+        return;
+    }
+    queue(std::make_shared<const std::vector<uint8_t>>(data, data + len));
+}
+
+void Outbox::writev(std::vector<iovec> &vector)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed)
+    {
+        throw std::runtime_error("Outbox closed in Outbox::writev");
+    }
+    if(frames.empty())
+    {
+        transport->writev(vector);
+        return;
+    }
+
+    auto frame = std::make_shared<std::vector<uint8_t>>();
+    for(const iovec &piece : vector)
+    {
+        const uint8_t *base = static_cast<const uint8_t *>(piece.iov_base);
+        frame->insert(frame->end(), base, base + piece.iov_len);
+    }
+    queue(std::move(frame));
+}
+
+void Outbox::sendFile(int fileFd, off_t offset, size_t len)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed)
+    {
+        throw std::runtime_error("Outbox closed in Outbox::sendFile");
+    }
+    if(frames.empty())
+    {
+        transport->sendFile(fileFd, offset, len);
+        return;
+    }
+
+    // A transport that keeps frames gets the file in frames of at most one message, as its sendFile does
+    size_t frameLen = keepsFrames ? Message::maxMessageLen : len;
+    while(len > 0)
+    {
+        size_t  chunk   = std::min(len, frameLen);
+        auto    data    = std::make_shared<std::vector<uint8_t>>(chunk);
+        ssize_t readLen = pread(fileFd, data->data(), chunk, offset);
+        if(readLen < 0 || static_cast<size_t>(readLen) != chunk)
+        {
+            throw std::runtime_error("pread failed in Outbox::sendFile");
+        }
+        queue(std::move(data));
+        offset += chunk;
+        len -= chunk;
+    }
+}
+
+bool Outbox::push(const Frame &frame, size_t limit, bool &schedule)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed || queuedLen + frame->size() > limit)
+        return false;
+
+    queue(frame);
+    schedule  = !scheduled;
+    scheduled = true;
+    return true;
+}
+
+void Outbox::queue(Frame frame)
+{
+    queuedLen += frame->size();
+    frames.push_back(std::move(frame));
+}
+
+Outbox::FlushResult Outbox::flush()
+{
+    // The transport may be gone already, a writer can hold the outbox of a removed node
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed)
+    {
+        scheduled = false;
+        return FlushResult::Closed;
+    }
+
+    // Every write of a transport that keeps frames is one frame for the peer, frames are written one at a time
+    size_t maxPiecesNum = keepsFrames ? 1 : flushPiecesNum;
+    while(!frames.empty() && !closed)
+    {
+        iovec  pieces[flushPiecesNum];
+        size_t piecesNum = 0;
+        for(size_t i = 0; i < frames.size() && piecesNum < maxPiecesNum; i++)
+        {
+            size_t offset              = i == 0 ? headOffset : 0;
+            pieces[piecesNum].iov_base = const_cast<uint8_t *>(frames[i]->data() + offset);
+            pieces[piecesNum].iov_len  = frames[i]->size() - offset;
+            piecesNum++;
+        }
+
+        size_t written = 0;
+        try
+        {
+            written = transport->writeSome(pieces, piecesNum);
+        }
+        catch(const std::exception &)
+        {
+            // The node's data thread sees the connection end and removes the node
+            closed = true;
+            break;
+        }
+        if(written == 0)
+            return FlushResult::Blocked;
+        if(keepsFrames && written != pieces[0].iov_len)
+        {
+            // The peer got a cut frame, the kernel does not do that for packet sockets
+            closed = true;
+            break;
+        }
+
+        while(written > 0)
+        {
+            size_t remaining = frames.front()->size() - headOffset;
+            if(written < remaining)
+            {
+                headOffset += written;
+                break;
+            }
+            written -= remaining;
+            queuedLen -= frames.front()->size();
+            headOffset = 0;
+            frames.pop_front();
+        }
+    }
+
+    scheduled = false;
+    if(closed)
+    {
+        frames.clear();
+        queuedLen  = 0;
+        headOffset = 0;
+        return FlushResult::Closed;
+    }
+    return FlushResult::Empty;
+}
+
+void Outbox::pollWritable(int epollFd, uint64_t data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed || transport->getPollFd() < 0)
+        return;
+
+    epoll_event event;
+    event.events   = (transport->isPollFdReadable() ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+    event.data.u64 = data;
+    if(epoll_ctl(epollFd, polled ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, transport->getPollFd(), &event) == 0)
+        polled = true;
+}
+
+void Outbox::stopPolling(int epollFd)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(polled && !closed)
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, transport->getPollFd(), nullptr);
+    polled = false;
+}
+
+void Outbox::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    closed    = true;
+    transport = nullptr;
+    frames.clear();
+    queuedLen  = 0;
+    headOffset = 0;
+}
+
+bool Outbox::isClosed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return closed;
+}
+
+size_t Outbox::getQueuedLen() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queuedLen;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+#include "transport.hpp"
+
+/* Output of a node that the fan-out writers flush without blocking. While frames are queued every write of the node
+ * goes behind them, so frames keep their order; an empty outbox writes straight to the transport as before. Queued
+ * frames are shared: a frame fanned out to many nodes is one buffer referenced from every outbox and written with
+ * writev from where it is, one frame per write if the transport keeps frames. A queued outbox is always scheduled
+ * with exactly one writer until it is flushed empty.
+ */
+class Outbox
+{
+public:
+    using Frame = std::shared_ptr<const std::vector<uint8_t>>;
+
+    enum class FlushResult
+    {
+        Empty,
+        Blocked, // The transport would block, poll its fd for writing
+        Closed,
+    };
+
+    Outbox(Transport *transport) : transport(transport), keepsFrames(transport->keepsFrames()) {}
+
+    // Writes of the node, queued behind the frames if there are any and never dropped. Throw once closed.
+    void write(const uint8_t *data, size_t len);
+    void writev(std::vector<iovec> &vector);
+    void sendFile(int fileFd, off_t offset, size_t len);
+
+    // Queues a shared frame unless more than limit bytes are queued already. schedule is set if the outbox has to be
+    // passed to a writer.
+    bool push(const Frame &frame, size_t limit, bool &schedule);
+
+    // Writer: writes queued frames until the outbox is empty or the transport would block
+    FlushResult flush();
+
+    // Writer: polling of the transport fd while flush returns Blocked, done under the lock so the fd is still the
+    // one of the transport
+    void pollWritable(int epollFd, uint64_t data);
+    void stopPolling(int epollFd);
+
+    // Node: before the transport goes away, queued frames are dropped and writes throw from then on
+    void close();
+
+    bool   isClosed() const;
+    size_t getQueuedLen() const;
+
+private:
+    static constexpr size_t flushPiecesNum = 64; // Frames per writev of a byte stream
+
+    mutable std::mutex mutex;
+    Transport         *transport; // Gone once the outbox is closed
+    const bool         keepsFrames;
+    std::deque<Frame>  frames;
+    size_t             headOffset = 0; // Written bytes of the first frame
+    size_t             queuedLen  = 0;
+    bool               scheduled  = false;
+    bool               polled     = false;
+    bool               closed     = false;
+
+    void queue(Frame frame); // Locked
+};
@@ -0,0 +1,534 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "sharedMemoryTransport.hpp"
+#include "message/endian.hpp"
+
+namespace
+{
+inline void relaxCpu()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Fds of every SCM_RIGHTS message, they are open in this process as soon as they were received
+void closeReceivedFds(msghdr &message)
+{
+    for(cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+    {
+        if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t fdsNum = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(size_t i = 0; i < fdsNum; i++)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(fd));
+            close(fd);
+        }
+    }
+}
+} // namespace
+
+SharedMemoryRing::SharedMemoryRing(Header *header, uint8_t *data, int dataEvent, int spaceEvent, int peerFd) :
+    header(header),
+    data(data),
+    capacity(header->capacity),
+    dataEvent(dataEvent),
+    spaceEvent(spaceEvent),
+    peerFd(peerFd)
+{
+}
+
+bool SharedMemoryRing::write(const uint8_t *source, size_t len)
+{
+    uint64_t headPos = header->head.load(std::memory_order_relaxed);
+    while(len > 0)
+    {
+        uint64_t tailPos = header->tail.load(std::memory_order_acquire);
+        if(headPos - tailPos == capacity)
+        {
+            // Full, the reader frees space
+            int result = wait(header->writerWaiting, spaceEvent, -1, [&] {
+                return headPos - header->tail.load(std::memory_order_acquire) < capacity;
+            });
+            if(result <= 0)
+                return false;
+            continue;
+        }
+        if(isClosed())
+            return false;
+
+        size_t chunk = put(headPos, tailPos, source, len);
+        source += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+ssize_t SharedMemoryRing::writeSome(const uint8_t *source, size_t len)
+{
+    if(isClosed())
+        return -1;
+
+    uint64_t headPos = header->head.load(std::memory_order_relaxed);
+    uint64_t tailPos = header->tail.load(std::memory_order_acquire);
+    if(headPos - tailPos == capacity)
+    {
+        // Announced before the last check, the reader either sees the flag and signals or the check sees its update.
+        // Signals of earlier waits are taken first, the space event is only readable for space freed from now on.
+        header->writerWaiting.store(1, std::memory_order_seq_cst);
+        uint64_t value = 0;
+        (void)::read(spaceEvent, &value, sizeof(value));
+        tailPos = header->tail.load(std::memory_order_seq_cst);
+        if(headPos - tailPos == capacity)
+            return 0;
+    }
+    if(header->writerWaiting.load(std::memory_order_relaxed) != 0)
+        header->writerWaiting.store(0, std::memory_order_relaxed);
+    return static_cast<ssize_t>(put(headPos, tailPos, source, len));
+}
+
+size_t SharedMemoryRing::put(uint64_t &headPos, uint64_t tailPos, const uint8_t *source, size_t len)
+{
+    size_t chunk  = std::min<uint64_t>(len, capacity - (headPos - tailPos));
+    size_t offset = headPos & (capacity - 1);
+    size_t first  = std::min<size_t>(chunk, capacity - offset);
+    memcpy(data + offset, source, first);
+    memcpy(data, source + first, chunk - first);
+    headPos += chunk;
+
+    // The store and the load of the flag pair with the reader's store of the flag and load of head
+    header->head.store(headPos, std::memory_order_seq_cst);
+    if(header->readerWaiting.load(std::memory_order_seq_cst) != 0)
+        signal(dataEvent);
+    return chunk;
+}
+
+ssize_t SharedMemoryRing::read(uint8_t *destination, size_t len, int timeoutMs)
+{
+    uint64_t tailPos = header->tail.load(std::memory_order_relaxed);
+    uint64_t headPos = header->head.load(std::memory_order_acquire);
+    if(headPos == tailPos)
+    {
+        int result = wait(header->readerWaiting, dataEvent, timeoutMs, [&] {
+            return header->head.load(std::memory_order_acquire) != tailPos;
+        });
+        if(result <= 0)
+            return result;
+        headPos = header->head.load(std::memory_order_acquire);
+    }
+
+    size_t chunk  = std::min<uint64_t>(len, headPos - tailPos);
+    size_t offset = tailPos & (capacity - 1);
+    size_t first  = std::min<size_t>(chunk, capacity - offset);
+    memcpy(destination, data + offset, first);
+    memcpy(destination + first, data, chunk - first);
+
+    header->tail.store(tailPos + chunk, std::memory_order_seq_cst);
+    if(header->writerWaiting.load(std::memory_order_seq_cst) != 0)
+        signal(spaceEvent);
+    return static_cast<ssize_t>(chunk);
+}
+
+void SharedMemoryRing::close()
+{
+    if(header == nullptr)
+        return;
+    header->closed.store(1, std::memory_order_seq_cst);
+    signal(dataEvent);
+    signal(spaceEvent);
+}
+
+template <typename Ready>
+int SharedMemoryRing::wait(std::atomic<uint32_t> &waiting, int event, int timeoutMs, Ready ready)
+{
+    static const size_t spins = getSpinsNum();
+    for(size_t i = 0; i < spins; i++)
+    {
+        if(ready())
+            return 1;
+        if(isClosed())
+            return 0;
+        relaxCpu();
+    }
+
+    // Announced before the last check, the other side either sees the flag or the check sees its update
+    waiting.store(1, std::memory_order_seq_cst);
+    int result = -1;
+    while(true)
+    {
+        if(ready())
+        {
+            result = 1;
+            break;
+        }
+        if(isClosed())
+        {
+            result = 0;
+            break;
+        }
+
+        pollfd fds[2] = {{event, POLLIN, 0}, {peerFd, POLLIN, 0}};
+        int    polled = poll(fds, peerFd >= 0 ? 2 : 1, timeoutMs);
+        if(polled == 0)
+        {
+            result = -1;
+            break;
+        }
+        if(polled < 0 && errno != EINTR)
+        {
+            result = 0;
+            break;
+        }
+        if((fds[0].revents & POLLIN) != 0)
+        {
+            uint64_t value = 0;
+            (void)::read(event, &value, sizeof(value));
+        }
+
+        // Nothing is sent on the control socket after the handshake, it only becomes readable when it is closed
+        if(peerFd >= 0 && fds[1].revents != 0 && !ready())
+        {
+            result = 0;
+            break;
+        }
+    }
+    waiting.store(0, std::memory_order_relaxed);
+    return result;
+}
+
+size_t SharedMemoryRing::getSpinsNum()
+{
+    return std::thread::hardware_concurrency() > 1 ? spinsNum : 0;
+}
+
+void SharedMemoryRing::signal(int event)
+{
+    uint64_t value = 1;
+    (void)::write(event, &value, sizeof(value));
+}
+
+SharedMemoryChannel::SharedMemoryChannel(int socketFd, size_t capacity) : socketFd(socketFd)
+{
+    if(capacity < Message::maxMessageLen || (capacity & (capacity - 1)) != 0)
+    {
+        close(socketFd);
+        throw std::runtime_error("Shared memory capacity has to be a power of two of at least one message");
+    }
+
+    try
+    {
+        memoryLen = 2 * sizeof(SharedMemoryRing::Header) + 2 * capacity;
+        memoryFd  = memfd_create("iot-shared-memory", MFD_CLOEXEC);
+        if(memoryFd < 0 || ftruncate(memoryFd, memoryLen) != 0)
+        {
+            throw std::runtime_error("Unable to create shared memory in SharedMemoryChannel");
+        }
+        for(int &event : events)
+        {
+            event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if(event < 0)
+            {
+                throw std::runtime_error("eventfd failed in SharedMemoryChannel");
+            }
+        }
+        map(capacity, true);
+
+        // The capacity goes along for the client to check the segment against
+        uint64_t capacityValue      = capacity;
+        iovec    vector             = {&capacityValue, sizeof(capacityValue)};
+        int      fds[1 + eventsNum] = {memoryFd, events[0], events[1], events[2], events[3]};
+        char     control[CMSG_SPACE(sizeof(fds))];
+        msghdr   message;
+        memset(&message, 0, sizeof(message));
+        memset(control, 0, sizeof(control));
+        message.msg_iov        = &vector;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr *header        = CMSG_FIRSTHDR(&message);
+        header->cmsg_level     = SOL_SOCKET;
+        header->cmsg_type      = SCM_RIGHTS;
+        header->cmsg_len       = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(header), fds, sizeof(fds));
+        if(sendmsg(socketFd, &message, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(capacityValue)))
+        {
+            throw std::runtime_error("Unable to pass shared memory to the client in SharedMemoryChannel");
+        }
+    }
+    catch(...)
+    {
+        release();
+        throw;
+    }
+}
+
+SharedMemoryChannel::SharedMemoryChannel(int socketFd) : socketFd(socketFd)
+{
+    try
+    {
+        uint64_t capacity = 0;
+        iovec    vector   = {&capacity, sizeof(capacity)};
+        int      fds[1 + eventsNum];
+        char     control[CMSG_SPACE(sizeof(fds))];
+        msghdr   message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov        = &vector;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t len            = recvmsg(socketFd, &message, MSG_CMSG_CLOEXEC);
+        if(len < 0)
+        {
+            throw std::runtime_error("No shared memory received from the server in SharedMemoryChannel");
+        }
+
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        if(len != static_cast<ssize_t>(sizeof(capacity)) || header == nullptr || header->cmsg_level != SOL_SOCKET ||
+           header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(fds)) ||
+           (message.msg_flags & MSG_CTRUNC) != 0)
+        {
+            closeReceivedFds(message);
+            throw std::runtime_error("No shared memory received from the server in SharedMemoryChannel");
+        }
+        memcpy(fds, CMSG_DATA(header), sizeof(fds));
+        memoryFd = fds[0];
+        std::copy(fds + 1, fds + 1 + eventsNum, events);
+
+        struct stat status;
+        memoryLen = 2 * sizeof(SharedMemoryRing::Header) + 2 * capacity;
+        if(fstat(memoryFd, &status) != 0 || static_cast<size_t>(status.st_size) != memoryLen)
+        {
+            throw std::runtime_error("Shared memory of the server has the wrong size in SharedMemoryChannel");
+        }
+        map(capacity, false);
+    }
+    catch(...)
+    {
+        release();
+        throw;
+    }
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+    input.close();
+    output.close();
+    release();
+}
+
+void SharedMemoryChannel::map(size_t capacity, bool server)
+{
+    memory = mmap(nullptr, memoryLen, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    if(memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        throw std::runtime_error("mmap failed in SharedMemoryChannel");
+    }
+
+    auto    *headers = static_cast<SharedMemoryRing::Header *>(memory);
+    uint8_t *data    = static_cast<uint8_t *>(memory) + 2 * sizeof(SharedMemoryRing::Header);
+    if(server)
+    {
+        for(size_t i = 0; i < 2; i++)
+        {
+            new(&headers[i]) SharedMemoryRing::Header();
+            headers[i].magic    = SharedMemoryRing::headerMagic;
+            headers[i].capacity = capacity;
+        }
+    }
+    else if(headers[0].magic != SharedMemoryRing::headerMagic || headers[1].magic != SharedMemoryRing::headerMagic ||
+            headers[0].capacity != capacity || headers[1].capacity != capacity)
+    {
+        throw std::runtime_error("Invalid shared memory of the server in SharedMemoryChannel");
+    }
+
+    SharedMemoryRing toServer(&headers[0], data, events[0], events[1], socketFd);
+    SharedMemoryRing toClient(&headers[1], data + capacity, events[2], events[3], socketFd);
+    input  = server ? toServer : toClient;
+    output = server ? toClient : toServer;
+}
+
+void SharedMemoryChannel::release()
+{
+    if(memory != nullptr)
+    {
+        munmap(memory, memoryLen);
+        memory = nullptr;
+    }
+    for(int &fd : events)
+    {
+        if(fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+    if(memoryFd >= 0)
+    {
+        close(memoryFd);
+        memoryFd = -1;
+    }
+    if(socketFd >= 0)
+    {
+        close(socketFd);
+        socketFd = -1;
+    }
+}
+
+ssize_t SharedMemoryTransport::read(uint8_t *data, size_t len)
+{
+    return channel->getInput().read(data, len, readTimeoutMs);
+}
+
+void SharedMemoryTransport::shutdownRead()
+{
+    channel->getInput().close();
+}
+
+void SharedMemoryTransport::write(const uint8_t *data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if(!channel->getOutput().write(data, len))
+    {
+        throw std::runtime_error("Shared memory closed in SharedMemoryTransport::write");
+    }
+}
+
+void SharedMemoryTransport::writev(std::vector<iovec> &vector)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    for(const iovec &piece : vector)
+    {
+        if(!channel->getOutput().write(static_cast<const uint8_t *>(piece.iov_base), piece.iov_len))
+        {
+            throw std::runtime_error("Shared memory closed in SharedMemoryTransport::writev");
+        }
+    }
+}
+
+size_t SharedMemoryTransport::writeSome(const iovec *pieces, size_t count)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    size_t                      written = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        const uint8_t *piece = static_cast<const uint8_t *>(pieces[i].iov_base);
+        ssize_t        len   = channel->getOutput().writeSome(piece, pieces[i].iov_len);
+        if(len < 0)
+        {
+            throw std::runtime_error("Shared memory closed in SharedMemoryTransport::writeSome");
+        }
+        written += len;
+        if(static_cast<size_t>(len) < pieces[i].iov_len)
+            break;
+    }
+    return written;
+}
+
+void SharedMemoryTransport::sendFile(int fileFd, off_t offset, size_t len)
+{
+    // There is no kernel path into the ring, the file goes through a buffer
+    std::vector<uint8_t>        buffer(std::min<size_t>(len, 64 * 1024));
+    std::lock_guard<std::mutex> lock(writeMutex);
+    while(len > 0)
+    {
+        ssize_t readLen = pread(fileFd, buffer.data(), std::min(len, buffer.size()), offset);
+        if(readLen <= 0 || !channel->getOutput().write(buffer.data(), readLen))
+        {
+            throw std::runtime_error("Unable to send file in SharedMemoryTransport::sendFile");
+        }
+        offset += readLen;
+        len -= readLen;
+    }
+}
+
+SharedMemoryClient::SharedMemoryClient(const std::string &socketPath)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path too long in SharedMemoryClient: " + socketPath);
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+    int socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(socketFd < 0 || connect(socketFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        if(socketFd >= 0)
+            close(socketFd);
+        throw std::runtime_error("Unable to connect to " + socketPath + " in SharedMemoryClient");
+    }
+    channel = std::make_unique<SharedMemoryChannel>(socketFd);
+}
+
+SharedMemoryClient::SharedMemoryClient(int socketFd) : channel(std::make_unique<SharedMemoryChannel>(socketFd))
+{
+}
+
+void SharedMemoryClient::send(const Message &message)
+{
+    send(message.getMessagePointer(), message.getMessageLen());
+}
+
+void SharedMemoryClient::send(const uint8_t *frame, size_t len)
+{
+    if(!channel->getOutput().write(frame, len))
+    {
+        throw std::runtime_error("Server gone in SharedMemoryClient::send");
+    }
+}
+
+bool SharedMemoryClient::receive(std::vector<uint8_t> &frame, int timeoutMs)
+{
+    while(true)
+    {
+        // Frames are split by their length field like the server does
+        if(inputEnd - inputStart >= sizeof(uint32_t))
+        {
+            uint32_t frameLen = 0;
+            Utilities::Endian::Instance().readWithEndianness(
+                frameLen, input.data() + inputStart, Message::messageEndianness);
+            if(frameLen < Message::overheadLen || frameLen > Message::maxMessageLen)
+            {
+                throw std::runtime_error("Invalid frame length in SharedMemoryClient::receive");
+            }
+            if(inputEnd - inputStart >= frameLen)
+            {
+                frame.assign(input.data() + inputStart, input.data() + inputStart + frameLen);
+                inputStart += frameLen;
+                return true;
+            }
+        }
+
+        if(inputStart > 0)
+        {
+            memmove(input.data(), input.data() + inputStart, inputEnd - inputStart);
+            inputEnd -= inputStart;
+            inputStart = 0;
+        }
+        ssize_t len = channel->getInput().read(input.data() + inputEnd, input.size() - inputEnd, timeoutMs);
+        if(len <= 0)
+            return false;
+        inputEnd += len;
+    }
+}
+
+bool SharedMemoryClient::isClosed() const
+{
+    return channel->getInput().isClosed();
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "transport.hpp"
+#include "message/message.hpp"
+
+/* Byte stream from one process to another through a ring in shared memory, one producer and one consumer. Head and
+ * tail count the bytes ever written and read, the data wraps at the power of two capacity. A side that finds the ring
+ * empty (reader) or full (writer) spins for a while, then announces that it waits and sleeps on its eventfd, the other
+ * side only writes the eventfd if it sees the announcement. A busy stream therefore passes without any syscall.
+ *
+ * | Header of the ring to the server | Header of the ring to the client | Data to the server | Data to the client |
+ */
+class SharedMemoryRing
+{
+public:
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) std::atomic<uint32_t> readerWaiting;
+        std::atomic<uint32_t> writerWaiting;
+        std::atomic<uint32_t> closed; // By either side, wakes both
+    };
+
+    static constexpr uint64_t headerMagic = 0x314D4853544F49; // "IOTSHM1"
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                  "Atomics in shared memory have to be lock free");
+
+    SharedMemoryRing() = default;
+    SharedMemoryRing(Header *header, uint8_t *data, int dataEvent, int spaceEvent, int peerFd);
+
+    // Producer: writes all of data, waits while the ring is full. False once the ring is closed or the peer is gone.
+    bool write(const uint8_t *data, size_t len);
+
+    // Producer: writes as much of data as fits without waiting. Returns the number of bytes, 0 if the ring is full,
+    // the space event becomes readable once the consumer frees space then. -1 once the ring is closed.
+    ssize_t writeSome(const uint8_t *data, size_t len);
+    int     getSpaceEvent() const { return spaceEvent; }
+
+    // Consumer: reads up to len bytes, waits up to timeoutMs (-1 for ever) while the ring is empty. Returns the number
+    // of bytes, 0 once the ring is closed or the peer is gone, -1 on timeout.
+    ssize_t read(uint8_t *data, size_t len, int timeoutMs);
+
+    void close();
+    bool isClosed() const { return header->closed.load(std::memory_order_acquire) != 0; }
+
+private:
+    static constexpr size_t spinsNum = 2000; // Polls of the other side before sleeping, some microseconds
+
+    // With a single CPU the other side cannot make progress while this side spins
+    static size_t getSpinsNum();
+
+    Header  *header     = nullptr;
+    uint8_t *data       = nullptr;
+    uint64_t capacity   = 0;
+    int      dataEvent  = -1; // Written by the producer, the consumer sleeps on it
+    int      spaceEvent = -1; // Written by the consumer, the producer sleeps on it
+    int      peerFd     = -1; // Control socket, readable once the peer process is gone
+
+    // Copies up to len bytes into the free space and publishes them, returns the number of bytes
+    size_t put(uint64_t &headPos, uint64_t tailPos, const uint8_t *source, size_t len);
+
+    // 1 ready, 0 closed, -1 timeout
+    template <typename Ready>
+    int wait(std::atomic<uint32_t> &waiting, int event, int timeoutMs, Ready ready);
+
+    static void signal(int event);
+};
+
+/* Shared memory segment of a local client with one ring per direction. The server creates the segment (a memfd) and
+ * four eventfds when a client connects to its Unix socket and passes them with SCM_RIGHTS. The socket stays open as
+ * control connection, its end tells either side that the other process is gone.
+ */
+class SharedMemoryChannel
+{
+public:
+    static constexpr size_t defaultCapacity = 1024 * 1024; // Per direction
+
+    SharedMemoryChannel() = delete;
+
+    // Server side: creates the segment and passes it over the connected socket, which the channel owns from then on
+    SharedMemoryChannel(int socketFd, size_t capacity);
+
+    // Client side: receives the segment from the server
+    SharedMemoryChannel(int socketFd);
+
+    ~SharedMemoryChannel();
+
+    SharedMemoryChannel(const SharedMemoryChannel &)            = delete;
+    SharedMemoryChannel &operator=(const SharedMemoryChannel &) = delete;
+
+    SharedMemoryRing &getInput() { return input; }
+    SharedMemoryRing &getOutput() { return output; }
+    int               getSocketFd() const { return socketFd; }
+
+private:
+    static constexpr size_t eventsNum = 4; // Data and space of the ring to the server, of the ring to the client
+
+    int              socketFd          = -1;
+    int              memoryFd          = -1;
+    void            *memory            = nullptr;
+    size_t           memoryLen         = 0;
+    int              events[eventsNum] = {-1, -1, -1, -1};
+    SharedMemoryRing input;
+    SharedMemoryRing output;
+
+    void map(size_t capacity, bool server);
+    void release();
+};
+
+// Server end of a local client's channel, read by the node data thread
+class SharedMemoryTransport : public Transport
+{
+public:
+    SharedMemoryTransport(std::unique_ptr<SharedMemoryChannel> channel) : channel(std::move(channel)) {}
+
+    bool    hasReader() const override { return true; }
+    ssize_t read(uint8_t *data, size_t len) override;
+    void    shutdownRead() override;
+
+    void        write(const uint8_t *data, size_t len) override;
+    void        writev(std::vector<iovec> &vector) override;
+    void        sendFile(int fileFd, off_t offset, size_t len) override;
+    std::string toString() const override { return "shm=" + std::to_string(channel->getSocketFd()); }
+
+    // The fan-out writers poll the space eventfd of the output ring for reading
+    size_t writeSome(const iovec *pieces, size_t count) override;
+    int    getPollFd() const override { return channel->getOutput().getSpaceEvent(); }
+    bool   isPollFdReadable() const override { return true; }
+
+private:
+    static constexpr int readTimeoutMs = 1000;
+
+    std::unique_ptr<SharedMemoryChannel> channel;
+    std::mutex                           writeMutex; // Single producer of the output ring
+};
+
+// Client end for a process on the server's host, e.g. an app node, frames go through the channel's rings
+class SharedMemoryClient
+{
+public:
+    SharedMemoryClient() = delete;
+    SharedMemoryClient(const std::string &socketPath);
+    SharedMemoryClient(int socketFd); // Connected socket of the server's listener, owned by the client
+
+    // Throws once the server is gone
+    void send(const Message &message);
+    void send(const uint8_t *frame, size_t len);
+
+    // Next frame from the server, false on timeout or once the server is gone
+    bool receive(std::vector<uint8_t> &frame, int timeoutMs);
+
+    bool isClosed() const;
+
+private:
+    std::unique_ptr<SharedMemoryChannel> channel;
+    std::vector<uint8_t>                 input      = std::vector<uint8_t>(2 * Message::maxMessageLen);
+    size_t                               inputStart = 0;
+    size_t                               inputEnd   = 0;
+};
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "transport.hpp"
+#include "message/message.hpp"
+
+size_t Transport::writeSome(const iovec *pieces, size_t count)
+{
+    std::vector<iovec> vector(pieces, pieces + count);
+    size_t             len = 0;
+    for(const iovec &piece : vector)
+        len += piece.iov_len;
+    writev(vector);
+    return len;
+}
+
+void Transport::writeWithFds(const uint8_t *, size_t, const std::vector<int> &)
+{
+    throw std::runtime_error("Transport can not pass fds in Transport::writeWithFds: " + toString());
+}
+
+SocketTransport::~SocketTransport()
+{
+    if(fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+ssize_t SocketTransport::read(uint8_t *data, size_t len)
+{
+    return ::read(fd, data, len);
+}
+
+void SocketTransport::shutdownRead()
+{
+    shutdown(fd, SHUT_RD);
+}
+
+void SocketTransport::write(const uint8_t *data, size_t len)
+{
+    if(fd < 0)
+    {
+        throw std::runtime_error("Invalid fd in SocketTransport::write");
+    }
+
+    ssize_t written = ::write(fd, data, len);
+    if(written < 0 || static_cast<size_t>(written) != len)
+    {
+        throw std::runtime_error("written != len in SocketTransport::write");
+    }
+}
+
+void SocketTransport::writev(std::vector<iovec> &vector)
+{
+    if(fd < 0)
+    {
+        throw std::runtime_error("Invalid fd in SocketTransport::writev");
+    }
+
+    // Pieces are written straight from where they are, partial writes continue inside the current piece
+    size_t index = 0;
+    while(index < vector.size())
+    {
+        int     count   = static_cast<int>(std::min<size_t>(vector.size() - index, IOV_MAX));
+        ssize_t written = ::writev(fd, vector.data() + index, count);
+        if(written < 0)
+        {
+            throw std::runtime_error("writev failed in SocketTransport::writev");
+        }
+
+        size_t remaining = written;
+        while(index < vector.size() && remaining >= vector[index].iov_len)
+        {
+            remaining -= vector[index].iov_len;
+            index++;
+        }
+        if(remaining > 0)
+        {
+            vector[index].iov_base = static_cast<uint8_t *>(vector[index].iov_base) + remaining;
+            vector[index].iov_len -= remaining;
+        }
+    }
+}
+
+void SocketTransport::sendFile(int fileFd, off_t offset, size_t len)
+{
+    if(fd < 0)
+    {
+        throw std::runtime_error("Invalid fd in SocketTransport::sendFile");
+    }
+
+    if(kind == Kind::Packet)
+    {
+        // Every sendfile chunk would be a packet of its own, the packets are sized so clients read them whole
+        std::vector<uint8_t> buffer(std::min(len, Message::maxMessageLen));
+        while(len > 0)
+        {
+            ssize_t readLen = pread(fileFd, buffer.data(), std::min(len, buffer.size()), offset);
+            if(readLen <= 0)
+            {
+                throw std::runtime_error("pread failed in SocketTransport::sendFile");
+            }
+            write(buffer.data(), readLen);
+            offset += readLen;
+            len -= readLen;
+        }
+        return;
+    }
+
+    // The kernel copies from the page cache to the socket, nothing passes through user space
+    while(len > 0)
+    {
+        ssize_t sent = sendfile(fd, fileFd, &offset, len);
+        if(sent <= 0)
+        {
+            throw std::runtime_error("sendfile failed in SocketTransport::sendFile");
+        }
+        len -= sent;
+    }
+}
+
+size_t SocketTransport::writeSome(const iovec *pieces, size_t count)
+{
+    if(fd < 0)
+    {
+        throw std::runtime_error("Invalid fd in SocketTransport::writeSome");
+    }
+
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov    = const_cast<iovec *>(pieces);
+    message.msg_iovlen = std::min<size_t>(count, IOV_MAX);
+    ssize_t written    = sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(written < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+        throw std::runtime_error("sendmsg failed in SocketTransport::writeSome");
+    }
+    return static_cast<size_t>(written);
+}
+
+int SocketTransport::releaseFd()
+{
+    int released = fd;
+    fd           = -1;
+    return released;
+}
+
+void SocketTransport::writeWithFds(const uint8_t *data, size_t len, const std::vector<int> &fds)
+{
+    if(kind != Kind::Packet)
+    {
+        Transport::writeWithFds(data, len, fds);
+        return;
+    }
+
+    iovec                iov = {const_cast<uint8_t *>(data), len};
+    std::vector<uint8_t> control(fds.empty() ? 0 : CMSG_SPACE(fds.size() * sizeof(int)));
+    msghdr               message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov    = &iov;
+    message.msg_iovlen = 1;
+    if(!fds.empty())
+    {
+        message.msg_control    = control.data();
+        message.msg_controllen = control.size();
+
+        cmsghdr *header    = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type  = SCM_RIGHTS;
+        header->cmsg_len   = CMSG_LEN(fds.size() * sizeof(int));
+        memcpy(CMSG_DATA(header), fds.data(), fds.size() * sizeof(int));
+    }
+
+    ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if(written < 0 || static_cast<size_t>(written) != len)
+    {
+        throw std::runtime_error("sendmsg failed in SocketTransport::writeWithFds");
+    }
+}
+
+bool SocketTransport::getPeerUid(uid_t &uid) const
+{
+    ucred     credentials;
+    socklen_t len = sizeof(credentials);
+    if(fd < 0 || getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &len) != 0 || len != sizeof(credentials))
+        return false;
+    uid = credentials.uid;
+    return true;
+}
+
+void MemoryTransport::writev(std::vector<iovec> &vector)
+{
+    gathered.clear();
+    for(const iovec &piece : vector)
+    {
+        const uint8_t *base = static_cast<const uint8_t *>(piece.iov_base);
+        gathered.insert(gathered.end(), base, base + piece.iov_len);
+    }
+    sink(gathered.data(), gathered.size());
+}
+
+void MemoryTransport::sendFile(int fileFd, off_t offset, size_t len)
+{
+    std::vector<uint8_t> data(len);
+    ssize_t              readLen = pread(fileFd, data.data(), len, offset);
+    if(readLen < 0 || static_cast<size_t>(readLen) != len)
+    {
+        throw std::runtime_error("pread failed in MemoryTransport::sendFile");
+    }
+    sink(data.data(), len);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+/* The byte stream between the server and a node. A transport with a reader is read by a data thread of the node, one
+ * without a reader gets its data pushed into the node with Node::receive by whoever owns the other end, e.g. the
+ * deterministic simulation. Writes are complete or throw.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual bool hasReader() const = 0;
+
+    // Blocking read of the data thread: > 0 bytes read, 0 closed, < 0 timed out
+    virtual ssize_t read(uint8_t *data, size_t len) = 0;
+
+    // Ends a blocking read, the data thread sees the transport closed
+    virtual void shutdownRead() = 0;
+
+    // Pieces of writev are modified on partial writes, sendFile writes the raw bytes of a file
+    virtual void        write(const uint8_t *data, size_t len)         = 0;
+    virtual void        writev(std::vector<iovec> &vector)             = 0;
+    virtual void        sendFile(int fileFd, off_t offset, size_t len) = 0;
+    virtual std::string toString() const                               = 0;
+
+    // Writes as much of the pieces as possible without blocking, 0 if the transport would block. Transports without
+    // a poll fd write everything.
+    virtual size_t writeSome(const iovec *pieces, size_t count);
+    virtual int    getPollFd() const { return -1; } // Polled for writing while writeSome would block
+    virtual bool   isPollFdReadable() const { return false; } // Polled for reading instead, e.g. an eventfd
+
+    // Every read returns exactly one frame, the node does not split them by their length field
+    virtual bool keepsFrames() const { return false; }
+
+    // The connection can be passed on to another server process with releaseFd, see Server::takeOver
+    virtual bool isMovable() const { return false; }
+
+    // Gives up the socket without closing or shutting it down, -1 if there is none
+    virtual int releaseFd() { return -1; }
+
+    // Writes data with fds attached as SCM_RIGHTS, only on Unix sockets
+    virtual bool canPassFds() const { return false; }
+    virtual void writeWithFds(const uint8_t *data, size_t len, const std::vector<int> &fds);
+
+    // User of the process at the other end of a Unix socket, false if it is not known
+    virtual bool getPeerUid(uid_t &) const { return false; }
+};
+
+/* TCP or Unix socket of an accepted connection, closed with the transport. A packet socket (SOCK_SEQPACKET) has the
+ * frame boundaries kept by the kernel, it sends files in packets of up to Message::maxMessageLen.
+ */
+class SocketTransport : public Transport
+{
+public:
+    enum class Kind
+    {
+        Stream,
+        Packet,
+    };
+
+    SocketTransport(int fd, Kind kind = Kind::Stream) : fd(fd), kind(kind) {}
+    ~SocketTransport() override;
+
+    bool    hasReader() const override { return true; }
+    ssize_t read(uint8_t *data, size_t len) override;
+    void    shutdownRead() override;
+
+    void        write(const uint8_t *data, size_t len) override;
+    void        writev(std::vector<iovec> &vector) override;
+    void        sendFile(int fileFd, off_t offset, size_t len) override;
+    std::string toString() const override { return "fd=" + std::to_string(fd); }
+
+    size_t writeSome(const iovec *pieces, size_t count) override;
+    int    getPollFd() const override { return fd; }
+
+    bool keepsFrames() const override { return kind == Kind::Packet; }
+    bool isMovable() const override { return kind == Kind::Stream; }
+    int  releaseFd() override;
+    bool canPassFds() const override { return kind == Kind::Packet; }
+    bool getPeerUid(uid_t &uid) const override;
+    void writeWithFds(const uint8_t *data, size_t len, const std::vector<int> &fds) override;
+
+private:
+    int  fd   = -1;
+    Kind kind = Kind::Stream;
+};
+
+// In process end of a virtual connection, everything the server writes goes to the sink at once
+class MemoryTransport : public Transport
+{
+public:
+    using Sink = std::function<void(const uint8_t *data, size_t len)>;
+
+    MemoryTransport(uint32_t connectionId, Sink sink) : connectionId(connectionId), sink(std::move(sink)) {}
+
+    bool    hasReader() const override { return false; }
+    ssize_t read(uint8_t *, size_t) override { return 0; }
+    void    shutdownRead() override {}
+
+    void        write(const uint8_t *data, size_t len) override { sink(data, len); }
+    void        writev(std::vector<iovec> &vector) override;
+    void        sendFile(int fileFd, off_t offset, size_t len) override;
+    std::string toString() const override { return "memory=" + std::to_string(connectionId); }
+
+private:
+    uint32_t             connectionId;
+    Sink                 sink;
+    std::vector<uint8_t> gathered; // Pieces of writev, passed to the sink as one write
+};
@@ -0,0 +1,150 @@
+#include "deviceShadow.hpp"
+#include "message/endian.hpp"
+#include "message/message.hpp"
+
+void DeviceShadow::addNode(uint32_t nodeId, uint32_t interfaceHash)
+{
+    if(nodeId >= maxNodeId)
+        return;
+    if(nodeId >= nodes.size())
+        nodes.resize(nodeId + 1);
+
+    NodeShadow &node = nodes[nodeId];
+    if(node.layout != nullptr)
+        return;
+
+    std::unique_ptr<Layout> &layout = layouts[interfaceHash];
+    if(!layout)
+        layout = std::make_unique<Layout>();
+    node.layout = layout.get();
+
+    snapshot.reset();
+    serialized.reset();
+}
+
+bool DeviceShadow::update(uint32_t nodeId, uint8_t interfaceIndex, uint8_t fieldIndex, uint64_t timestamp, double value)
+{
+    if(nodeId >= nodes.size() || nodes[nodeId].layout == nullptr)
+        return false;
+
+    NodeShadow &node = nodes[nodeId];
+    int32_t     slot = getSlot(*node.layout, interfaceIndex, fieldIndex);
+    if(slot < 0)
+        return true;
+
+    // Slots other nodes of the interface added since this node last reported are still unreported
+    if(static_cast<size_t>(slot) >= node.values.size())
+        node.values.resize(node.layout->fieldKeys->size());
+
+    Value &stored = node.values[slot];
+    if(stored.timestamp == 0)
+        node.reportedNum++;
+    stored.timestamp = timestamp;
+    stored.value     = value;
+
+    node.snapshot.reset();
+    snapshot.reset();
+    serialized.reset();
+    return true;
+}
+
+int32_t DeviceShadow::getSlot(Layout &layout, uint8_t interfaceIndex, uint8_t fieldIndex)
+{
+    if(interfaceIndex < layout.slots.size() && fieldIndex < layout.slots[interfaceIndex].size() &&
+       layout.slots[interfaceIndex][fieldIndex] >= 0)
+    {
+        return layout.slots[interfaceIndex][fieldIndex];
+    }
+    if(layout.fieldKeys->size() >= maxSlotsNum)
+        return -1;
+
+    // New field of the interface, the keys are copied as snapshots may reference them
+    if(interfaceIndex >= layout.slots.size())
+        layout.slots.resize(interfaceIndex + 1);
+    if(fieldIndex >= layout.slots[interfaceIndex].size())
+        layout.slots[interfaceIndex].resize(fieldIndex + 1, -1);
+
+    auto fieldKeys = std::make_shared<std::vector<uint16_t>>(*layout.fieldKeys);
+    fieldKeys->push_back(uint16_t(interfaceIndex) << 8 | fieldIndex);
+    layout.fieldKeys                         = std::move(fieldKeys);
+    layout.slots[interfaceIndex][fieldIndex] = static_cast<int32_t>(layout.fieldKeys->size() - 1);
+    return layout.slots[interfaceIndex][fieldIndex];
+}
+
+std::shared_ptr<const DeviceShadow::NodeSnapshot> DeviceShadow::getSnapshot(uint32_t nodeId)
+{
+    if(nodeId >= nodes.size() || nodes[nodeId].layout == nullptr)
+        return nullptr;
+    return getSnapshot(nodeId, nodes[nodeId]);
+}
+
+std::shared_ptr<const DeviceShadow::NodeSnapshot> DeviceShadow::getSnapshot(uint32_t nodeId, NodeShadow &node)
+{
+    if(!node.snapshot)
+    {
+        auto nodeSnapshot         = std::make_shared<NodeSnapshot>();
+        nodeSnapshot->nodeId      = nodeId;
+        nodeSnapshot->fieldKeys   = node.layout->fieldKeys;
+        nodeSnapshot->values      = node.values;
+        nodeSnapshot->reportedNum = node.reportedNum;
+        node.snapshot             = std::move(nodeSnapshot);
+    }
+    return node.snapshot;
+}
+
+std::shared_ptr<const DeviceShadow::Snapshot> DeviceShadow::getSnapshot()
+{
+    if(!snapshot)
+    {
+        // Nodes that did not change since the last snapshot are shared with it
+        auto fleet = std::make_shared<Snapshot>();
+        for(uint32_t nodeId = 0; nodeId < nodes.size(); nodeId++)
+        {
+            if(nodes[nodeId].layout == nullptr)
+                continue;
+            fleet->nodes.push_back(getSnapshot(nodeId, nodes[nodeId]));
+            fleet->reportedNum += nodes[nodeId].reportedNum;
+        }
+        snapshot = std::move(fleet);
+    }
+    return snapshot;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> DeviceShadow::getSerialized()
+{
+    if(!serialized)
+        serialized = std::make_shared<const std::vector<uint8_t>>(serialize(*getSnapshot()));
+    return serialized;
+}
+
+std::vector<uint8_t> DeviceShadow::serialize(const Snapshot &snapshot)
+{
+    std::vector<uint8_t> data(headerLen + snapshot.nodes.size() * nodeHeaderLen + snapshot.reportedNum * valueLen);
+
+    const Utilities::Endian &endian = Utilities::Endian::Instance();
+    uint8_t                 *out    = data.data();
+    auto                     put    = [&](auto value) {
+        endian.writeWithEndianness(value, out, Message::messageEndianness);
+        out += sizeof(value);
+    };
+
+    put(static_cast<uint32_t>(snapshot.nodes.size()));
+    for(const std::shared_ptr<const NodeSnapshot> &node : snapshot.nodes)
+    {
+        put(node->nodeId);
+        put(static_cast<uint16_t>(node->reportedNum));
+        for(size_t slot = 0; slot < node->values.size(); slot++)
+        {
+            const Value &value = node->values[slot];
+            if(value.timestamp == 0)
+                continue;
+
+            uint16_t fieldKey = (*node->fieldKeys)[slot];
+            put(static_cast<uint8_t>(fieldKey >> 8));
+            put(static_cast<uint8_t>(fieldKey));
+            put(value.timestamp);
+            put(value.value);
+        }
+    }
+    return data;
+}
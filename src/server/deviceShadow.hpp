@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/* Last known telemetry value of every field of every registered node, so apps read the state of the fleet from the
+ * server instead of waking up every device.
+ *
+ * The values of a node are a dense array, the slot of a field is given by the layout of the node's interface: nodes
+ * with the same interface share one layout, a field gets the next slot the first time any of them reports it. An
+ * update writes the value into its slot and drops the cached snapshots that contained the node, nothing else.
+ * Snapshots are immutable and copied on write: the snapshot of a node copies its array once after it changed, the
+ * fleet snapshot references the snapshots of all nodes, so a new one only copies the nodes that changed since. They
+ * can be held and read on any thread while updates go on. The fleet snapshot is serialized in one pass into a buffer
+ * of the exact size, the buffer is kept until the next update.
+ * Updates and taking snapshots are done on the event thread.
+ */
+class DeviceShadow
+{
+public:
+    struct Value
+    {
+        uint64_t timestamp = 0; // Nanoseconds since epoch, 0 if the node never reported the field
+        double   value     = 0;
+    };
+
+    struct NodeSnapshot
+    {
+        uint32_t                                     nodeId = 0;
+        std::shared_ptr<const std::vector<uint16_t>> fieldKeys; // Interface index << 8 | field index of each slot
+        std::vector<Value>                           values;    // By slot, can be shorter than fieldKeys
+        size_t                                       reportedNum = 0;
+    };
+
+    struct Snapshot
+    {
+        std::vector<std::shared_ptr<const NodeSnapshot>> nodes; // In node ID order
+        size_t                                           reportedNum = 0;
+    };
+
+    /* Serialized snapshot, little endian:
+     *
+     * | Nodes num (4) | Nodes |
+     *
+     * Node:  | Node ID (4) | Values num (2) | Values |
+     * Value: | Interface index (1) | Field index (1) | Timestamp (8) | Value (8, double) |
+     *
+     * Only fields the node reported are included.
+     */
+    static constexpr size_t   headerLen     = 4;
+    static constexpr size_t   nodeHeaderLen = 4 + 2;
+    static constexpr size_t   valueLen      = 1 + 1 + 8 + 8;
+    static constexpr size_t   maxSlotsNum   = UINT16_MAX; // Fields per interface layout
+    static constexpr uint32_t maxNodeId     = 1 << 24;    // Node IDs are handed out in sequence, see NodeList
+
+    // Binds the node to the layout of its interface, nothing changes for a node added before
+    void addNode(uint32_t nodeId, uint32_t interfaceHash);
+
+    // False if the node was not added
+    bool update(uint32_t nodeId, uint8_t interfaceIndex, uint8_t fieldIndex, uint64_t timestamp, double value);
+
+    // nullptr if the node was not added
+    std::shared_ptr<const NodeSnapshot>         getSnapshot(uint32_t nodeId);
+    std::shared_ptr<const Snapshot>             getSnapshot();
+    std::shared_ptr<const std::vector<uint8_t>> getSerialized(); // Of the fleet snapshot
+
+    static std::vector<uint8_t> serialize(const Snapshot &snapshot);
+
+private:
+    struct Layout
+    {
+        std::vector<std::vector<int32_t>>            slots; // By interface and field index, -1 if not assigned
+        std::shared_ptr<const std::vector<uint16_t>> fieldKeys = std::make_shared<const std::vector<uint16_t>>();
+    };
+
+    struct NodeShadow
+    {
+        Layout                             *layout = nullptr; // nullptr if the node was not added
+        std::vector<Value>                  values;
+        size_t                              reportedNum = 0;
+        std::shared_ptr<const NodeSnapshot> snapshot; // Cached until the node changes
+    };
+
+    std::unordered_map<uint32_t, std::unique_ptr<Layout>> layouts; // By interface hash
+    std::vector<NodeShadow>                                nodes;   // By node ID
+
+    std::shared_ptr<const Snapshot>             snapshot;
+    std::shared_ptr<const std::vector<uint8_t>> serialized;
+
+    static int32_t getSlot(Layout &layout, uint8_t interfaceIndex, uint8_t fieldIndex);
+
+    std::shared_ptr<const NodeSnapshot> getSnapshot(uint32_t nodeId, NodeShadow &node);
+};
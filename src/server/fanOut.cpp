@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "fanOut.hpp"
+
+FanOut::FanOut() : FanOut(Config())
+{
+}
+
+FanOut::FanOut(const Config &config) : config(config), scheduled(std::max<size_t>(config.writersNum, 1))
+{
+    for(size_t i = 0; i < scheduled.size(); i++)
+    {
+        auto writer     = std::make_unique<Writer>();
+        writer->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        writer->wakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(writer->epollFd < 0 || writer->wakeFd < 0)
+        {
+            throw std::runtime_error("Unable to create the writer poll in FanOut::FanOut");
+        }
+
+        // The wake up is told apart from outboxes by data 0
+        epoll_event event;
+        event.events   = EPOLLIN;
+        event.data.u64 = 0;
+        epoll_ctl(writer->epollFd, EPOLL_CTL_ADD, writer->wakeFd, &event);
+        writers.push_back(std::move(writer));
+    }
+    for(auto &writer : writers)
+    {
+        writer->thread = std::thread(writerProcess, this, writer.get());
+    }
+}
+
+FanOut::~FanOut()
+{
+    inDestruction = true;
+    for(auto &writer : writers)
+    {
+        if(writer->thread.joinable())
+            writer->thread.join();
+        close(writer->epollFd);
+        close(writer->wakeFd);
+    }
+}
+
+void FanOut::subscribe(uint32_t publisherId, Node *subscriber)
+{
+    std::vector<Node *> &subscribers = topics[publisherId];
+    if(std::find(subscribers.begin(), subscribers.end(), subscriber) != subscribers.end())
+        return;
+
+    subscribers.push_back(subscriber);
+    subscriptions[subscriber].push_back(publisherId);
+}
+
+void FanOut::unsubscribe(uint32_t publisherId, const Node *subscriber)
+{
+    auto topic = topics.find(publisherId);
+    if(topic != topics.end())
+    {
+        std::erase(topic->second, subscriber);
+        if(topic->second.empty())
+            topics.erase(topic);
+    }
+
+    auto subscription = subscriptions.find(subscriber);
+    if(subscription != subscriptions.end())
+    {
+        std::erase(subscription->second, publisherId);
+        if(subscription->second.empty())
+            subscriptions.erase(subscription);
+    }
+}
+
+void FanOut::removeNode(const Node *node)
+{
+    auto subscription = subscriptions.find(node);
+    if(subscription == subscriptions.end())
+        return;
+
+    // Copied, unsubscribe changes the list
+    std::vector<uint32_t> publisherIds = subscription->second;
+    for(uint32_t publisherId : publisherIds)
+        unsubscribe(publisherId, node);
+}
+
+size_t FanOut::publish(uint32_t publisherId, const uint8_t *frame, size_t len)
+{
+    auto topic = topics.find(publisherId);
+    if(topic == topics.end())
+        return 0;
+    return deliver(topic->second, frame, len);
+}
+
+size_t FanOut::deliver(const std::vector<Node *> &subscribers, const uint8_t *frame, size_t len)
+{
+    if(subscribers.empty())
+        return 0;
+
+    // The one copy of the frame, every outbox references it until its subscriber got it
+    Outbox::Frame shared    = std::make_shared<const std::vector<uint8_t>>(frame, frame + len);
+    size_t        queuedNum = 0;
+    for(Node *subscriber : subscribers)
+    {
+        const std::shared_ptr<Outbox> &outbox   = subscriber->getOutbox();
+        bool                           schedule = false;
+        if(!outbox->push(shared, config.outboxLimit, schedule))
+        {
+            framesDropped.add();
+            continue;
+        }
+        queuedNum++;
+        if(schedule)
+            scheduled[getWriterIndex(outbox.get())].push_back(outbox);
+    }
+    framesQueued.add(queuedNum);
+
+    // One lock and at most one wake up per writer and frame
+    for(size_t i = 0; i < writers.size(); i++)
+    {
+        if(scheduled[i].empty())
+            continue;
+
+        Writer &writer   = *writers[i];
+        bool    wasEmpty = false;
+        {
+            std::lock_guard<std::mutex> lock(writer.mutex);
+            wasEmpty = writer.ready.empty();
+            writer.ready.insert(writer.ready.end(), scheduled[i].begin(), scheduled[i].end());
+        }
+        scheduled[i].clear();
+        if(wasEmpty)
+        {
+            uint64_t value = 1;
+            (void)::write(writer.wakeFd, &value, sizeof(value));
+        }
+    }
+    return queuedNum;
+}
+
+size_t FanOut::getSubscribersNum(uint32_t publisherId) const
+{
+    auto topic = topics.find(publisherId);
+    return topic != topics.end() ? topic->second.size() : 0;
+}
+
+size_t FanOut::getWriterIndex(const Outbox *outbox) const
+{
+    // An outbox always goes to the same writer, it is never flushed by two at once
+    return (reinterpret_cast<uintptr_t>(outbox) / alignof(std::max_align_t)) % writers.size();
+}
+
+void FanOut::writerProcess(FanOut *self, Writer *writer)
+{
+    epoll_event events[eventsNum];
+    while(!self->inDestruction)
+    {
+        int eventsReady = epoll_wait(writer->epollFd, events, eventsNum, pollTimeoutMs);
+        if(eventsReady == 0)
+        {
+            // Outboxes of nodes that went away while they were blocked never get writable
+            std::erase_if(writer->blocked, [](const auto &entry) { return entry.second->isClosed(); });
+        }
+        for(int i = 0; i < eventsReady; i++)
+        {
+            if(events[i].data.u64 == 0)
+            {
+                uint64_t value = 0;
+                (void)::read(writer->wakeFd, &value, sizeof(value));
+                continue;
+            }
+
+            // Events of outboxes that were flushed otherwise or dropped meanwhile are ignored
+            auto blocked = writer->blocked.find(events[i].data.u64);
+            if(blocked != writer->blocked.end())
+            {
+                writer->batch.push_back(std::move(blocked->second));
+                writer->blocked.erase(blocked);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(writer->mutex);
+            writer->batch.insert(writer->batch.end(), writer->ready.begin(), writer->ready.end());
+            writer->ready.clear();
+        }
+        for(const std::shared_ptr<Outbox> &outbox : writer->batch)
+            self->flush(*writer, outbox);
+        writer->batch.clear();
+    }
+}
+
+void FanOut::flush(Writer &writer, const std::shared_ptr<Outbox> &outbox)
+{
+    uint64_t key = reinterpret_cast<uintptr_t>(outbox.get());
+    if(outbox->flush() == Outbox::FlushResult::Blocked)
+    {
+        outbox->pollWritable(writer.epollFd, key);
+        writer.blocked[key] = outbox;
+        return;
+    }
+    outbox->stopPolling(writer.epollFd);
+    writer.blocked.erase(key);
+}
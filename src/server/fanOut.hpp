@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "metrics/registry.hpp"
+#include "node/node.hpp"
+#include "node/outbox.hpp"
+
+/* Publish/subscribe fan-out: nodes subscribe to everything another node sends. A published frame is copied once into
+ * a shared buffer that is queued to the outbox of every subscriber, the writer threads flush the outboxes without
+ * blocking and poll the transports that would block. A slow subscriber only fills its own outbox, frames beyond its
+ * limit are dropped for that subscriber alone while the others get them.
+ * Subscriptions are changed and frames published on the event thread, the topics are not locked.
+ */
+class FanOut
+{
+public:
+    struct Config
+    {
+        size_t writersNum  = 2;
+        size_t outboxLimit = 4 * 1024 * 1024; // Bytes queued for a subscriber before its frames are dropped
+    };
+
+    FanOut();
+    FanOut(const Config &config);
+    ~FanOut();
+
+    FanOut(const FanOut &)            = delete;
+    FanOut &operator=(const FanOut &) = delete;
+
+    void subscribe(uint32_t publisherId, Node *subscriber);
+    void unsubscribe(uint32_t publisherId, const Node *subscriber);
+    void removeNode(const Node *node); // All subscriptions of a node that disconnects
+
+    // Queues the frame to every subscriber of the publisher, returns the number it was queued to
+    size_t publish(uint32_t publisherId, const uint8_t *frame, size_t len);
+
+    // Queues the frame to the given subscribers, e.g. the ones of matching content subscriptions
+    size_t deliver(const std::vector<Node *> &subscribers, const uint8_t *frame, size_t len);
+
+    size_t getSubscribersNum(uint32_t publisherId) const;
+
+private:
+    static constexpr int    pollTimeoutMs = 100; // Upper bound of the wait for the destructor
+    static constexpr size_t eventsNum     = 64;
+
+    struct Writer
+    {
+        std::thread                          thread;
+        int                                  epollFd = -1;
+        int                                  wakeFd  = -1; // eventfd, written when ready gets its first outbox
+        std::mutex                           mutex;
+        std::vector<std::shared_ptr<Outbox>> ready; // Guarded by mutex
+
+        // Writer thread only: outboxes polled for writing by their address, also kept alive here
+        std::unordered_map<uint64_t, std::shared_ptr<Outbox>> blocked;
+        std::vector<std::shared_ptr<Outbox>>                  batch; // Being flushed
+    };
+
+    Config                                                  config;
+    std::unordered_map<uint32_t, std::vector<Node *>>       topics;        // Subscribers by publisher id
+    std::unordered_map<const Node *, std::vector<uint32_t>> subscriptions; // Publisher ids by subscriber
+    std::vector<std::unique_ptr<Writer>>                    writers;
+    std::vector<std::vector<std::shared_ptr<Outbox>>>       scheduled; // Of the publish, by writer
+    std::atomic<bool>                                       inDestruction = false;
+
+    Metrics::Counter &framesQueued =
+        Metrics::Registry::getCounter("iot_fanout_queued_frames_total", "Published frames queued to subscribers");
+    Metrics::Counter &framesDropped = Metrics::Registry::getCounter(
+        "iot_fanout_dropped_frames_total", "Published frames dropped for subscribers with a full outbox");
+
+    static void writerProcess(FanOut *self, Writer *writer);
+
+    size_t getWriterIndex(const Outbox *outbox) const;
+    void   flush(Writer &writer, const std::shared_ptr<Outbox> &outbox);
+};
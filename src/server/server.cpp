@@ -2,6 +2,9 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <semaphore>
 #include <functional>
 #include <fstream>
@@ -23,17 +26,77 @@ std::string Server::getServerInterfaceString() const
     return ss.str();
 }
 
-Server::Server() : eventSemaphore(0)
+Database::HistoryStore::Config Server::getHistoryStoreConfig()
 {
-    serverNode = ServerNode(getServerInterfaceString());
+    Database::HistoryStore::Config config;
+    config.retention      = historyRetention;
+    config.dropWhenBehind = true; // The event handler must not wait for the disk, the history is lossy then
+    config.observer       = std::bind(&Server::historyRecordWritten, this, std::placeholders::_1);
+    return config;
+}
+
+Server::Server() : Server(Config())
+{
+}
+
+Server::Server(const Config &config) :
+    config(config),
+    eventSemaphore(0),
+    registryStore(Database::RegistryStore::Config()),
+    nodeList(&registryStore),
+    rollupStore(Database::RollupStore::Config()),
+    historyStore(getHistoryStoreConfig()),
+    nodeDatabase(Database::SqliteWriter::Config()),
+    blobStore(Database::BlobStore::Config()),
+    metricsExporter(config.metrics)
+{
+    serverNode = ServerNode(getServerInterfaceString(),
+                            &nodeList,
+                            &nodeDatabase,
+                            &historyStore,
+                            &rollupStore,
+                            &blobStore,
+                            &metricsExporter,
+                            &fanOut);
+    serverNode.setTaskRunner([this](std::function<void()> task) {
+        Event event;
+        event.type = Event::Task;
+        event.task = std::move(task);
+        pushEvent(event);
+    });
+
+    if(config.handoff.listenerFd >= 0)
+    {
+        serverSocketFd     = config.handoff.listenerFd;
+        connectionListener = std::thread(Server::connectionListenerProcess, this);
+    }
+    else if(config.port != 0)
+    {
+        startListener();
+    }
+    for(const Handoff::Connection &connection : config.handoff.connections)
+    {
+        adoptConnection(connection);
+    }
+    if(!config.sharedMemorySocketPath.empty() || !config.localSocketPath.empty())
+    {
+        startLocalListener();
+    }
+    if(config.eventThread)
+    {
+        eventHandler = std::thread(Server::eventHandlerProcess, this);
+    }
+}
 
+void Server::startListener()
+{
     addrinfo hints, *p;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family   = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM; // SOCK_STREAM refers to TCP
     hints.ai_flags    = AI_PASSIVE;
 
-    int ret = getaddrinfo(NULL, std::to_string(serverPort).c_str(), &hints, &add_info);
+    int ret = getaddrinfo(NULL, std::to_string(config.port).c_str(), &hints, &add_info);
     if(ret != 0)
         throw std::runtime_error("getaddrinfo failed in Server::Server() with error: " + std::to_string(ret));
     if(add_info == nullptr)
@@ -97,52 +160,121 @@ Server::Server() : eventSemaphore(0)
     }
 
     connectionListener = std::thread(Server::connectionListenerProcess, this);
-    eventHandler       = std::thread(Server::eventHandlerProcess, this);
+}
+
+int Server::listenUnix(const std::string &path, int type)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path too long in Server::Server(): " + path);
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    // A socket file left by an earlier run is replaced
+    unlink(path.c_str());
+
+    // Only processes of the server's user may connect, the mode is set before listen so no connection is accepted
+    // with the permissions of the umask
+    int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if(fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+       chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(fd, 32) != 0)
+    {
+        if(fd >= 0)
+            close(fd);
+        throw std::runtime_error("Unable to listen on " + path + " in Server::Server()");
+    }
+    return fd;
+}
+
+void Server::startLocalListener()
+{
+    if(!config.sharedMemorySocketPath.empty())
+        sharedMemorySocketFd = listenUnix(config.sharedMemorySocketPath, SOCK_STREAM);
+    if(!config.localSocketPath.empty())
+        localSocketFd = listenUnix(config.localSocketPath, SOCK_SEQPACKET);
+
+    localListener = std::thread(Server::localListenerProcess, this);
+}
+
+void Server::adoptConnection(const Handoff::Connection &connection)
+{
+    // Not started before its NodeConnected event, the pending bytes are in front of the first read
+    Node *node = nodeConnectedEvent(std::make_unique<SocketTransport>(connection.fd), connection.address);
+    if(!connection.pending.empty())
+        node->receive(connection.pending.data(), connection.pending.size());
+
+    const NodeRecord *record = nodeList.getRecord(connection.nodeId);
+    if(record != nullptr)
+    {
+        node->setRegistration(record->id, record->name, record->type, record->description);
+        nodeList.nodeRegistered(node);
+    }
 }
 
 Server::~Server()
 {
-    log("Destructing server", LogLevel::Debug);
+    LOG_MESSAGE(LogLevel::Debug, "Destructing server");
     inDestruction = true;
 
-    shutdown(serverSocketFd, SHUT_RD);
     if(connectionListener.joinable())
     {
-        log("Joining connection listener thread", LogLevel::Debug);
+        LOG_MESSAGE(LogLevel::Debug, "Joining connection listener thread");
         connectionListener.join();
     }
+    if(localListener.joinable())
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Joining local listener thread");
+        localListener.join();
+    }
 
-    eventSemaphore.release();
     if(eventHandler.joinable())
     {
-        log("Joining event handler thread", LogLevel::Debug);
+        eventSemaphore.release();
+        LOG_MESSAGE(LogLevel::Debug, "Joining event handler thread");
         eventHandler.join();
     }
 
     // Close socket if open
-    log("Closing socket", LogLevel::Debug);
+    LOG_MESSAGE(LogLevel::Debug, "Closing socket");
     if(serverSocketFd >= 0)
     {
         close(serverSocketFd);
         serverSocketFd = -1;
     }
+    if(sharedMemorySocketFd >= 0)
+    {
+        close(sharedMemorySocketFd);
+        sharedMemorySocketFd = -1;
+        unlink(config.sharedMemorySocketPath.c_str());
+    }
+    if(localSocketFd >= 0)
+    {
+        close(localSocketFd);
+        localSocketFd = -1;
+        unlink(config.localSocketPath.c_str());
+    }
 
     // Free add_info in allocated
-    log("Free addrinfo", LogLevel::Debug);
+    LOG_MESSAGE(LogLevel::Debug, "Free addrinfo");
     if(add_info != nullptr)
     {
         freeaddrinfo(add_info);
         add_info = nullptr;
     }
 
-    log("Destructor finished", LogLevel::Debug);
+    LOG_MESSAGE(LogLevel::Debug, "Destructor finished");
 }
 
 void Server::connectionListenerProcess(Server *self)
 {
-    while(!self->inDestruction)
+    // Polled so neither the destructor nor a handoff has to shut the listening socket down
+    while(!self->inDestruction && !self->handoffStarted)
     {
-        // Blocking loop listening for incoming connections
+        pollfd listener = {self->serverSocketFd, POLLIN, 0};
+        if(poll(&listener, 1, listenerPollTimeoutMs) <= 0)
+            continue;
+
         sockaddr_storage client_addr;
         socklen_t        client_addr_size = sizeof(client_addr);
         int              fd               = accept(self->serverSocketFd, (sockaddr *)&client_addr, &client_addr_size);
@@ -152,34 +284,86 @@ void Server::connectionListenerProcess(Server *self)
             char                ip[INET_ADDRSTRLEN];
             struct sockaddr_in *sockAddressVar = (struct sockaddr_in *)&client_addr;
             inet_ntop(AF_INET, &sockAddressVar->sin_addr, ip, INET_ADDRSTRLEN);
-            self->nodeConnectedEvent(fd, ip);
+            self->nodeConnectedEvent(std::make_unique<SocketTransport>(fd), ip);
         }
     }
 }
 
-void Server::eventHandlerProcess(Server *self)
+void Server::localListenerProcess(Server *self)
 {
     while(!self->inDestruction)
     {
-        self->eventSemaphore.acquire();
+        pollfd listeners[2] = {{self->sharedMemorySocketFd, POLLIN, 0}, {self->localSocketFd, POLLIN, 0}};
+        if(poll(listeners, 2, listenerPollTimeoutMs) <= 0)
+            continue;
 
-        // Handle all queued events
-        while(!self->eventQueue.empty())
+        if((listeners[0].revents & POLLIN) != 0)
         {
-            self->handleEvent(self->eventQueue.front());
-            self->eventQueue.pop();
+            int fd = accept4(self->sharedMemorySocketFd, nullptr, nullptr, SOCK_CLOEXEC);
+            try
+            {
+                if(fd >= 0)
+                {
+                    auto channel = std::make_unique<SharedMemoryChannel>(fd, SharedMemoryChannel::defaultCapacity);
+                    self->nodeConnectedEvent(std::make_unique<SharedMemoryTransport>(std::move(channel)), "local");
+                }
+            }
+            catch(const std::exception &e)
+            {
+                LOG_MESSAGE(LogLevel::Warning, "Local client rejected: " + std::string(e.what()));
+            }
         }
+        if((listeners[1].revents & POLLIN) != 0)
+        {
+            int fd = accept4(self->localSocketFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if(fd >= 0)
+                self->nodeConnectedEvent(std::make_unique<SocketTransport>(fd, SocketTransport::Kind::Packet), "local");
+        }
+    }
+}
+
+void Server::eventHandlerProcess(Server *self)
+{
+    while(!self->inDestruction)
+    {
+        self->eventSemaphore.acquire();
+        self->runEvents();
     }
 }
 
+Node *Server::addNode(std::unique_ptr<Transport> transport, const std::string &address)
+{
+    return nodeConnectedEvent(std::move(transport), address);
+}
+
+size_t Server::runEvents()
+{
+    // Handle all queued events, the queue is taken as a whole so nodes can push while they are handled
+    std::queue<Event> events;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        events.swap(eventQueue);
+    }
+    size_t eventsNum = events.size();
+    while(!events.empty())
+    {
+        handleEvent(events.front());
+        events.pop();
+        eventQueueDepth.sub();
+    }
+    return eventsNum;
+}
+
 void Server::messageReceivedEvent(const Node *node, const Message &message)
 {
     Server::Event newEvent;
-    newEvent.type    = Event::EventType::MessageReceived;
-    newEvent.node    = const_cast<Node *>(node);
-    newEvent.message = new Message(message);
-    eventQueue.push(newEvent);
-    eventSemaphore.release();
+    newEvent.type         = Event::EventType::MessageReceived;
+    newEvent.node         = const_cast<Node *>(node);
+    newEvent.message      = new Message(message);
+    newEvent.receivedTime = std::chrono::steady_clock::now();
+    newEvent.trace        = Metrics::Tracer::begin(node->getTraceReadTime(), node->getId());
+    newEvent.trace.mark(Metrics::Trace::Enqueue);
+    pushEvent(newEvent);
 }
 
 void Server::nodeDisconnectedEvent(const Node *node)
@@ -187,21 +371,37 @@ void Server::nodeDisconnectedEvent(const Node *node)
     Server::Event newEvent;
     newEvent.type = Event::EventType::NodeDisconnected;
     newEvent.node = const_cast<Node *>(node);
-    eventQueue.push(newEvent);
-    eventSemaphore.release();
+    pushEvent(newEvent);
 }
 
-void Server::nodeConnectedEvent(const int &fd, const char ip[])
+Node *Server::nodeConnectedEvent(std::unique_ptr<Transport> transport, const std::string &ip)
 {
     Event newEvent;
     newEvent.type = Event::NodeConnected;
     newEvent.node =
-        new Node(fd,
+        new Node(std::move(transport),
                  ip,
                  std::bind(&Server::messageReceivedEvent, this, std::placeholders::_1, std::placeholders::_2),
                  std::bind(&Server::nodeDisconnectedEvent, this, std::placeholders::_1));
-    eventQueue.push(newEvent);
-    eventSemaphore.release();
+    pushEvent(newEvent);
+    return newEvent.node;
+}
+
+void Server::pushEvent(const Event &event)
+{
+    // Only the first event of an empty queue wakes the handler, which takes the whole queue once per wake up, so the
+    // semaphore never counts beyond 1
+    bool wasEmpty = false;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        wasEmpty = eventQueue.empty();
+        eventQueue.push(event);
+    }
+    eventQueueDepth.add();
+    if(wasEmpty && config.eventThread)
+    {
+        eventSemaphore.release();
+    }
 }
 
 void Server::handleEvent(Event event)
@@ -210,63 +410,326 @@ void Server::handleEvent(Event event)
     switch(event.type)
     {
     case Event::Invalid:
-        log("Invalid event received!", LogLevel::Error);
+        LOG_MESSAGE(LogLevel::Error, "Invalid event received!");
         break;
 
     case Event::NodeConnected:
         nodeList.addNode(event.node);
+        nodeDatabase.recordEvent(0, "connected", event.node->toString());
         event.node->start();
         break;
 
     case Event::NodeDisconnected:
+        nodeDatabase.recordEvent(event.node->getId(), "disconnected", event.node->toString());
+        serverNode.nodeRemoved(event.node);
         nodeList.removeNode(event.node);
         break;
 
     case Event::MessageReceived:
         if(event.message != nullptr)
         {
-            handleMessage(event.node, *event.message);
+            event.trace.mark(Metrics::Trace::Dequeue);
+            receiveToDispatch.record(std::chrono::steady_clock::now() - event.receivedTime);
+            handleMessage(event.node, *event.message, event.trace);
+            Metrics::Tracer::finish(event.trace);
             delete event.message;
         }
         else
         {
-            log("Message event with message == nullptr received in Server::handleEvent", LogLevel::Error);
+            LOG_MESSAGE(LogLevel::Error, "Message event with message == nullptr received in Server::handleEvent");
         }
         break;
 
+    case Event::Task:
+        event.task();
+        break;
+
+    case Event::Handoff:
+        completeHandoff(event.node);
+        break;
+
     default:
-        log("Unknown event received", LogLevel::Error);
+        LOG_MESSAGE(LogLevel::Error, "Unknown event received");
     }
 }
 
-void Server::handleMessage(const Node *node, const Message &message)
+void Server::handleMessage(Node *node, const Message &message, Metrics::Trace &trace)
 {
     if(node == nullptr)
     {
-        log("nullptr in Server::handleMessage", LogLevel::Error);
+        LOG_MESSAGE(LogLevel::Error, "nullptr in Server::handleMessage");
         return;
     }
 
-    if(message.getDestinationId() == serverId)
+    auto dispatchTime = std::chrono::steady_clock::now();
+    if(node->isRegistered() && !isClipData(message))
+    {
+        // Everything a registered node sends is kept in its history, rollups are updated once it is written.
+        // Clip data is the exception, it goes to the blob store only. Subscribers get the same.
+        if(!historyStore.append(node->getId(),
+                                Database::HistoryStore::getTimestamp(),
+                                message.getMessagePointer(),
+                                message.getMessageLen()))
+        {
+            historyRecordsDropped.add();
+        }
+        fanOut.publish(node->getId(), message.getMessagePointer(), message.getMessageLen());
+    }
+
+    trace.destinationId = message.getDestinationId();
+    if(isHandoffRequest(message))
+    {
+        startHandoff(node);
+    }
+    else if(message.getDestinationId() == serverId)
     {
-        serverNode.handleMessage(node, message);
+        try
+        {
+            trace.mark(Metrics::Trace::Route);
+            serverNode.handleMessage(node, message);
+            trace.mark(Metrics::Trace::Send);
+        }
+        catch(const std::exception &e)
+        {
+            LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in Server::handleMessage for server node message");
+        }
     }
     else if(node->isRegistered())
     {
         // Message destination is another node, send it to the other node
         try
         {
-            Node *destination = nodeList.getNodeById(node->getId());
+            Node *destination = nodeList.getNodeById(message.getDestinationId());
+            trace.mark(Metrics::Trace::Route);
             destination->sendMessage(message);
+            trace.mark(Metrics::Trace::Send);
+            messagesRouted.add();
+            dispatchToSend.record(std::chrono::steady_clock::now() - dispatchTime);
         }
         catch(const std::exception &e)
         {
-            log(std::string(e.what()) + " in Server::handleMessage", LogLevel::Error);
+            messagesUndeliverable.add();
+            LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in Server::handleMessage");
         }
     }
     else
     {
-        log("Unregistered node trying to send message to another node, sender node info: " + node->toString(),
-            LogLevel::Warning);
+        messagesUndeliverable.add();
+        LOG_MESSAGE(LogLevel::Warning,
+                    "Unregistered node trying to send message to another node, sender node info: " + node->toString());
+    }
+}
+
+bool Server::isClipData(const Message &message) const
+{
+    const uint8_t *payload = message.getPayloadPointer();
+    return message.getDestinationId() == serverId && payload != nullptr &&
+           static_cast<ServerProtocol::Command>(payload[0]) == ServerProtocol::Command::ClipData;
+}
+
+bool Server::isHandoffRequest(const Message &message) const
+{
+    const uint8_t *payload = message.getPayloadPointer();
+    return message.getDestinationId() == serverId && payload != nullptr &&
+           static_cast<ServerProtocol::Command>(payload[0]) == ServerProtocol::Command::Handoff;
+}
+
+void Server::startHandoff(Node *requester)
+{
+    // Only a process of the server's user on this host can take the sockets, it has to be on the local socket
+    uid_t peerUid = 0;
+    if(!requester->canPassFds() || !requester->getPeerUid(peerUid) || peerUid != geteuid() || handoffStarted)
+    {
+        LOG_MESSAGE(LogLevel::Warning, "Handoff request rejected from node: " + requester->toString());
+        return;
+    }
+
+    LOG_MESSAGE(LogLevel::Info, "Handing off connections to a new server process");
+    handoffStarted = true;
+    if(connectionListener.joinable())
+    {
+        connectionListener.join();
+    }
+    size_t stoppedNum = 0;
+    for(const Node *node : nodeList.getNodes())
+    {
+        if(const_cast<Node *>(node)->stopReading())
+            stoppedNum++;
     }
-}
\ No newline at end of file
+    LOG_MESSAGE(LogLevel::Info, "Stopped reading " + std::to_string(stoppedNum) + " connections");
+
+    // Messages the nodes read before they stopped are queued before this event, they are sent on when it comes
+    Event event;
+    event.type = Event::Handoff;
+    event.node = requester;
+    pushEvent(event);
+}
+
+void Server::completeHandoff(Node *requester)
+{
+    auto passSocket = [requester](HandoffKind kind, int fd, uint32_t nodeId, const std::string &address,
+                                  const std::vector<uint8_t> &pending) {
+        PayloadWriter packet;
+        packet.write(static_cast<uint8_t>(kind));
+        packet.write(nodeId);
+        packet.writeString<uint8_t>(address);
+        packet.write<uint32_t>(pending.size());
+        packet.writeBytes(pending.data(), pending.size());
+
+        std::vector<int> fds;
+        if(fd >= 0)
+            fds.push_back(fd);
+        requester->writeWithFds(packet.getPointer(), packet.getLen(), fds);
+    };
+
+    size_t passedNum = 0;
+    try
+    {
+        if(serverSocketFd >= 0)
+        {
+            passSocket(HandoffKind::Listener, serverSocketFd, 0, "", {});
+            close(serverSocketFd);
+            serverSocketFd = -1;
+        }
+        for(const Node *constNode : nodeList.getNodes())
+        {
+            Node                *node = const_cast<Node *>(constNode);
+            std::vector<uint8_t> pending;
+            int                  fd = node->releaseSocket(pending);
+            if(fd < 0)
+                continue;
+
+            // The socket stays open in the new process
+            passSocket(HandoffKind::Connection, fd, node->isRegistered() ? node->getId() : 0, node->getIp(), pending);
+            close(fd);
+            passedNum++;
+        }
+        passSocket(HandoffKind::End, -1, 0, "", {});
+    }
+    catch(const std::exception &e)
+    {
+        LOG_MESSAGE(LogLevel::Error, std::string(e.what()) + " in Server::completeHandoff, connections are lost");
+    }
+    LOG_MESSAGE(LogLevel::Info, "Handed off " + std::to_string(passedNum) + " connections");
+    handedOff = true;
+}
+
+Server::Handoff Server::takeOver(const std::string &localSocketPath)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(localSocketPath.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path too long in Server::takeOver: " + localSocketPath);
+    memcpy(address.sun_path, localSocketPath.c_str(), localSocketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        if(fd >= 0)
+            close(fd);
+        throw std::runtime_error("Unable to connect to " + localSocketPath + " in Server::takeOver");
+    }
+
+    Handoff handoff;
+    auto    fail = [&](const std::string &reason) {
+        close(fd);
+        if(handoff.listenerFd >= 0)
+            close(handoff.listenerFd);
+        for(const Handoff::Connection &connection : handoff.connections)
+            close(connection.fd);
+        throw std::runtime_error(reason + " in Server::takeOver");
+    };
+
+    PayloadWriter request;
+    request.write(static_cast<uint8_t>(ServerProtocol::Command::Handoff));
+    Message requestMessage(0, serverId, request.getPointer(), request.getLen());
+    if(send(fd, requestMessage.getMessagePointer(), requestMessage.getMessageLen(), MSG_NOSIGNAL) < 0)
+        fail("Unable to send the handoff request");
+
+    std::vector<uint8_t> packet(2 * Message::maxMessageLen);
+    bool                 done = false;
+    while(!done)
+    {
+        pollfd old = {fd, POLLIN, 0};
+        if(poll(&old, 1, handoffTimeoutMs) <= 0)
+            fail("Timeout waiting for the handoff");
+
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int))];
+        iovec                    iov = {packet.data(), packet.size()};
+        msghdr                   message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov        = &iov;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t len            = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        if(len <= 0)
+            fail("Server process gone during the handoff");
+
+        int      passedFd = -1;
+        cmsghdr *header   = CMSG_FIRSTHDR(&message);
+        if(header != nullptr && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+            memcpy(&passedFd, CMSG_DATA(header), sizeof(passedFd));
+
+        try
+        {
+            PayloadReader reader(packet.data(), len);
+            HandoffKind   kind = static_cast<HandoffKind>(reader.read<uint8_t>());
+            if(kind == HandoffKind::End)
+            {
+                done = true;
+                continue;
+            }
+            if(passedFd < 0)
+                throw std::runtime_error("no fd");
+
+            uint32_t       nodeId      = reader.read<uint32_t>();
+            std::string    peerAddress = reader.readString<uint8_t>();
+            uint32_t       pendingLen  = reader.read<uint32_t>();
+            const uint8_t *pending     = reader.readBytes(pendingLen);
+            if(kind == HandoffKind::Listener)
+            {
+                handoff.listenerFd = passedFd;
+                continue;
+            }
+
+            Handoff::Connection connection;
+            connection.fd      = passedFd;
+            connection.nodeId  = nodeId;
+            connection.address = peerAddress;
+            connection.pending.assign(pending, pending + pendingLen);
+            handoff.connections.push_back(std::move(connection));
+        }
+        catch(const std::exception &e)
+        {
+            if(passedFd >= 0)
+                close(passedFd);
+            fail("Invalid handoff packet: " + std::string(e.what()));
+        }
+    }
+
+    // The old process closes its stores on the way out, its end of the socket is closed last
+    pollfd old = {fd, POLLIN, 0};
+    if(poll(&old, 1, handoffTimeoutMs) <= 0 || recv(fd, packet.data(), packet.size(), 0) != 0)
+        fail("Server process did not exit after the handoff");
+    close(fd);
+    return handoff;
+}
+
+void Server::historyRecordWritten(const Database::HistoryStore::Record &record)
+{
+    uint32_t       destinationId = 0;
+    const uint8_t *payload       = nullptr;
+    size_t         payloadLen    = 0;
+    Message::viewFrame(record.payload, record.payloadLen, destinationId, payload, payloadLen);
+    if(destinationId != serverId || payloadLen == 0)
+        return;
+
+    PayloadReader reader(payload, payloadLen);
+    if(static_cast<ServerProtocol::Command>(reader.read<uint8_t>()) == ServerProtocol::Command::Telemetry)
+    {
+        auto sample = ServerProtocol::TelemetrySample::read(reader);
+        rollupStore.update(record.nodeId, sample.interfaceIndex, sample.fieldIndex, record.timestamp, sample.value);
+    }
+}
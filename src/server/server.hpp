@@ -1,30 +1,112 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <thread>
+#include <vector>
 #include <netdb.h>
 #include <semaphore>
+#include <mutex>
 #include <queue>
 
 #include "node/nodeList.hpp"
 #include "node/node.hpp"
+#include "node/sharedMemoryTransport.hpp"
 #include "message/message.hpp"
+#include "fanOut.hpp"
 #include "serverNode.hpp"
+#include "database/blobStore.hpp"
+#include "database/historyStore.hpp"
+#include "database/nodeDatabase.hpp"
+#include "database/registryStore.hpp"
+#include "database/rollupStore.hpp"
+#include "metrics/exporter.hpp"
+#include "metrics/registry.hpp"
+#include "metrics/tracer.hpp"
 #include "utilities/logger.hpp"
 
 class Server
 {
 public:
+    // Sockets a server process passes on to its successor, see takeOver
+    struct Handoff
+    {
+        struct Connection
+        {
+            int                  fd     = -1;
+            uint32_t             nodeId = 0; // 0 if not registered
+            std::string          address;
+            std::vector<uint8_t> pending; // Partial frame the old process read already
+        };
+
+        int                     listenerFd = -1; // TCP listener
+        std::vector<Connection> connections;
+    };
+
+    struct Config
+    {
+        uint16_t                  port         = 10000; // 0 for no listener, nodes are only added with addNode
+        bool                      eventThread  = true;  // False to handle events only in runEvents
+        Metrics::Exporter::Config metrics;
+
+        // Unix socket of local clients, each gets a SharedMemoryChannel to exchange frames through. Empty for none.
+        std::string sharedMemorySocketPath = "iot-shm.sock";
+
+        // Unix SOCK_SEQPACKET socket of local clients, every packet is one frame. Empty for none. Both Unix sockets are
+        // only accessible to the server's user, a handoff over this one is only done for a peer of that user.
+        std::string localSocketPath = "iot-local.sock";
+
+        // Sockets of the server process taken over, from takeOver
+        Handoff handoff;
+    };
+
     Server();
+    Server(const Config &config);
     ~Server();
 
+    // Adds a node on a transport of the caller, e.g. a simulated node on a MemoryTransport. The node is valid until
+    // its transport is closed with Node::receiveClose and the disconnect is handled.
+    Node *addNode(std::unique_ptr<Transport> transport, const std::string &address);
+
+    // Handles the queued events on the calling thread, for a server without event thread. Returns their number.
+    size_t runEvents();
+
+    /* Restart without dropping connections: a new server process connects to the local socket of the running one and
+     * sends a Handoff command. The running process stops accepting and reading TCP connections, sends on the messages
+     * it read already and passes its TCP listener and every TCP connection with SCM_RIGHTS, one packet each:
+     *
+     * | Kind (1) | Node ID (4) | Address len (1) | Address | Pending len (4) | Pending |
+     *
+     * A packet of kind End follows the last one, then the old process exits (see isHandedOff). takeOver returns once
+     * it is gone and its stores are closed, the result goes into Config::handoff of the new server. Nodes keep their
+     * connections and registrations, local clients and open queries of nodes are not passed on.
+     */
+    static Handoff takeOver(const std::string &localSocketPath);
+
+    // The connections went to a new server process, which waits for this one to exit
+    bool isHandedOff() const { return handedOff; }
+
 private:
     // Constant expressions
-    static constexpr uint32_t serverPort = 10000;
-    static constexpr uint32_t serverId   = 0;
+    static constexpr uint32_t serverId = 0;
     using LogLevel                       = Utilities::Logger::LogLevel;
 
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::Server;
+
+    static constexpr std::chrono::hours historyRetention = std::chrono::hours(24 * 30);
+
+    static constexpr int listenerPollTimeoutMs = 100;   // Upper bound of the wait for the destructor
+    static constexpr int handoffTimeoutMs      = 30000; // Of each step of takeOver
+
+    enum class HandoffKind : uint8_t
+    {
+        Listener = 1,
+        Connection,
+        End,
+    };
+
     // TODO: Improve events, use variant maybe
     struct Event
     {
@@ -35,13 +117,17 @@ private:
             NodeDisconnected,
             MessageReceived,
             Task,
+            Handoff, // Queued behind the messages of the nodes that stopped reading
             // And all possible events
         };
 
         EventType type;
 
-        Node *   node;
-        Message *message;
+        Node *                                node;
+        Message *                             message;
+        std::chrono::steady_clock::time_point receivedTime; // Of MessageReceived events
+        Metrics::Trace                        trace;        // Of sampled MessageReceived events
+        std::function<void()>                 task;         // Of Task events, runs on the event handler
 
         Event()
         {
@@ -53,34 +139,69 @@ private:
 
 
     // Variables
+    Config                     config;
     int                        serverSocketFd = -1;
     addrinfo *                 add_info       = nullptr;
     std::thread                connectionListener;
+    int                        sharedMemorySocketFd = -1;
+    int                        localSocketFd        = -1;
+    std::thread                localListener; // Of both Unix sockets
     std::thread                eventHandler;
     std::counting_semaphore<1> eventSemaphore;
+    std::mutex                 eventMutex; // Guards eventQueue, events come from every node data thread
     std::queue<Event>          eventQueue;
-    bool                       inDestruction = false;
+    std::atomic<bool>          inDestruction  = false;
+    std::atomic<bool>          handoffStarted = false;
+    std::atomic<bool>          handedOff      = false;
 
     // TaskManager taskManager;
-    NodeList   nodeList;
-    ServerNode serverNode;
+    Database::RegistryStore registryStore; // Restored into nodeList, constructed before it
+    NodeList                nodeList;
+    ServerNode              serverNode;
+    Database::RollupStore   rollupStore; // Updated from the history writer, constructed before historyStore
+    Database::HistoryStore  historyStore;
+    Database::NodeDatabase  nodeDatabase;
+    Database::BlobStore     blobStore;
+    Metrics::Exporter       metricsExporter;
+    FanOut                  fanOut;
+
+    // Metrics, see metrics/registry.hpp
+    Metrics::Gauge &eventQueueDepth =
+        Metrics::Registry::getGauge("iot_event_queue_depth", "Events waiting for the event handler");
+    Metrics::Counter &messagesRouted =
+        Metrics::Registry::getCounter("iot_messages_routed_total", "Messages sent on to their destination node");
+    Metrics::Counter &messagesUndeliverable = Metrics::Registry::getCounter(
+        "iot_messages_undeliverable_total", "Messages to unknown nodes or from unregistered ones");
+    Metrics::Counter &historyRecordsDropped = Metrics::Registry::getCounter(
+        "iot_history_records_dropped_total", "Messages missing from the history since its writer was behind");
+    Metrics::Histogram &receiveToDispatch = Metrics::Registry::getHistogram(
+        "iot_receive_to_dispatch_nanoseconds", "From a message being read to the event handler dispatching it");
+    Metrics::Histogram &dispatchToSend = Metrics::Registry::getHistogram(
+        "iot_dispatch_to_send_nanoseconds", "From dispatching a message to it being sent to its destination node");
 
     // Static functions
     static void connectionListenerProcess(Server *self);
+    static void localListenerProcess(Server *self);
+    static int  listenUnix(const std::string &path, int type);
     static void eventHandlerProcess(Server *self);
 
     // Member functions
-    std::string getServerInterfaceString() const;
-    void        nodeConnectedEvent(const int &fd, const char ip[]);
-    void        handleEvent(Event event);
-    void        handleMessage(const Node *node, const Message &message);
+    std::string                    getServerInterfaceString() const;
+    Database::HistoryStore::Config getHistoryStoreConfig();
+    void                           startListener();
+    void                           startLocalListener();
+    void                           adoptConnection(const Handoff::Connection &connection);
+    Node *                         nodeConnectedEvent(std::unique_ptr<Transport> transport, const std::string &ip);
+    void                           pushEvent(const Event &event);
+    void                           handleEvent(Event event);
+    void                           handleMessage(Node *node, const Message &message, Metrics::Trace &trace);
+    bool                           isClipData(const Message &message) const;
+    bool                           isHandoffRequest(const Message &message) const;
+    void                           startHandoff(Node *requester);
+    void                           completeHandoff(Node *requester);
 
     // Callbacks
     void messageReceivedEvent(const Node *node, const Message &message);
     void nodeDisconnectedEvent(const Node *node);
-
-    void log(const std::string &message, LogLevel logLevel = LogLevel::Info) const
-    {
-        Utilities::Logger::logMessage("Server:: " + message, logLevel);
-    }
+    void historyRecordWritten(const Database::HistoryStore::Record &record);
 };
@@ -1,16 +1,750 @@
+#include <algorithm>
+#include <climits>
+#include <future>
 #include <vector>
 
 #include "serverNode.hpp"
+#include "message/crc.hpp"
 
-ServerNode::ServerNode(std::string deviceInterfaceString)
+ServerNode::ServerNode(std::string                   deviceInterfaceString,
+                       NodeList *                    nodeList,
+                       Database::NodeDatabase *      nodeDatabase,
+                       const Database::HistoryStore *historyStore,
+                       Database::RollupStore *       rollupStore,
+                       Database::BlobStore *         blobStore,
+                       const Metrics::Exporter *     metricsExporter,
+                       FanOut *                      fanOut) :
+    nodeList(nodeList),
+    nodeDatabase(nodeDatabase),
+    historyStore(historyStore),
+    rollupStore(rollupStore),
+    blobStore(blobStore),
+    metricsExporter(metricsExporter),
+    fanOut(fanOut)
 {
     (void)deviceInterfaceString;
     // InterfaceParser interfaceParser;
     // deviceInterface = interfaceParser.parseDeviceInterface(deviceInterfaceString);
 }
 
-void ServerNode::handleMessage(const Node *node, const Message &message) const
+void ServerNode::handleMessage(Node *node, const Message &message)
 {
-    (void)node;
-    (void)message;
+    if(nodeList == nullptr)
+    {
+        throw std::runtime_error("ServerNode::handleMessage called without a node list");
+    }
+
+    PayloadReader reader(message.getPayloadPointer(), message.getPayloadLen());
+    Command       command = static_cast<Command>(reader.read<uint8_t>());
+    switch(command)
+    {
+    case Command::Register:
+        handleRegister(node, reader);
+        break;
+
+    case Command::Resume:
+        handleResume(node, reader);
+        break;
+
+    case Command::Telemetry:
+        // Telemetry is kept in the sender's history by the server, rollups are updated from there
+        if(!node->isRegistered())
+        {
+            LOG_MESSAGE(LogLevel::Warning, "Telemetry from unregistered node: " + node->toString());
+        }
+        else
+        {
+            handleTelemetry(node, message, reader);
+        }
+        break;
+
+    case Command::HistoryQuery:
+        handleHistoryQuery(node, reader);
+        break;
+
+    case Command::HistoryNext:
+        handleHistoryNext(node, reader);
+        break;
+
+    case Command::HistoryClose:
+        historyCursors.erase({node, reader.read<uint32_t>()});
+        break;
+
+    case Command::ClipBegin:
+        handleClipBegin(node, reader);
+        break;
+
+    case Command::ClipData:
+        handleClipData(node, reader);
+        break;
+
+    case Command::ClipEnd:
+        handleClipEnd(node, reader);
+        break;
+
+    case Command::ClipRequest:
+        handleClipRequest(node, reader);
+        break;
+
+    case Command::MetricsQuery:
+        handleMetricsQuery(node, reader);
+        break;
+
+    case Command::MetricsNext:
+        handleBinaryNext(node, reader, Command::MetricsPage, metricsCursors);
+        break;
+
+    case Command::ShadowQuery:
+        handleShadowQuery(node, reader);
+        break;
+
+    case Command::ShadowNext:
+        handleBinaryNext(node, reader, Command::ShadowPage, shadowCursors);
+        break;
+
+    case Command::NodesQuery:
+        handleNodesQuery(node, reader);
+        break;
+
+    case Command::NodesNext:
+        handleBinaryNext(node, reader, Command::NodesPage, nodesCursors);
+        break;
+
+    case Command::RollupQuery:
+        handleRollupQuery(node, reader);
+        break;
+
+    case Command::RollupNext:
+        handleBinaryNext(node, reader, Command::RollupPage, rollupCursors);
+        break;
+
+    case Command::Subscribe:
+        handleSubscribe(node, reader);
+        break;
+
+    case Command::Unsubscribe:
+        if(fanOut != nullptr)
+        {
+            fanOut->unsubscribe(reader.read<uint32_t>(), node);
+        }
+        break;
+
+    case Command::SubscribeMatch:
+        handleSubscribeMatch(node, reader);
+        break;
+
+    case Command::UnsubscribeMatch:
+        subscriptionIndex.remove(node, reader.read<uint32_t>());
+        break;
+
+    default:
+        LOG_FORMAT(LogLevel::Warning,
+                   "Unexpected command {} from node: {}",
+                   static_cast<int>(command),
+                   node->toString());
+    }
+}
+
+void ServerNode::handleRegister(Node *node, PayloadReader &reader) const
+{
+    // A second registration would leave the node listed under its previous ID as well
+    if(node->isRegistered())
+    {
+        LOG_FORMAT(LogLevel::Warning, "Ignored registration of already registered node: {}", node->toString());
+        return;
+    }
+
+    NodeRecord record;
+    record.name        = reader.readString<uint8_t>();
+    record.type        = reader.readString<uint8_t>();
+    record.description = reader.readString<uint16_t>();
+    record.options     = reader.read<uint32_t>();
+
+    uint32_t       interfaceLen = reader.read<uint32_t>();
+    const uint8_t *interface    = reader.readBytes(interfaceLen);
+
+    record.interfaceHash = Utilities::crc32_instance.calculate(interface, interfaceLen);
+    record.interface     = std::make_shared<const std::string>(reinterpret_cast<const char *>(interface), interfaceLen);
+
+    const NodeRecord &stored = nodeList->addRecord(std::move(record));
+    node->setRegistration(stored.id, stored.name, stored.type, stored.description);
+    nodeList->nodeRegistered(node);
+    LOG_FORMAT(LogLevel::Debug, "Node registered: {}", node->toString());
+
+    if(nodeDatabase != nullptr)
+    {
+        nodeDatabase->recordRegistration(stored.id,
+                                         stored.name,
+                                         stored.type,
+                                         stored.description,
+                                         stored.options,
+                                         stored.interfaceHash,
+                                         *stored.interface);
+    }
+
+    ServerProtocol::SessionToken token;
+    token.nodeId        = stored.id;
+    token.options       = stored.options;
+    token.interfaceHash = stored.interfaceHash;
+    token.secret        = stored.secret;
+
+    PayloadWriter body;
+    body.write(stored.id);
+    token.write(body);
+    sendResponse(node, Command::RegisterAck, body);
+}
+
+void ServerNode::handleResume(Node *node, PayloadReader &reader) const
+{
+    if(node->isRegistered())
+    {
+        LOG_FORMAT(LogLevel::Warning, "Rejected session resume of already registered node: {}", node->toString());
+        sendResponse(node, Command::ResumeRejected, PayloadWriter());
+        return;
+    }
+
+    ServerProtocol::SessionToken token = ServerProtocol::SessionToken::read(reader);
+
+    const NodeRecord *record = nodeList->findRecord(token.nodeId, token.options, token.interfaceHash, token.secret);
+    if(record == nullptr)
+    {
+        LOG_FORMAT(LogLevel::Debug, "Rejected session resume for id {}", token.nodeId);
+        sendResponse(node, Command::ResumeRejected, PayloadWriter());
+        return;
+    }
+
+    // Registration data and interface are taken from the stored record, nothing is parsed again
+    node->setRegistration(record->id, record->name, record->type, record->description);
+    nodeList->nodeRegistered(node);
+    LOG_FORMAT(LogLevel::Debug, "Node resumed session: {}", node->toString());
+
+    if(nodeDatabase != nullptr)
+    {
+        nodeDatabase->recordEvent(record->id, "resumed");
+    }
+
+    PayloadWriter body;
+    body.write(record->id);
+    sendResponse(node, Command::ResumeAck, body);
+}
+
+void ServerNode::nodeRemoved(const Node *node)
+{
+    historyCursors.erase(historyCursors.lower_bound({node, 0}), historyCursors.upper_bound({node, UINT32_MAX}));
+    metricsCursors.erase(metricsCursors.lower_bound({node, 0}), metricsCursors.upper_bound({node, UINT32_MAX}));
+    shadowCursors.erase(shadowCursors.lower_bound({node, 0}), shadowCursors.upper_bound({node, UINT32_MAX}));
+    nodesCursors.erase(nodesCursors.lower_bound({node, 0}), nodesCursors.upper_bound({node, UINT32_MAX}));
+    rollupCursors.erase(rollupCursors.lower_bound({node, 0}), rollupCursors.upper_bound({node, UINT32_MAX}));
+
+    // Unfinished uploads are dropped, their chunks stay available for deduplication
+    clipUploads.erase(clipUploads.lower_bound({node, 0}), clipUploads.upper_bound({node, UINT32_MAX}));
+    std::erase_if(finishingClips, [node](const auto &entry) { return entry.second.node == node; });
+
+    if(fanOut != nullptr)
+    {
+        fanOut->removeNode(node);
+    }
+    subscriptionIndex.removeNode(node);
+}
+
+void ServerNode::handleHistoryQuery(Node *node, PayloadReader &reader)
+{
+    ServerProtocol::HistoryQuery query = ServerProtocol::HistoryQuery::read(reader);
+
+    auto   first       = historyCursors.lower_bound({node, 0});
+    auto   last        = historyCursors.upper_bound({node, UINT32_MAX});
+    size_t openCursors = std::distance(first, last);
+    if(historyStore == nullptr || !node->isRegistered() || openCursors >= maxCursorsPerNode)
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Rejected history query from node: " + node->toString());
+        sendHistoryRejected(node, query.queryId);
+        return;
+    }
+
+    // Reusing the ID of an open query restarts it
+    HistoryCursor &historyCursor = historyCursors[{node, query.queryId}];
+    historyCursor.cursor         = historyStore->openCursor(query.nodeId, query.from, query.to);
+    historyCursor.interfaceIndex = query.interfaceIndex;
+    historyCursor.fieldIndex     = query.fieldIndex;
+    sendHistoryPages(node, query.queryId, historyCursor, query.pages);
+}
+
+void ServerNode::handleHistoryNext(Node *node, PayloadReader &reader)
+{
+    uint32_t queryId = reader.read<uint32_t>();
+    uint16_t pages   = reader.read<uint16_t>();
+
+    auto it = historyCursors.find({node, queryId});
+    if(it == historyCursors.end())
+    {
+        sendHistoryRejected(node, queryId);
+        return;
+    }
+    sendHistoryPages(node, queryId, it->second, pages);
+}
+
+void ServerNode::sendHistoryPages(Node *node, uint32_t queryId, HistoryCursor &historyCursor, uint16_t pages)
+{
+    using Record = Database::HistoryStore::Record;
+
+    constexpr size_t pageCapacity = historyPagePayloadLen - ServerProtocol::historyPageHeaderLen;
+
+    std::vector<Record> records;
+    bool                finished = false;
+    pages                        = std::clamp<uint16_t>(pages, 1, maxPagesPerRequest);
+    for(uint16_t page = 0; page < pages && !finished; page++)
+    {
+        // Records are collected as pointers into the segment mappings and written to the socket from there
+        records.clear();
+        size_t pageLen = 0;
+        finished       = !historyCursor.cursor.next([&](const Record &record) {
+            if(!matchesField(record, historyCursor.interfaceIndex, historyCursor.fieldIndex))
+                return true;
+
+            size_t recordLen = ServerProtocol::historyRecordHeaderLen + record.payloadLen;
+            if(recordLen > pageCapacity)
+            {
+                LOG_MESSAGE(LogLevel::Warning, "History record too large for a page, skipping it");
+                return true;
+            }
+            if(pageLen + recordLen > pageCapacity)
+                return false;
+
+            records.push_back(record);
+            pageLen += recordLen;
+            return true;
+        });
+
+        GatherMessage message(serverId, node->getId());
+        message.write(static_cast<uint8_t>(Command::HistoryPage));
+        message.write(queryId);
+        message.write(static_cast<uint8_t>(finished ? ServerProtocol::LastPage : 0));
+        message.write(static_cast<uint16_t>(records.size()));
+        for(const Record &record : records)
+        {
+            message.write(record.timestamp);
+            message.write(record.payloadLen);
+            message.addReference(record.payload, record.payloadLen);
+        }
+        node->sendMessage(message);
+    }
+
+    if(finished)
+    {
+        historyCursors.erase({node, queryId});
+    }
+}
+
+void ServerNode::sendHistoryRejected(const Node *node, uint32_t queryId) const
+{
+    PayloadWriter body;
+    body.write(queryId);
+    body.write(static_cast<uint8_t>(ServerProtocol::LastPage | ServerProtocol::Rejected));
+    body.write<uint16_t>(0);
+    sendResponse(node, Command::HistoryPage, body);
+}
+
+void ServerNode::handleClipBegin(Node *node, PayloadReader &reader)
+{
+    uint32_t    uploadId       = reader.read<uint32_t>();
+    uint64_t    eventTimestamp = reader.read<uint64_t>();
+    std::string event          = reader.readString<uint8_t>();
+
+    auto   first       = clipUploads.lower_bound({node, 0});
+    auto   last        = clipUploads.upper_bound({node, UINT32_MAX});
+    size_t openUploads = std::distance(first, last);
+    if(blobStore == nullptr || !node->isRegistered() || openUploads >= maxUploadsPerNode)
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Rejected clip upload from node: " + node->toString());
+        sendClipStored(node, uploadId, 0);
+        return;
+    }
+
+    clipUploads[{node, uploadId}] = blobStore->beginClip(node->getId(), eventTimestamp, event);
+}
+
+void ServerNode::handleClipData(Node *node, PayloadReader &reader)
+{
+    uint32_t uploadId = reader.read<uint32_t>();
+    size_t   dataLen  = reader.getRemainingLen();
+
+    // Data of rejected uploads is dropped, the node learns about it with ClipStored
+    auto it = clipUploads.find({node, uploadId});
+    if(it != clipUploads.end())
+    {
+        it->second->write(reader.readBytes(dataLen), dataLen);
+    }
+}
+
+void ServerNode::handleClipEnd(Node *node, PayloadReader &reader)
+{
+    uint32_t uploadId = reader.read<uint32_t>();
+    auto     it       = clipUploads.find({node, uploadId});
+    if(it == clipUploads.end())
+    {
+        sendClipStored(node, uploadId, 0);
+        return;
+    }
+
+    uint64_t finishId = nextFinishId++;
+    finishingClips[finishId] = {node, uploadId, it->second->getSize()};
+    std::shared_ptr<Database::BlobStore::Upload> upload = std::move(it->second);
+    clipUploads.erase(it);
+
+    // Syncing and recording the clip run on the blob store worker, ClipStored is sent once the clip is durable
+    if(taskRunner)
+    {
+        upload->finish([this, finishId](uint64_t clipId) {
+            taskRunner([this, finishId, clipId] { clipFinished(finishId, clipId); });
+        });
+        return;
+    }
+
+    std::promise<uint64_t> stored;
+    upload->finish([&stored](uint64_t clipId) { stored.set_value(clipId); });
+    clipFinished(finishId, stored.get_future().get());
+}
+
+void ServerNode::clipFinished(uint64_t finishId, uint64_t clipId)
+{
+    auto it = finishingClips.find(finishId);
+    if(it == finishingClips.end())
+        return;
+
+    FinishingClip clip = it->second;
+    finishingClips.erase(it);
+    if(clipId != 0 && nodeDatabase != nullptr)
+    {
+        nodeDatabase->recordEvent(
+            clip.node->getId(), "clip", "id=" + std::to_string(clipId) + ", size=" + std::to_string(clip.size));
+    }
+    sendClipStored(clip.node, clip.uploadId, clipId);
+}
+
+void ServerNode::handleClipRequest(Node *node, PayloadReader &reader) const
+{
+    uint64_t clipId = reader.read<uint64_t>();
+
+    // Only registered nodes read clips, others get the answer for an unknown clip
+    Database::BlobStore::Clip clip;
+    if(blobStore == nullptr || !node->isRegistered() || !blobStore->findClip(clipId, clip))
+    {
+        if(!node->isRegistered())
+            LOG_MESSAGE(LogLevel::Debug, "Rejected clip request from node: " + node->toString());
+        clip.chunks.clear();
+    }
+
+    // An unknown clip is answered with a single header without chunks
+    for(size_t i = 0; i < std::max<size_t>(clip.chunks.size(), 1); i++)
+    {
+        Database::BlobStore::Chunk chunk = i < clip.chunks.size() ? clip.chunks[i] : Database::BlobStore::Chunk();
+
+        PayloadWriter body;
+        body.write(clipId);
+        body.write(static_cast<uint32_t>(i));
+        body.write(static_cast<uint32_t>(clip.chunks.size()));
+        body.writeBytes(chunk.hash.data(), chunk.hash.size());
+        body.write(chunk.len);
+        sendResponse(node, Command::ClipChunk, body);
+
+        if(chunk.len > 0)
+        {
+            node->sendFile(blobStore->getPackFd(chunk.pack), chunk.offset, chunk.len);
+        }
+    }
+}
+
+void ServerNode::sendClipStored(const Node *node, uint32_t uploadId, uint64_t clipId) const
+{
+    PayloadWriter body;
+    body.write(uploadId);
+    body.write(clipId);
+    sendResponse(node, Command::ClipStored, body);
+}
+
+void ServerNode::handleSubscribe(Node *node, PayloadReader &reader)
+{
+    uint32_t publisherId = reader.read<uint32_t>();
+    if(fanOut == nullptr || !node->isRegistered() || publisherId == node->getId() || publisherId == serverId)
+    {
+        LOG_FORMAT(LogLevel::Warning, "Rejected subscription to {} from node: {}", publisherId, node->toString());
+        return;
+    }
+
+    // The publisher does not have to be connected or known yet
+    fanOut->subscribe(publisherId, node);
+    LOG_FORMAT(LogLevel::Debug, "Node {} subscribed to {}", node->getId(), publisherId);
+}
+
+void ServerNode::handleSubscribeMatch(Node *node, PayloadReader &reader)
+{
+    auto predicate = ServerProtocol::MatchPredicate::read(reader);
+
+    SubscriptionIndex::Predicate indexed;
+    indexed.nodeType       = predicate.nodeType;
+    indexed.interfaceIndex = predicate.interfaceIndex;
+    indexed.fieldIndex     = predicate.fieldIndex;
+    indexed.low            = predicate.low;
+    indexed.high           = predicate.high;
+    indexed.lowInclusive   = predicate.flags & ServerProtocol::MatchPredicate::LowInclusive;
+    indexed.highInclusive  = predicate.flags & ServerProtocol::MatchPredicate::HighInclusive;
+
+    // A replaced subscription does not count against the limit
+    subscriptionIndex.remove(node, predicate.subscriptionId);
+    if(fanOut == nullptr || !node->isRegistered() || subscriptionIndex.getSubscriptionsNum(node) >= maxMatchesPerNode ||
+       !subscriptionIndex.add(node, predicate.subscriptionId, indexed))
+    {
+        LOG_FORMAT(LogLevel::Warning,
+                   "Rejected match subscription {} from node: {}",
+                   predicate.subscriptionId,
+                   node->toString());
+        return;
+    }
+    LOG_FORMAT(LogLevel::Debug,
+               "Node {} subscribed to {} {}.{} in [{}, {}]",
+               node->getId(),
+               predicate.nodeType,
+               predicate.interfaceIndex,
+               predicate.fieldIndex,
+               predicate.low,
+               predicate.high);
+}
+
+void ServerNode::handleTelemetry(const Node *node, const Message &message, PayloadReader &reader)
+{
+    auto     sample    = ServerProtocol::TelemetrySample::read(reader);
+    uint64_t timestamp = Database::HistoryStore::getTimestamp();
+
+    // A node gets its shadow with its first sample, the layout follows from its interface
+    if(!deviceShadow.update(node->getId(), sample.interfaceIndex, sample.fieldIndex, timestamp, sample.value))
+    {
+        const NodeRecord *record = nodeList->getRecord(node->getId());
+        if(record != nullptr)
+        {
+            deviceShadow.addNode(node->getId(), record->interfaceHash);
+            deviceShadow.update(node->getId(), sample.interfaceIndex, sample.fieldIndex, timestamp, sample.value);
+        }
+    }
+    publishMatches(node, message, sample);
+}
+
+void ServerNode::publishMatches(const Node *node, const Message &message, const ServerProtocol::TelemetrySample &sample)
+{
+    if(fanOut == nullptr || subscriptionIndex.getSubscriptionsNum() == 0)
+        return;
+
+    matches.clear();
+    subscriptionIndex.match(node->getType(), sample.interfaceIndex, sample.fieldIndex, sample.value, matches);
+    if(matches.empty())
+        return;
+
+    // Once per subscriber, however many of its subscriptions matched
+    matchedSubscribers.clear();
+    for(const SubscriptionIndex::Match &match : matches)
+        matchedSubscribers.push_back(match.subscriber);
+    std::sort(matchedSubscribers.begin(), matchedSubscribers.end());
+    matchedSubscribers.erase(std::unique(matchedSubscribers.begin(), matchedSubscribers.end()),
+                             matchedSubscribers.end());
+    fanOut->deliver(matchedSubscribers, message.getMessagePointer(), message.getMessageLen());
+}
+
+void ServerNode::handleMetricsQuery(Node *node, PayloadReader &reader)
+{
+    uint32_t queryId = reader.read<uint32_t>();
+    uint16_t pages   = reader.read<uint16_t>();
+
+    auto   first       = metricsCursors.lower_bound({node, 0});
+    auto   last        = metricsCursors.upper_bound({node, UINT32_MAX});
+    size_t openCursors = std::distance(first, last);
+    if(metricsExporter == nullptr || !node->isRegistered() || openCursors >= maxCursorsPerNode)
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Rejected metrics query from node: " + node->toString());
+        sendBinaryRejected(node, Command::MetricsPage, queryId);
+        return;
+    }
+
+    // The snapshot is rendered by the exporter thread, the query only takes a reference to the latest one
+    auto          publication   = metricsExporter->getPublication();
+    BinaryCursor &metricsCursor = metricsCursors[{node, queryId}];
+    metricsCursor.binary        = std::shared_ptr<const std::vector<uint8_t>>(publication, &publication->binary);
+    metricsCursor.offset        = 0;
+    sendBinaryPages(node, Command::MetricsPage, metricsCursors, queryId, pages);
+}
+
+void ServerNode::handleShadowQuery(Node *node, PayloadReader &reader)
+{
+    auto query = ServerProtocol::ShadowQuery::read(reader);
+
+    auto   first       = shadowCursors.lower_bound({node, 0});
+    auto   last        = shadowCursors.upper_bound({node, UINT32_MAX});
+    size_t openCursors = std::distance(first, last);
+    if(!node->isRegistered() || openCursors >= maxCursorsPerNode)
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Rejected shadow query from node: " + node->toString());
+        sendBinaryRejected(node, Command::ShadowPage, query.queryId);
+        return;
+    }
+
+    // The fleet is serialized once per change however many apps ask, a single node on every query
+    BinaryCursor &shadowCursor = shadowCursors[{node, query.queryId}];
+    shadowCursor.offset        = 0;
+    if(query.nodeId == ServerProtocol::ShadowQuery::allNodes)
+    {
+        shadowCursor.binary = deviceShadow.getSerialized();
+    }
+    else
+    {
+        DeviceShadow::Snapshot snapshot;
+        if(auto nodeSnapshot = deviceShadow.getSnapshot(query.nodeId))
+        {
+            snapshot.reportedNum = nodeSnapshot->reportedNum;
+            snapshot.nodes.push_back(std::move(nodeSnapshot));
+        }
+        shadowCursor.binary = std::make_shared<const std::vector<uint8_t>>(DeviceShadow::serialize(snapshot));
+    }
+    sendBinaryPages(node, Command::ShadowPage, shadowCursors, query.queryId, query.pages);
+}
+
+void ServerNode::handleNodesQuery(Node *node, PayloadReader &reader)
+{
+    auto query = ServerProtocol::NodesQuery::read(reader);
+
+    auto   first       = nodesCursors.lower_bound({node, 0});
+    auto   last        = nodesCursors.upper_bound({node, UINT32_MAX});
+    size_t openCursors = std::distance(first, last);
+    if(!node->isRegistered() || openCursors >= maxCursorsPerNode)
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Rejected nodes query from node: " + node->toString());
+        sendBinaryRejected(node, Command::NodesPage, query.queryId);
+        return;
+    }
+
+    BinaryCursor &nodesCursor = nodesCursors[{node, query.queryId}];
+    nodesCursor.binary        = nodeList->getDirectory().getChanges(query.sinceVersion);
+    nodesCursor.offset        = 0;
+    sendBinaryPages(node, Command::NodesPage, nodesCursors, query.queryId, query.pages);
+}
+
+void ServerNode::handleRollupQuery(Node *node, PayloadReader &reader)
+{
+    auto query = ServerProtocol::RollupQuery::read(reader);
+
+    auto   first       = rollupCursors.lower_bound({node, 0});
+    auto   last        = rollupCursors.upper_bound({node, UINT32_MAX});
+    size_t openCursors = std::distance(first, last);
+    if(rollupStore == nullptr || !node->isRegistered() || openCursors >= maxCursorsPerNode ||
+       query.resolution >= Database::RollupStore::resolutionsNum)
+    {
+        LOG_MESSAGE(LogLevel::Debug, "Rejected rollup query from node: " + node->toString());
+        sendBinaryRejected(node, Command::RollupPage, query.queryId);
+        return;
+    }
+
+    auto buckets = rollupStore->query(query.nodeId,
+                                      query.interfaceIndex,
+                                      query.fieldIndex,
+                                      static_cast<Database::RollupStore::Resolution>(query.resolution),
+                                      query.from,
+                                      query.to);
+
+    PayloadWriter data;
+    data.write(static_cast<uint32_t>(buckets.size()));
+    for(const Database::RollupStore::Bucket &bucket : buckets)
+    {
+        data.write(bucket.start);
+        data.write(bucket.count);
+        data.write(bucket.min);
+        data.write(bucket.max);
+        data.write(bucket.sum);
+        data.write(bucket.last);
+    }
+
+    std::vector<uint8_t> binary(data.getPointer(), data.getPointer() + data.getLen());
+    BinaryCursor        &rollupCursor = rollupCursors[{node, query.queryId}];
+    rollupCursor.binary               = std::make_shared<const std::vector<uint8_t>>(std::move(binary));
+    rollupCursor.offset               = 0;
+    sendBinaryPages(node, Command::RollupPage, rollupCursors, query.queryId, query.pages);
+}
+
+void ServerNode::handleBinaryNext(Node                            *node,
+                                  PayloadReader                   &reader,
+                                  Command                          pageCommand,
+                                  std::map<NodeKey, BinaryCursor> &cursors)
+{
+    uint32_t queryId = reader.read<uint32_t>();
+    uint16_t pages   = reader.read<uint16_t>();
+
+    if(cursors.find({node, queryId}) == cursors.end())
+    {
+        sendBinaryRejected(node, pageCommand, queryId);
+        return;
+    }
+    sendBinaryPages(node, pageCommand, cursors, queryId, pages);
+}
+
+void ServerNode::sendBinaryPages(Node                            *node,
+                                 Command                          pageCommand,
+                                 std::map<NodeKey, BinaryCursor> &cursors,
+                                 uint32_t                         queryId,
+                                 uint16_t                         pages)
+{
+    constexpr size_t pageCapacity = Message::maxPayloadLen - ServerProtocol::metricsPageHeaderLen;
+
+    BinaryCursor               &cursor   = cursors.at({node, queryId});
+    const std::vector<uint8_t> &binary   = *cursor.binary;
+    bool                        finished = false;
+    pages                                = std::clamp<uint16_t>(pages, 1, maxPagesPerRequest);
+    for(uint16_t page = 0; page < pages && !finished; page++)
+    {
+        size_t len = std::min(pageCapacity, binary.size() - cursor.offset);
+        finished   = cursor.offset + len == binary.size();
+
+        GatherMessage message(serverId, node->getId());
+        message.write(static_cast<uint8_t>(pageCommand));
+        message.write(queryId);
+        message.write(static_cast<uint8_t>(finished ? ServerProtocol::LastPage : 0));
+        message.addReference(binary.data() + cursor.offset, len);
+        node->sendMessage(message);
+        cursor.offset += len;
+    }
+
+    if(finished)
+    {
+        cursors.erase({node, queryId});
+    }
+}
+
+void ServerNode::sendBinaryRejected(const Node *node, Command pageCommand, uint32_t queryId) const
+{
+    PayloadWriter body;
+    body.write(queryId);
+    body.write(static_cast<uint8_t>(ServerProtocol::LastPage | ServerProtocol::Rejected));
+    sendResponse(node, pageCommand, body);
+}
+
+bool ServerNode::matchesField(const Database::HistoryStore::Record &record, uint8_t interfaceIndex, uint8_t fieldIndex)
+{
+    if(interfaceIndex == ServerProtocol::HistoryQuery::anyIndex)
+        return true;
+
+    // Stored records are complete frames, only Telemetry to the server carries interface and field
+    uint32_t       destinationId = 0;
+    const uint8_t *payload       = nullptr;
+    size_t         payloadLen    = 0;
+    Message::viewFrame(record.payload, record.payloadLen, destinationId, payload, payloadLen);
+    if(destinationId != serverId || payloadLen < 3 || static_cast<Command>(payload[0]) != Command::Telemetry)
+        return false;
+
+    return payload[1] == interfaceIndex &&
+           (fieldIndex == ServerProtocol::HistoryQuery::anyIndex || payload[2] == fieldIndex);
+}
+
+void ServerNode::sendResponse(const Node *node, Command command, const PayloadWriter &body) const
+{
+    PayloadWriter payload;
+    payload.write(static_cast<uint8_t>(command));
+    payload.writeBytes(body.getPointer(), body.getLen());
+
+    Message response(serverId, node->getId(), payload.getPointer(), payload.getLen());
+    node->sendMessage(response);
 }
@@ -4,10 +4,23 @@
 #include <string>
 #include <thread>
 #include <functional>
+#include <map>
+#include <utility>
 
 #include "node/node.hpp"
+#include "node/nodeList.hpp"
+#include "database/blobStore.hpp"
+#include "database/historyStore.hpp"
+#include "database/nodeDatabase.hpp"
+#include "database/rollupStore.hpp"
+#include "deviceShadow.hpp"
+#include "fanOut.hpp"
 //#include "deviceInterface/deviceInterface.hpp"
 #include "message/message.hpp"
+#include "message/payload.hpp"
+#include "metrics/exporter.hpp"
+#include "serverProtocol.hpp"
+#include "subscriptionIndex.hpp"
 #include "utilities/logger.hpp"
 
 class ServerNode
@@ -15,18 +28,127 @@ class ServerNode
 public:
     ServerNode()  = default;
     ~ServerNode() = default;
-    ServerNode(std::string deviceInterfaceString);
 
-    void handleMessage(const Node *node, const Message &message) const;
+    // Open uploads are owned by the server node, it can only be moved
+    ServerNode(ServerNode &&)            = default;
+    ServerNode &operator=(ServerNode &&) = default;
+    ServerNode(std::string                   deviceInterfaceString,
+               NodeList *                    nodeList,
+               Database::NodeDatabase *      nodeDatabase,
+               const Database::HistoryStore *historyStore,
+               Database::RollupStore *       rollupStore,
+               Database::BlobStore *         blobStore,
+               const Metrics::Exporter *     metricsExporter,
+               FanOut *                      fanOut);
+
+    void handleMessage(Node *node, const Message &message);
+
+    // Drops the state kept for a node, called before the node is removed
+    void nodeRemoved(const Node *node);
+
+    // Runs tasks of other threads on the thread calling handleMessage, without it finishing a clip upload blocks
+    void setTaskRunner(std::function<void(std::function<void()>)> runner) { taskRunner = std::move(runner); }
 
 private:
     using LogLevel = Utilities::Logger::LogLevel;
 
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::ServerNode;
+
+    using Command  = ServerProtocol::Command;
+    using NodeKey  = std::pair<const Node *, uint32_t>;
+
+    static constexpr uint32_t serverId              = 0;
+    static constexpr size_t   maxCursorsPerNode     = 16;
+    static constexpr size_t   maxUploadsPerNode     = 4;
+    static constexpr size_t   maxMatchesPerNode     = 256; // Match subscriptions
+    static constexpr uint16_t maxPagesPerRequest    = 64;
+    static constexpr size_t   historyPagePayloadLen = Message::maxPayloadLen;
+
+    struct HistoryCursor
+    {
+        Database::HistoryStore::Cursor cursor;
+        uint8_t                        interfaceIndex;
+        uint8_t                        fieldIndex;
+    };
+
+    // Metrics, shadow and nodes queries, keeps the snapshot of the query alive until its last page is sent
+    struct BinaryCursor
+    {
+        std::shared_ptr<const std::vector<uint8_t>> binary;
+        size_t                                       offset = 0;
+    };
+
+    // Clip upload the blob store worker is finishing
+    struct FinishingClip
+    {
+        const Node *node;
+        uint32_t    uploadId;
+        uint64_t    size;
+    };
+
     // DeviceInterface::DeviceInterface deviceInterface;
+    NodeList *                    nodeList        = nullptr;
+    Database::NodeDatabase *      nodeDatabase    = nullptr; // Optional, registrations are not recorded without it
+    const Database::HistoryStore *historyStore    = nullptr; // Optional, history queries are rejected without it
+    Database::RollupStore *       rollupStore     = nullptr; // Optional, rollup queries are rejected without it
+    Database::BlobStore *         blobStore       = nullptr; // Optional, clip uploads are rejected without it
+    const Metrics::Exporter *     metricsExporter = nullptr; // Optional, metrics queries are rejected without it
+    FanOut *                      fanOut          = nullptr; // Optional, subscriptions are rejected without it
+
+    // Open history, metrics, shadow, nodes and rollup queries and clip uploads by node and query or upload ID
+    std::map<NodeKey, HistoryCursor>                                historyCursors;
+    std::map<NodeKey, BinaryCursor>                                 metricsCursors;
+    std::map<NodeKey, BinaryCursor>                                 shadowCursors;
+    std::map<NodeKey, BinaryCursor>                                 nodesCursors;
+    std::map<NodeKey, BinaryCursor>                                 rollupCursors;
+    std::map<NodeKey, std::shared_ptr<Database::BlobStore::Upload>> clipUploads;
+
+    // Finishing clip uploads by finish ID, a node removed in the meantime is not told about its clip
+    std::map<uint64_t, FinishingClip>          finishingClips;
+    uint64_t                                   nextFinishId = 0;
+    std::function<void(std::function<void()>)> taskRunner;
+
+    // Match subscriptions of all nodes, and the matches and subscribers of the sample being published
+    SubscriptionIndex                     subscriptionIndex;
+    std::vector<SubscriptionIndex::Match> matches;
+    std::vector<Node *>                   matchedSubscribers;
+
+    // Last telemetry values of all registered nodes
+    DeviceShadow deviceShadow;
+
+    void handleRegister(Node *node, PayloadReader &reader) const;
+    void handleResume(Node *node, PayloadReader &reader) const;
+    void handleHistoryQuery(Node *node, PayloadReader &reader);
+    void handleHistoryNext(Node *node, PayloadReader &reader);
+    void sendHistoryPages(Node *node, uint32_t queryId, HistoryCursor &historyCursor, uint16_t pages);
+    void sendHistoryRejected(const Node *node, uint32_t queryId) const;
+    void handleClipBegin(Node *node, PayloadReader &reader);
+    void handleClipData(Node *node, PayloadReader &reader);
+    void handleClipEnd(Node *node, PayloadReader &reader);
+    void clipFinished(uint64_t finishId, uint64_t clipId);
+    void handleClipRequest(Node *node, PayloadReader &reader) const;
+    void sendClipStored(const Node *node, uint32_t uploadId, uint64_t clipId) const;
+    void handleMetricsQuery(Node *node, PayloadReader &reader);
+    void handleShadowQuery(Node *node, PayloadReader &reader);
+    void handleNodesQuery(Node *node, PayloadReader &reader);
+    void handleRollupQuery(Node *node, PayloadReader &reader);
+    void handleBinaryNext(Node                            *node,
+                          PayloadReader                   &reader,
+                          Command                          pageCommand,
+                          std::map<NodeKey, BinaryCursor> &cursors);
+    void sendBinaryPages(Node                            *node,
+                         Command                          pageCommand,
+                         std::map<NodeKey, BinaryCursor> &cursors,
+                         uint32_t                         queryId,
+                         uint16_t                         pages);
+    void sendBinaryRejected(const Node *node, Command pageCommand, uint32_t queryId) const;
+    void handleSubscribe(Node *node, PayloadReader &reader);
+    void handleSubscribeMatch(Node *node, PayloadReader &reader);
+    void handleTelemetry(const Node *node, const Message &message, PayloadReader &reader);
+    void publishMatches(const Node *node, const Message &message, const ServerProtocol::TelemetrySample &sample);
+    void sendResponse(const Node *node, Command command, const PayloadWriter &body) const;
+
+    static bool matchesField(const Database::HistoryStore::Record &record, uint8_t interfaceIndex, uint8_t fieldIndex);
 
     static void dataThreadProcessor(ServerNode *self);
-    void        log(const std::string &message, LogLevel logLevel = LogLevel::Info) const
-    {
-        Utilities::Logger::logMessage("ServerNode:: " + message, logLevel);
-    }
-};
\ No newline at end of file
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "message/payload.hpp"
+
+namespace ServerProtocol
+{
+/* Messages with destination ID 0 are addressed to the server node, their payload format:
+ *
+ * | Field   | Size    | Type     |
+ * |---------|---------|----------|
+ * | Command | 1 byte  | uint8_t  |
+ * | Body    | n bytes | raw data |
+ *
+ * Command bodies:
+ *
+ * Register:       | Name len (1) | Name | Type len (1) | Type | Description len (2) | Description |
+ *                 | Options (4) | Interface len (4) | Interface |
+ * RegisterAck:    | Node ID (4) | Session token (20) |
+ * Resume:         | Session token (20) |
+ * ResumeAck:      | Node ID (4) |
+ * ResumeRejected: empty, node has to register again, also the answer to a Resume from a registered node
+ * Telemetry:      | Interface index (1) | Field index (1) | Value (8, double) |
+ * HistoryQuery:   | Query ID (4) | Node ID (4) | From (8) | To (8) | Interface index (1) | Field index (1) |
+ *                 | Pages (2) |
+ * HistoryNext:    | Query ID (4) | Pages (2) |
+ * HistoryClose:   | Query ID (4) |
+ * HistoryPage:    | Query ID (4) | Flags (1) | Records num (2) | Records |
+ *
+ * ClipBegin:      | Upload ID (4) | Event timestamp (8) | Event len (1) | Event |
+ * ClipData:       | Upload ID (4) | Data |
+ * ClipEnd:        | Upload ID (4) |
+ * ClipStored:     | Upload ID (4) | Clip ID (8) |
+ * ClipRequest:    | Clip ID (8) |, from registered nodes only
+ * ClipChunk:      | Clip ID (8) | Chunk index (4) | Chunks num (4) | SHA-256 (32) | Chunk len (4) |
+ *
+ * MetricsQuery:   | Query ID (4) | Pages (2) |
+ * MetricsNext:    | Query ID (4) | Pages (2) |
+ * MetricsPage:    | Query ID (4) | Flags (1) | Data |
+ *
+ * Subscribe:      | Publisher node ID (4) |
+ * Unsubscribe:    | Publisher node ID (4) |
+ * SubscribeMatch: | Subscription ID (4) | Type len (1) | Type | Interface index (1) | Field index (1) | Flags (1) |
+ *                 | Low (8, double) | High (8, double) |
+ * UnsubscribeMatch: | Subscription ID (4) |
+ *
+ * ShadowQuery:    | Query ID (4) | Node ID (4) | Pages (2) |
+ * ShadowNext:     | Query ID (4) | Pages (2) |
+ * ShadowPage:     | Query ID (4) | Flags (1) | Data |
+ *
+ * NodesQuery:     | Query ID (4) | Since version (8) | Pages (2) |
+ * NodesNext:      | Query ID (4) | Pages (2) |
+ * NodesPage:      | Query ID (4) | Flags (1) | Data |
+ *
+ * RollupQuery:    | Query ID (4) | Node ID (4) | Interface index (1) | Field index (1) | Resolution (1) | From (8) |
+ *                 | To (8) | Pages (2) |
+ * RollupNext:     | Query ID (4) | Pages (2) |
+ * RollupPage:     | Query ID (4) | Flags (1) | Data |
+ *
+ * Handoff:        empty, from a new server process on the local socket, see Server::takeOver
+ *
+ * History queries open a cursor on the server, every HistoryQuery and HistoryNext is answered with up to Pages
+ * HistoryPage messages. Each page record is | Timestamp (8) | Frame len (4) | Frame | where frame is the message
+ * as the node sent it. The cursor is closed after the page flagged as last.
+ *
+ * Clips (e.g. camera recordings) are uploaded as ClipData messages between ClipBegin and ClipEnd, the event
+ * timestamp links the clip to the record in the node's history that triggered it. ClipStored returns clip ID 0 if
+ * the upload failed. A ClipRequest is answered with one ClipChunk per chunk, each followed on the connection by
+ * Chunk len raw bytes of the clip that are not framed as a message. Chunks num 0 means the clip is unknown.
+ *
+ * A MetricsQuery takes the latest metrics snapshot of the server in binary form (see metrics/exporter.hpp), it is
+ * sent in consecutive parts of up to Pages MetricsPage messages per MetricsQuery and MetricsNext. Flags are the ones
+ * of HistoryPage, the query is closed after the last page.
+ *
+ * A registered node that subscribes to a publisher gets every frame the publisher sends from then on as it was sent,
+ * clip data excepted: source ID is the publisher's, destination ID the one it addressed. Frames are dropped for a
+ * subscriber that does not read them fast enough, see server/fanOut.hpp. Subscriptions end with the connection.
+ *
+ * A match subscription gets the Telemetry frames of every registered node of the type whose sample of the field lies
+ * between Low and High, infinite for an open side, e.g. "any thermostat's temperature > 30". The ends are included as
+ * flagged. A frame matching several subscriptions of a node is sent to it once. SubscribeMatch with the ID of an
+ * existing subscription replaces it, see server/subscriptionIndex.hpp.
+ *
+ * The server keeps the last Telemetry value of every field of every registered node. A ShadowQuery reads them for one
+ * node, or for all nodes with Node ID 0, without asking the devices; it is paged like a MetricsQuery. The data is a
+ * serialized snapshot, see server/deviceShadow.hpp.
+ *
+ * A NodesQuery returns the changes of the list of connected registered nodes since the version the app got last, or
+ * the full list if that version is too old, e.g. Since version 0. The data starts with the current version to ask
+ * with next time, it is paged like a MetricsQuery, see node/nodeDirectory.hpp.
+ *
+ * A RollupQuery returns the minute, hour or day buckets (Resolution 0, 1 or 2) of a Telemetry field of a node whose
+ * start lies between From and To, see database/rollupStore.hpp. It is paged like a MetricsQuery, the data is
+ * | Buckets num (4) | Buckets | in start order with every bucket
+ * | Start (8) | Count (8) | Min (8, double) | Max (8, double) | Sum (8, double) | Last (8, double) |.
+ */
+enum class Command : uint8_t
+{
+    Invalid = 0,
+    Register,
+    RegisterAck,
+    Resume,
+    ResumeAck,
+    ResumeRejected,
+    Telemetry,
+    HistoryQuery,
+    HistoryNext,
+    HistoryClose,
+    HistoryPage,
+    ClipBegin,
+    ClipData,
+    ClipEnd,
+    ClipStored,
+    ClipRequest,
+    ClipChunk,
+    MetricsQuery,
+    MetricsNext,
+    MetricsPage,
+    Handoff,
+    Subscribe,
+    Unsubscribe,
+    SubscribeMatch,
+    UnsubscribeMatch,
+    ShadowQuery,
+    ShadowNext,
+    ShadowPage,
+    NodesQuery,
+    NodesNext,
+    NodesPage,
+    RollupQuery,
+    RollupNext,
+    RollupPage,
+};
+
+/* Session token handed out at registration, presenting it on reconnect restores the registration
+ * without exchanging the interface again:
+ *
+ * | Field          | Size    | Type     |
+ * |----------------|---------|----------|
+ * | Node ID        | 4 bytes | uint32_t |
+ * | Options        | 4 bytes | uint32_t |
+ * | Interface hash | 4 bytes | uint32_t |
+ * | Secret         | 8 bytes | uint64_t |
+ */
+struct SessionToken
+{
+    static constexpr size_t tokenLen = 20;
+
+    uint32_t nodeId        = 0;
+    uint32_t options       = 0;
+    uint32_t interfaceHash = 0;
+    uint64_t secret        = 0;
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(nodeId);
+        writer.write(options);
+        writer.write(interfaceHash);
+        writer.write(secret);
+    }
+
+    static SessionToken read(PayloadReader &reader)
+    {
+        SessionToken token;
+        token.nodeId        = reader.read<uint32_t>();
+        token.options       = reader.read<uint32_t>();
+        token.interfaceHash = reader.read<uint32_t>();
+        token.secret        = reader.read<uint64_t>();
+        return token;
+    }
+};
+// Value of one interface field reported by a registered node
+struct TelemetrySample
+{
+    uint8_t interfaceIndex = 0;
+    uint8_t fieldIndex     = 0;
+    double  value          = 0;
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(interfaceIndex);
+        writer.write(fieldIndex);
+        writer.write(value);
+    }
+
+    static TelemetrySample read(PayloadReader &reader)
+    {
+        TelemetrySample sample;
+        sample.interfaceIndex = reader.read<uint8_t>();
+        sample.fieldIndex     = reader.read<uint8_t>();
+        sample.value          = reader.read<double>();
+        return sample;
+    }
+};
+
+// Time range query over the history of a node, only Telemetry records of the given field are returned
+// unless the indices are anyIndex
+struct HistoryQuery
+{
+    static constexpr uint8_t anyIndex = 0xFF;
+
+    uint32_t queryId        = 0;
+    uint32_t nodeId         = 0;
+    uint64_t from           = 0; // Nanoseconds since epoch
+    uint64_t to             = 0;
+    uint8_t  interfaceIndex = anyIndex;
+    uint8_t  fieldIndex     = anyIndex;
+    uint16_t pages          = 1;
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(queryId);
+        writer.write(nodeId);
+        writer.write(from);
+        writer.write(to);
+        writer.write(interfaceIndex);
+        writer.write(fieldIndex);
+        writer.write(pages);
+    }
+
+    static HistoryQuery read(PayloadReader &reader)
+    {
+        HistoryQuery query;
+        query.queryId        = reader.read<uint32_t>();
+        query.nodeId         = reader.read<uint32_t>();
+        query.from           = reader.read<uint64_t>();
+        query.to             = reader.read<uint64_t>();
+        query.interfaceIndex = reader.read<uint8_t>();
+        query.fieldIndex     = reader.read<uint8_t>();
+        query.pages          = reader.read<uint16_t>();
+        return query;
+    }
+};
+
+// Range predicate of a SubscribeMatch over a field of every node of a type
+struct MatchPredicate
+{
+    enum Flags : uint8_t
+    {
+        LowInclusive  = 1 << 0,
+        HighInclusive = 1 << 1,
+    };
+
+    uint32_t    subscriptionId = 0;
+    std::string nodeType;
+    uint8_t     interfaceIndex = 0;
+    uint8_t     fieldIndex     = 0;
+    uint8_t     flags          = LowInclusive | HighInclusive;
+    double      low            = -std::numeric_limits<double>::infinity();
+    double      high           = std::numeric_limits<double>::infinity();
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(subscriptionId);
+        writer.writeString<uint8_t>(nodeType);
+        writer.write(interfaceIndex);
+        writer.write(fieldIndex);
+        writer.write(flags);
+        writer.write(low);
+        writer.write(high);
+    }
+
+    static MatchPredicate read(PayloadReader &reader)
+    {
+        MatchPredicate predicate;
+        predicate.subscriptionId = reader.read<uint32_t>();
+        predicate.nodeType       = reader.readString<uint8_t>();
+        predicate.interfaceIndex = reader.read<uint8_t>();
+        predicate.fieldIndex     = reader.read<uint8_t>();
+        predicate.flags          = reader.read<uint8_t>();
+        predicate.low            = reader.read<double>();
+        predicate.high           = reader.read<double>();
+        return predicate;
+    }
+};
+
+// Last values of one node or of the fleet
+struct ShadowQuery
+{
+    static constexpr uint32_t allNodes = 0;
+
+    uint32_t queryId = 0;
+    uint32_t nodeId  = allNodes;
+    uint16_t pages   = 1;
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(queryId);
+        writer.write(nodeId);
+        writer.write(pages);
+    }
+
+    static ShadowQuery read(PayloadReader &reader)
+    {
+        ShadowQuery query;
+        query.queryId = reader.read<uint32_t>();
+        query.nodeId  = reader.read<uint32_t>();
+        query.pages   = reader.read<uint16_t>();
+        return query;
+    }
+};
+
+// Changes of the connected nodes list since a version
+struct NodesQuery
+{
+    uint32_t queryId      = 0;
+    uint64_t sinceVersion = 0;
+    uint16_t pages        = 1;
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(queryId);
+        writer.write(sinceVersion);
+        writer.write(pages);
+    }
+
+    static NodesQuery read(PayloadReader &reader)
+    {
+        NodesQuery query;
+        query.queryId      = reader.read<uint32_t>();
+        query.sinceVersion = reader.read<uint64_t>();
+        query.pages        = reader.read<uint16_t>();
+        return query;
+    }
+};
+
+// Aggregates of a field of a node over a time range
+struct RollupQuery
+{
+    uint32_t queryId        = 0;
+    uint32_t nodeId         = 0;
+    uint8_t  interfaceIndex = 0;
+    uint8_t  fieldIndex     = 0;
+    uint8_t  resolution     = 0; // Database::RollupStore::Resolution
+    uint64_t from           = 0; // Nanoseconds since epoch
+    uint64_t to             = 0;
+    uint16_t pages          = 1;
+
+    void write(PayloadWriter &writer) const
+    {
+        writer.write(queryId);
+        writer.write(nodeId);
+        writer.write(interfaceIndex);
+        writer.write(fieldIndex);
+        writer.write(resolution);
+        writer.write(from);
+        writer.write(to);
+        writer.write(pages);
+    }
+
+    static RollupQuery read(PayloadReader &reader)
+    {
+        RollupQuery query;
+        query.queryId        = reader.read<uint32_t>();
+        query.nodeId         = reader.read<uint32_t>();
+        query.interfaceIndex = reader.read<uint8_t>();
+        query.fieldIndex     = reader.read<uint8_t>();
+        query.resolution     = reader.read<uint8_t>();
+        query.from           = reader.read<uint64_t>();
+        query.to             = reader.read<uint64_t>();
+        query.pages          = reader.read<uint16_t>();
+        return query;
+    }
+};
+
+// Flags of a HistoryPage, a MetricsPage, a ShadowPage, a NodesPage and a RollupPage
+enum HistoryPageFlags : uint8_t
+{
+    LastPage = 1 << 0,
+    Rejected = 1 << 1, // Unknown query ID, too many open queries or no history available
+};
+
+constexpr size_t historyPageHeaderLen   = 1 + 4 + 1 + 2; // Command, query ID, flags, records num
+constexpr size_t historyRecordHeaderLen = 8 + 4;         // Timestamp, frame len
+constexpr size_t metricsPageHeaderLen   = 1 + 4 + 1;     // Command, query ID, flags
+} // namespace ServerProtocol
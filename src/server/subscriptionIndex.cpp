@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iterator>
+
+#include "subscriptionIndex.hpp"
+
+double SubscriptionIndex::Entry::getInnerPoint() const
+{
+    if(low == -unbounded && high == unbounded)
+        return 0;
+    if(low == -unbounded)
+        return highInclusive ? high : std::nextafter(high, -unbounded);
+    if(high == unbounded)
+        return lowInclusive ? low : std::nextafter(low, unbounded);
+
+    double middle = low / 2 + high / 2;
+    if(contains(middle))
+        return middle;
+    return lowInclusive ? low : high;
+}
+
+bool SubscriptionIndex::add(Node *subscriber, uint32_t subscriptionId, const Predicate &predicate)
+{
+    Entry entry{predicate.low,
+                predicate.high,
+                predicate.lowInclusive,
+                predicate.highInclusive,
+                subscriber,
+                subscriptionId};
+    if(std::isnan(entry.low) || std::isnan(entry.high) || !entry.contains(entry.getInnerPoint()))
+        return false;
+
+    remove(subscriber, subscriptionId);
+
+    uint16_t    fieldKey = getFieldKey(predicate.interfaceIndex, predicate.fieldIndex);
+    FieldIndex &field    = types[predicate.nodeType][fieldKey];
+    field.entries.push_back(entry);
+    field.dirty = true;
+    locations.emplace(SubscriptionKey(subscriber, subscriptionId), std::make_pair(predicate.nodeType, fieldKey));
+    return true;
+}
+
+void SubscriptionIndex::remove(const Node *subscriber, uint32_t subscriptionId)
+{
+    auto location = locations.find({subscriber, subscriptionId});
+    if(location == locations.end())
+        return;
+
+    auto type = types.find(location->second.first);
+    if(type != types.end())
+    {
+        auto field = type->second.find(location->second.second);
+        if(field != type->second.end())
+        {
+            std::erase_if(field->second.entries, [&](const Entry &entry) {
+                return entry.subscriber == subscriber && entry.subscriptionId == subscriptionId;
+            });
+            field->second.dirty = true;
+            if(field->second.entries.empty())
+                type->second.erase(field);
+        }
+        if(type->second.empty())
+            types.erase(type);
+    }
+    locations.erase(location);
+}
+
+void SubscriptionIndex::removeNode(const Node *subscriber)
+{
+    std::vector<uint32_t> subscriptionIds;
+    auto                  first = locations.lower_bound({subscriber, 0});
+    auto                  last  = locations.upper_bound({subscriber, UINT32_MAX});
+    for(auto location = first; location != last; location++)
+        subscriptionIds.push_back(location->first.second);
+
+    for(uint32_t subscriptionId : subscriptionIds)
+        remove(subscriber, subscriptionId);
+}
+
+size_t SubscriptionIndex::getSubscriptionsNum(const Node *subscriber) const
+{
+    return std::distance(locations.lower_bound({subscriber, 0}), locations.upper_bound({subscriber, UINT32_MAX}));
+}
+
+void SubscriptionIndex::match(std::string_view     nodeType,
+                              uint8_t              interfaceIndex,
+                              uint8_t              fieldIndex,
+                              double               value,
+                              std::vector<Match> &matches)
+{
+    auto type = types.find(nodeType);
+    if(type == types.end() || std::isnan(value))
+        return;
+    auto fieldEntry = type->second.find(getFieldKey(interfaceIndex, fieldIndex));
+    if(fieldEntry == type->second.end())
+        return;
+
+    FieldIndex &field = fieldEntry->second;
+    if(field.dirty)
+        field.build();
+
+    // Below the center of a tree node only the low ends of its entries decide, above it only the high ends
+    for(int32_t nodeIndex = field.tree.empty() ? -1 : 0; nodeIndex >= 0;)
+    {
+        const TreeNode &node = field.tree[nodeIndex];
+        if(value < node.center)
+        {
+            for(uint32_t i = node.begin; i < node.end; i++)
+            {
+                const Entry &entry = field.entries[field.byLow[i]];
+                if(!entry.reachesDown(value))
+                    break;
+                matches.push_back({entry.subscriber, entry.subscriptionId});
+            }
+            nodeIndex = node.left;
+        }
+        else if(value > node.center)
+        {
+            for(uint32_t i = node.begin; i < node.end; i++)
+            {
+                const Entry &entry = field.entries[field.byHigh[i]];
+                if(!entry.reachesUp(value))
+                    break;
+                matches.push_back({entry.subscriber, entry.subscriptionId});
+            }
+            nodeIndex = node.right;
+        }
+        else
+        {
+            for(uint32_t i = node.begin; i < node.end; i++)
+            {
+                const Entry &entry = field.entries[field.byLow[i]];
+                matches.push_back({entry.subscriber, entry.subscriptionId});
+            }
+            nodeIndex = -1;
+        }
+    }
+}
+
+void SubscriptionIndex::FieldIndex::build()
+{
+    tree.clear();
+    byLow.clear();
+    byHigh.clear();
+    byLow.reserve(entries.size());
+    byHigh.reserve(entries.size());
+
+    std::vector<uint32_t> indexes(entries.size());
+    for(uint32_t i = 0; i < indexes.size(); i++)
+        indexes[i] = i;
+    build(indexes);
+    dirty = false;
+}
+
+int32_t SubscriptionIndex::FieldIndex::build(std::vector<uint32_t> &indexes)
+{
+    if(indexes.empty())
+        return -1;
+
+    // The median of the finite ends splits the entries about evenly
+    std::vector<double> ends;
+    ends.reserve(indexes.size() * 2);
+    for(uint32_t index : indexes)
+    {
+        if(std::isfinite(entries[index].low))
+            ends.push_back(entries[index].low);
+        if(std::isfinite(entries[index].high))
+            ends.push_back(entries[index].high);
+    }
+    double center = 0;
+    if(!ends.empty())
+    {
+        std::nth_element(ends.begin(), ends.begin() + ends.size() / 2, ends.end());
+        center = ends[ends.size() / 2];
+    }
+
+    std::vector<uint32_t> here;
+    std::vector<uint32_t> below;
+    std::vector<uint32_t> above;
+    auto                  split = [&] {
+        here.clear();
+        below.clear();
+        above.clear();
+        for(uint32_t index : indexes)
+        {
+            const Entry &entry = entries[index];
+            if(entry.contains(center))
+                here.push_back(index);
+            else if(!entry.reachesUp(center))
+                below.push_back(index);
+            else
+                above.push_back(index);
+        }
+    };
+    split();
+    if(here.empty())
+    {
+        // Open ends at the median, a center inside one entry keeps every level smaller than the one above
+        center = entries[indexes.front()].getInnerPoint();
+        split();
+    }
+
+    int32_t nodeIndex = static_cast<int32_t>(tree.size());
+    tree.push_back({center, static_cast<uint32_t>(byLow.size()), static_cast<uint32_t>(byLow.size() + here.size())});
+
+    std::sort(here.begin(), here.end(), [&](uint32_t a, uint32_t b) {
+        const Entry &first  = entries[a];
+        const Entry &second = entries[b];
+        return first.low < second.low ||
+               (first.low == second.low && first.lowInclusive && !second.lowInclusive);
+    });
+    byLow.insert(byLow.end(), here.begin(), here.end());
+    std::sort(here.begin(), here.end(), [&](uint32_t a, uint32_t b) {
+        const Entry &first  = entries[a];
+        const Entry &second = entries[b];
+        return first.high > second.high ||
+               (first.high == second.high && first.highInclusive && !second.highInclusive);
+    });
+    byHigh.insert(byHigh.end(), here.begin(), here.end());
+
+    int32_t left          = build(below);
+    int32_t right         = build(above);
+    tree[nodeIndex].left  = left;
+    tree[nodeIndex].right = right;
+    return nodeIndex;
+}
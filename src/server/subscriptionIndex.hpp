@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "node/node.hpp"
+
+/* Content based subscriptions: predicates over the telemetry values of every node of a type, e.g. "field 2 of
+ * interface 0 of any thermostat > 30". Predicates are indexed by node type, interface index and field index, the
+ * predicates of one field are an interval tree over their value ranges. A sample only visits the tree of its field
+ * and in it the predicates whose range reaches the side of the sample, O(log n + matches) instead of every predicate.
+ * The tree of a field is rebuilt on the first match after its predicates changed, subscriptions are expected to
+ * change far less often than telemetry arrives. Used from the event thread only.
+ */
+class SubscriptionIndex
+{
+public:
+    static constexpr double unbounded = std::numeric_limits<double>::infinity();
+
+    // Value range of the predicate, -unbounded and unbounded for one sided ranges
+    struct Predicate
+    {
+        std::string nodeType;
+        uint8_t     interfaceIndex = 0;
+        uint8_t     fieldIndex     = 0;
+        double      low            = -unbounded;
+        double      high           = unbounded;
+        bool        lowInclusive   = true;
+        bool        highInclusive  = true;
+    };
+
+    struct Match
+    {
+        Node    *subscriber     = nullptr;
+        uint32_t subscriptionId = 0;
+    };
+
+    // Adds or replaces the subscription of the subscriber, false if the range is empty or not a number
+    bool add(Node *subscriber, uint32_t subscriptionId, const Predicate &predicate);
+    void remove(const Node *subscriber, uint32_t subscriptionId);
+    void removeNode(const Node *subscriber);
+
+    // Appends the subscriptions whose predicate the sample fulfills to matches
+    void match(std::string_view     nodeType,
+               uint8_t              interfaceIndex,
+               uint8_t              fieldIndex,
+               double               value,
+               std::vector<Match> &matches);
+
+    size_t getSubscriptionsNum() const { return locations.size(); }
+    size_t getSubscriptionsNum(const Node *subscriber) const;
+
+private:
+    using SubscriptionKey = std::pair<const Node *, uint32_t>;
+
+    struct Entry
+    {
+        double   low;
+        double   high;
+        bool     lowInclusive;
+        bool     highInclusive;
+        Node    *subscriber;
+        uint32_t subscriptionId;
+
+        bool contains(double value) const { return reachesDown(value) && reachesUp(value); }
+        bool reachesDown(double value) const { return low < value || (lowInclusive && low == value); }
+        bool reachesUp(double value) const { return high > value || (highInclusive && high == value); }
+
+        double getInnerPoint() const; // Inside the range unless it is empty
+    };
+
+    // Tree node: entries containing center, left and right hold the ones entirely below and above it. The entries of
+    // a tree node are byLow[begin, end) in ascending low and byHigh[begin, end) in descending high order.
+    struct TreeNode
+    {
+        double   center;
+        uint32_t begin;
+        uint32_t end;
+        int32_t  left  = -1;
+        int32_t  right = -1;
+    };
+
+    struct FieldIndex
+    {
+        std::vector<Entry>    entries;
+        bool                  dirty = false;
+        std::vector<TreeNode> tree; // Root first
+        std::vector<uint32_t> byLow;
+        std::vector<uint32_t> byHigh;
+
+        void    build();
+        int32_t build(std::vector<uint32_t> &indexes);
+    };
+
+    // Hashes std::string_view lookups without building a string
+    struct TypeHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view type) const { return std::hash<std::string_view>()(type); }
+    };
+
+    // Field indexes by node type and interface index << 8 | field index
+    std::unordered_map<std::string, std::unordered_map<uint16_t, FieldIndex>, TypeHash, std::equal_to<>> types;
+
+    // Where each subscription is, for removing it
+    std::map<SubscriptionKey, std::pair<std::string, uint16_t>> locations;
+
+    static uint16_t getFieldKey(uint8_t interfaceIndex, uint8_t fieldIndex)
+    {
+        return uint16_t(interfaceIndex) << 8 | fieldIndex;
+    }
+};
@@ -0,0 +1,560 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "loadGenerator.hpp"
+
+using Command = ServerProtocol::Command;
+
+static constexpr size_t   readBufferLen    = 64 * 1024;
+static constexpr int      epollTimeoutMs   = 1;
+static constexpr uint32_t timeoutScanMs    = 100;
+static constexpr double   maxBurstSeconds  = 0.01; // Budget kept after a stall of the loop
+static constexpr size_t   hotspotPercent   = 90;
+static constexpr size_t   hotNodesPerMille = 10;
+
+LoadGenerator::PayloadDistribution LoadGenerator::PayloadDistribution::parse(const std::string &text)
+{
+    PayloadDistribution distribution;
+    size_t              separator = text.find(':');
+    std::string         type      = text.substr(0, separator);
+    std::string         value     = separator == std::string::npos ? "" : text.substr(separator + 1);
+    try
+    {
+        if(type == "fixed")
+        {
+            distribution.type = Fixed;
+            distribution.min  = std::stoul(value);
+            distribution.max  = distribution.min;
+        }
+        else if(type == "uniform")
+        {
+            size_t dash       = value.find('-');
+            distribution.type = Uniform;
+            distribution.min  = std::stoul(value.substr(0, dash));
+            distribution.max  = std::stoul(value.substr(dash + 1));
+        }
+        else if(type == "exponential")
+        {
+            distribution.type = Exponential;
+            distribution.min  = std::stoul(value);
+            distribution.max  = Message::maxPayloadLen;
+        }
+        else
+        {
+            throw std::invalid_argument(type);
+        }
+    }
+    catch(const std::logic_error &e)
+    {
+        throw std::runtime_error("Invalid payload distribution: " + text);
+    }
+
+    if(distribution.min > distribution.max || distribution.max > Message::maxPayloadLen)
+    {
+        throw std::runtime_error("Payload length out of range: " + text);
+    }
+    return distribution;
+}
+
+LoadGenerator::LoadGenerator(const Config &config) : config(config), nodeIds(config.nodesNum)
+{
+    if(config.nodesNum < 2 || config.threadsNum == 0)
+    {
+        throw std::runtime_error("LoadGenerator needs at least 2 nodes and 1 thread");
+    }
+
+    memset(&serverAddress, 0, sizeof(serverAddress));
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_port   = htons(config.port);
+    if(inet_pton(AF_INET, config.address.c_str(), &serverAddress.sin_addr) != 1)
+    {
+        throw std::runtime_error("Invalid server address " + config.address);
+    }
+
+    interface = "{\"interfaceVersion\":1.0,\"interfaces\":[{\"index\":0,\"name\":\"ping\",\"type\":\"data\","
+                "\"arguments\":[{\"dataType\":\"integer\"}]}]}";
+
+    for(size_t t = 0; t < std::min(config.threadsNum, config.nodesNum); t++)
+    {
+        auto worker       = std::make_unique<Worker>();
+        worker->generator = std::mt19937_64(t + 1);
+        worker->epollFd   = epoll_create1(EPOLL_CLOEXEC);
+        if(worker->epollFd < 0)
+        {
+            throw std::runtime_error("epoll_create1 failed in LoadGenerator");
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    // Node i belongs to thread i % threads, all of them connect right away within the connect rate
+    for(size_t i = 0; i < config.nodesNum; i++)
+    {
+        Worker &worker = *workers[i % workers.size()];
+        auto    node   = std::make_unique<SimulatedNode>();
+        node->index    = static_cast<uint32_t>(i);
+        worker.pendingConnects.push_back(node.get());
+        worker.nodes.push_back(std::move(node));
+    }
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    stopping = true;
+    for(auto &worker : workers)
+    {
+        if(worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+        for(auto &node : worker->nodes)
+        {
+            if(node->fd >= 0)
+                close(node->fd);
+        }
+        close(worker->epollFd);
+    }
+}
+
+void LoadGenerator::run(const std::function<void(const Totals &totals)> &progress, std::chrono::milliseconds interval)
+{
+    for(auto &worker : workers)
+    {
+        worker->thread = std::thread(&LoadGenerator::workerProcess, this, std::ref(*worker));
+    }
+
+    auto end = std::chrono::steady_clock::now() + config.duration;
+    while(std::chrono::steady_clock::now() < end)
+    {
+        auto left = end - std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(interval, left));
+        progress(getTotals());
+    }
+
+    stopping = true;
+    for(auto &worker : workers)
+    {
+        worker->thread.join();
+    }
+}
+
+LoadGenerator::Totals LoadGenerator::getTotals() const
+{
+    Totals totals;
+    totals.connects    = counters.connects.load(std::memory_order_relaxed);
+    totals.disconnects = counters.disconnects.load(std::memory_order_relaxed);
+    totals.drops       = counters.drops.load(std::memory_order_relaxed);
+    totals.pings       = counters.pings.load(std::memory_order_relaxed);
+    totals.replies     = counters.replies.load(std::memory_order_relaxed);
+    totals.timeouts    = counters.timeouts.load(std::memory_order_relaxed);
+    totals.bytesSent   = counters.bytesSent.load(std::memory_order_relaxed);
+    totals.activeNodes = std::max<int64_t>(counters.activeNodes.load(std::memory_order_relaxed), 0);
+    return totals;
+}
+
+uint64_t LoadGenerator::getNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void LoadGenerator::workerProcess(Worker &worker)
+{
+    // Rates are split evenly between the threads, budgets grow with the time the loop takes
+    double connectRate  = config.connectRate / workers.size();
+    double messageRate  = config.messageRate / workers.size();
+    double churnRate    = config.churnRate / workers.size();
+    double connects     = 1;
+    double messages     = 0;
+    double disconnects  = 0;
+    auto   lastTime     = std::chrono::steady_clock::now();
+    auto   nextScanTime = lastTime;
+
+    std::vector<uint8_t> buffer(readBufferLen);
+    epoll_event          events[maxEvents];
+    while(!stopping)
+    {
+        auto   now     = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastTime).count();
+        lastTime       = now;
+
+        connects = std::min(connects + elapsed * connectRate, std::max(connectRate * maxBurstSeconds, 1.0));
+        while(connects >= 1 && !worker.pendingConnects.empty() && worker.pendingConnects.front()->reconnectTime <= now)
+        {
+            SimulatedNode *node = worker.pendingConnects.front();
+            worker.pendingConnects.pop_front();
+            connectNode(worker, *node);
+            connects--;
+        }
+
+        // A node taken from the ready queue may have been closed or already sent since it was queued
+        size_t readyNum = worker.readyNodes.size();
+        if(messageRate > 0)
+            messages = std::min(messages + elapsed * messageRate, std::max(messageRate * maxBurstSeconds, 1.0));
+        for(size_t i = 0; i < readyNum && (messageRate == 0 || messages >= 1); i++)
+        {
+            SimulatedNode *node = worker.readyNodes.front();
+            worker.readyNodes.pop_front();
+            if(node->state != SimulatedNode::Active || node->inFlight)
+                continue;
+
+            sendPing(worker, *node);
+            if(node->inFlight)
+                messages--;
+        }
+
+        disconnects += elapsed * churnRate;
+        for(int attempt = 0; disconnects >= 1 && attempt < 8; attempt++)
+        {
+            SimulatedNode &node = *worker.nodes[worker.generator() % worker.nodes.size()];
+            if(node.state == SimulatedNode::Active)
+            {
+                closeNode(worker, node, true);
+                disconnects--;
+            }
+        }
+        disconnects = std::min(disconnects, std::max(churnRate * maxBurstSeconds, 1.0));
+
+        if(now >= nextScanTime)
+        {
+            uint64_t timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(config.replyTimeout).count();
+            uint64_t oldest  = getNow() - timeout;
+            for(auto &node : worker.nodes)
+            {
+                if(node->state == SimulatedNode::Active && node->inFlight && node->pingTime < oldest)
+                {
+                    counters.timeouts.fetch_add(1, std::memory_order_relaxed);
+                    node->inFlight = false;
+                    worker.readyNodes.push_back(node.get());
+                }
+            }
+            nextScanTime = now + std::chrono::milliseconds(timeoutScanMs);
+        }
+
+        int eventsNum = epoll_wait(worker.epollFd, events, maxEvents, epollTimeoutMs);
+        for(int i = 0; i < eventsNum; i++)
+        {
+            SimulatedNode &node = *static_cast<SimulatedNode *>(events[i].data.ptr);
+            if(node.state == SimulatedNode::Disconnected)
+                continue;
+
+            if(node.state == SimulatedNode::Connecting)
+            {
+                int       error    = 0;
+                socklen_t errorLen = sizeof(error);
+                if((events[i].events & (EPOLLERR | EPOLLHUP)) != 0 ||
+                   getsockopt(node.fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) != 0 || error != 0)
+                {
+                    closeNode(worker, node, false);
+                    continue;
+                }
+
+                node.state = SimulatedNode::Registering;
+                epoll_event event{EPOLLIN, {.ptr = &node}};
+                epoll_ctl(worker.epollFd, EPOLL_CTL_MOD, node.fd, &event);
+                sendRegistration(worker, node);
+                continue;
+            }
+
+            if((events[i].events & EPOLLOUT) != 0)
+                flush(worker, node);
+            if((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0 && node.state != SimulatedNode::Disconnected)
+                readNode(worker, node, buffer.data(), buffer.size());
+        }
+    }
+}
+
+void LoadGenerator::connectNode(Worker &worker, SimulatedNode &node)
+{
+    node.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(node.fd < 0)
+    {
+        closeNode(worker, node, false);
+        return;
+    }
+
+    // Every message is written on its own, Nagle would hold pings back for the previous reply
+    int option = 1;
+    setsockopt(node.fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+
+    node.state = SimulatedNode::Connecting;
+    epoll_event event{EPOLLIN | EPOLLOUT, {.ptr = &node}};
+    const sockaddr *address = reinterpret_cast<const sockaddr *>(&serverAddress);
+    if((connect(node.fd, address, sizeof(serverAddress)) != 0 && errno != EINPROGRESS) ||
+       epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, node.fd, &event) != 0)
+    {
+        closeNode(worker, node, false);
+    }
+}
+
+void LoadGenerator::closeNode(Worker &worker, SimulatedNode &node, bool churn)
+{
+    if(node.fd >= 0)
+    {
+        close(node.fd);
+        node.fd = -1;
+    }
+    if(node.inFlight)
+    {
+        counters.timeouts.fetch_add(1, std::memory_order_relaxed);
+        node.inFlight = false;
+    }
+    if(node.state == SimulatedNode::Active)
+    {
+        counters.activeNodes.fetch_sub(1, std::memory_order_relaxed);
+        nodeIds[node.index].store(0, std::memory_order_relaxed);
+    }
+    (churn ? counters.disconnects : counters.drops).fetch_add(1, std::memory_order_relaxed);
+
+    node.state         = SimulatedNode::Disconnected;
+    node.reconnectTime = std::chrono::steady_clock::now() + config.reconnectDelay;
+    node.input.clear();
+    node.output.clear();
+    worker.pendingConnects.push_back(&node);
+}
+
+void LoadGenerator::readNode(Worker &worker, SimulatedNode &node, uint8_t *buffer, size_t bufferLen)
+{
+    while(true)
+    {
+        ssize_t len = read(node.fd, buffer, bufferLen);
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            closeNode(worker, node, false);
+            return;
+        }
+        if(len < 0)
+        {
+            if(errno == EAGAIN)
+                return;
+            continue;
+        }
+        node.input.insert(node.input.end(), buffer, buffer + len);
+
+        // Complete frames are handled, a partial one waits for the next read
+        size_t offset = 0;
+        while(node.input.size() - offset >= sizeof(uint32_t))
+        {
+            uint32_t frameLen = 0;
+            Utilities::Endian::Instance().readWithEndianness(
+                frameLen, node.input.data() + offset, Message::messageEndianness);
+            if(frameLen < Message::overheadLen || frameLen > Message::maxMessageLen)
+            {
+                closeNode(worker, node, false);
+                return;
+            }
+            if(node.input.size() - offset < frameLen)
+                break;
+
+            try
+            {
+                handleMessage(worker, node, Message(node.input.data() + offset, frameLen));
+            }
+            catch(const std::exception &e)
+            {
+                closeNode(worker, node, false);
+                return;
+            }
+            if(node.state == SimulatedNode::Disconnected)
+                return;
+            offset += frameLen;
+        }
+        node.input.erase(node.input.begin(), node.input.begin() + offset);
+    }
+}
+
+void LoadGenerator::handleMessage(Worker &worker, SimulatedNode &node, const Message &message)
+{
+    PayloadReader reader(message.getPayloadPointer(), message.getPayloadLen());
+    if(message.getSourceId() == 0)
+    {
+        Command command = static_cast<Command>(reader.read<uint8_t>());
+        if(command == Command::ResumeRejected)
+        {
+            // E.g. the server restarted, the node registers again on the same connection
+            node.hasToken = false;
+            sendRegistration(worker, node);
+            return;
+        }
+        if(command != Command::RegisterAck && command != Command::ResumeAck)
+            return;
+
+        uint32_t id = reader.read<uint32_t>();
+        if(command == Command::RegisterAck)
+        {
+            node.token    = ServerProtocol::SessionToken::read(reader);
+            node.hasToken = true;
+        }
+        node.state = SimulatedNode::Active;
+        nodeIds[node.index].store(id, std::memory_order_relaxed);
+        counters.connects.fetch_add(1, std::memory_order_relaxed);
+        counters.activeNodes.fetch_add(1, std::memory_order_relaxed);
+        worker.readyNodes.push_back(&node);
+        return;
+    }
+
+    uint8_t  kind     = reader.read<uint8_t>();
+    uint32_t sequence = reader.read<uint32_t>();
+    uint64_t sendTime = reader.read<uint64_t>();
+    if(kind == pingKind && node.state == SimulatedNode::Active)
+    {
+        PayloadWriter reply;
+        reply.write(replyKind);
+        reply.write(sequence);
+        reply.write(sendTime);
+        send(worker, node, Message(nodeIds[node.index].load(std::memory_order_relaxed),
+                                   message.getSourceId(),
+                                   reply.getPointer(),
+                                   reply.getLen()));
+    }
+    else if(kind == replyKind && node.inFlight && sequence == node.sequence)
+    {
+        roundTrips.record(getNow() - sendTime);
+        counters.replies.fetch_add(1, std::memory_order_relaxed);
+        node.inFlight = false;
+        worker.readyNodes.push_back(&node);
+    }
+}
+
+void LoadGenerator::sendRegistration(Worker &worker, SimulatedNode &node)
+{
+    PayloadWriter body;
+    if(node.hasToken)
+    {
+        node.token.write(body);
+        sendCommand(worker, node, Command::Resume, body);
+        return;
+    }
+
+    body.writeString<uint8_t>("load node " + std::to_string(node.index));
+    body.writeString<uint8_t>("load");
+    body.writeString<uint16_t>("simulated node of the load generator");
+    body.write<uint32_t>(0);
+    body.write<uint32_t>(interface.size());
+    body.writeBytes(reinterpret_cast<const uint8_t *>(interface.data()), interface.size());
+    sendCommand(worker, node, Command::Register, body);
+}
+
+void LoadGenerator::sendPing(Worker &worker, SimulatedNode &node)
+{
+    uint32_t destination = pickDestination(worker, node);
+    if(destination == 0)
+    {
+        // Not connected yet or in churn, the node tries another one later
+        worker.readyNodes.push_back(&node);
+        return;
+    }
+
+    static const std::vector<uint8_t> padding(Message::maxPayloadLen);
+    PayloadWriter                     payload;
+    node.sequence++;
+    node.pingTime = getNow();
+    payload.write(pingKind);
+    payload.write(node.sequence);
+    payload.write(node.pingTime);
+    payload.writeBytes(padding.data(), pickPayloadLen(worker) - payloadHeaderLen);
+
+    node.inFlight = true;
+    counters.pings.fetch_add(1, std::memory_order_relaxed);
+    send(worker,
+         node,
+         Message(nodeIds[node.index].load(std::memory_order_relaxed),
+                 destination,
+                 payload.getPointer(),
+                 payload.getLen()));
+}
+
+void LoadGenerator::sendCommand(Worker &worker, SimulatedNode &node, Command command, const PayloadWriter &body)
+{
+    PayloadWriter payload;
+    payload.write(static_cast<uint8_t>(command));
+    payload.writeBytes(body.getPointer(), body.getLen());
+    send(worker, node, Message(0, 0, payload.getPointer(), payload.getLen()));
+}
+
+void LoadGenerator::send(Worker &worker, SimulatedNode &node, const Message &message)
+{
+    counters.bytesSent.fetch_add(message.getMessageLen(), std::memory_order_relaxed);
+    node.output.insert(node.output.end(),
+                       message.getMessagePointer(),
+                       message.getMessagePointer() + message.getMessageLen());
+    flush(worker, node);
+}
+
+void LoadGenerator::flush(Worker &worker, SimulatedNode &node)
+{
+    bool wasBlocked = !node.output.empty();
+    while(!node.output.empty())
+    {
+        ssize_t len = ::send(node.fd, node.output.data(), node.output.size(), MSG_NOSIGNAL);
+        if(len < 0 && errno == EINTR)
+            continue;
+        if(len < 0 && errno == EAGAIN)
+        {
+            // The rest goes when the socket is writable again
+            epoll_event event{EPOLLIN | EPOLLOUT, {.ptr = &node}};
+            epoll_ctl(worker.epollFd, EPOLL_CTL_MOD, node.fd, &event);
+            return;
+        }
+        if(len <= 0)
+        {
+            closeNode(worker, node, false);
+            return;
+        }
+        node.output.erase(node.output.begin(), node.output.begin() + len);
+    }
+
+    if(wasBlocked)
+    {
+        epoll_event event{EPOLLIN, {.ptr = &node}};
+        epoll_ctl(worker.epollFd, EPOLL_CTL_MOD, node.fd, &event);
+    }
+}
+
+uint32_t LoadGenerator::pickDestination(Worker &worker, const SimulatedNode &node)
+{
+    size_t nodesNum = config.nodesNum;
+    size_t index    = 0;
+    switch(config.pattern)
+    {
+    case Pattern::Random:
+        index = (node.index + 1 + worker.generator() % (nodesNum - 1)) % nodesNum;
+        break;
+    case Pattern::Ring:
+        index = (node.index + 1) % nodesNum;
+        break;
+    case Pattern::Hotspot:
+        if(worker.generator() % 100 < hotspotPercent)
+            index = worker.generator() % std::max<size_t>(nodesNum * hotNodesPerMille / 1000, 1);
+        else
+            index = worker.generator() % nodesNum;
+        if(index == node.index)
+            index = (index + 1) % nodesNum;
+        break;
+    }
+    return nodeIds[index].load(std::memory_order_relaxed);
+}
+
+size_t LoadGenerator::pickPayloadLen(Worker &worker)
+{
+    const PayloadDistribution &payload = config.payload;
+    size_t                     len     = payload.min;
+    switch(payload.type)
+    {
+    case PayloadDistribution::Fixed:
+        break;
+    case PayloadDistribution::Uniform:
+        len = std::uniform_int_distribution<size_t>(payload.min, payload.max)(worker.generator);
+        break;
+    case PayloadDistribution::Exponential:
+        len = static_cast<size_t>(std::exponential_distribution<double>(1.0 / payload.min)(worker.generator));
+        break;
+    }
+    return std::clamp(len, payloadHeaderLen, std::max(payload.max, payloadHeaderLen));
+}
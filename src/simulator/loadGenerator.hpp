@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+
+#include "message/message.hpp"
+#include "message/payload.hpp"
+#include "metrics/histogram.hpp"
+#include "server/serverProtocol.hpp"
+
+/* Simulates a fleet of nodes against a running server from a few threads. Every thread drives its share of the nodes
+ * over non-blocking sockets with an epoll loop, so tens of thousands of nodes take no more than the socket buffers.
+ *
+ * Nodes connect at a limited rate, register (or resume their session after a reconnect) and then send pings to other
+ * simulated nodes through the server. The destination answers with a short reply and the sender records the round
+ * trip. A node has one ping in flight at a time, pings are started at the configured rate across all nodes or, with
+ * rate 0, as soon as a node got its reply. With churn nodes are disconnected at random and reconnect after a delay.
+ *
+ * Ping and reply payload:
+ *
+ * | Kind (1) | Sequence (4) | Send time (8, steady ns) | Padding |
+ */
+class LoadGenerator
+{
+public:
+    enum class Pattern
+    {
+        Random,  // Any other node
+        Ring,    // The next node by index
+        Hotspot, // 90 % of the pings to the first 1 % of the nodes
+    };
+
+    // Payload length of pings, replies only carry the header
+    struct PayloadDistribution
+    {
+        enum Type
+        {
+            Fixed,
+            Uniform,     // min..max
+            Exponential, // Mean min, cut at max
+        };
+
+        Type   type = Fixed;
+        size_t min  = 64;
+        size_t max  = 64;
+
+        // "fixed:<len>", "uniform:<min>-<max>" or "exponential:<mean>"
+        static PayloadDistribution parse(const std::string &text);
+    };
+
+    struct Config
+    {
+        std::string               address        = "127.0.0.1";
+        uint16_t                  port           = 10000;
+        size_t                    nodesNum       = 1000;
+        size_t                    threadsNum     = 4;
+        double                    messageRate    = 1000; // Pings per second of all nodes, 0 for closed loop
+        double                    connectRate    = 2000; // Connection attempts per second of all nodes
+        double                    churnRate      = 0;    // Disconnects per second of all nodes
+        std::chrono::milliseconds reconnectDelay = std::chrono::seconds(1);
+        std::chrono::milliseconds replyTimeout   = std::chrono::seconds(5);
+        std::chrono::seconds      duration       = std::chrono::seconds(30);
+        Pattern                   pattern        = Pattern::Random;
+        PayloadDistribution       payload;
+    };
+
+    struct Totals
+    {
+        uint64_t connects    = 0; // Registered or resumed
+        uint64_t disconnects = 0; // By churn
+        uint64_t drops       = 0; // By the server or an error
+        uint64_t pings       = 0;
+        uint64_t replies     = 0; // Round trips completed
+        uint64_t timeouts    = 0; // Pings without reply, including the ones lost to a disconnect
+        uint64_t bytesSent   = 0;
+        uint64_t activeNodes = 0;
+    };
+
+    LoadGenerator() = delete;
+    LoadGenerator(const Config &config);
+    ~LoadGenerator();
+
+    // Runs for the configured duration, every interval progress is passed to the callback
+    void run(const std::function<void(const Totals &totals)> &progress, std::chrono::milliseconds interval);
+
+    Totals                       getTotals() const;
+    Metrics::Histogram::Snapshot getRoundTrips() const { return roundTrips.getSnapshot(); }
+
+private:
+    static constexpr uint8_t pingKind         = 'P';
+    static constexpr uint8_t replyKind        = 'R';
+    static constexpr size_t  payloadHeaderLen = 1 + 4 + 8;
+    static constexpr size_t  maxEvents        = 256;
+
+    struct SimulatedNode
+    {
+        enum State
+        {
+            Disconnected,
+            Connecting,
+            Registering,
+            Active,
+        };
+
+        uint32_t                              index    = 0;
+        int                                   fd       = -1;
+        State                                 state    = Disconnected;
+        bool                                  inFlight = false;
+        uint32_t                              sequence = 0;
+        uint64_t                              pingTime = 0;
+        bool                                  hasToken = false;
+        ServerProtocol::SessionToken          token;
+        std::vector<uint8_t>                  input;  // Partial frame of the last read
+        std::vector<uint8_t>                  output; // Not yet written
+        std::chrono::steady_clock::time_point reconnectTime;
+    };
+
+    struct Counters
+    {
+        std::atomic<uint64_t> connects    = 0;
+        std::atomic<uint64_t> disconnects = 0;
+        std::atomic<uint64_t> drops       = 0;
+        std::atomic<uint64_t> pings       = 0;
+        std::atomic<uint64_t> replies     = 0;
+        std::atomic<uint64_t> timeouts    = 0;
+        std::atomic<uint64_t> bytesSent   = 0;
+        std::atomic<int64_t>  activeNodes = 0;
+    };
+
+    // Nodes of one thread, only touched by it
+    struct Worker
+    {
+        int                                         epollFd = -1;
+        std::vector<std::unique_ptr<SimulatedNode>> nodes;
+        std::deque<SimulatedNode *>                 pendingConnects; // In the order of their reconnect time
+        std::deque<SimulatedNode *>                 readyNodes;      // Active without a ping in flight
+        std::mt19937_64                             generator;
+        std::thread                                 thread;
+    };
+
+    Config                               config;
+    sockaddr_in                          serverAddress; // Parsed from config once, all workers connect to it
+    std::atomic<bool>                    stopping = false;
+    std::vector<std::atomic<uint32_t>>   nodeIds; // By node index, 0 while a node is not active
+    std::vector<std::unique_ptr<Worker>> workers;
+    Counters                             counters;
+    Metrics::Histogram                   roundTrips;
+    std::string                          interface;
+
+    static uint64_t getNow();
+
+    void workerProcess(Worker &worker);
+    void connectNode(Worker &worker, SimulatedNode &node);
+    void closeNode(Worker &worker, SimulatedNode &node, bool churn);
+    void readNode(Worker &worker, SimulatedNode &node, uint8_t *buffer, size_t bufferLen);
+    void handleMessage(Worker &worker, SimulatedNode &node, const Message &message);
+    void sendRegistration(Worker &worker, SimulatedNode &node);
+    void sendPing(Worker &worker, SimulatedNode &node);
+    void send(Worker &worker, SimulatedNode &node, const Message &message);
+    void flush(Worker &worker, SimulatedNode &node);
+    void sendCommand(Worker &worker, SimulatedNode &node, ServerProtocol::Command command, const PayloadWriter &body);
+
+    uint32_t pickDestination(Worker &worker, const SimulatedNode &node);
+    size_t   pickPayloadLen(Worker &worker);
+};
@@ -0,0 +1,214 @@
+#include <ctime>
+#include <memory>
+
+#include "simulation.hpp"
+#include "message/payload.hpp"
+#include "node/transport.hpp"
+#include "server/serverProtocol.hpp"
+
+using Command = ServerProtocol::Command;
+
+namespace
+{
+constexpr uint64_t fnvOffsetBasis = 0xCBF29CE484222325;
+constexpr uint64_t fnvPrime       = 0x100000001B3;
+
+void mix(uint64_t &digest, uint64_t value)
+{
+    for(size_t i = 0; i < sizeof(value); i++)
+    {
+        digest ^= (value >> (8 * i)) & 0xFF;
+        digest *= fnvPrime;
+    }
+}
+} // namespace
+
+Simulation::Simulation(Server &server, const Config &config) :
+    server(server), config(config), generator(config.seed), nodes(config.nodesNum)
+{
+    if(config.nodesNum < 2 || config.connectRate <= 0 || config.payloadLen < payloadHeaderLen ||
+       config.payloadLen > Message::maxPayloadLen)
+    {
+        throw std::runtime_error("Simulation needs at least 2 nodes, a connect rate and a valid payload length");
+    }
+
+    interface = "{\"interfaceVersion\":1.0,\"interfaces\":[{\"index\":0,\"name\":\"ping\",\"type\":\"data\","
+                "\"arguments\":[{\"dataType\":\"integer\"}]}]}";
+}
+
+uint64_t Simulation::getCpuTime(clockid_t clock)
+{
+    timespec time;
+    clock_gettime(clock, &time);
+    return uint64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+Simulation::Totals Simulation::run()
+{
+    totals        = Totals();
+    totals.digest = fnvOffsetBasis;
+
+    uint64_t connectTime = uint64_t(config.nodesNum * 1e9 / config.connectRate);
+    uint64_t endTime     = connectTime + config.duration.count();
+    for(uint32_t i = 0; i < config.nodesNum; i++)
+        schedule(uint64_t(i * 1e9 / config.connectRate), [this, i] { connect(i); });
+    if(config.messageRate > 0)
+        schedule(0, [this] { ping(); });
+
+    uint64_t wallStart    = getCpuTime(CLOCK_MONOTONIC);
+    uint64_t processStart = getCpuTime(CLOCK_PROCESS_CPUTIME_ID);
+    while(!actions.empty() && actions.top().time <= endTime)
+    {
+        Action action = actions.top();
+        actions.pop();
+        now = action.time;
+        action.function();
+        totals.actions++;
+    }
+    totals.virtualTime = now;
+    totals.wallTime    = getCpuTime(CLOCK_MONOTONIC) - wallStart;
+    totals.processCpu  = getCpuTime(CLOCK_PROCESS_CPUTIME_ID) - processStart;
+
+    // Frames still on their way are dropped, the disconnects are not part of the measurement
+    actions = decltype(actions)();
+    for(VirtualNode &node : nodes)
+    {
+        if(node.node != nullptr)
+            node.node->receiveClose();
+        node.node = nullptr;
+    }
+    while(server.runEvents() > 0)
+    {
+    }
+    outputs.clear();
+    registeredNodes.clear();
+    return totals;
+}
+
+void Simulation::schedule(uint64_t delay, std::function<void()> function)
+{
+    actions.push(Action{now + delay, nextSequence++, std::move(function)});
+}
+
+void Simulation::connect(uint32_t nodeIndex)
+{
+    runServer([&] {
+        auto sink = [this, nodeIndex](const uint8_t *data, size_t len) {
+            outputs.push_back(Output{nodeIndex, std::vector<uint8_t>(data, data + len)});
+        };
+        auto transport = std::make_unique<MemoryTransport>(nodeIndex, sink);
+        nodes[nodeIndex].node = server.addNode(std::move(transport), "simulation");
+    });
+
+    PayloadWriter payload;
+    payload.write(static_cast<uint8_t>(Command::Register));
+    payload.writeString<uint8_t>("simulated node " + std::to_string(nodeIndex));
+    payload.writeString<uint8_t>("simulation");
+    payload.writeString<uint16_t>("node of the deterministic simulation");
+    payload.write<uint32_t>(0);
+    payload.write<uint32_t>(interface.size());
+    payload.writeBytes(reinterpret_cast<const uint8_t *>(interface.data()), interface.size());
+    sendToServer(nodeIndex, Message(0, 0, payload.getPointer(), payload.getLen()));
+}
+
+void Simulation::ping()
+{
+    std::exponential_distribution<double> interval(config.messageRate / 1e9);
+    schedule(uint64_t(interval(generator)), [this] { ping(); });
+    if(registeredNodes.size() < 2)
+        return;
+
+    // The destination is drawn from the other registered nodes
+    std::uniform_int_distribution<size_t> pick(0, registeredNodes.size() - 1);
+    size_t                                source      = pick(generator);
+    size_t                                destination = pick(generator);
+    if(destination == source)
+        destination = (destination + 1) % registeredNodes.size();
+
+    static const std::vector<uint8_t> padding(Message::maxPayloadLen);
+    VirtualNode                      &node = nodes[registeredNodes[source]];
+    PayloadWriter                     payload;
+    payload.write(pingKind);
+    payload.write(++node.sequence);
+    payload.write(now);
+    payload.writeBytes(padding.data(), config.payloadLen - payloadHeaderLen);
+    totals.pings++;
+    sendToServer(registeredNodes[source],
+                 Message(node.id, nodes[registeredNodes[destination]].id, payload.getPointer(), payload.getLen()));
+}
+
+void Simulation::sendToServer(uint32_t nodeIndex, const Message &message)
+{
+    std::vector<uint8_t> data(message.getMessagePointer(), message.getMessagePointer() + message.getMessageLen());
+    schedule(config.latency.count(), [this, nodeIndex, data = std::move(data)] {
+        Node *node = nodes[nodeIndex].node;
+        if(node == nullptr)
+            return;
+
+        totals.framesIn++;
+        runServer([&] { node->receive(data.data(), data.size()); });
+    });
+}
+
+void Simulation::receive(uint32_t nodeIndex, const std::vector<uint8_t> &data)
+{
+    // The server writes one frame per write
+    Message message(data.data(), data.size());
+    mix(totals.digest, now);
+    mix(totals.digest, nodeIndex);
+    mix(totals.digest, message.getSourceId());
+    mix(totals.digest, message.getDestinationId());
+    mix(totals.digest, message.getMessageLen());
+    if(message.getPayloadLen() == 0)
+        return;
+
+    VirtualNode  &node = nodes[nodeIndex];
+    PayloadReader reader(message.getPayloadPointer(), message.getPayloadLen());
+    if(message.getSourceId() == 0)
+    {
+        if(static_cast<Command>(reader.read<uint8_t>()) == Command::RegisterAck && node.id == 0)
+        {
+            node.id = reader.read<uint32_t>();
+            registeredNodes.push_back(nodeIndex);
+            totals.registered++;
+        }
+        return;
+    }
+
+    uint8_t  kind     = reader.read<uint8_t>();
+    uint32_t sequence = reader.read<uint32_t>();
+    uint64_t sendTime = reader.read<uint64_t>();
+    if(kind == pingKind)
+    {
+        PayloadWriter reply;
+        reply.write(replyKind);
+        reply.write(sequence);
+        reply.write(sendTime);
+        sendToServer(nodeIndex, Message(node.id, message.getSourceId(), reply.getPointer(), reply.getLen()));
+    }
+    else if(kind == replyKind)
+    {
+        roundTrips.record(now - sendTime);
+        totals.replies++;
+    }
+}
+
+void Simulation::runServer(const std::function<void()> &function)
+{
+    // Everything until the server has no events left is its work on the frame
+    uint64_t start = getCpuTime(CLOCK_THREAD_CPUTIME_ID);
+    function();
+    while(server.runEvents() > 0)
+    {
+    }
+    totals.serverCpuTime += getCpuTime(CLOCK_THREAD_CPUTIME_ID) - start;
+
+    // Frames the server wrote reach their node after the latency, in the order they were written
+    for(Output &output : outputs)
+    {
+        totals.framesOut++;
+        schedule(config.latency.count(),
+                 [this, output = std::move(output)] { receive(output.nodeIndex, output.data); });
+    }
+    outputs.clear();
+}
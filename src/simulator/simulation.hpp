@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "message/message.hpp"
+#include "metrics/histogram.hpp"
+#include "server/server.hpp"
+
+/* Deterministic simulation of a node fleet inside the server process. Nodes are connected to a server without event
+ * thread and listener over MemoryTransports, there are no sockets and no threads between them. A scheduler runs
+ * actions in order of their virtual time, ties in the order they were scheduled, and hands every frame to the server
+ * or to a node after the configured one way latency. After every action the server handles all events it queued.
+ * With the same seed, configuration and build a run repeats exactly, the digest of all frames the nodes received
+ * tells. It does not cover payload bytes, session tokens are random.
+ *
+ * Nodes register and then send pings to other registered nodes at the configured rate of the fleet, the destination
+ * answers with a reply like a node of the load generator. Server CPU time is the thread CPU time of passing frames
+ * into nodes and handling the server events, the background writers of the stores only show up in the process CPU
+ * time.
+ */
+class Simulation
+{
+public:
+    struct Config
+    {
+        size_t                   nodesNum    = 10000;
+        uint64_t                 seed        = 1;
+        double                   messageRate = 100000; // Pings per virtual second of all nodes
+        double                   connectRate = 100000; // Connections per virtual second
+        size_t                   payloadLen  = 32;     // Of pings, at least the ping header
+        std::chrono::nanoseconds latency     = std::chrono::microseconds(100); // One way
+        std::chrono::nanoseconds duration    = std::chrono::seconds(10);       // Virtual time after connecting
+    };
+
+    struct Totals
+    {
+        uint64_t registered    = 0;
+        uint64_t pings         = 0;
+        uint64_t replies       = 0;
+        uint64_t framesIn      = 0; // Passed to the server
+        uint64_t framesOut     = 0; // Written by the server
+        uint64_t actions       = 0;
+        uint64_t virtualTime   = 0; // Nanoseconds
+        uint64_t wallTime      = 0; // Nanoseconds
+        uint64_t serverCpuTime = 0; // Nanoseconds
+        uint64_t processCpu    = 0; // Nanoseconds, including the simulation and the store threads
+        uint64_t digest        = 0; // FNV-1a of the time, node, source, destination and length of received frames
+    };
+
+    Simulation() = delete;
+    Simulation(Server &server, const Config &config);
+
+    Totals                       run();
+    Metrics::Histogram::Snapshot getRoundTrips() const { return roundTrips.getSnapshot(); } // Virtual nanoseconds
+
+private:
+    static constexpr uint8_t pingKind         = 'P';
+    static constexpr uint8_t replyKind        = 'R';
+    static constexpr size_t  payloadHeaderLen = 1 + 4 + 8;
+
+    struct Action
+    {
+        uint64_t              time;
+        uint64_t              sequence; // Orders actions of the same time
+        std::function<void()> function;
+
+        bool operator>(const Action &other) const
+        {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct VirtualNode
+    {
+        Node    *node     = nullptr; // Server side, owned by the server
+        uint32_t id       = 0;       // 0 until registered
+        uint32_t sequence = 0;
+    };
+
+    struct Output
+    {
+        uint32_t             nodeIndex;
+        std::vector<uint8_t> data;
+    };
+
+    Server                                                          &server;
+    Config                                                           config;
+    std::priority_queue<Action, std::vector<Action>, std::greater<>> actions;
+    uint64_t                                                         now          = 0;
+    uint64_t                                                         nextSequence = 0;
+    std::mt19937_64                                                  generator;
+    std::vector<VirtualNode>                                         nodes;
+    std::vector<uint32_t>                                            registeredNodes; // Indexes
+    std::vector<Output>                                              outputs; // Written by the server in the step
+    std::string                                                      interface;
+    Totals                                                           totals;
+    Metrics::Histogram                                               roundTrips;
+
+    static uint64_t getCpuTime(clockid_t clock);
+
+    void schedule(uint64_t delay, std::function<void()> function);
+    void connect(uint32_t nodeIndex);
+    void ping();
+    void sendToServer(uint32_t nodeIndex, const Message &message);
+    void receive(uint32_t nodeIndex, const std::vector<uint8_t> &data);
+    void runServer(const std::function<void()> &function);
+};
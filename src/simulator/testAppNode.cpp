@@ -61,7 +61,7 @@ void AppNode::threadProcess(const AppNode *obj)
         if(!connectedNodesQueried)
         {
             connectedNodesQueried = true;
-            obj->log("App node requesting connected nodes", LogLevel::Debug);
+            LOG_MESSAGE(LogLevel::Debug, "App node requesting connected nodes");
             // Message msg(obj->nodeId, 0, GetConnectedNodesPayload());
             // obj->sendMessage(msg);
         }
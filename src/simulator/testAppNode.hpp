@@ -11,6 +11,8 @@ class AppNode : private TestNode
 private:
     using LogLevel = Utilities::Logger::LogLevel;
 
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::AppNode;
+
     std::string nodeName;
     uint32_t    nodeId;
     bool        inDestruction = false;
@@ -22,11 +24,6 @@ private:
     int         sendMessage(const Message &message) const override;
     static void threadProcess(const AppNode *object);
 
-    void log(std::string message, LogLevel logLevel = LogLevel::Debug) const
-    {
-        Utilities::Logger::logMessage("AppNode:: " + message, logLevel);
-    }
-
 public:
     AppNode(std::string nodeName, std::string serverAddress = "127.0.0.1", uint16_t serverPort = 10000);
     ~AppNode();
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#include "trafficReplay.hpp"
+#include "utilities/trafficCapture.hpp"
+
+static constexpr uint64_t drainTimeoutNs = 10'000'000'000;
+
+TrafficReplay::TrafficReplay(const std::string &capturePath)
+{
+    std::ifstream file(capturePath, std::ios::binary);
+    if(!file)
+    {
+        throw std::runtime_error("Unable to open traffic capture " + capturePath);
+    }
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    // Blocks of different shards overlap in time, only the records of one connection are in order in the file
+    std::unordered_set<uint32_t> connectionIds;
+    uint64_t                     startTime = Utilities::TrafficCapture::readCapture(
+        content.data(), content.size(), [&](const Utilities::TrafficCapture::Record &record) {
+            records.push_back(
+                Record{record.time, record.connectionId, size_t(record.data - content.data()), record.len});
+            connectionIds.insert(record.connectionId);
+        });
+    if(startTime == 0)
+    {
+        throw std::runtime_error("Not a traffic capture: " + capturePath);
+    }
+
+    std::stable_sort(
+        records.begin(), records.end(), [](const Record &a, const Record &b) { return a.time < b.time; });
+    uint64_t firstTime = records.empty() ? 0 : records.front().time;
+    for(Record &record : records)
+        record.time -= firstTime;
+    connectionsNum = connectionIds.size();
+}
+
+TrafficReplay::~TrafficReplay()
+{
+    for(auto &[connectionId, connection] : connections)
+    {
+        if(connection.fd >= 0)
+            ::close(connection.fd);
+    }
+    if(epollFd >= 0)
+        ::close(epollFd);
+}
+
+TrafficReplay::Totals TrafficReplay::run(const Config &config)
+{
+    if(epollFd < 0)
+    {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if(epollFd < 0)
+        {
+            throw std::runtime_error("epoll_create1 failed in TrafficReplay::run");
+        }
+    }
+    totals              = Totals();
+    totals.capturedSpan = records.empty() ? 0 : records.back().time;
+
+    std::vector<uint8_t> buffer(readBufferLen);
+    uint64_t             start = getNow();
+    for(const Record &record : records)
+    {
+        // The last millisecond before a record is due is spun, epoll timeouts are too coarse for the gaps of a burst
+        uint64_t due = start + (config.speed > 0 ? uint64_t(record.time / config.speed) : 0);
+        uint64_t now = getNow();
+        while(now < due)
+        {
+            handleEvents(static_cast<int>((due - now) / 1'000'000), buffer.data());
+            now = getNow();
+        }
+        totals.maxLag = std::max(totals.maxLag, now - due);
+
+        auto found = connections.find(record.connectionId);
+        if(record.len == 0)
+        {
+            if(found != connections.end() && found->second.fd >= 0)
+            {
+                found->second.closing = true;
+                if(!found->second.connecting)
+                    flush(record.connectionId, found->second);
+            }
+            continue;
+        }
+        if(found == connections.end())
+        {
+            found = connections.emplace(record.connectionId, Connection()).first;
+            open(config, record.connectionId, found->second);
+        }
+
+        // A dropped connection keeps its entry, the rest of its records would make no sense on a new one
+        Connection &connection = found->second;
+        if(connection.fd < 0)
+            continue;
+        connection.output.insert(
+            connection.output.end(), content.data() + record.offset, content.data() + record.offset + record.len);
+        totals.records++;
+        if(!connection.connecting)
+            flush(record.connectionId, connection);
+
+        // Without a rate to keep the server sets the pace, reading its responses keeps it from stalling on them
+        handleEvents(0, buffer.data());
+        while(connection.fd >= 0 && connection.output.size() > maxOutputLen)
+            handleEvents(1, buffer.data());
+    }
+
+    uint64_t drainStart = getNow();
+    while(getNow() - drainStart < drainTimeoutNs &&
+          std::any_of(connections.begin(), connections.end(), [](const auto &entry) {
+              return entry.second.fd >= 0 && (entry.second.connecting || !entry.second.output.empty());
+          }))
+    {
+        handleEvents(1, buffer.data());
+    }
+    totals.duration = getNow() - start;
+    return totals;
+}
+
+void TrafficReplay::open(const Config &config, uint32_t connectionId, Connection &connection)
+{
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port   = htons(config.port);
+    if(inet_pton(AF_INET, config.address.c_str(), &address.sin_addr) != 1)
+    {
+        throw std::runtime_error("Invalid server address " + config.address);
+    }
+
+    totals.connections++;
+    connection.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(connection.fd < 0)
+    {
+        close(connectionId, connection, true);
+        return;
+    }
+
+    // Records are written as they are due, not collected by Nagle
+    int option = 1;
+    setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+
+    epoll_event event{EPOLLIN | EPOLLOUT, {.u64 = connectionId}};
+    if((connect(connection.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 &&
+        errno != EINPROGRESS) ||
+       epoll_ctl(epollFd, EPOLL_CTL_ADD, connection.fd, &event) != 0)
+    {
+        close(connectionId, connection, true);
+    }
+}
+
+void TrafficReplay::close(uint32_t connectionId, Connection &connection, bool dropped)
+{
+    if(connection.fd >= 0)
+    {
+        ::close(connection.fd);
+        connection.fd = -1;
+    }
+    if(dropped)
+    {
+        totals.drops++;
+        connection.output.clear();
+        return;
+    }
+    connections.erase(connectionId);
+}
+
+void TrafficReplay::flush(uint32_t connectionId, Connection &connection)
+{
+    size_t written = 0;
+    while(written < connection.output.size())
+    {
+        ssize_t len =
+            ::send(connection.fd, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if(len < 0 && errno == EINTR)
+            continue;
+        if(len < 0 && errno == EAGAIN)
+            break;
+        if(len <= 0)
+        {
+            close(connectionId, connection, true);
+            return;
+        }
+        written += len;
+    }
+    totals.bytesSent += written;
+    connection.output.erase(connection.output.begin(), connection.output.begin() + written);
+
+    // Writability is only watched while there is output left
+    epoll_event event{EPOLLIN | (connection.output.empty() ? 0u : uint32_t(EPOLLOUT)), {.u64 = connectionId}};
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    if(connection.output.empty() && connection.closing)
+    {
+        close(connectionId, connection, false);
+    }
+}
+
+void TrafficReplay::handleEvents(int timeoutMs, uint8_t *buffer)
+{
+    epoll_event events[maxEvents];
+    int         eventsNum = epoll_wait(epollFd, events, maxEvents, timeoutMs);
+    for(int i = 0; i < eventsNum; i++)
+    {
+        uint32_t connectionId = static_cast<uint32_t>(events[i].data.u64);
+        auto     found        = connections.find(connectionId);
+        if(found == connections.end() || found->second.fd < 0)
+            continue;
+
+        Connection &connection = found->second;
+        if(connection.connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0)
+        {
+            int       error    = 0;
+            socklen_t errorLen = sizeof(error);
+            if(getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) != 0 || error != 0)
+            {
+                close(connectionId, connection, true);
+                continue;
+            }
+            connection.connecting = false;
+        }
+        if(!connection.connecting && (events[i].events & EPOLLOUT) != 0)
+        {
+            flush(connectionId, connection);
+
+            // The connection is gone if it was closing
+            found = connections.find(connectionId);
+            if(found == connections.end() || found->second.fd < 0)
+                continue;
+        }
+        if((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+        {
+            while(true)
+            {
+                ssize_t len = read(connection.fd, buffer, readBufferLen);
+                if(len > 0)
+                {
+                    totals.bytesReceived += len;
+                    continue;
+                }
+                if(len < 0 && (errno == EAGAIN || errno == EINTR))
+                    break;
+                close(connectionId, connection, true);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Replays a traffic capture of the server (see utilities/trafficCapture.hpp) against a running server. Every captured
+ * connection gets a connection of its own, opened with its first record and closed with its close record, and its data
+ * is written in the captured order. Records are due at their captured time divided by the speed, with speed 0 they are
+ * written as fast as the server takes them. Responses of the server are read and dropped.
+ *
+ * The replayed nodes register again and get new ids, messages between nodes only reach their destination if the
+ * server hands out the ids of the captured run, so a capture of a freshly started server replays best against a
+ * freshly started server.
+ */
+class TrafficReplay
+{
+public:
+    struct Config
+    {
+        std::string address = "127.0.0.1";
+        uint16_t    port    = 10000;
+        double      speed   = 1; // Multiple of the captured rate, 0 for as fast as possible
+    };
+
+    struct Totals
+    {
+        uint64_t records       = 0; // Data records written
+        uint64_t bytesSent     = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t connections   = 0;
+        uint64_t drops         = 0; // Connections closed by the server or an error before their close record
+        uint64_t maxLag        = 0; // Nanoseconds a record was written after it was due
+        uint64_t duration      = 0; // Nanoseconds from the first record to the last one written
+        uint64_t capturedSpan  = 0; // Nanoseconds from the first record to the last one in the capture
+    };
+
+    TrafficReplay() = delete;
+    TrafficReplay(const std::string &capturePath);
+    ~TrafficReplay();
+
+    size_t getRecordsNum() const { return records.size(); }
+    size_t getConnectionsNum() const { return connectionsNum; }
+
+    // Replays the whole capture once, returns when all data is written or the connections are dropped
+    Totals run(const Config &config);
+
+private:
+    static constexpr size_t maxEvents     = 256;
+    static constexpr size_t readBufferLen = 64 * 1024;
+    static constexpr size_t maxOutputLen  = 4 * 1024 * 1024; // Of a connection before the replay waits for it
+
+    struct Record
+    {
+        uint64_t time; // Nanoseconds after the first record
+        uint32_t connectionId;
+        size_t   offset; // Of the data in content
+        size_t   len;    // 0 for the close record
+    };
+
+    struct Connection
+    {
+        int                  fd         = -1;
+        bool                 connecting = true;
+        bool                 closing    = false; // The close record was reached, closes once output is written
+        std::vector<uint8_t> output;             // Not yet written
+    };
+
+    std::vector<uint8_t> content;
+    std::vector<Record>  records; // By time, stable so that the records of a connection keep their order
+    size_t               connectionsNum = 0;
+
+    int                                      epollFd = -1;
+    std::unordered_map<uint32_t, Connection> connections;
+    Totals                                   totals;
+
+    static uint64_t getNow()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void open(const Config &config, uint32_t connectionId, Connection &connection);
+    void close(uint32_t connectionId, Connection &connection, bool dropped);
+    void flush(uint32_t connectionId, Connection &connection);
+    void handleEvents(int timeoutMs, uint8_t *buffer);
+};
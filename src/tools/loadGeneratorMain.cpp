@@ -0,0 +1,139 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "simulator/loadGenerator.hpp"
+
+/* Drives a fleet of simulated nodes against a running server, see simulator/loadGenerator.hpp. Prints progress every
+ * second and the achieved throughput and round trip percentiles at the end.
+ * Usage: iot-load-generator [--address <ip>] [--port <port>] [--nodes <n>] [--threads <n>] [--rate <pings/s>]
+ *                           [--connect-rate <connections/s>] [--churn <disconnects/s>] [--reconnect-delay <ms>]
+ *                           [--timeout <ms>] [--duration <s>] [--pattern random|ring|hotspot]
+ *                           [--payload fixed:<len>|uniform:<min>-<max>|exponential:<mean>]
+ */
+namespace
+{
+void printUsage(const char *executable)
+{
+    std::cerr << "Usage: " << executable
+              << " [--address <ip>] [--port <port>] [--nodes <n>] [--threads <n>] [--rate <pings/s, 0 closed loop>]"
+                 " [--connect-rate <connections/s>] [--churn <disconnects/s>] [--reconnect-delay <ms>]"
+                 " [--timeout <ms>] [--duration <s>] [--pattern random|ring|hotspot]"
+                 " [--payload fixed:<len>|uniform:<min>-<max>|exponential:<mean>]"
+              << std::endl;
+}
+
+LoadGenerator::Config parseConfig(int argc, char *argv[])
+{
+    LoadGenerator::Config config;
+    for(int i = 1; i < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if(i + 1 >= argc)
+            throw std::runtime_error("Missing value of " + option);
+
+        std::string value = argv[i + 1];
+        if(option == "--address")
+            config.address = value;
+        else if(option == "--port")
+            config.port = static_cast<uint16_t>(std::stoul(value));
+        else if(option == "--nodes")
+            config.nodesNum = std::stoul(value);
+        else if(option == "--threads")
+            config.threadsNum = std::stoul(value);
+        else if(option == "--rate")
+            config.messageRate = std::stod(value);
+        else if(option == "--connect-rate")
+            config.connectRate = std::stod(value);
+        else if(option == "--churn")
+            config.churnRate = std::stod(value);
+        else if(option == "--reconnect-delay")
+            config.reconnectDelay = std::chrono::milliseconds(std::stoul(value));
+        else if(option == "--timeout")
+            config.replyTimeout = std::chrono::milliseconds(std::stoul(value));
+        else if(option == "--duration")
+            config.duration = std::chrono::seconds(std::stoul(value));
+        else if(option == "--payload")
+            config.payload = LoadGenerator::PayloadDistribution::parse(value);
+        else if(option == "--pattern" && value == "random")
+            config.pattern = LoadGenerator::Pattern::Random;
+        else if(option == "--pattern" && value == "ring")
+            config.pattern = LoadGenerator::Pattern::Ring;
+        else if(option == "--pattern" && value == "hotspot")
+            config.pattern = LoadGenerator::Pattern::Hotspot;
+        else
+            throw std::runtime_error("Unknown option " + option + " " + value);
+    }
+    return config;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    LoadGenerator::Config config;
+    try
+    {
+        config = parseConfig(argc, argv);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        LoadGenerator         generator(config);
+        LoadGenerator::Totals last;
+        size_t                second = 0;
+        generator.run(
+            [&](const LoadGenerator::Totals &totals) {
+                second++;
+                std::printf("%4zus: active %6llu, pings %7llu/s, replies %7llu/s, timeouts %llu, churned %llu, "
+                            "dropped %llu\n",
+                            second,
+                            static_cast<unsigned long long>(totals.activeNodes),
+                            static_cast<unsigned long long>(totals.pings - last.pings),
+                            static_cast<unsigned long long>(totals.replies - last.replies),
+                            static_cast<unsigned long long>(totals.timeouts),
+                            static_cast<unsigned long long>(totals.disconnects),
+                            static_cast<unsigned long long>(totals.drops));
+                std::fflush(stdout);
+                last = totals;
+            },
+            std::chrono::seconds(1));
+
+        // Every ping and reply is routed by the server, so its message rate is twice the round trip rate
+        LoadGenerator::Totals        totals  = generator.getTotals();
+        Metrics::Histogram::Snapshot trips   = generator.getRoundTrips();
+        double                       seconds = std::chrono::duration<double>(config.duration).count();
+        std::printf("nodes %zu, threads %zu, duration %.0f s\n", config.nodesNum, config.threadsNum, seconds);
+        std::printf("connects %llu, churned %llu, dropped %llu\n",
+                    static_cast<unsigned long long>(totals.connects),
+                    static_cast<unsigned long long>(totals.disconnects),
+                    static_cast<unsigned long long>(totals.drops));
+        std::printf("pings %llu, replies %llu, timeouts %llu\n",
+                    static_cast<unsigned long long>(totals.pings),
+                    static_cast<unsigned long long>(totals.replies),
+                    static_cast<unsigned long long>(totals.timeouts));
+        std::printf("throughput %.0f round trips/s, %.0f routed messages/s, %.2f MB/s sent\n",
+                    totals.replies / seconds,
+                    (totals.pings + totals.replies) / seconds,
+                    totals.bytesSent / seconds / 1e6);
+        std::printf("round trip us: mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+                    trips.getMean() / 1e3,
+                    trips.getQuantile(0.5) / 1e3,
+                    trips.getQuantile(0.9) / 1e3,
+                    trips.getQuantile(0.99) / 1e3,
+                    trips.getQuantile(0.999) / 1e3,
+                    trips.getMax() / 1e3);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "iot-load-generator: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+#include "utilities/diagnostics.hpp"
+#include "utilities/logFile.hpp"
+#include "utilities/logFormat.hpp"
+#include "utilities/logger.hpp"
+#include "utilities/quarantineRing.hpp"
+
+/* Turns a binary log written with Logger::setBinaryOutput into the text the logger writes to the console. Also reads
+ * the files of Logger::setFileOutput, compressed or not, and prints their text or decodes their binary log. A
+ * quarantine ring file is printed as hex dumps of its frames.
+ * Usage: iot-log-decoder [--plain] <file>
+ */
+namespace
+{
+using Logger = Utilities::Logger;
+using namespace Utilities::LogFormat;
+
+struct Format
+{
+    Logger::LogLevel logLevel;
+    std::string      file;
+    uint32_t         line;
+    std::string      format;
+};
+
+class Decoder
+{
+public:
+    Decoder(const std::vector<uint8_t> &data, bool color) :
+        in(data.data()), end(data.data() + data.size()), color(color)
+    {
+    }
+
+    // Writes all complete records to stdout, returns false if the file ends inside a record
+    bool decode()
+    {
+        if(size_t(end - in) < sizeof(fileMagic) || memcmp(in, &fileMagic, sizeof(fileMagic)) != 0)
+        {
+            std::cerr << "iot-log-decoder: Not a binary log file" << std::endl;
+            return false;
+        }
+
+        try
+        {
+            while(in < end)
+            {
+                decodeRecord();
+                if(output.size() >= outputChunkLen)
+                    writeOutput();
+            }
+        }
+        catch(const std::exception &e)
+        {
+            writeOutput();
+            std::cerr << "iot-log-decoder: " << e.what() << std::endl;
+            return false;
+        }
+        writeOutput();
+        return true;
+    }
+
+private:
+    static constexpr size_t outputChunkLen = 64 * 1024;
+
+    const uint8_t *                      in;
+    const uint8_t *                      end;
+    bool                                 color;
+    std::unordered_map<uint32_t, Format> formats;
+    uint64_t                             timestamp = 0;
+    std::string                          output;
+    std::string                          message;
+
+    void writeOutput()
+    {
+        std::fwrite(output.data(), 1, output.size(), stdout);
+        output.clear();
+    }
+
+    uint8_t readByte()
+    {
+        if(in >= end)
+        {
+            throw std::runtime_error("Truncated record at the end of the file");
+        }
+        return *in++;
+    }
+
+    std::string_view readBytes()
+    {
+        uint64_t len = readVarint(in, end);
+        if(len > uint64_t(end - in))
+        {
+            throw std::runtime_error("Truncated record at the end of the file");
+        }
+        std::string_view bytes(reinterpret_cast<const char *>(in), len);
+        in += len;
+        return bytes;
+    }
+
+    void readTimestamp() { timestamp += fromZigzag(readVarint(in, end)); }
+
+    void decodeRecord()
+    {
+        // Every process appending to the file starts with the magic
+        if(size_t(end - in) >= sizeof(fileMagic) && memcmp(in, &fileMagic, sizeof(fileMagic)) == 0)
+        {
+            in += sizeof(fileMagic);
+            formats.clear();
+            timestamp = 0;
+            return;
+        }
+
+        FileRecord kind = FileRecord(readByte());
+        switch(kind)
+        {
+        case FileRecord::Format:
+        {
+            uint32_t formatId = readVarint(in, end);
+            Format   format;
+            format.logLevel   = Logger::LogLevel(readByte());
+            format.line       = readVarint(in, end);
+            format.file       = readBytes();
+            format.format     = readBytes();
+            formats[formatId] = std::move(format);
+            break;
+        }
+
+        case FileRecord::Text:
+        {
+            Logger::LogLevel logLevel = Logger::LogLevel(readByte());
+            readTimestamp();
+            Logger::appendLines(output, readBytes(), logLevel, timestamp, color);
+            break;
+        }
+
+        case FileRecord::Entry:
+        {
+            uint32_t formatId = readVarint(in, end);
+            readTimestamp();
+            std::string_view args = readBytes();
+
+            auto format = formats.find(formatId);
+            if(format == formats.end())
+            {
+                throw std::runtime_error("Entry with unknown format id " + std::to_string(formatId));
+            }
+            message.clear();
+            Utilities::LogFormat::format(message,
+                                         format->second.format,
+                                         reinterpret_cast<const uint8_t *>(args.data()),
+                                         args.size());
+            Logger::appendLines(output, message, format->second.logLevel, timestamp, color);
+            break;
+        }
+
+        default:
+            throw std::runtime_error("Invalid record type " + std::to_string(int(kind)));
+        }
+    }
+};
+
+// Prints every frame of a quarantine ring, oldest first, 16 bytes per line
+bool printQuarantine(const std::vector<uint8_t> &data, bool color)
+{
+    static constexpr size_t bytesPerLine = 16;
+
+    std::string output;
+    bool        valid = Utilities::QuarantineRing::readRing(
+        data.data(), data.size(), [&](const Utilities::QuarantineRing::Record &record) {
+            std::string message = "Frame of node " + std::to_string(record.source) + ", " +
+                                  std::to_string(record.frameLen) + " bytes";
+            if(record.storedLen < record.frameLen)
+                message += ", first " + std::to_string(record.storedLen) + " kept";
+
+            char line[16];
+            for(size_t offset = 0; offset < record.storedLen; offset += bytesPerLine)
+            {
+                snprintf(line, sizeof(line), "\n%06zX ", offset);
+                message += line;
+                message += Utilities::Diagnostic::toHex(record.data + offset,
+                                                        std::min<size_t>(record.storedLen - offset, bytesPerLine),
+                                                        bytesPerLine);
+            }
+            Logger::appendLines(output, message, Logger::LogLevel::Warning, record.timestamp, color);
+            std::fwrite(output.data(), 1, output.size(), stdout);
+            output.clear();
+        });
+
+    if(!valid)
+    {
+        std::cerr << "iot-log-decoder: Invalid quarantine ring" << std::endl;
+    }
+    return valid;
+}
+} // namespace
+
+static constexpr unsigned readLen = 1024 * 1024;
+
+int main(int argc, char *argv[])
+{
+    bool        color = true;
+    std::string path;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if(argument == "--plain")
+            color = false;
+        else
+            path = argument;
+    }
+    if(path.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " [--plain] <file>" << std::endl;
+        return 1;
+    }
+
+    // gzread reads uncompressed files as they are
+    gzFile file = gzopen(path.c_str(), "rb");
+    if(file == nullptr)
+    {
+        std::cerr << "iot-log-decoder: Unable to open " << path << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    while(true)
+    {
+        size_t len = data.size();
+        data.resize(len + readLen);
+        int ret = gzread(file, data.data() + len, readLen);
+        data.resize(len + std::max(ret, 0));
+        if(ret <= 0)
+            break;
+    }
+    gzclose(file);
+
+    uint64_t magic = 0;
+    if(data.size() >= Utilities::LogFile::headerLen)
+        memcpy(&magic, data.data(), sizeof(magic));
+    if(magic == Utilities::QuarantineRing::fileMagic)
+        return printQuarantine(data, color) ? 0 : 1;
+    if(magic != Utilities::LogFile::fileMagic)
+    {
+        Decoder decoder(data, color);
+        return decoder.decode() ? 0 : 1;
+    }
+
+    uint32_t flags = 0;
+    memcpy(&flags, data.data() + sizeof(magic), sizeof(flags));
+    bool                 binary = (flags & Utilities::LogFile::Flags::Binary) != 0;
+    bool                 torn   = false;
+    std::vector<uint8_t> binaryLog;
+    Utilities::LogFile::readBlocks(data.data(), data.size(), torn, [&](const uint8_t *payload, size_t len) {
+        if(binary)
+            binaryLog.insert(binaryLog.end(), payload, payload + len);
+        else
+            std::fwrite(payload, 1, len, stdout);
+    });
+
+    bool success = true;
+    if(binary)
+    {
+        Decoder decoder(binaryLog, color);
+        success = decoder.decode();
+    }
+    if(torn)
+    {
+        // A torn last block is what a crash leaves behind, everything before it is intact
+        std::cerr << "iot-log-decoder: Torn block at the end of " << path << " skipped" << std::endl;
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "simulator/simulation.hpp"
+#include "utilities/logger.hpp"
+
+/* Runs the deterministic in-process simulation of a node fleet against a server without sockets, see
+ * simulator/simulation.hpp. The server keeps its stores in a fresh temporary directory unless --dir is given, a
+ * directory with the stores of an earlier run restores its nodes and changes the run.
+ * Usage: iot-simulation [--nodes <n>] [--seed <n>] [--rate <pings/s>] [--connect-rate <connections/s>]
+ *                       [--payload <len>] [--latency <us>] [--duration <virtual s>] [--dir <directory>]
+ */
+namespace
+{
+void printUsage(const char *executable)
+{
+    std::cerr << "Usage: " << executable
+              << " [--nodes <n>] [--seed <n>] [--rate <pings/s>] [--connect-rate <connections/s>]"
+                 " [--payload <len>] [--latency <us>] [--duration <virtual s>] [--dir <directory>]"
+              << std::endl;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Simulation::Config config;
+    std::string        directory;
+    try
+    {
+        for(int i = 1; i < argc; i += 2)
+        {
+            std::string option = argv[i];
+            if(i + 1 >= argc)
+                throw std::runtime_error("Missing value of " + option);
+
+            std::string value = argv[i + 1];
+            if(option == "--nodes")
+                config.nodesNum = std::stoul(value);
+            else if(option == "--seed")
+                config.seed = std::stoull(value);
+            else if(option == "--rate")
+                config.messageRate = std::stod(value);
+            else if(option == "--connect-rate")
+                config.connectRate = std::stod(value);
+            else if(option == "--payload")
+                config.payloadLen = std::stoul(value);
+            else if(option == "--latency")
+                config.latency = std::chrono::microseconds(std::stoul(value));
+            else if(option == "--duration")
+                config.duration = std::chrono::seconds(std::stoul(value));
+            else if(option == "--dir")
+                directory = value;
+            else
+                throw std::runtime_error("Unknown option " + option);
+        }
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // The stores are opened in the working directory, the server interface description is found next to the executable
+    std::filesystem::path temporary;
+    try
+    {
+        if(directory.empty())
+        {
+            std::string pattern = (std::filesystem::temp_directory_path() / "iot-simulation-XXXXXX").string();
+            if(mkdtemp(pattern.data()) == nullptr)
+                throw std::runtime_error("Unable to create a temporary directory");
+            temporary = pattern;
+            directory = pattern;
+        }
+        std::filesystem::create_directories(directory);
+        std::filesystem::current_path(directory);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "iot-simulation: " << e.what() << std::endl;
+        return 1;
+    }
+
+    int result = 0;
+    try
+    {
+        Utilities::Logger::setGlobalLogLevel(Utilities::Logger::LogLevel::Warning);
+
+        Server::Config serverConfig;
+        serverConfig.port                   = 0;
+        serverConfig.eventThread            = false;
+        serverConfig.metrics.socketPath     = "";
+        serverConfig.sharedMemorySocketPath = "";
+        serverConfig.localSocketPath        = "";
+        Server     server(serverConfig);
+        Simulation simulation(server, config);
+
+        Simulation::Totals           totals = simulation.run();
+        Metrics::Histogram::Snapshot trips  = simulation.getRoundTrips();
+        double                       wall   = totals.wallTime / 1e9;
+        std::printf("nodes %zu, seed %llu, virtual %.3f s, wall %.3f s, %llu actions\n",
+                    config.nodesNum,
+                    static_cast<unsigned long long>(config.seed),
+                    totals.virtualTime / 1e9,
+                    wall,
+                    static_cast<unsigned long long>(totals.actions));
+        std::printf("registered %llu, pings %llu, replies %llu, frames in %llu, out %llu\n",
+                    static_cast<unsigned long long>(totals.registered),
+                    static_cast<unsigned long long>(totals.pings),
+                    static_cast<unsigned long long>(totals.replies),
+                    static_cast<unsigned long long>(totals.framesIn),
+                    static_cast<unsigned long long>(totals.framesOut));
+        std::printf("server cpu %.3f s, %.0f ns per frame in; process cpu %.3f s; %.0f frames/s wall\n",
+                    totals.serverCpuTime / 1e9,
+                    totals.framesIn > 0 ? double(totals.serverCpuTime) / totals.framesIn : 0,
+                    totals.processCpu / 1e9,
+                    wall > 0 ? totals.framesIn / wall : 0);
+        std::printf("virtual round trip us: p50 %.1f, p99 %.1f, max %.1f\n",
+                    trips.getQuantile(0.5) / 1e3,
+                    trips.getQuantile(0.99) / 1e3,
+                    trips.getMax() / 1e3);
+        std::printf("digest %016llx\n", static_cast<unsigned long long>(totals.digest));
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "iot-simulation: " << e.what() << std::endl;
+        result = 1;
+    }
+
+    if(!temporary.empty())
+    {
+        std::error_code error;
+        std::filesystem::current_path(temporary.parent_path(), error);
+        std::filesystem::remove_all(temporary, error);
+    }
+    return result;
+}
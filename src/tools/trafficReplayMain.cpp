@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "simulator/trafficReplay.hpp"
+
+/* Replays a traffic capture of the server (iot-server --capture <file>) against a running server, see
+ * simulator/trafficReplay.hpp. Prints how closely the captured timing was kept and the achieved rate.
+ * Usage: iot-traffic-replay [--address <ip>] [--port <port>] [--speed <n, 0 as fast as possible>] [--loops <n>]
+ *                           <capture file>
+ */
+namespace
+{
+void printUsage(const char *executable)
+{
+    std::cerr << "Usage: " << executable
+              << " [--address <ip>] [--port <port>] [--speed <n, 0 as fast as possible>] [--loops <n>]"
+                 " <capture file>"
+              << std::endl;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    TrafficReplay::Config config;
+    std::string           capturePath;
+    size_t                loops = 1;
+    try
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            std::string option = argv[i];
+            if(i + 1 == argc && option.compare(0, 2, "--") != 0)
+                capturePath = option;
+            else if(i + 1 >= argc)
+                throw std::runtime_error("Missing value of " + option);
+            else if(option == "--address")
+                config.address = argv[++i];
+            else if(option == "--port")
+                config.port = static_cast<uint16_t>(std::stoul(argv[++i]));
+            else if(option == "--speed")
+                config.speed = std::stod(argv[++i]);
+            else if(option == "--loops")
+                loops = std::stoul(argv[++i]);
+            else
+                throw std::runtime_error("Unknown option " + option);
+        }
+        if(capturePath.empty())
+            throw std::runtime_error("Missing capture file");
+        if(config.speed < 0)
+            throw std::runtime_error("Negative speed");
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        TrafficReplay replay(capturePath);
+        std::printf("%s: %zu records of %zu connections\n",
+                    capturePath.c_str(),
+                    replay.getRecordsNum(),
+                    replay.getConnectionsNum());
+
+        // Every loop is a separate run, a regression test compares the rates of runs at speed 0
+        for(size_t loop = 0; loop < loops; loop++)
+        {
+            TrafficReplay::Totals totals   = replay.run(config);
+            double                seconds  = totals.duration / 1e9;
+            double                captured = totals.capturedSpan / 1e9;
+            std::printf("run %zu: %llu records, %.2f MB in %.3f s (captured %.3f s, %.2fx), %.0f records/s, "
+                        "%.2f MB/s\n",
+                        loop + 1,
+                        static_cast<unsigned long long>(totals.records),
+                        totals.bytesSent / 1e6,
+                        seconds,
+                        captured,
+                        seconds > 0 ? captured / seconds : 0,
+                        seconds > 0 ? totals.records / seconds : 0,
+                        seconds > 0 ? totals.bytesSent / seconds / 1e6 : 0);
+            std::printf("       connections %llu, dropped %llu, received %.2f MB, max lag %.3f ms\n",
+                        static_cast<unsigned long long>(totals.connections),
+                        static_cast<unsigned long long>(totals.drops),
+                        totals.bytesReceived / 1e6,
+                        totals.maxLag / 1e6);
+            std::fflush(stdout);
+        }
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "iot-traffic-replay: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+
+#include "diagnostics.hpp"
+
+namespace Utilities
+{
+RateLimiter::RateLimiter(double ratePerSecond, double burst) :
+    interval(static_cast<uint64_t>(1e9 / std::max(ratePerSecond, 1e-9))),
+    tolerance(static_cast<uint64_t>(interval * (std::max(burst, 1.0) - 1)))
+{
+}
+
+bool RateLimiter::tryAcquire(uint64_t now)
+{
+    uint64_t arrival = theoreticalArrival.load(std::memory_order_relaxed);
+    while(true)
+    {
+        uint64_t start = std::max(arrival, now);
+        if(start - now > tolerance)
+            return false;
+
+        if(theoreticalArrival.compare_exchange_weak(arrival, start + interval, std::memory_order_relaxed))
+            return true;
+    }
+}
+
+Diagnostic::Source::Source(const Diagnostic &diagnostic) :
+    limiter(diagnostic.config.sourceRate, diagnostic.config.sourceBurst)
+{
+}
+
+Diagnostic::Diagnostic(Logger::Module module, const char *name) : Diagnostic(module, name, Config())
+{
+}
+
+Diagnostic::Diagnostic(Logger::Module module, const char *name, const Config &config) :
+    module(module), name(name), config(config), globalLimiter(config.globalRate, config.globalBurst)
+{
+    nextSummary = getNow() + std::chrono::duration_cast<std::chrono::nanoseconds>(config.summaryInterval).count();
+}
+
+bool Diagnostic::sample(Source &source)
+{
+    uint64_t now = getNow();
+    source.events++;
+    events.fetch_add(1, std::memory_order_relaxed);
+
+    bool candidate = source.events <= config.sampleFirst ||
+                     (config.sampleEvery > 0 && (source.events - config.sampleFirst) % config.sampleEvery == 0);
+    bool logged = candidate && source.limiter.tryAcquire(now) && globalLimiter.tryAcquire(now);
+    if(!logged)
+    {
+        source.suppressed++;
+        totalSuppressed.fetch_add(1, std::memory_order_relaxed);
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    logSummary(now);
+    return logged;
+}
+
+void Diagnostic::endSource(Source &source, std::string_view sourceName)
+{
+    if(source.suppressed > 0 && Logger::isEnabled(module, Logger::LogLevel::Warning))
+    {
+        Logger::logMessage(module,
+                           std::string(name) + " of " + std::string(sourceName) + ": suppressed " +
+                               std::to_string(source.suppressed) + " of " + std::to_string(source.events) +
+                               " similar events",
+                           Logger::LogLevel::Warning);
+    }
+    source.events     = 0;
+    source.suppressed = 0;
+}
+
+std::string Diagnostic::toHex(const uint8_t *data, size_t len, size_t maxLen)
+{
+    static constexpr char digits[] = "0123456789ABCDEF";
+
+    std::string hex;
+    size_t      hexLen = std::min(len, maxLen);
+    hex.reserve(hexLen * 3 + 24);
+    for(size_t i = 0; i < hexLen; i++)
+    {
+        if(i > 0)
+            hex += ' ';
+        hex += digits[data[i] >> 4];
+        hex += digits[data[i] & 0x0F];
+    }
+    if(len > hexLen)
+    {
+        hex += " ... (" + std::to_string(len - hexLen) + " more bytes)";
+    }
+    return hex;
+}
+
+uint64_t Diagnostic::getNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Diagnostic::logSummary(uint64_t now)
+{
+    // One caller per interval wins the summary
+    uint64_t next = nextSummary.load(std::memory_order_relaxed);
+    if(now < next || suppressed.load(std::memory_order_relaxed) == 0)
+        return;
+
+    uint64_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(config.summaryInterval).count();
+    if(!nextSummary.compare_exchange_strong(next, now + interval, std::memory_order_relaxed))
+        return;
+
+    uint64_t count = suppressed.exchange(0, std::memory_order_relaxed);
+    if(count > 0 && Logger::isEnabled(module, Logger::LogLevel::Warning))
+    {
+        Logger::logMessage(module,
+                           std::string(name) + ": suppressed " + std::to_string(count) + " similar events",
+                           Logger::LogLevel::Warning);
+    }
+}
+} // namespace Utilities
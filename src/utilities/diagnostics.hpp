@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "logger.hpp"
+
+namespace Utilities
+{
+// Token bucket in the form of the generic cell rate algorithm, the state is a single atomic so it can be shared
+// between threads without a lock
+class RateLimiter
+{
+public:
+    RateLimiter(double ratePerSecond, double burst);
+
+    // True if a token was available at now (steady clock nanoseconds)
+    bool tryAcquire(uint64_t now);
+
+private:
+    uint64_t              interval;  // Nanoseconds per token
+    uint64_t              tolerance; // How far the theoretical arrival may run ahead of now
+    std::atomic<uint64_t> theoreticalArrival = 0;
+};
+
+/* Logging of events that can repeat at the rate of the input, like malformed frames of a misbehaving node, without
+ * letting the log output grow with them. Of every source's events the first sampleFirst and then every sampleEvery-th
+ * are candidates, a candidate is logged if both the rate limit of its source and the global one have a token left.
+ * The other events are only counted and reported as "suppressed K similar events", at most once per summaryInterval
+ * for all sources and per source when it ends.
+ *
+ *     if(malformedFrames.sample(source))
+ *         LOG_FORMAT(LogLevel::Warning, "Malformed frame ...", ...);
+ */
+class Diagnostic
+{
+public:
+    struct Config
+    {
+        uint32_t             sampleFirst     = 10;
+        uint32_t             sampleEvery     = 1000; // 0 logs no more events after the first ones
+        double               sourceRate      = 1;    // Logged events per second of a single source
+        double               sourceBurst     = 5;
+        double               globalRate      = 10; // Logged events per second of all sources
+        double               globalBurst     = 20;
+        std::chrono::seconds summaryInterval = std::chrono::seconds(10);
+    };
+
+    // Events of one sender, e.g. a node, used by one thread at a time
+    class Source
+    {
+    public:
+        Source(const Diagnostic &diagnostic);
+
+        uint64_t getEvents() const { return events; }
+        uint64_t getSuppressed() const { return suppressed; }
+
+    private:
+        friend class Diagnostic;
+
+        RateLimiter limiter;
+        uint64_t    events     = 0;
+        uint64_t    suppressed = 0;
+    };
+
+    Diagnostic(Logger::Module module, const char *name);
+    Diagnostic(Logger::Module module, const char *name, const Config &config);
+
+    // Counts an event of source, true if the caller should log it
+    bool sample(Source &source);
+
+    // Logs the suppressed events of source, if any, and starts its counts over, e.g. when a node disconnects
+    void endSource(Source &source, std::string_view sourceName);
+
+    uint64_t getEvents() const { return events; }
+    uint64_t getSuppressed() const { return totalSuppressed; }
+
+    // Up to maxLen bytes as hex, for a short excerpt of an event's data in its log message
+    static std::string toHex(const uint8_t *data, size_t len, size_t maxLen = 16);
+
+private:
+    Logger::Module module;
+    const char *   name;
+    Config         config;
+    RateLimiter    globalLimiter;
+
+    std::atomic<uint64_t> events          = 0;
+    std::atomic<uint64_t> totalSuppressed = 0;
+    std::atomic<uint64_t> suppressed      = 0; // Since the last summary
+    std::atomic<uint64_t> nextSummary     = 0;
+
+    static uint64_t getNow();
+
+    void logSummary(uint64_t now);
+};
+} // namespace Utilities
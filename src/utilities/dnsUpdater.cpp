@@ -48,11 +48,12 @@ int DnsUpdater::updateDnsIp()
         if(strcmp(webPageBuffer, "OK") == 0)
             return 0;
         else
-            log("Unexpected web content received! Received web: " + std::string(webPageBuffer), LogLevel::Debug);
+            LOG_MESSAGE(LogLevel::Debug,
+                        "Unexpected web content received! Received web: " + std::string(webPageBuffer));
     }
     else
     {
-        log("curl_easy_perform() failed with error " + std::to_string(status), LogLevel::Error);
+        LOG_MESSAGE(LogLevel::Error, "curl_easy_perform() failed with error " + std::to_string(status));
     }
 
     return -EFAULT;
@@ -85,12 +86,12 @@ void DnsUpdater::updateThread(DnsUpdater *obj)
 
         if(ret >= 0)
         {
-            obj->log("DNS successfully updated!", LogLevel::Info);
+            LOG_MESSAGE(LogLevel::Info, "DNS successfully updated!");
             sleepSeconds = obj->updateIntervalSeconds; // Sleep for updateIntervalSeconds
         }
         else
         {
-            obj->log("Updating DNS failed!", LogLevel::Warning);
+            LOG_MESSAGE(LogLevel::Warning, "Updating DNS failed!");
             sleepSeconds = obj->minUpdateIntervalSeconds; // Sleep for minUpdateIntervalSeconds and try again
         }
         sleep(sleepSeconds);
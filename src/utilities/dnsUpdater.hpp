@@ -20,6 +20,8 @@ private:
 
     using LogLevel = Utilities::Logger::LogLevel;
 
+    static constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::DnsUpdater;
+
     CURL *       curl;
     std::thread  updaterThread;
     char         webPageBuffer[webPageBufferSize];
@@ -32,11 +34,6 @@ private:
                 copyWebpage(const void *buf, const std::size_t size, const std::size_t nmemb, void *user_pointer);
     static void updateThread(DnsUpdater *obj);
 
-    void log(const std::string &message, LogLevel logLevel = LogLevel::Info) const
-    {
-        Utilities::Logger::logMessage("DnsUpdater:: " + message, logLevel);
-    }
-
 public:
     DnsUpdater() = delete;
     DnsUpdater(const int intervalSeconds = minUpdateIntervalSeconds);
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "logFile.hpp"
+#include "logger.hpp"
+#include "message/crc.hpp"
+
+namespace Utilities
+{
+namespace
+{
+using LogLevel = Logger::LogLevel;
+
+constexpr Logger::Module logModule = Logger::Module::LogFile;
+
+constexpr size_t flagsIndex      = 8;
+constexpr size_t compressReadLen = 256 * 1024;
+} // namespace
+
+LogFile::LogFile(const Config &config) : config(config)
+{
+    std::filesystem::create_directories(config.directory);
+
+    // Files of earlier runs, "<name>-<sequence>.log" or "<name>-<sequence>.log.gz"
+    std::vector<uint32_t> sequences;
+    std::vector<uint32_t> uncompressed;
+    for(const auto &entry : std::filesystem::directory_iterator(config.directory))
+    {
+        std::string fileName     = entry.path().filename().string();
+        unsigned    fileSequence = 0;
+        int         nameLen      = 0;
+        if(fileName.compare(0, config.name.size() + 1, config.name + "-") != 0 ||
+           sscanf(fileName.c_str() + config.name.size() + 1, "%8u.log%n", &fileSequence, &nameLen) != 1 || nameLen == 0)
+            continue;
+
+        std::string suffix = fileName.substr(config.name.size() + 1 + nameLen);
+        if(suffix.empty())
+        {
+            recoverFile(entry.path().string());
+            uncompressed.push_back(fileSequence);
+        }
+        else if(suffix != ".gz")
+        {
+            continue;
+        }
+        sequences.push_back(fileSequence);
+    }
+    std::sort(sequences.begin(), sequences.end());
+    sequences.erase(std::unique(sequences.begin(), sequences.end()), sequences.end());
+
+    rotatedSequences.assign(sequences.begin(), sequences.end());
+    sequence = sequences.empty() ? 0 : sequences.back() + 1;
+    removeOldFiles();
+
+    if(config.compress)
+    {
+        for(uint32_t fileSequence : uncompressed)
+        {
+            if(std::find(rotatedSequences.begin(), rotatedSequences.end(), fileSequence) != rotatedSequences.end())
+                compressQueue.push_back(getPath(fileSequence));
+        }
+        compressThread = std::thread(compressThreadProcess, this);
+    }
+
+    openFile(0);
+}
+
+LogFile::~LogFile()
+{
+    {
+        std::lock_guard<std::mutex> lock(compressMutex);
+        inDestruction = true;
+    }
+    compressCondition.notify_one();
+
+    if(compressThread.joinable())
+    {
+        compressThread.join();
+    }
+
+    closeFile();
+}
+
+bool LogFile::needsRotation(size_t len) const
+{
+    return writePos + blockHeaderLen + len > mapLen ||
+           std::chrono::steady_clock::now() - openedTime >= config.rotationInterval;
+}
+
+void LogFile::rotate(size_t minLen)
+{
+    // An empty file is replaced instead of being kept, e.g. when the first block is larger than fileSize
+    bool empty = writePos == headerLen;
+    closeFile();
+    if(empty)
+    {
+        unlink(path.c_str());
+        openFile(minLen);
+        return;
+    }
+
+    rotatedSequences.push_back(sequence);
+    if(config.compress)
+    {
+        {
+            std::lock_guard<std::mutex> lock(compressMutex);
+            compressQueue.push_back(path);
+        }
+        compressCondition.notify_one();
+    }
+
+    sequence++;
+    removeOldFiles();
+    openFile(minLen);
+}
+
+void LogFile::append(const uint8_t *data, size_t len)
+{
+    if(len == 0)
+        return;
+
+    if(needsRotation(len))
+    {
+        rotate(len);
+    }
+
+    // The header is written last, a crash in between leaves zeroes or a block with a wrong CRC
+    uint32_t payloadLen = static_cast<uint32_t>(len);
+    uint32_t crc        = crc32_instance.calculate(data, payloadLen);
+    memcpy(map + writePos + blockHeaderLen, data, len);
+    memcpy(map + writePos + sizeof(payloadLen), &crc, sizeof(crc));
+    memcpy(map + writePos, &payloadLen, sizeof(payloadLen));
+    writePos += blockHeaderLen + len;
+}
+
+bool LogFile::isValidBlock(const uint8_t *payload, size_t len, uint32_t crc)
+{
+    return crc32_instance.calculate(payload, len) == crc;
+}
+
+void LogFile::openFile(size_t minBlockLen)
+{
+    path   = getPath(sequence);
+    mapLen = std::max(config.fileSize, headerLen + blockHeaderLen + minBlockLen);
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Unable to create log file " + path);
+    }
+
+    // A file that could not be set up is removed again, closeFile only handles completely opened files
+    auto discardFile = [this]() {
+        close(fd);
+        unlink(path.c_str());
+        fd = -1;
+    };
+
+    // Preallocated space reads as zeroes, which ends the blocks, and appends never have to extend the file
+    int ret = posix_fallocate(fd, 0, mapLen);
+    if(ret != 0)
+    {
+        discardFile();
+        throw std::runtime_error("posix_fallocate failed for " + path + " with error " + std::to_string(ret));
+    }
+
+    void *fileMap = mmap(nullptr, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(fileMap == MAP_FAILED)
+    {
+        discardFile();
+        throw std::runtime_error("mmap failed for " + path);
+    }
+    map = static_cast<uint8_t *>(fileMap);
+
+    uint32_t flags = config.binary ? uint32_t(Flags::Binary) : 0;
+    memcpy(map, &fileMagic, sizeof(fileMagic));
+    memcpy(map + flagsIndex, &flags, sizeof(flags));
+    writePos   = headerLen;
+    openedTime = std::chrono::steady_clock::now();
+}
+
+void LogFile::closeFile()
+{
+    if(fd < 0)
+        return;
+
+    uint32_t flags = 0;
+    memcpy(&flags, map + flagsIndex, sizeof(flags));
+    flags |= Flags::Closed;
+    memcpy(map + flagsIndex, &flags, sizeof(flags));
+
+    munmap(map, mapLen);
+    if(ftruncate(fd, writePos) != 0 || fdatasync(fd) != 0)
+    {
+        LOG_MESSAGE(LogLevel::Warning, "Unable to truncate and sync " + path);
+    }
+    close(fd);
+
+    fd     = -1;
+    map    = nullptr;
+    mapLen = 0;
+}
+
+void LogFile::recoverFile(const std::string &filePath)
+{
+    int recoverFd = open(filePath.c_str(), O_RDWR | O_CLOEXEC);
+    if(recoverFd < 0)
+        return;
+
+    struct stat status;
+    if(fstat(recoverFd, &status) != 0 || size_t(status.st_size) < headerLen)
+    {
+        close(recoverFd);
+        return;
+    }
+
+    size_t len     = status.st_size;
+    void * fileMap = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, recoverFd, 0);
+    if(fileMap == MAP_FAILED)
+    {
+        close(recoverFd);
+        return;
+    }
+
+    uint8_t *data  = static_cast<uint8_t *>(fileMap);
+    uint64_t magic = 0;
+    uint32_t flags = 0;
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&flags, data + flagsIndex, sizeof(flags));
+    if(magic == fileMagic && (flags & Flags::Closed) == 0)
+    {
+        // The process ended without closing the file, its preallocated space and a torn last block are dropped
+        bool   torn     = false;
+        size_t validLen = readBlocks(data, len, torn, [](const uint8_t *, size_t) {});
+        if(torn)
+        {
+            LOG_FORMAT(LogLevel::Warning, "Dropped torn block at offset {} of {}", validLen, filePath);
+        }
+
+        flags |= Flags::Closed;
+        memcpy(data + flagsIndex, &flags, sizeof(flags));
+        munmap(fileMap, len);
+        if(ftruncate(recoverFd, validLen) != 0)
+        {
+            LOG_MESSAGE(LogLevel::Warning, "Unable to truncate " + filePath);
+        }
+    }
+    else
+    {
+        munmap(fileMap, len);
+    }
+    close(recoverFd);
+}
+
+void LogFile::removeOldFiles()
+{
+    while(rotatedSequences.size() > config.maxFiles)
+    {
+        std::string oldPath = getPath(rotatedSequences.front());
+        unlink(oldPath.c_str());
+        unlink((oldPath + ".gz").c_str());
+        rotatedSequences.pop_front();
+    }
+}
+
+std::string LogFile::getPath(uint32_t fileSequence) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "-%08u.log", fileSequence);
+    return config.directory + "/" + config.name + name;
+}
+
+void LogFile::compressThreadProcess(LogFile *self)
+{
+    while(true)
+    {
+        std::string filePath;
+        {
+            std::unique_lock<std::mutex> lock(self->compressMutex);
+            self->compressCondition.wait(lock, [&] { return self->inDestruction || !self->compressQueue.empty(); });
+
+            // Files still queued are compressed by the next run
+            if(self->inDestruction)
+                return;
+
+            filePath = self->compressQueue.front();
+            self->compressQueue.pop_front();
+        }
+
+        if(!compressFile(filePath))
+        {
+            LOG_MESSAGE(LogLevel::Warning, "Unable to compress " + filePath);
+        }
+    }
+}
+
+bool LogFile::compressFile(const std::string &filePath)
+{
+    int inputFd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(inputFd < 0)
+        return false;
+
+    std::string tempPath = filePath + ".gz.tmp";
+    gzFile      output   = gzopen(tempPath.c_str(), "wb");
+    if(output == nullptr)
+    {
+        close(inputFd);
+        return false;
+    }
+
+    std::vector<uint8_t> buffer(compressReadLen);
+    bool                 success = true;
+    while(true)
+    {
+        ssize_t len = read(inputFd, buffer.data(), buffer.size());
+        if(len < 0)
+        {
+            success = false;
+            break;
+        }
+        if(len == 0)
+            break;
+        if(gzwrite(output, buffer.data(), static_cast<unsigned>(len)) != len)
+        {
+            success = false;
+            break;
+        }
+    }
+    close(inputFd);
+
+    // The original is only removed once the compressed file is complete
+    if(gzclose(output) != Z_OK || !success || rename(tempPath.c_str(), (filePath + ".gz").c_str()) != 0)
+    {
+        unlink(tempPath.c_str());
+        return false;
+    }
+    unlink(filePath.c_str());
+    return true;
+}
+} // namespace Utilities
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Utilities
+{
+/* Log sink that appends to a preallocated, memory mapped file and starts the next file when it is full or older than
+ * rotationInterval. Writes are a memcpy into the mapping, the kernel writes the pages back, so a crash of the process
+ * loses nothing that was appended.
+ *
+ * <name>-<sequence>.log: | Header (16 bytes) | Block | Block | ... | zeroes up to the preallocated size |
+ *
+ * Header: | Magic (8) | Flags (4) | Reserved (4) |
+ * Block:  | Payload len (4) | CRC32 of the payload (4) | Payload |
+ *
+ * Every append is one block of text lines or, with the Binary flag, of binary log records (see logFormat.hpp), every
+ * file holds a complete binary log. A zero length ends the blocks, a block with a wrong CRC is a torn write of a crash
+ * and ends them as well. Files of an earlier run are truncated to their valid blocks on startup. Rotated files are
+ * compressed to <name>-<sequence>.log.gz in the background if enabled, only the newest maxFiles are kept.
+ */
+class LogFile
+{
+public:
+    struct Config
+    {
+        std::string          directory        = "log";
+        std::string          name             = "iot-server";
+        size_t               fileSize         = 64 * 1024 * 1024; // Preallocated, larger blocks get a larger file
+        std::chrono::seconds rotationInterval = std::chrono::hours(24);
+        size_t               maxFiles         = 10; // Rotated files that are kept besides the current one
+        bool                 compress         = false;
+        bool                 binary           = false;
+    };
+
+    enum Flags : uint32_t
+    {
+        Binary = 1 << 0,
+        Closed = 1 << 1, // Truncated to its blocks by a clean close or by recovery
+    };
+
+    static constexpr uint64_t fileMagic      = 0x3146474F4C544F49; // "IOTLOGF1"
+    static constexpr size_t   headerLen      = 16;
+    static constexpr size_t   blockHeaderLen = 8;
+
+    LogFile() = delete;
+    LogFile(const Config &config);
+    ~LogFile();
+
+    const Config &getConfig() const { return config; }
+
+    // True if a block of len bytes does not fit into the current file or the file is due for rotation
+    bool needsRotation(size_t len) const;
+
+    // Closes the current file and starts the next one with space for a block of at least minLen bytes
+    void rotate(size_t minLen = 0);
+
+    // Appends data as one block, rotates first if needed
+    void append(const uint8_t *data, size_t len);
+
+    // Calls callback(payload, len) for every valid block of a file's content and returns the length of the valid part.
+    // torn is set if the blocks end with an invalid block instead of zeroes or the end of data.
+    template <typename Callback>
+    static size_t readBlocks(const uint8_t *data, size_t len, bool &torn, Callback callback);
+
+private:
+    Config config;
+
+    // Current file, only used by the appending thread
+    uint32_t                              sequence = 0;
+    std::string                           path;
+    int                                   fd       = -1;
+    uint8_t *                             map      = nullptr;
+    size_t                                mapLen   = 0;
+    size_t                                writePos = 0;
+    std::chrono::steady_clock::time_point openedTime;
+    std::deque<uint32_t>                  rotatedSequences; // Oldest first
+
+    std::mutex              compressMutex; // Guards the members below
+    std::condition_variable compressCondition;
+    std::deque<std::string> compressQueue;
+    bool                    inDestruction = false;
+    std::thread             compressThread;
+
+    static void compressThreadProcess(LogFile *self);
+    static bool compressFile(const std::string &filePath);
+    static bool isValidBlock(const uint8_t *payload, size_t len, uint32_t crc);
+
+    void        openFile(size_t minBlockLen);
+    void        closeFile();
+    void        recoverFile(const std::string &filePath);
+    void        removeOldFiles();
+    std::string getPath(uint32_t fileSequence) const;
+};
+
+template <typename Callback>
+size_t LogFile::readBlocks(const uint8_t *data, size_t len, bool &torn, Callback callback)
+{
+    torn          = false;
+    size_t offset = headerLen;
+    while(offset + blockHeaderLen <= len)
+    {
+        uint32_t payloadLen = 0;
+        uint32_t crc        = 0;
+        memcpy(&payloadLen, data + offset, sizeof(payloadLen));
+        memcpy(&crc, data + offset + sizeof(payloadLen), sizeof(crc));
+        if(payloadLen == 0)
+            return offset;
+
+        if(payloadLen > len - offset - blockHeaderLen || !isValidBlock(data + offset + blockHeaderLen, payloadLen, crc))
+        {
+            torn = true;
+            return offset;
+        }
+
+        callback(data + offset + blockHeaderLen, size_t(payloadLen));
+        offset += blockHeaderLen + payloadLen;
+    }
+
+    // A block header cut off by the end of data is torn, zeroes of the preallocated space are not
+    for(size_t i = offset; i < len && !torn; i++)
+        torn = data[i] != 0;
+    return offset;
+}
+} // namespace Utilities
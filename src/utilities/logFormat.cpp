@@ -0,0 +1,103 @@
+#include <cstdio>
+#include <stdexcept>
+
+#include "logFormat.hpp"
+
+namespace Utilities::LogFormat
+{
+uint64_t readVarint(const uint8_t *&in, const uint8_t *end)
+{
+    uint64_t value = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if(in >= end)
+        {
+            throw std::runtime_error("Truncated varint in LogFormat::readVarint");
+        }
+
+        uint8_t byte = *in++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+            return value;
+    }
+    throw std::runtime_error("Invalid varint in LogFormat::readVarint");
+}
+
+// Appends the text of the next argument
+static void appendArg(std::string &output, const uint8_t *&in, const uint8_t *end)
+{
+    ArgType type = static_cast<ArgType>(*in++);
+    switch(type)
+    {
+    case ArgType::False:
+        output += "false";
+        break;
+
+    case ArgType::True:
+        output += "true";
+        break;
+
+    case ArgType::UInt:
+        output += std::to_string(readVarint(in, end));
+        break;
+
+    case ArgType::Int:
+        output += std::to_string(fromZigzag(readVarint(in, end)));
+        break;
+
+    case ArgType::Double:
+    {
+        double value = 0;
+        if(end - in < static_cast<ptrdiff_t>(sizeof(value)))
+        {
+            throw std::runtime_error("Truncated double in LogFormat::format");
+        }
+        memcpy(&value, in, sizeof(value));
+        in += sizeof(value);
+
+        char text[32];
+        int  len = snprintf(text, sizeof(text), "%g", value);
+        output.append(text, len);
+        break;
+    }
+
+    case ArgType::String:
+    {
+        uint64_t len = readVarint(in, end);
+        if(len > static_cast<uint64_t>(end - in))
+        {
+            throw std::runtime_error("Truncated string in LogFormat::format");
+        }
+        output.append(reinterpret_cast<const char *>(in), len);
+        in += len;
+        break;
+    }
+
+    default:
+        throw std::runtime_error("Invalid argument type " + std::to_string(static_cast<int>(type)) +
+                                 " in LogFormat::format");
+    }
+}
+
+void format(std::string &output, std::string_view format, const uint8_t *args, size_t argsLen)
+{
+    const uint8_t *in  = args;
+    const uint8_t *end = args + argsLen;
+
+    size_t start = 0;
+    while(start < format.size())
+    {
+        size_t placeholder = format.find("{}", start);
+        if(placeholder == std::string_view::npos || in >= end)
+        {
+            // Placeholders without argument are kept as they are
+            output.append(format.substr(start));
+            break;
+        }
+
+        output.append(format.substr(start, placeholder - start));
+        appendArg(output, in, end);
+        start = placeholder + 2;
+    }
+}
+} // namespace Utilities::LogFormat
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/* Deferred formatting of log messages: call sites record a format string id and their raw arguments, the text is
+ * only produced by the log writer or, with binary log output, offline by iot-log-decoder.
+ *
+ * Format strings use {} as placeholder for the next argument. Every argument is stored as a type byte followed by
+ * its value, integers as (zigzag) varints, doubles as 8 bytes, strings as a varint length followed by the bytes.
+ *
+ * Binary log file (host byte order), timestamps are nanoseconds since epoch stored as zigzag varint difference to
+ * the previous timestamp in the file:
+ *
+ * | Magic (8) | Record | Record | ... |
+ *
+ * Format: | 0 (1) | Format ID (varint) | Log level (1) | Line (varint) | File len (varint) | File |
+ *         | Format len (varint) | Format |
+ * Text:   | 1 (1) | Log level (1) | Timestamp diff (varint) | Message len (varint) | Message |
+ * Entry:  | 2 (1) | Format ID (varint) | Timestamp diff (varint) | Arguments len (varint) | Arguments |
+ *
+ * A format record precedes the first entry that uses it.
+ */
+namespace Utilities::LogFormat
+{
+static constexpr uint64_t fileMagic    = 0x31474F4C42544F49; // "IOTBLOG1"
+static constexpr size_t   maxVarintLen = 10;
+
+enum class FileRecord : uint8_t
+{
+    Format = 0,
+    Text,
+    Entry,
+};
+
+enum class ArgType : uint8_t
+{
+    False = 0,
+    True,
+    UInt,
+    Int,
+    Double,
+    String,
+};
+
+inline void writeVarint(uint8_t *&out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        *out++ = uint8_t(value) | 0x80;
+        value >>= 7;
+    }
+    *out++ = uint8_t(value);
+}
+
+inline uint64_t toZigzag(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t fromZigzag(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// Reads a varint, throws if it does not end before end
+uint64_t readVarint(const uint8_t *&in, const uint8_t *end);
+
+template <typename T>
+constexpr size_t getMaxArgLen(const T &)
+{
+    static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "Unsupported LOG_FORMAT argument type");
+    return 1 + maxVarintLen;
+}
+
+inline size_t getMaxArgLen(const std::string &value)
+{
+    return 1 + maxVarintLen + value.size();
+}
+
+inline size_t getMaxArgLen(std::string_view value)
+{
+    return 1 + maxVarintLen + value.size();
+}
+
+inline size_t getMaxArgLen(const char *value)
+{
+    return 1 + maxVarintLen + (value != nullptr ? strlen(value) : 0);
+}
+
+inline void encodeString(uint8_t *&out, const char *data, size_t len)
+{
+    *out++ = uint8_t(ArgType::String);
+    writeVarint(out, len);
+    memcpy(out, data, len);
+    out += len;
+}
+
+template <typename T>
+void encodeArg(uint8_t *&out, const T &value)
+{
+    if constexpr(std::is_same_v<T, bool>)
+    {
+        *out++ = uint8_t(value ? ArgType::True : ArgType::False);
+    }
+    else if constexpr(std::is_same_v<T, char>)
+    {
+        encodeString(out, &value, 1);
+    }
+    else if constexpr(std::is_enum_v<T>)
+    {
+        encodeArg(out, static_cast<std::underlying_type_t<T>>(value));
+    }
+    else if constexpr(std::is_floating_point_v<T>)
+    {
+        double converted = value;
+        *out++           = uint8_t(ArgType::Double);
+        memcpy(out, &converted, sizeof(converted));
+        out += sizeof(converted);
+    }
+    else if constexpr(std::is_signed_v<T>)
+    {
+        *out++ = uint8_t(ArgType::Int);
+        writeVarint(out, toZigzag(value));
+    }
+    else
+    {
+        *out++ = uint8_t(ArgType::UInt);
+        writeVarint(out, value);
+    }
+}
+
+inline void encodeArg(uint8_t *&out, const std::string &value)
+{
+    encodeString(out, value.data(), value.size());
+}
+
+inline void encodeArg(uint8_t *&out, std::string_view value)
+{
+    encodeString(out, value.data(), value.size());
+}
+
+inline void encodeArg(uint8_t *&out, const char *value)
+{
+    encodeString(out, value != nullptr ? value : "", value != nullptr ? strlen(value) : 0);
+}
+
+// Appends format with its placeholders replaced by the encoded arguments, throws if the arguments are malformed
+void format(std::string &output, std::string_view format, const uint8_t *args, size_t argsLen);
+} // namespace Utilities::LogFormat
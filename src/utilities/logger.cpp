@@ -1,19 +1,736 @@
-#include <iostream>
-#include <string>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <iomanip>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "logger.hpp"
+#include "spscRing.hpp"
 
 namespace Utilities
 {
-bool Logger::logOutputAllowed(Logger::LogLevel requestedLogLevel)
+namespace
 {
-    if(requestedLogLevel > globalLogLevel || globalLogLevel == LogLevel::None)
-        return false;
-    else
-        return true;
+void writeAll(int fd, const uint8_t *data, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t ret = write(fd, data, len);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return;
+        data += ret;
+        len -= ret;
+    }
+}
+
+void writeAll(int fd, const std::string &data)
+{
+    writeAll(fd, reinterpret_cast<const uint8_t *>(data.data()), data.size());
+}
+
+uint64_t getTimestamp()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+std::terminate_handler previousTerminateHandler = nullptr;
+
+using Module = Logger::Module;
+
+constexpr std::array<const char *, size_t(Module::Count)> moduleNames = {
+    "General",
+    "Server",
+    "ServerNode",
+    "Node",
+    "NodeList",
+    "AppNode",
+    "DnsUpdater",
+    "HistoryStore",
+    "RegistryStore",
+    "SqliteWriter",
+    "BlobStore",
+    "RollupStore",
+    "LogFile",
+    "Metrics",
+};
+
+std::mutex                              levelsMutex; // Serializes changes of the global and module levels
+std::array<bool, size_t(Module::Count)> moduleOverridden = {};
+} // namespace
+
+struct Logger::Ring
+{
+    SpscRing          records{ringSize};
+    std::atomic<bool> inUse{false}; // Owned by a thread, only that thread pushes
+};
+
+struct Logger::ThreadState
+{
+    Ring *               ring     = nullptr;
+    bool                 acquired = false;
+    bool                 inRing   = false; // The record of beginRecord is in the ring, not in scratch
+    LogLevel             logLevel = LogLevel::None;
+    std::vector<uint8_t> scratch; // Records written synchronously
+
+    ~ThreadState()
+    {
+        if(ring != nullptr)
+            ring->inUse.store(false, std::memory_order_release);
+    }
+};
+
+// Owner of the rings, the format strings and the background writer, lives until the process exits
+class Logger::Backend
+{
+public:
+    struct Entry
+    {
+        RecordHeader   header;
+        const uint8_t *data; // Message or arguments, points into a ring until it is released
+        size_t         len;
+    };
+
+    Backend() : writerThread(Backend::writerThreadProcess, this) {}
+
+    Ring *acquireRing()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto &ring : rings)
+        {
+            // A ring of an exited thread is reused once everything it queued is written
+            if(!ring->inUse.load(std::memory_order_acquire) && ring->records.isEmpty())
+            {
+                ring->inUse.store(true, std::memory_order_relaxed);
+                return ring.get();
+            }
+        }
+
+        if(rings.size() >= maxRingsNum)
+            return nullptr;
+
+        rings.push_back(std::make_unique<Ring>());
+        rings.back()->inUse.store(true, std::memory_order_relaxed);
+        return rings.back().get();
+    }
+
+    uint32_t registerFormat(FormatInfo format, std::string formatString)
+    {
+        std::lock_guard<std::mutex> lock(formatsMutex);
+        formatStrings.push_back(std::move(formatString));
+        format.format = formatStrings.back().c_str();
+        formats.push_back(format);
+        return uint32_t(formats.size() - 1);
+    }
+
+    // Replaces the output, an empty path and no file restore the console output
+    void setOutput(const std::string &binaryPath, std::unique_ptr<LogFile> file)
+    {
+        int binaryOutputFd = -1;
+        if(!binaryPath.empty())
+        {
+            binaryOutputFd = open(binaryPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if(binaryOutputFd < 0)
+            {
+                throw std::runtime_error("Unable to open binary log output " + binaryPath);
+            }
+
+            // Every process appending to the file starts with the magic, format ids and timestamps restart there
+            writeAll(binaryOutputFd,
+                     reinterpret_cast<const uint8_t *>(&LogFormat::fileMagic),
+                     sizeof(LogFormat::fileMagic));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            if(binaryFd >= 0)
+                close(binaryFd);
+            binaryFd = binaryOutputFd;
+            std::swap(logFile, file);
+            startBinaryLog();
+        }
+
+        // The previous file is closed without the lock, it may log while it closes
+        file.reset();
+    }
+
+    // Writes entries in their order to the console, the binary output or the log file
+    void writeEntries(const std::vector<Entry> &entries)
+    {
+        if(entries.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if(logFile != nullptr)
+        {
+            writeFile(entries);
+            return;
+        }
+
+        if(binaryFd >= 0)
+        {
+            for(const Entry &entry : entries)
+                appendBinary(entry);
+            writeAll(binaryFd, binaryOutput.data(), binaryOutput.size());
+            binaryOutput.clear();
+            return;
+        }
+
+        for(const Entry &entry : entries)
+        {
+            std::string &target = entry.header.logLevel == uint8_t(LogLevel::Error) ? errorOutput : output;
+            appendText(target, entry, true);
+        }
+        writeAll(STDOUT_FILENO, output);
+        writeAll(STDERR_FILENO, errorOutput);
+        output.clear();
+        errorOutput.clear();
+    }
+
+    void wake()
+    {
+        // Checked without the lock, a missed wake up only delays the batch until writeInterval
+        if(!wakeRequested.exchange(true, std::memory_order_relaxed))
+            condition.notify_one();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(stopped || std::this_thread::get_id() == writerThread.get_id())
+            return;
+
+        uint64_t ticket = ++requestedFlush;
+        condition.notify_one();
+        flushCondition.wait(lock, [&] { return completedFlush >= ticket || stopped; });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(stopped || stopping)
+                return;
+            stopping = true;
+        }
+        condition.notify_one();
+        writerThread.join();
+
+        // Closing truncates the log file to its content, later messages go to the console
+        setOutput("", nullptr);
+    }
+
+    bool isStopped() const { return stopped.load(std::memory_order_acquire); }
+
+    // Log calls of the writer itself, e.g. of the log file, must neither block nor write synchronously
+    bool isWriterThread() const { return std::this_thread::get_id() == writerThread.get_id(); }
+
+private:
+    static constexpr std::chrono::milliseconds writeInterval = std::chrono::milliseconds(10);
+
+    std::mutex                         mutex; // Guards rings and the flush state
+    std::condition_variable            condition;
+    std::condition_variable            flushCondition;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::atomic<bool>                  wakeRequested  = false;
+    uint64_t                           requestedFlush = 0;
+    uint64_t                           completedFlush = 0;
+    bool                               stopping       = false;
+    std::atomic<bool>                  stopped        = false;
+
+    std::mutex              formatsMutex;
+    std::deque<FormatInfo>  formats;
+    std::deque<std::string> formatStrings; // Never moved, formats point to them
+
+    std::mutex               outputMutex; // Guards the output state below
+    std::vector<FormatInfo>  knownFormats; // Copy of formats for the writer
+    std::unique_ptr<LogFile> logFile;
+    int                      binaryFd          = -1;
+    uint32_t                 writtenFormatsNum = 0;
+    uint64_t                 lastTimestamp     = 0;
+    bool                     binaryLogStarted  = false; // The magic of the log file's binary log is written
+    std::vector<uint8_t>     binaryOutput;
+    std::string              output;
+    std::string              errorOutput;
+    std::string              message;
+
+    std::thread writerThread;
+
+    const FormatInfo &getFormat(uint32_t formatId)
+    {
+        if(formatId >= knownFormats.size())
+        {
+            std::lock_guard<std::mutex> lock(formatsMutex);
+            knownFormats.assign(formats.begin(), formats.end());
+        }
+        if(formatId >= knownFormats.size())
+        {
+            throw std::runtime_error("Unknown format id " + std::to_string(formatId));
+        }
+        return knownFormats[formatId];
+    }
+
+    void appendText(std::string &target, const Entry &entry, bool color)
+    {
+        LogLevel logLevel = LogLevel(entry.header.logLevel);
+        if(entry.header.kind == RecordKind::Text)
+        {
+            std::string_view text(reinterpret_cast<const char *>(entry.data), entry.len);
+            appendLines(target, text, logLevel, entry.header.timestamp, color);
+            return;
+        }
+
+        message.clear();
+        try
+        {
+            LogFormat::format(message, getFormat(entry.header.formatId).format, entry.data, entry.len);
+        }
+        catch(const std::exception &e)
+        {
+            message += std::string(" <") + e.what() + ">";
+        }
+        appendLines(target, message, logLevel, entry.header.timestamp, color);
+    }
+
+    // Every log file holds a complete binary log, a batch that starts a new file is encoded again for it
+    void writeFile(const std::vector<Entry> &entries)
+    {
+        encodeFileBatch(entries);
+        size_t len = logFile->getConfig().binary ? binaryOutput.size() : output.size();
+        if(logFile->needsRotation(len))
+        {
+            logFile->rotate(len);
+            startBinaryLog();
+            encodeFileBatch(entries);
+        }
+
+        if(logFile->getConfig().binary)
+            logFile->append(binaryOutput.data(), binaryOutput.size());
+        else
+            logFile->append(reinterpret_cast<const uint8_t *>(output.data()), output.size());
+        binaryOutput.clear();
+        output.clear();
+    }
+
+    void encodeFileBatch(const std::vector<Entry> &entries)
+    {
+        binaryOutput.clear();
+        output.clear();
+        if(!logFile->getConfig().binary)
+        {
+            for(const Entry &entry : entries)
+                appendText(output, entry, false);
+            return;
+        }
+
+        if(!binaryLogStarted)
+        {
+            uint8_t *out = reserveBinary(sizeof(LogFormat::fileMagic));
+            memcpy(out, &LogFormat::fileMagic, sizeof(LogFormat::fileMagic));
+            binaryLogStarted = true;
+        }
+        for(const Entry &entry : entries)
+            appendBinary(entry);
+    }
+
+    // Format ids and timestamps restart with every binary log
+    void startBinaryLog()
+    {
+        writtenFormatsNum = 0;
+        lastTimestamp     = 0;
+        binaryLogStarted  = false;
+    }
+
+    uint8_t *reserveBinary(size_t maxLen)
+    {
+        size_t len = binaryOutput.size();
+        binaryOutput.resize(len + maxLen);
+        return binaryOutput.data() + len;
+    }
+
+    void appendTimestamp(uint8_t *&out, uint64_t timestamp)
+    {
+        LogFormat::writeVarint(out, LogFormat::toZigzag(int64_t(timestamp - lastTimestamp)));
+        lastTimestamp = timestamp;
+    }
+
+    void appendBinary(const Entry &entry)
+    {
+        using namespace LogFormat;
+
+        uint8_t *out = nullptr;
+        if(entry.header.kind == RecordKind::Text)
+        {
+            out    = reserveBinary(2 + 3 * maxVarintLen + entry.len);
+            *out++ = uint8_t(FileRecord::Text);
+            *out++ = entry.header.logLevel;
+        }
+        else
+        {
+            // Format records of the ids registered since the last entry come first
+            getFormat(entry.header.formatId);
+            for(; writtenFormatsNum <= entry.header.formatId; writtenFormatsNum++)
+                appendFormat(writtenFormatsNum, knownFormats[writtenFormatsNum]);
+
+            out    = reserveBinary(1 + 3 * maxVarintLen + entry.len);
+            *out++ = uint8_t(FileRecord::Entry);
+            writeVarint(out, entry.header.formatId);
+        }
+
+        appendTimestamp(out, entry.header.timestamp);
+        writeVarint(out, entry.len);
+        memcpy(out, entry.data, entry.len);
+        out += entry.len;
+        binaryOutput.resize(out - binaryOutput.data());
+    }
+
+    void appendFormat(uint32_t formatId, const FormatInfo &format)
+    {
+        using namespace LogFormat;
+
+        size_t   fileLen   = strlen(format.file);
+        size_t   formatLen = strlen(format.format);
+        uint8_t *out       = reserveBinary(2 + 5 * maxVarintLen + fileLen + formatLen);
+        *out++             = uint8_t(FileRecord::Format);
+        writeVarint(out, formatId);
+        *out++ = uint8_t(format.logLevel);
+        writeVarint(out, format.line);
+        writeVarint(out, fileLen);
+        memcpy(out, format.file, fileLen);
+        out += fileLen;
+        writeVarint(out, formatLen);
+        memcpy(out, format.format, formatLen);
+        out += formatLen;
+        binaryOutput.resize(out - binaryOutput.data());
+    }
+
+    static void writerThreadProcess(Backend *self)
+    {
+        std::vector<Ring *>                    batchRings;
+        std::vector<Entry>                     entries;
+        std::vector<std::pair<Ring *, size_t>> releases;
+        uint64_t                               reportedDrops = 0;
+        std::string                            dropMessage;
+
+        while(true)
+        {
+            std::unique_lock<std::mutex> lock(self->mutex);
+            self->condition.wait_for(lock, writeInterval, [&] {
+                return self->stopping || self->requestedFlush > self->completedFlush ||
+                       self->wakeRequested.load(std::memory_order_relaxed);
+            });
+            self->wakeRequested.store(false, std::memory_order_relaxed);
+
+            uint64_t flushTicket = self->requestedFlush;
+            bool     stopping    = self->stopping;
+            batchRings.clear();
+            for(auto &ring : self->rings)
+                batchRings.push_back(ring.get());
+            lock.unlock();
+
+            for(Ring *ring : batchRings)
+            {
+                size_t tailPos = ring->records.read([&](const uint8_t *data, size_t len) {
+                    Entry entry;
+                    memcpy(&entry.header, data, sizeof(entry.header));
+                    entry.data = data + sizeof(entry.header);
+                    entry.len  = len - sizeof(entry.header);
+                    entries.push_back(entry);
+                });
+                releases.emplace_back(ring, tailPos);
+            }
+
+            // Entries of all threads are written in timestamp order, like a single log would have them
+            std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+                return a.header.timestamp < b.header.timestamp;
+            });
+
+            uint64_t drops = droppedMessages.load(std::memory_order_relaxed);
+            if(drops != reportedDrops)
+            {
+                dropMessage = "Logger:: " + std::to_string(drops - reportedDrops) +
+                              " messages dropped, rings were full";
+
+                Entry entry;
+                entry.header = {RecordKind::Text, uint8_t(LogLevel::Warning), 0, 0, getTimestamp()};
+                entry.data   = reinterpret_cast<const uint8_t *>(dropMessage.data());
+                entry.len    = dropMessage.size();
+                entries.push_back(entry);
+                reportedDrops = drops;
+            }
+
+            try
+            {
+                self->writeEntries(entries);
+            }
+            catch(const std::exception &e)
+            {
+                std::string error = "Logger:: Writing log entries failed: " + std::string(e.what()) + "\n";
+                writeAll(STDERR_FILENO, error);
+            }
+
+            for(const auto &[ring, tailPos] : releases)
+                ring->records.release(tailPos);
+            entries.clear();
+            releases.clear();
+
+            lock.lock();
+            self->completedFlush = flushTicket;
+            if(stopping)
+                self->stopped.store(true, std::memory_order_release);
+            lock.unlock();
+            self->flushCondition.notify_all();
+
+            if(stopping)
+                return;
+        }
+    }
+};
+
+Logger::Backend *Logger::getBackend()
+{
+    // Never destroyed, threads exiting after the exit handlers still release their rings to it
+    static Backend *backend = [] {
+        Backend *instance = new Backend();
+        std::atexit([] { getBackend()->stop(); });
+        previousTerminateHandler = std::set_terminate([] {
+            flush();
+            if(previousTerminateHandler != nullptr)
+                previousTerminateHandler();
+            std::abort();
+        });
+        return instance;
+    }();
+    return backend;
+}
+
+Logger::ThreadState &Logger::getThreadState()
+{
+    static thread_local ThreadState threadState;
+    return threadState;
+}
+
+void Logger::setSynchronous(bool newSynchronous)
+{
+    synchronous = newSynchronous;
+    if(newSynchronous)
+        flush();
+}
+
+void Logger::setBinaryOutput(const std::string &path)
+{
+    // Messages logged before go to the previous output
+    flush();
+    getBackend()->setOutput(path, nullptr);
+}
+
+void Logger::setFileOutput(const LogFile::Config &config)
+{
+    // The file is created first, messages about recovered files of an earlier run go to the previous output
+    auto file = std::make_unique<LogFile>(config);
+    flush();
+    getBackend()->setOutput("", std::move(file));
+}
+
+void Logger::setConsoleOutput()
+{
+    flush();
+    getBackend()->setOutput("", nullptr);
+}
+
+void Logger::flush()
+{
+    getBackend()->flush();
+}
+
+void Logger::setGlobalLogLevel(LogLevel newGlobalLogLevel)
+{
+    std::lock_guard<std::mutex> lock(levelsMutex);
+    globalLogLevel = newGlobalLogLevel;
+    for(size_t module = 0; module < moduleOverridden.size(); module++)
+    {
+        if(!moduleOverridden[module])
+            moduleLogLevels[module] = newGlobalLogLevel;
+    }
+}
+
+void Logger::setModuleLogLevel(Module module, LogLevel logLevel)
+{
+    std::lock_guard<std::mutex> lock(levelsMutex);
+    moduleOverridden[size_t(module)] = true;
+    moduleLogLevels[size_t(module)]  = logLevel;
+}
+
+void Logger::resetModuleLogLevel(Module module)
+{
+    std::lock_guard<std::mutex> lock(levelsMutex);
+    moduleOverridden[size_t(module)] = false;
+    moduleLogLevels[size_t(module)]  = globalLogLevel.load();
+}
+
+void Logger::setModuleLogLevels(const std::string &overrides)
+{
+    size_t start = 0;
+    while(start < overrides.size())
+    {
+        size_t      end       = std::min(overrides.find(',', start), overrides.size());
+        std::string entry     = overrides.substr(start, end - start);
+        size_t      separator = entry.find('=');
+        start                 = end + 1;
+        if(entry.empty())
+            continue;
+        if(separator == std::string::npos)
+        {
+            throw std::runtime_error("Invalid log level override " + entry + ", expected <module>=<level>");
+        }
+
+        std::string moduleName = entry.substr(0, separator);
+        std::string levelName  = entry.substr(separator + 1);
+        size_t      module     = 0;
+        while(module < size_t(Module::Count) && moduleName != moduleNames[module])
+            module++;
+        if(module == size_t(Module::Count))
+        {
+            throw std::runtime_error("Unknown log module " + moduleName);
+        }
+
+        LogLevel logLevel = LogLevel::None;
+        if(levelName != "None")
+        {
+            logLevel = LogLevel::Error;
+            while(logLevel <= LogLevel::Debug && levelName != getLogLevelString(logLevel))
+                logLevel = LogLevel(int(logLevel) + 1);
+            if(logLevel > LogLevel::Debug)
+            {
+                throw std::runtime_error("Unknown log level " + levelName);
+            }
+        }
+        setModuleLogLevel(Module(module), logLevel);
+    }
+}
+
+const char *Logger::getModuleName(Module module)
+{
+    return size_t(module) < moduleNames.size() ? moduleNames[size_t(module)] : "";
+}
+
+uint32_t Logger::registerFormat(Module module, LogLevel logLevel, const char *file, uint32_t line, const char *format)
+{
+    std::string prefixed = module == Module::General ? format : getModuleName(module) + std::string(":: ") + format;
+    return getBackend()->registerFormat(FormatInfo{logLevel, file, line, nullptr}, std::move(prefixed));
+}
+
+void Logger::logMessage(::std::string message, Logger::LogLevel logLevel)
+{
+    if(!isEnabled(logLevel))
+        return;
+
+    logMessage(Module::General, message, logLevel);
+}
+
+void Logger::logMessage(Module module, std::string_view message, LogLevel logLevel)
+{
+    // The prefix is copied straight into the record, so a logged message costs no allocation
+    std::string_view prefix    = module == Module::General ? "" : getModuleName(module);
+    std::string_view separator = prefix.empty() ? "" : ":: ";
+    size_t           len       = prefix.size() + separator.size() + message.size();
+
+    uint8_t *data = beginRecord(RecordKind::Text, logLevel, 0, len);
+    if(data == nullptr)
+        return;
+
+    memcpy(data, prefix.data(), prefix.size());
+    memcpy(data + prefix.size(), separator.data(), separator.size());
+    memcpy(data + prefix.size() + separator.size(), message.data(), message.size());
+    commitRecord(len);
+}
+
+uint8_t *Logger::beginRecord(RecordKind kind, LogLevel logLevel, uint32_t formatId, size_t maxLen)
+{
+    ThreadState &state   = getThreadState();
+    Backend *    backend = getBackend();
+    RecordHeader header  = {kind, uint8_t(logLevel), 0, formatId, getTimestamp()};
+    size_t       len     = sizeof(header) + maxLen;
+    bool         writer  = backend->isWriterThread(); // Holds the output, it can only queue
+
+    state.inRing   = false;
+    state.logLevel = logLevel;
+    if((!synchronous || writer) && !backend->isStopped())
+    {
+        if(!state.acquired)
+        {
+            state.ring     = backend->acquireRing();
+            state.acquired = true;
+        }
+
+        // Records larger than a ring takes are written synchronously
+        if(state.ring != nullptr && len <= state.ring->records.getMaxRecordLen())
+        {
+            uint8_t *data = nullptr;
+            while((data = state.ring->records.reserve(len)) == nullptr)
+            {
+                backend->wake();
+                if(overflowPolicy == OverflowPolicy::Drop || writer)
+                {
+                    droppedMessages.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                if(backend->isStopped())
+                    break;
+                std::this_thread::yield();
+            }
+
+            if(data != nullptr)
+            {
+                memcpy(data, &header, sizeof(header));
+                state.inRing = true;
+                return data + sizeof(header);
+            }
+        }
+    }
+
+    if(writer)
+    {
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    state.scratch.resize(len);
+    memcpy(state.scratch.data(), &header, sizeof(header));
+    return state.scratch.data() + sizeof(header);
+}
+
+void Logger::commitRecord(size_t len)
+{
+    ThreadState &state = getThreadState();
+    if(!state.inRing)
+    {
+        Backend::Entry entry;
+        memcpy(&entry.header, state.scratch.data(), sizeof(entry.header));
+        entry.data = state.scratch.data() + sizeof(entry.header);
+        entry.len  = len;
+        getBackend()->writeEntries({entry});
+        return;
+    }
+
+    state.ring->records.commit(sizeof(RecordHeader) + len);
+
+    // The writer runs every writeInterval anyway, it is woken up early before the ring fills up or for errors
+    if(state.ring->records.getUsed() >= ringSize / 2 || state.logLevel == LogLevel::Error)
+        getBackend()->wake();
 }
 
 std::string Logger::getLogLevelString(Logger::LogLevel logLevel)
@@ -34,31 +751,30 @@ std::string Logger::getLogLevelString(Logger::LogLevel logLevel)
     return "";
 }
 
-std::string Logger::getLogprefix(Logger::LogLevel logLevel)
+void Logger::appendPrefix(std::string &output, Logger::LogLevel logLevel, uint64_t timestamp)
 {
-    using namespace std::chrono;
+    const time_t seconds = timestamp / 1000000000;
+    struct tm    now;
+    localtime_r(&seconds, &now);
 
-    auto         currentTime = system_clock::now();
-    const time_t t           = system_clock::to_time_t(currentTime);
-    struct tm *  now         = localtime(&t);
-    auto         millis      = duration_cast<milliseconds>(currentTime.time_since_epoch()).count() % 1000;
-
-    std::stringstream ss;
-    ss << std::setfill('0') << std::setw(4) << now->tm_year + 1900 << "-" << std::setw(2) << now->tm_mon + 1 << "-"
-       << std::setw(2) << now->tm_mday << " " << std::setw(2) << now->tm_hour << ":" << std::setw(2) << now->tm_min
-       << ":" << std::setw(2) << now->tm_sec << "." << std::setw(3) << millis;
-
-    ss << " [" << getLogLevelString(logLevel) << "]: ";
-
-    auto ret_string = ss.str();
+    char prefix[64];
+    int  len = snprintf(prefix,
+                       sizeof(prefix),
+                       "%04d-%02d-%02d %02d:%02d:%02d.%03d [%s]:",
+                       now.tm_year + 1900,
+                       now.tm_mon + 1,
+                       now.tm_mday,
+                       now.tm_hour,
+                       now.tm_min,
+                       now.tm_sec,
+                       int(timestamp / 1000000 % 1000),
+                       getLogLevelString(logLevel).c_str());
+    output.append(prefix, len);
 
     // pad prefix to make the actual test consistent in different log levels
-    int padding_spaces = 35 - ret_string.length();
-    if(padding_spaces > 0)
-    {
-        ret_string = ret_string.insert(ret_string.size() - 1, padding_spaces, ' ');
-    }
-    return ret_string;
+    if(size_t(len) + 1 < maxPrefixLen)
+        output.append(maxPrefixLen - 1 - len, ' ');
+    output.push_back(' ');
 }
 
 std::string Logger::getColorPrefix(Logger::LogLevel logLevel)
@@ -128,28 +844,26 @@ std::string Logger::getColorSuffix(Logger::LogLevel logLevel)
     return "\033[0m";
 }
 
-void Logger::logMessage(::std::string message, Logger::LogLevel logLevel)
-{
-    if(!logOutputAllowed(logLevel))
-        return;
 
-    std::stringstream message_ss(message);
-    std::string       line;
-    std::string       prefix       = getLogprefix(logLevel);
-    std::string       color_prefix = getColorPrefix(logLevel);
-    std::string       color_suffix = getColorSuffix(logLevel);
+void Logger::appendLines(std::string     &output,
+                         std::string_view message,
+                         LogLevel         logLevel,
+                         uint64_t         timestamp,
+                         bool             color)
+{
+    std::string colorPrefix = color ? getColorPrefix(logLevel) : "";
+    std::string colorSuffix = color ? getColorSuffix(logLevel) : "";
 
-    loggerMutex.lock();
-    while(std::getline(message_ss, line))
+    size_t start = 0;
+    while(start < message.size())
     {
-        line = color_prefix + prefix + line + color_suffix;
-
-        if(logLevel == LogLevel::Error)
-            ::std::cerr << line << ::std::endl;
-        else
-            ::std::cout << line << ::std::endl;
+        size_t end = std::min(message.find('\n', start), message.size());
+        output += colorPrefix;
+        appendPrefix(output, logLevel, timestamp);
+        output.append(message.substr(start, end - start));
+        output += colorSuffix;
+        output.push_back('\n');
+        start = end + 1;
     }
-    loggerMutex.unlock();
 }
-
 } // namespace Utilities
@@ -1,13 +1,59 @@
 #pragma once
 
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
+
+#include "logFile.hpp"
+#include "logFormat.hpp"
+
+// Highest log level compiled in, 0 (None) to 4 (Debug), set with the IOT_LOG_LEVEL CMake option. Calls above it are
+// removed at compile time, their arguments are never evaluated.
+#ifndef IOT_LOG_MAX_LEVEL
+#define IOT_LOG_MAX_LEVEL 4
+#endif
+
+// Logs message, prefixed with the name of the module, if logLevel is enabled for the module of the calling class.
+// message is only evaluated if it is logged. Classes select their module with a static logModule member, other code
+// logs to Module::General.
+#define LOG_MESSAGE(logLevel, message)                                                                                 \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr(static_cast<int>(logLevel) <= IOT_LOG_MAX_LEVEL)                                                  \
+        {                                                                                                              \
+            if(Utilities::Logger::isEnabled(logModule, logLevel))                                                      \
+                Utilities::Logger::logMessage(logModule, message, logLevel);                                           \
+        }                                                                                                              \
+    } while(0)
+
+// Like LOG_MESSAGE with the {} placeholders of format replaced by the arguments. The arguments are formatted later by
+// the log writer, the call itself only copies their values.
+#define LOG_FORMAT(logLevel, format, ...)                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr(static_cast<int>(logLevel) <= IOT_LOG_MAX_LEVEL)                                                  \
+        {                                                                                                              \
+            if(Utilities::Logger::isEnabled(logModule, logLevel))                                                      \
+            {                                                                                                          \
+                static const uint32_t logFormatId =                                                                    \
+                    Utilities::Logger::registerFormat(logModule, logLevel, __FILE__, __LINE__, format);                \
+                Utilities::Logger::logFormat(logFormatId, logLevel __VA_OPT__(, ) __VA_ARGS__);                        \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while(0)
 
 namespace Utilities
 {
+/* Messages are queued to a ring buffer of the logging thread and formatted and written in batches by a background
+ * thread. Every thread gets its own single producer ring, so logging takes no lock. A full ring drops the message
+ * and counts it, or makes the caller wait with OverflowPolicy::Block. Threads beyond the ring budget and the
+ * synchronous mode write directly under a mutex. Queued messages are written on flush(), at exit and before
+ * std::terminate aborts. With a binary output the writer stores messages and LOG_FORMAT arguments unformatted, see
+ * logFormat.hpp.
+ */
 class Logger
 {
-    // TODO: Improve this class, use << or at least variable args for messages
 public:
     enum class LogLevel : int
     {
@@ -18,17 +64,148 @@ public:
         Debug
     };
 
-    static void setGlobalLogLevel(LogLevel newGlobalLogLevel) { globalLogLevel = newGlobalLogLevel; }
+    // Classes that log, every module has its own effective log level
+    enum class Module : uint8_t
+    {
+        General = 0, // Code outside the classes below, logged without prefix
+        Server,
+        ServerNode,
+        Node,
+        NodeList,
+        AppNode,
+        DnsUpdater,
+        HistoryStore,
+        RegistryStore,
+        SqliteWriter,
+        BlobStore,
+        RollupStore,
+        LogFile,
+        Metrics,
+        Count
+    };
+
+    enum class OverflowPolicy
+    {
+        Drop = 0, // Count the message and continue, the count is logged once there is space again
+        Block,    // Wait for the background thread to make space
+    };
+
+    // The global level applies to every module without an override of its own
+    static void setGlobalLogLevel(LogLevel newGlobalLogLevel);
+    static void setModuleLogLevel(Module module, LogLevel logLevel);
+    static void resetModuleLogLevel(Module module);
+
+    // Applies overrides like "Node=Debug,Server=Warning", throws on unknown modules or levels
+    static void setModuleLogLevels(const std::string &overrides);
+    static void setOverflowPolicy(OverflowPolicy newOverflowPolicy) { overflowPolicy = newOverflowPolicy; }
+
+    // Synchronous logging writes every message before returning, flushes the queued messages when enabled
+    static void setSynchronous(bool newSynchronous);
+
+    // Log output is appended to path in binary form instead of being written to stdout and stderr, iot-log-decoder
+    // turns it into text. An empty path switches back to the console.
+    static void setBinaryOutput(const std::string &path);
+
+    // Log output goes to rotating log files, see logFile.hpp
+    static void setFileOutput(const LogFile::Config &config);
+    static void setConsoleOutput();
+
+    static bool isEnabled(Module module, LogLevel logLevel)
+    {
+        // Error is the lowest level that is logged, nothing is logged for a module at level None
+        return logLevel <= moduleLogLevels[static_cast<size_t>(module)].load(std::memory_order_relaxed);
+    }
+    static bool isEnabled(LogLevel logLevel) { return isEnabled(Module::General, logLevel); }
+
+    static const char *getModuleName(Module module);
 
     static void logMessage(std::string message, LogLevel logEntryLevel = LogLevel::Info);
+    static void logMessage(Module module, std::string_view message, LogLevel logEntryLevel);
+
+    // Used by LOG_FORMAT, registerFormat runs once per call site
+    static uint32_t
+        registerFormat(Module module, LogLevel logLevel, const char *file, uint32_t line, const char *format);
+    template <typename... Args>
+    static void logFormat(uint32_t formatId, LogLevel logLevel, const Args &...args);
+
+    // Blocks until every message logged before the call is written
+    static void flush();
+
+    static uint64_t getDroppedMessages() { return droppedMessages; }
+
+    // Appends every line of message with prefix and, if color is set, colors as they are written to the console
+    static void appendLines(std::string     &output,
+                            std::string_view message,
+                            LogLevel         logLevel,
+                            uint64_t         timestamp,
+                            bool             color = true);
 
 private:
-    inline static LogLevel   globalLogLevel;
-    inline static std::mutex loggerMutex;
-    static bool              logOutputAllowed(LogLevel logLevel);
-    static std::string       getLogprefix(Logger::LogLevel logLevel);
-    static std::string       getLogLevelString(LogLevel LogLevel);
-    static std::string       getColorPrefix(LogLevel LogLevel);
-    static std::string       getColorSuffix(LogLevel LogLevel);
+    struct Ring;
+    class Backend;
+    struct ThreadState;
+
+    // Call site of a LOG_FORMAT, file is a literal and format is prefixed with the module name
+    struct FormatInfo
+    {
+        LogLevel    logLevel;
+        const char *file;
+        uint32_t    line;
+        const char *format;
+    };
+
+    enum class RecordKind : uint8_t
+    {
+        Text = 0,
+        Formatted,
+    };
+
+    // Header of the records in the rings, followed by the message or the encoded arguments
+    struct RecordHeader
+    {
+        RecordKind kind;
+        uint8_t    logLevel;
+        uint16_t   reserved;
+        uint32_t   formatId;
+        uint64_t   timestamp;
+    };
+
+    static constexpr size_t ringSize     = 64 * 1024;
+    static constexpr size_t maxRingsNum  = 256; // Memory bound of the queued messages is ringSize * maxRingsNum
+    static constexpr size_t maxPrefixLen = 35;
+
+    inline static std::atomic<LogLevel>       globalLogLevel;
+    inline static std::atomic<LogLevel>       moduleLogLevels[static_cast<size_t>(Module::Count)];
+    inline static std::atomic<OverflowPolicy> overflowPolicy  = OverflowPolicy::Drop;
+    inline static std::atomic<bool>           synchronous     = false;
+    inline static std::atomic<uint64_t>       droppedMessages = 0;
+
+    static Backend *    getBackend();
+    static ThreadState &getThreadState();
+
+    // Space for a record of up to maxLen bytes or nullptr if it is dropped, queued or written by commitRecord
+    static uint8_t *beginRecord(RecordKind kind, LogLevel logLevel, uint32_t formatId, size_t maxLen);
+    static void     commitRecord(size_t len);
+
+    static void        appendPrefix(std::string &output, LogLevel logLevel, uint64_t timestamp);
+    static std::string getLogLevelString(LogLevel LogLevel);
+    static std::string getColorPrefix(LogLevel LogLevel);
+    static std::string getColorSuffix(LogLevel LogLevel);
 };
-} // namespace Utilities
\ No newline at end of file
+
+template <typename... Args>
+void Logger::logFormat(uint32_t formatId, LogLevel logLevel, const Args &...args)
+{
+    size_t   maxLen = (LogFormat::getMaxArgLen(args) + ... + 0);
+    uint8_t *data   = beginRecord(RecordKind::Formatted, logLevel, formatId, maxLen);
+    if(data == nullptr)
+        return;
+
+    uint8_t *end = data;
+    (LogFormat::encodeArg(end, args), ...);
+    commitRecord(end - data);
+}
+} // namespace Utilities
+
+// Module of the log macros outside of classes with their own logModule
+inline constexpr Utilities::Logger::Module logModule = Utilities::Logger::Module::General;
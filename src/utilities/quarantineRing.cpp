@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "quarantineRing.hpp"
+
+namespace Utilities
+{
+static constexpr size_t minDataLen = 4096;
+
+QuarantineRing::QuarantineRing(size_t len, const std::string &path)
+{
+    mapLen = headerLen + getAlignedLen(std::max(len, minDataLen));
+
+    void *ringMap = MAP_FAILED;
+    if(path.empty())
+    {
+        ringMap = mmap(nullptr, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    else
+    {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if(fd < 0)
+        {
+            throw std::runtime_error("Unable to open quarantine ring " + path);
+        }
+
+        // A ring of another size is started over, the same size keeps the records of earlier runs
+        struct stat status;
+        if(fstat(fd, &status) != 0 || size_t(status.st_size) != mapLen)
+        {
+            if(ftruncate(fd, 0) != 0 || ftruncate(fd, mapLen) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Unable to resize quarantine ring " + path);
+            }
+        }
+        ringMap = mmap(nullptr, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if(ringMap == MAP_FAILED)
+    {
+        if(fd >= 0)
+            close(fd);
+        throw std::runtime_error("mmap failed for quarantine ring " + path);
+    }
+
+    map    = static_cast<uint8_t *>(ringMap);
+    header = reinterpret_cast<Header *>(map);
+    data   = map + headerLen;
+
+    uint64_t dataLen = mapLen - headerLen;
+    if(header->magic != fileMagic || header->dataLen != dataLen || header->head > dataLen || header->tail > dataLen)
+    {
+        memset(header, 0, sizeof(Header));
+        header->magic   = fileMagic;
+        header->dataLen = dataLen;
+    }
+}
+
+QuarantineRing::~QuarantineRing()
+{
+    munmap(map, mapLen);
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+void QuarantineRing::store(uint32_t source, const uint8_t *frame, size_t len)
+{
+    uint64_t dataLen   = mapLen - headerLen;
+    uint32_t storedLen = static_cast<uint32_t>(std::min<size_t>(len, dataLen / 4 - recordHeaderLen));
+    size_t   recordLen = recordHeaderLen + getAlignedLen(storedLen);
+    uint32_t frameLen  = static_cast<uint32_t>(std::min<size_t>(len, UINT32_MAX - 1));
+    uint32_t reserved  = 0;
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(header->head + recordLen > dataLen)
+    {
+        // The records between head and the end are the oldest, they go before the ring continues at the start
+        while(header->recordsNum > 0 && header->tail >= header->head)
+            evictOldest();
+        if(header->head + sizeof(wrapMarker) <= dataLen)
+            memcpy(data + header->head, &wrapMarker, sizeof(wrapMarker));
+        header->head = 0;
+    }
+    while(header->recordsNum > 0 && header->tail >= header->head && header->tail < header->head + recordLen)
+        evictOldest();
+    if(header->recordsNum == 0)
+        header->tail = header->head;
+
+    uint8_t *record = data + header->head;
+    memcpy(record, &storedLen, sizeof(storedLen));
+    memcpy(record + 4, &frameLen, sizeof(frameLen));
+    memcpy(record + 8, &timestamp, sizeof(timestamp));
+    memcpy(record + 16, &source, sizeof(source));
+    memcpy(record + 20, &reserved, sizeof(reserved));
+    memcpy(record + recordHeaderLen, frame, storedLen);
+
+    header->head += recordLen;
+    header->recordsNum++;
+    header->totalStored++;
+}
+
+uint64_t QuarantineRing::getRecordsNum() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return header->recordsNum;
+}
+
+uint64_t QuarantineRing::getTotalStored() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return header->totalStored;
+}
+
+void QuarantineRing::evictOldest()
+{
+    uint32_t storedLen = wrapMarker;
+    if(header->tail + sizeof(storedLen) <= header->dataLen)
+        memcpy(&storedLen, data + header->tail, sizeof(storedLen));
+
+    if(storedLen == wrapMarker)
+    {
+        header->tail = 0;
+        return;
+    }
+    header->tail += recordHeaderLen + getAlignedLen(storedLen);
+    header->recordsNum--;
+}
+} // namespace Utilities
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+namespace Utilities
+{
+/* Keeps the raw bytes of rejected input, like malformed frames, for later inspection. The newest records overwrite
+ * the oldest once the ring is full. With a path the ring is a memory mapped file that survives restarts and crashes
+ * and is printed by iot-log-decoder, otherwise it is kept in memory.
+ *
+ * | Header (48 bytes) | Records ... |
+ *
+ * Header: | Magic (8) | Data len (8) | Head (8) | Tail (8) | Records (8) | Total stored (8) |
+ * Record: | Stored len (4) | Frame len (4) | Timestamp (8) | Source (4) | Reserved (4) | Data, padded to 8 bytes |
+ *
+ * Head and tail are offsets into the data after the header, records are kept from tail to head. A stored len of
+ * wrapMarker marks the end of the used data before the ring continues at offset 0. Frames longer than a quarter of
+ * the ring are stored truncated, frame len is the original length. Timestamps are nanoseconds since epoch.
+ */
+class QuarantineRing
+{
+public:
+    struct Record
+    {
+        uint32_t       storedLen;
+        uint32_t       frameLen;
+        uint64_t       timestamp;
+        uint32_t       source;
+        uint32_t       reserved;
+        const uint8_t *data;
+    };
+
+    static constexpr uint64_t fileMagic       = 0x31544E5251544F49; // "IOTQRNT1"
+    static constexpr size_t   headerLen       = 48;
+    static constexpr size_t   recordHeaderLen = 24;
+    static constexpr uint32_t wrapMarker      = 0xFFFFFFFF;
+
+    QuarantineRing() = delete;
+    QuarantineRing(size_t len, const std::string &path = "");
+    ~QuarantineRing();
+
+    QuarantineRing(const QuarantineRing &)            = delete;
+    QuarantineRing &operator=(const QuarantineRing &) = delete;
+
+    // Thread safe, source identifies the sender, e.g. a node id
+    void store(uint32_t source, const uint8_t *data, size_t len);
+
+    uint64_t getRecordsNum() const;
+    uint64_t getTotalStored() const;
+
+    // Calls callback(const Record &) for the kept records, oldest first
+    template <typename Callback>
+    void forEach(Callback callback) const;
+
+    // Same for the content of a ring file, returns false if it is not a valid ring
+    template <typename Callback>
+    static bool readRing(const uint8_t *ring, size_t len, Callback callback);
+
+private:
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t dataLen;
+        uint64_t head;
+        uint64_t tail;
+        uint64_t recordsNum;
+        uint64_t totalStored;
+    };
+    static_assert(sizeof(Header) == headerLen);
+
+    mutable std::mutex mutex;
+    uint8_t *          map    = nullptr;
+    size_t             mapLen = 0;
+    int                fd     = -1;
+    Header *           header = nullptr;
+    uint8_t *          data   = nullptr;
+
+    static size_t getAlignedLen(size_t len) { return (len + 7) & ~size_t(7); }
+
+    void evictOldest();
+};
+
+template <typename Callback>
+void QuarantineRing::forEach(Callback callback) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    readRing(map, mapLen, callback);
+}
+
+template <typename Callback>
+bool QuarantineRing::readRing(const uint8_t *ring, size_t len, Callback callback)
+{
+    Header ringHeader;
+    if(len < headerLen)
+        return false;
+    memcpy(&ringHeader, ring, sizeof(ringHeader));
+    if(ringHeader.magic != fileMagic || ringHeader.dataLen != len - headerLen || ringHeader.tail > ringHeader.dataLen)
+        return false;
+
+    const uint8_t *ringData = ring + headerLen;
+    uint64_t       offset   = ringHeader.tail;
+    for(uint64_t i = 0; i < ringHeader.recordsNum; i++)
+    {
+        Record record;
+        if(offset + sizeof(uint32_t) <= ringHeader.dataLen)
+            memcpy(&record.storedLen, ringData + offset, sizeof(record.storedLen));
+        if(offset + sizeof(uint32_t) > ringHeader.dataLen || record.storedLen == wrapMarker)
+        {
+            offset = 0;
+            memcpy(&record.storedLen, ringData, sizeof(record.storedLen));
+        }
+        if(offset + recordHeaderLen + record.storedLen > ringHeader.dataLen)
+            return false;
+
+        memcpy(&record.frameLen, ringData + offset + 4, sizeof(record.frameLen));
+        memcpy(&record.timestamp, ringData + offset + 8, sizeof(record.timestamp));
+        memcpy(&record.source, ringData + offset + 16, sizeof(record.source));
+        memcpy(&record.reserved, ringData + offset + 20, sizeof(record.reserved));
+        record.data = ringData + offset + recordHeaderLen;
+        callback(record);
+
+        offset += recordHeaderLen + getAlignedLen(record.storedLen);
+    }
+    return true;
+}
+} // namespace Utilities
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include "sha256.hpp"
+
+namespace Utilities
+{
+namespace
+{
+constexpr uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotateRight(uint32_t value, uint32_t bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+#if defined(__x86_64__)
+bool hasShaExtensions()
+{
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_SSE4_1) == 0 || (ecx & bit_SSSE3) == 0)
+        return false;
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & bit_SHA) != 0;
+}
+
+const bool shaExtensions = hasShaExtensions();
+
+// Block processing with the SHA extensions, 4 rounds per step with the state kept as ABEF and CDGH
+__attribute__((target("sha,sse4.1"))) void processBlocksSha(uint32_t *state, const uint8_t *data, size_t blocksNum)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i cdab   = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xB1);
+    __m128i efgh   = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(cdab, efgh, 8);   // ABEF
+    __m128i state1 = _mm_blend_epi16(efgh, cdab, 0xF0); // CDGH
+
+    for(size_t blockNum = 0; blockNum < blocksNum; blockNum++, data += 64)
+    {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+
+        __m128i w[16];
+        for(size_t g = 0; g < 16; g++)
+        {
+            if(g < 4)
+            {
+                w[g] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * g)), byteSwap);
+            }
+            else
+            {
+                __m128i sum = _mm_add_epi32(_mm_sha256msg1_epu32(w[g - 4], w[g - 3]),
+                                            _mm_alignr_epi8(w[g - 1], w[g - 2], 4));
+                w[g]        = _mm_sha256msg2_epu32(sum, w[g - 1]);
+            }
+
+            __m128i message = _mm_add_epi32(
+                w[g], _mm_loadu_si128(reinterpret_cast<const __m128i *>(&roundConstants[4 * g])));
+            state1  = _mm_sha256rnds2_epu32(state1, state0, message);
+            message = _mm_shuffle_epi32(message, 0x0E);
+            state0  = _mm_sha256rnds2_epu32(state0, state1, message);
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(state0, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0)); // DCBA
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));    // HGFE
+}
+#endif
+} // namespace
+
+void Sha256::init()
+{
+    state[0]   = 0x6a09e667;
+    state[1]   = 0xbb67ae85;
+    state[2]   = 0x3c6ef372;
+    state[3]   = 0xa54ff53a;
+    state[4]   = 0x510e527f;
+    state[5]   = 0x9b05688c;
+    state[6]   = 0x1f83d9ab;
+    state[7]   = 0x5be0cd19;
+    blockIndex = 0;
+    totalLen   = 0;
+}
+
+void Sha256::update(const uint8_t *data, size_t len)
+{
+    totalLen += len;
+
+    // Complete a partially filled block first, whole blocks are processed straight from data
+    if(blockIndex > 0)
+    {
+        size_t copyLen = std::min(len, blockLen - blockIndex);
+        memcpy(block + blockIndex, data, copyLen);
+        blockIndex += copyLen;
+        data += copyLen;
+        len -= copyLen;
+        if(blockIndex < blockLen)
+            return;
+
+        processBlocks(block, 1);
+        blockIndex = 0;
+    }
+
+    size_t blocksNum = len / blockLen;
+    processBlocks(data, blocksNum);
+    data += blocksNum * blockLen;
+    len -= blocksNum * blockLen;
+
+    memcpy(block, data, len);
+    blockIndex = len;
+}
+
+Sha256::Digest Sha256::finish()
+{
+    // Padding: 0x80, zeroes up to 56 bytes in the last block, message length in bits big endian
+    uint64_t bitsLen    = totalLen * 8;
+    block[blockIndex++] = 0x80;
+    if(blockIndex > blockLen - sizeof(bitsLen))
+    {
+        memset(block + blockIndex, 0, blockLen - blockIndex);
+        processBlocks(block, 1);
+        blockIndex = 0;
+    }
+    memset(block + blockIndex, 0, blockLen - sizeof(bitsLen) - blockIndex);
+    for(size_t i = 0; i < sizeof(bitsLen); i++)
+    {
+        block[blockLen - 1 - i] = static_cast<uint8_t>(bitsLen >> (8 * i));
+    }
+    processBlocks(block, 1);
+
+    Digest digest;
+    for(size_t i = 0; i < 8; i++)
+    {
+        digest[4 * i]     = static_cast<uint8_t>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+Sha256::Digest Sha256::calculate(const uint8_t *data, size_t len)
+{
+    Sha256 sha;
+    sha.update(data, len);
+    return sha.finish();
+}
+
+void Sha256::processBlocks(const uint8_t *data, size_t blocksNum)
+{
+#if defined(__x86_64__)
+    if(shaExtensions)
+    {
+        processBlocksSha(state, data, blocksNum);
+        return;
+    }
+#endif
+
+    for(size_t blockNum = 0; blockNum < blocksNum; blockNum++, data += blockLen)
+    {
+        uint32_t w[64];
+        for(size_t i = 0; i < 16; i++)
+        {
+            w[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 | (uint32_t)data[4 * i + 2] << 8 |
+                   (uint32_t)data[4 * i + 3];
+        }
+        for(size_t i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i]        = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for(size_t i = 0; i < 64; i++)
+        {
+            uint32_t s1    = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            uint32_t ch    = (e & f) ^ (~e & g);
+            uint32_t temp1 = h + s1 + ch + roundConstants[i] + w[i];
+            uint32_t s0    = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            uint32_t maj   = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t temp2 = s0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+} // namespace Utilities
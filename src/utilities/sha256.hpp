@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Utilities
+{
+// SHA-256 (FIPS 180-4), used where data is addressed by its content
+class Sha256
+{
+public:
+    static constexpr size_t digestLen = 32;
+    using Digest                      = std::array<uint8_t, digestLen>;
+
+    Sha256() { init(); }
+
+    // Starts a new calculation chain
+    void init();
+
+    // Adds data to the calculation chain
+    void update(const uint8_t *data, size_t len);
+
+    // Finishes the calculation chain, init has to be called before the instance is used again
+    Digest finish();
+
+    // Calculates the digest of data
+    static Digest calculate(const uint8_t *data, size_t len);
+
+private:
+    static constexpr size_t blockLen = 64;
+
+    uint32_t state[8];
+    uint8_t  block[blockLen];
+    size_t   blockIndex;
+    uint64_t totalLen;
+
+    void processBlocks(const uint8_t *data, size_t blocksNum);
+};
+
+// Hash functor for digests as unordered container keys, digests are uniformly distributed already
+struct DigestHasher
+{
+    size_t operator()(const Sha256::Digest &digest) const
+    {
+        size_t value = 0;
+        for(size_t i = 0; i < sizeof(value); i++)
+        {
+            value = (value << 8) | digest[i];
+        }
+        return value;
+    }
+};
+} // namespace Utilities
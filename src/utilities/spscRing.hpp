@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Utilities
+{
+/* Lock-free ring of variable length records between one producer and one consumer thread.
+ *
+ * | Record header (8 bytes) | Record | padding | Record header | ... |
+ *
+ * Records are 8 byte aligned and never wrap, a record that does not fit before the end of the buffer is preceded by
+ * a marker that skips the rest of the buffer. The producer reserves the maximum length of a record, writes it in
+ * place and commits the length it actually used.
+ */
+class SpscRing
+{
+public:
+    SpscRing() = delete;
+    SpscRing(size_t capacity) : buffer(capacity)
+    {
+        if(capacity < 2 * headerLen || (capacity & (capacity - 1)) != 0)
+        {
+            throw std::runtime_error("SpscRing capacity has to be a power of two, capacity=" +
+                                     std::to_string(capacity));
+        }
+    }
+
+    // Largest record that can be reserved
+    size_t getMaxRecordLen() const { return buffer.size() / 2 - headerLen; }
+
+    // Producer side: space for maxLen bytes or nullptr if the ring is full, visible to the consumer after commit
+    uint8_t *reserve(size_t maxLen)
+    {
+        if(maxLen > getMaxRecordLen())
+            return nullptr;
+
+        size_t capacity = buffer.size();
+        size_t headPos  = head.load(std::memory_order_relaxed);
+        size_t tailPos  = tail.load(std::memory_order_acquire);
+        size_t offset   = headPos & (capacity - 1);
+        size_t skipLen  = capacity - offset < getRecordLen(maxLen) ? capacity - offset : 0;
+        if(capacity - (headPos - tailPos) < skipLen + getRecordLen(maxLen))
+            return nullptr;
+
+        if(skipLen > 0)
+        {
+            uint32_t marker = skipMarker;
+            memcpy(buffer.data() + offset, &marker, sizeof(marker));
+            headPos += skipLen;
+            offset = 0;
+        }
+        reservedPos = headPos;
+        return buffer.data() + offset + headerLen;
+    }
+
+    void commit(size_t len)
+    {
+        uint32_t recordLen = static_cast<uint32_t>(len);
+        memcpy(buffer.data() + (reservedPos & (buffer.size() - 1)), &recordLen, sizeof(recordLen));
+        head.store(reservedPos + getRecordLen(len), std::memory_order_release);
+    }
+
+    size_t getUsed() const { return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed); }
+    bool   isEmpty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+    // Consumer side: calls callback(data, len) for every committed record and returns the position to release once
+    // the records are not used anymore
+    template <typename Callback>
+    size_t read(Callback callback) const
+    {
+        size_t tailPos = tail.load(std::memory_order_relaxed);
+        size_t headPos = head.load(std::memory_order_acquire);
+        while(tailPos != headPos)
+        {
+            size_t   offset    = tailPos & (buffer.size() - 1);
+            uint32_t recordLen = 0;
+            memcpy(&recordLen, buffer.data() + offset, sizeof(recordLen));
+            if(recordLen == skipMarker)
+            {
+                tailPos += buffer.size() - offset;
+                continue;
+            }
+
+            callback(buffer.data() + offset + headerLen, size_t(recordLen));
+            tailPos += getRecordLen(recordLen);
+        }
+        return tailPos;
+    }
+
+    void release(size_t tailPos) { tail.store(tailPos, std::memory_order_release); }
+
+private:
+    static constexpr size_t   headerLen  = 8;
+    static constexpr uint32_t skipMarker = UINT32_MAX;
+
+    std::vector<uint8_t> buffer;
+    size_t               reservedPos = 0; // Producer only
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+    static size_t getRecordLen(size_t len) { return (headerLen + len + headerLen - 1) & ~(headerLen - 1); }
+};
+} // namespace Utilities
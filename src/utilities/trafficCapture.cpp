@@ -0,0 +1,133 @@
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "trafficCapture.hpp"
+
+namespace Utilities
+{
+TrafficCapture::TrafficCapture(const std::string &path, std::chrono::milliseconds flushInterval) :
+    flushInterval(flushInterval), startTime(std::chrono::steady_clock::now())
+{
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Unable to open traffic capture " + path);
+    }
+
+    auto     now               = std::chrono::system_clock::now().time_since_epoch();
+    uint8_t  header[headerLen] = {0};
+    uint64_t magic             = fileMagic;
+    uint64_t start             = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    memcpy(header, &magic, sizeof(magic));
+    memcpy(header + sizeof(magic), &start, sizeof(start));
+    if(write(fd, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)))
+    {
+        close(fd);
+        throw std::runtime_error("Unable to write traffic capture " + path);
+    }
+
+    writerThread = std::thread(writerThreadProcess, this);
+}
+
+TrafficCapture::~TrafficCapture()
+{
+    inDestruction = true;
+    if(writerThread.joinable())
+    {
+        writerThread.join();
+    }
+    flush();
+    close(fd);
+}
+
+void TrafficCapture::record(uint32_t connectionId, const uint8_t *data, size_t len)
+{
+    Shard &shard = shards[connectionId % shardsNum];
+
+    // The time is taken under the lock, so it only grows within a block and the deltas stay short
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if(shard.records.size() + len + 3 * 10 > maxShardDataLen)
+    {
+        droppedNum.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    if(shard.records.empty())
+    {
+        shard.baseTime = time;
+        shard.lastTime = time;
+    }
+    appendVarint(shard.records, time - shard.lastTime);
+    appendVarint(shard.records, connectionId);
+    appendVarint(shard.records, len);
+    shard.records.insert(shard.records.end(), data, data + len);
+    shard.lastTime = time;
+}
+
+void TrafficCapture::writerThreadProcess(TrafficCapture *self)
+{
+    while(!self->inDestruction)
+    {
+        std::this_thread::sleep_for(std::min(self->flushInterval, std::chrono::milliseconds(100)));
+        self->flush();
+    }
+}
+
+void TrafficCapture::flush()
+{
+    std::vector<uint8_t> records;
+    for(Shard &shard : shards)
+    {
+        uint64_t baseTime = 0;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if(shard.records.empty())
+                continue;
+
+            // The emptied buffer keeps its capacity for the next interval
+            records.swap(shard.records);
+            shard.records.reserve(records.capacity());
+            baseTime = shard.baseTime;
+        }
+
+        uint8_t  header[blockHeaderLen];
+        uint32_t recordsLen = records.size();
+        uint32_t crc        = crc32_instance.calculate(records.data(), recordsLen);
+        memcpy(header, &recordsLen, sizeof(recordsLen));
+        memcpy(header + 4, &crc, sizeof(crc));
+        memcpy(header + 8, &baseTime, sizeof(baseTime));
+        if(write(fd, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)) ||
+           write(fd, records.data(), records.size()) != static_cast<ssize_t>(records.size()))
+        {
+            droppedNum.fetch_add(1, std::memory_order_relaxed);
+        }
+        records.clear();
+    }
+}
+
+void TrafficCapture::appendVarint(std::vector<uint8_t> &output, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        output.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<uint8_t>(value));
+}
+
+bool TrafficCapture::readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for(unsigned shift = 0; data < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *data++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+} // namespace Utilities
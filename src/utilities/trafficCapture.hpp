@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "message/crc.hpp"
+
+namespace Utilities
+{
+/* Captures the data nodes send to the server as it is read, with the time and the connection it came from, so that a
+ * workload can be replayed later (iot-traffic-replay). Node data threads append a record to a buffer under the lock
+ * of one of a few shards, a writer thread writes the buffers out as blocks every flush interval. A node is never held
+ * up by the disk, records that do not fit into a full buffer are dropped and counted.
+ *
+ * | Header (24 bytes) | Block | Block | ... |
+ *
+ * Header: | Magic (8) | Start time (8) | Reserved (8) |
+ * Block:  | Records len (4) | CRC32 of the records (4) | Base time (8) | Records |
+ * Record: | Time delta (varint) | Connection ID (varint) | Data len (varint) | Data |
+ *
+ * Start time is nanoseconds since epoch, base time nanoseconds after the start time and every time delta nanoseconds
+ * after the previous record of the block, the first one after the base time. Varints are LEB128. Data len 0 marks
+ * the end of a connection. The records of a connection are all in blocks of the same shard and in order, a torn
+ * block at the end of a file after a crash ends the records.
+ */
+class TrafficCapture
+{
+public:
+    struct Record
+    {
+        uint64_t       time; // Nanoseconds after the start time
+        uint32_t       connectionId;
+        const uint8_t *data;
+        size_t         len;
+    };
+
+    static constexpr uint64_t fileMagic      = 0x3154504143544F49; // "IOTCAPT1"
+    static constexpr size_t   headerLen      = 24;
+    static constexpr size_t   blockHeaderLen = 16;
+
+    TrafficCapture() = delete;
+    TrafficCapture(const std::string &path, std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100));
+    ~TrafficCapture();
+
+    TrafficCapture(const TrafficCapture &)            = delete;
+    TrafficCapture &operator=(const TrafficCapture &) = delete;
+
+    // Thread safe, len 0 ends the connection
+    void record(uint32_t connectionId, const uint8_t *data, size_t len);
+    void recordClose(uint32_t connectionId) { record(connectionId, nullptr, 0); }
+
+    uint64_t getDroppedNum() const { return droppedNum.load(std::memory_order_relaxed); }
+
+    // Calls callback(const Record &) for the records of a capture file's content in file order and returns the start
+    // time, 0 if it is not a capture
+    template <typename Callback>
+    static uint64_t readCapture(const uint8_t *data, size_t len, Callback callback);
+
+private:
+    static constexpr size_t shardsNum       = 16;
+    static constexpr size_t maxShardDataLen = 8 * 1024 * 1024; // Per flush interval
+
+    struct alignas(64) Shard
+    {
+        std::mutex           mutex; // Guards the members below
+        std::vector<uint8_t> records;
+        uint64_t             baseTime = 0;
+        uint64_t             lastTime = 0;
+    };
+
+    int                                   fd = -1;
+    std::chrono::milliseconds             flushInterval;
+    std::chrono::steady_clock::time_point startTime;
+    Shard                                 shards[shardsNum];
+    std::atomic<uint64_t>                 droppedNum    = 0;
+    std::atomic<bool>                     inDestruction = false;
+    std::thread                           writerThread;
+
+    static void writerThreadProcess(TrafficCapture *self);
+
+    void flush();
+
+    static void appendVarint(std::vector<uint8_t> &output, uint64_t value);
+    static bool readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value);
+};
+
+template <typename Callback>
+uint64_t TrafficCapture::readCapture(const uint8_t *data, size_t len, Callback callback)
+{
+    uint64_t magic     = 0;
+    uint64_t startTime = 0;
+    if(len < headerLen)
+        return 0;
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&startTime, data + sizeof(magic), sizeof(startTime));
+    if(magic != fileMagic)
+        return 0;
+
+    size_t offset = headerLen;
+    while(offset + blockHeaderLen <= len)
+    {
+        uint32_t recordsLen = 0;
+        uint32_t crc        = 0;
+        uint64_t time       = 0;
+        memcpy(&recordsLen, data + offset, sizeof(recordsLen));
+        memcpy(&crc, data + offset + 4, sizeof(crc));
+        memcpy(&time, data + offset + 8, sizeof(time));
+        const uint8_t *records = data + offset + blockHeaderLen;
+        if(recordsLen == 0 || recordsLen > len - offset - blockHeaderLen ||
+           crc32_instance.calculate(records, recordsLen) != crc)
+            break;
+
+        const uint8_t *end = records + recordsLen;
+        while(records < end)
+        {
+            uint64_t delta        = 0;
+            uint64_t connectionId = 0;
+            uint64_t dataLen      = 0;
+            if(!readVarint(records, end, delta) || !readVarint(records, end, connectionId) ||
+               !readVarint(records, end, dataLen) || dataLen > size_t(end - records))
+                break;
+
+            time += delta;
+            callback(Record{time, static_cast<uint32_t>(connectionId), records, size_t(dataLen)});
+            records += dataLen;
+        }
+        offset += blockHeaderLen + recordsLen;
+    }
+    return startTime;
+}
+} // namespace Utilities